@@ -1,11 +1,44 @@
 #ifndef AUTOMATA_ALGORITHM_H
 #define AUTOMATA_ALGORITHM_H
 
+#include <stdlib.h>
+
 #include "nfa.h"
 #include "dfa.h"
 
+typedef enum subset_status
+{
+    SUBSET_SUCCESS = 0,
+    SUBSET_STATE_LIMIT,
+    SUBSET_MEMORY_LIMIT,
+    SUBSET_TIME_LIMIT
+} SUBSET_STATUS;
+
+// limits of a subset construction, a limit of zero is unlimited
+struct subset_construction_options
+{
+    // maximum number of DFA states
+    size_t max_states;
+    // maximum approximate number of bytes used by the DFA states and their NFA state sets
+    size_t max_memory;
+    // maximum wall clock time in milliseconds
+    size_t max_milliseconds;
+};
+
 DFA subset_construction(NFA nfa);
 
+/**
+ * constructs the DFA equivalent to an NFA, giving up once any limit is exceeded. all memory
+ * allocated by the construction is released when it gives up, so callers can fall back to
+ * simulating the NFA.
+ *
+ * @param nfa the NFA
+ * @param options the limits of the construction; null for no limits
+ * @param status the location to store the outcome of the construction; may be null
+ * @return the DFA; null if a limit was exceeded
+ */
+DFA subset_construction_limited(NFA nfa, const struct subset_construction_options *options, SUBSET_STATUS *status);
+
 DFA minimize_dstates(DFA dfa);
 
 #endif
\ No newline at end of file
@@ -17,5 +17,7 @@
 #include "nfa.h"
 #include "dfa.h"
 #include "dot.h"
+#include "frozen_dfa.h"
+#include "bitset_nfa.h"
 
 #endif
\ No newline at end of file
@@ -0,0 +1,173 @@
+/**
+ * interface of module for bitset simulation of nondeterministic finite automata.
+ *
+ * a bitset NFA is an immutable, table-driven form of a medium sized NFA. the active
+ * states of a simulation are a bit vector. symbols are compressed into equivalence
+ * classes, and for every class and state the table holds the states reached from the
+ * state on the class as a bit vector with the epsilon closure already applied. a step
+ * is the union of the rows of the active states, a loop over whole words which the
+ * compiler vectorizes.
+ *
+ * only states which can be left on a symbol or which are accepting get a bit, the other
+ * states of a closure are never needed once the closure has been taken.
+ */
+
+#ifndef BITSET_NFA_H
+#define BITSET_NFA_H
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "nfa.h"
+
+// NFAs with more states are not turned into bitset NFAs
+#define BITSET_NFA_MAX_STATES 4096
+// the largest number of words of the bit vector of a bitset NFA
+#define BITSET_NFA_MAX_WORDS (BITSET_NFA_MAX_STATES / 64)
+// NFAs whose table would take more bytes are not turned into bitset NFAs
+#define BITSET_NFA_MAX_MEMORY (64ul << 20)
+
+typedef struct bitset_nondeterministic_finite_automaton * BITSET_NFA;
+
+/**
+ * creates the bitset form of an NFA. the NFA is not modified and may be destroyed
+ * independently of the bitset NFA.
+ *
+ * @param automaton the NFA to convert
+ * @return the newly created bitset NFA; null if the NFA has more than
+ * `BITSET_NFA_MAX_STATES` states or its table exceeds `BITSET_NFA_MAX_MEMORY` bytes
+ */
+BITSET_NFA nfa_bitset(NFA automaton);
+
+/**
+ * creates the bitset form of an NFA whose input bytes are folded before they are matched,
+ * e.g. to lowercase. the folding is built into the byte class map.
+ *
+ * @param automaton the NFA to convert
+ * @param fold the byte every byte 0-255 folds to; null if the bytes are not folded
+ * @return the newly created bitset NFA; null if the NFA has more than
+ * `BITSET_NFA_MAX_STATES` states or its table exceeds `BITSET_NFA_MAX_MEMORY` bytes
+ */
+BITSET_NFA nfa_bitset_folded(NFA automaton, const unsigned char *fold);
+
+/**
+ * destroys a bitset NFA
+ *
+ * @param automaton the bitset NFA to destroy
+ */
+void bitset_nfa_free(BITSET_NFA automaton);
+
+/**
+ * retrieves the number of bits of the state vector of the bitset NFA, which is the
+ * number of states that can be left on a symbol or are accepting
+ *
+ * @param automaton the bitset NFA
+ * @return the number of bits of a state vector of `automaton`
+ */
+size_t bitset_nfa_count_bits(BITSET_NFA automaton);
+
+/**
+ * retrieves the number of symbol equivalence classes in the bitset NFA, including the
+ * class of symbols without any transition
+ *
+ * @param automaton the bitset NFA
+ * @return the number of symbol classes in `automaton`
+ */
+size_t bitset_nfa_count_classes(BITSET_NFA automaton);
+
+/**
+ * retrieves the number of 64-bit words of a state vector of the bitset NFA
+ *
+ * @param automaton the bitset NFA
+ * @return the number of words of a state vector, at most `BITSET_NFA_MAX_WORDS`
+ */
+size_t bitset_nfa_words(BITSET_NFA automaton);
+
+/**
+ * retrieves the size in bytes of the bitset NFA
+ *
+ * @param automaton the bitset NFA
+ * @return the number of bytes used by `automaton`
+ */
+size_t bitset_nfa_footprint(BITSET_NFA automaton);
+
+/**
+ * writes the starting state vector of the bitset NFA
+ *
+ * @param automaton the bitset NFA
+ * @param active the state vector to write, `bitset_nfa_words` words long
+ */
+void bitset_nfa_start(BITSET_NFA automaton, uint64_t *active);
+
+/**
+ * computes the states reached from a state vector on a symbol
+ *
+ * @param automaton the bitset NFA
+ * @param active the state vector the step starts from
+ * @param next the state vector to write the states reached to, distinct from `active`
+ * @param sym the symbol that causes the transition
+ * @return nonzero if any state is reached; zero if the simulation is dead
+ */
+int bitset_nfa_step(BITSET_NFA automaton, const uint64_t *active, uint64_t *next, SYMBOL sym);
+
+/**
+ * determines if a state vector of the bitset NFA contains an accepting state
+ *
+ * @param automaton the bitset NFA
+ * @param active the state vector
+ * @return nonzero if `active` contains an accepting state; zero otherwise
+ */
+int bitset_nfa_is_accepting(BITSET_NFA automaton, const uint64_t *active);
+
+/**
+ * determines if the bitset NFA accepts the following string
+ *
+ * @param automaton the bitset NFA
+ * @param string the zero terminated string to check for acceptance
+ * @return true if the automaton accepts the string; false otherwise
+ */
+int bitset_nfa_accept(BITSET_NFA automaton, SYMBOL *string);
+
+/**
+ * determines if the bitset NFA accepts the following c-style string
+ *
+ * @param automaton the bitset NFA
+ * @param string the null terminated char string to check for acceptance
+ * @return true if the automaton accepts the string; false otherwise
+ */
+int bitset_nfa_accept_cstr(BITSET_NFA automaton, const char *string);
+
+/**
+ * determines if the bitset NFA accepts a string of bytes of a given length.
+ * the string may contain the symbol 0.
+ *
+ * @param automaton the bitset NFA
+ * @param symbols the symbols of the string
+ * @param length the number of symbols
+ * @return true if the automaton accepts the string; false otherwise
+ */
+int bitset_nfa_accept_u8(BITSET_NFA automaton, const uint8_t *symbols, size_t length);
+
+/**
+ * determines if the bitset NFA accepts a string of 16-bit symbols of a given length.
+ * the string may contain the symbol 0.
+ *
+ * @param automaton the bitset NFA
+ * @param symbols the symbols of the string
+ * @param length the number of symbols
+ * @return true if the automaton accepts the string; false otherwise
+ */
+int bitset_nfa_accept_u16(BITSET_NFA automaton, const uint16_t *symbols, size_t length);
+
+/**
+ * determines if the bitset NFA accepts a string of symbols of a given length.
+ * the string may contain the symbol 0.
+ *
+ * @param automaton the bitset NFA
+ * @param symbols the symbols of the string
+ * @param length the number of symbols
+ * @return true if the automaton accepts the string; false otherwise
+ */
+int bitset_nfa_accept_symbols(BITSET_NFA automaton, const SYMBOL *symbols, size_t length);
+
+#endif
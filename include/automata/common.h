@@ -1,12 +1,20 @@
 #ifndef COMMON_H
 #define COMMON_H
 
+typedef int SYMBOL;
+
 typedef enum sim_status
 {
     SIM_FAILURE = -1,
     SIM_SUCCESS = 0
 } SIM_STATUS;
 
+// an inclusive range of symbols
+struct symbol_range
+{
+    SYMBOL lo, hi;
+};
+
 extern const int EPSILON;
 
-#endif
\ No newline at end of file
+#endif
@@ -2,13 +2,22 @@
 #define DFA_H
 
 #include <stdlib.h>
+#include <stdint.h>
 
 #include "common.h"
+#include "utility/arena.h"
 
 typedef int SYMBOL;
 
 typedef struct deterministic_state * DSTATE;
 
+// a transition on every symbol of an inclusive range
+struct dstate_range_transition
+{
+    SYMBOL lo, hi;
+    DSTATE to;
+};
+
 /**
  * creates a new deterministc state
  * 
@@ -16,6 +25,15 @@ typedef struct deterministic_state * DSTATE;
  */
 DSTATE dstate_new();
 
+/**
+ * creates a new deterministic state allocated from an arena. the state and its
+ * transitions are released together with the arena, `dstate_free` does nothing.
+ * 
+ * @param arena the arena to allocate the state from
+ * @return a newly allocated empty deterministic state
+ */
+DSTATE dstate_arena_new(ARENA arena);
+
 /**
  * releases and destroys a deterministic state
  * 
@@ -41,6 +59,15 @@ DSTATE dstate_debug_new(const char *debug_tag);
  */
 const char *dstate_tag(DSTATE state);
 
+/**
+ * retrieves the id of a state within the DFA owning it. the states of a DFA
+ * are numbered consecutively from zero in breadth-first order.
+ * 
+ * @param state the state
+ * @return the id of the state; -1 if the state has never been owned by a DFA
+ */
+int dstate_id(DSTATE state);
+
 /**
  * adds a new transition to the deterministic state
  * 
@@ -51,6 +78,33 @@ const char *dstate_tag(DSTATE state);
  */
 int dstate_add_transition(DSTATE from, SYMBOL sym, DSTATE to);
 
+/**
+ * adds a new transition on every symbol of a range to the deterministic state. a range of
+ * a single symbol is added as a transition on that symbol. the transitions on ranges are
+ * found by `dstate_get_transition_state` but kept apart from the transitions on single
+ * symbols otherwise, they are only listed by `dstate_view_range_transitions`.
+ * 
+ * @param from the state the transition starts from
+ * @param lo the smallest symbol of the range
+ * @param hi the largest symbol of the range
+ * @param to the state the transition sends in
+ * @return zero on success; nonzero if the range is empty, contains epsilon or overlaps
+ * any other transition of the state
+ */
+int dstate_add_range_transition(DSTATE from, SYMBOL lo, SYMBOL hi, DSTATE to);
+
+/**
+ * borrows the transitions on ranges of symbols out of a state, sorted by their symbols.
+ * the ranges are disjoint.
+ * 
+ * @param state the state
+ * @param count the location to store the number of range transitions
+ * @return the range transitions out of `state`, NULL if none
+ * @warning the view is owned by the state and invalidated the moment the transitions
+ * of the state are modified
+ */
+const struct dstate_range_transition *dstate_view_range_transitions(DSTATE state, size_t *count);
+
 /**
  * removes a transition from a state to another state on a symbol
  * 
@@ -139,6 +193,19 @@ typedef struct deterministic_finite_automaton * DFA;
  */
 DFA dfa_new(DSTATE starting_state, DSTATE *accepting_states, size_t num_accepting_states);
 
+/**
+ * creates a new DFA whose states were all allocated from an arena with `dstate_arena_new`.
+ * the DFA takes ownership of the arena, destroying the DFA releases the arena at once
+ * instead of destroying the states one by one.
+ * 
+ * @param starting_state the starting state for the DFA
+ * @param accepting_states a list of accepting states
+ * @param num_accepting_states the number of accepting states
+ * @param arena the arena holding the states
+ * @return the newly created DFA if valid, null on any error
+ */
+DFA dfa_new_arena(DSTATE starting_state, DSTATE *accepting_states, size_t num_accepting_states, ARENA arena);
+
 /**
  * destroys a nondeterministic finite automata (DFA)
  * 
@@ -208,6 +275,39 @@ int dfa_accept(DFA automaton, SYMBOL *string);
  */
 int dfa_accept_cstr(DFA automaton, char *string);
 
+/**
+ * determines if the automaton accepts a string of bytes of a given length.
+ * the string may contain the symbol 0.
+ *
+ * @param automaton the DFA
+ * @param symbols the symbols of the string
+ * @param length the number of symbols
+ * @return true if the automaton accepts the string; false otherwise
+ */
+int dfa_accept_u8(DFA automaton, const uint8_t *symbols, size_t length);
+
+/**
+ * determines if the automaton accepts a string of 16-bit symbols of a given length.
+ * the string may contain the symbol 0.
+ *
+ * @param automaton the DFA
+ * @param symbols the symbols of the string
+ * @param length the number of symbols
+ * @return true if the automaton accepts the string; false otherwise
+ */
+int dfa_accept_u16(DFA automaton, const uint16_t *symbols, size_t length);
+
+/**
+ * determines if the automaton accepts a string of symbols of a given length.
+ * the string may contain the symbol 0.
+ *
+ * @param automaton the DFA
+ * @param symbols the symbols of the string
+ * @param length the number of symbols
+ * @return true if the automaton accepts the string; false otherwise
+ */
+int dfa_accept_symbols(DFA automaton, const SYMBOL *symbols, size_t length);
+
 /**
  * prints the DFA in a debug friendly way
  * 
@@ -227,6 +327,34 @@ typedef struct DFA_simulator * DFA_SIM;
  */
 DFA_SIM dfa_sim_init(DFA automaton);
 
+/**
+ * retrieves the number of bytes of scratch space a simulator of the DFA needs
+ *
+ * @param automaton the automaton to simulate
+ * @return the size of the scratch space for `dfa_sim_init_scratch`
+ */
+size_t dfa_sim_scratch_size(DFA automaton);
+
+/**
+ * creates a simulator of the DFA within caller provided scratch space, which makes
+ * matching free of heap allocations
+ *
+ * @param automaton the automaton to simulate
+ * @param scratch the scratch space, aligned for any type
+ * @param size the size of the scratch space in bytes
+ * @return the object used to simulate the DFA; null if the scratch space is too small
+ * or misaligned
+ * @warning the scratch space must outlive the simulator
+ */
+DFA_SIM dfa_sim_init_scratch(DFA automaton, void *scratch, size_t size);
+
+/**
+ * restarts the DFA simulator on a new input
+ *
+ * @param sim the simulator to reset
+ */
+void dfa_sim_reset(DFA_SIM sim);
+
 /**
  * steps through the DFA simulator with an input symbol
  * 
@@ -236,7 +364,16 @@ DFA_SIM dfa_sim_init(DFA automaton);
 void dfa_sim_step(DFA_SIM sim, SYMBOL input_sym);
 
 /**
- * destroys the DFA simulator 
+ * retrieves the status of the DFA simulator on the input so far
+ *
+ * @param sim the simulator
+ * @return `SIM_SUCCESS` if the input so far is accepted; `SIM_FAILURE` otherwise
+ */
+SIM_STATUS dfa_sim_status(DFA_SIM sim);
+
+/**
+ * destroys the DFA simulator. the scratch space of a simulator created with
+ * `dfa_sim_init_scratch` is left to the caller.
  * 
  * @param sim the simulator to destroy
  * @return the final simulator status before destruction
@@ -0,0 +1,242 @@
+/**
+ * interface of module for frozen deterministic finite automata.
+ *
+ * a frozen DFA is an immutable, table-driven form of a DFA. states are numbered
+ * in breadth-first order from the starting state, symbols are compressed into
+ * equivalence classes and the transitions are stored in a dense state x class
+ * table. state 0 is always the dead state, every transition out of it leads
+ * back to itself.
+ *
+ * the in-memory representation of a frozen DFA is a single contiguous image
+ * which is identical to the on-disk format. the image is position-independent
+ * (all sections are referenced via offsets from the start of the image), so a
+ * saved image can be mapped read-only with `dfa_load_mmap` and shared between
+ * many processes through the page cache without copying.
+ *
+ * image layout (all offsets are 8-byte aligned, integers in native byte order):
+ * 1. header (magic, version, section offsets, checksum)
+ * 2. class map for the symbols 0-255 (256 x uint32)
+ * 3. class map for all other symbols as sorted, disjoint ranges
+ * 4. transition table (num_states x num_classes x uint32)
+ * 5. state flags (num_states x uint8)
+ *
+ * besides accepting states, the flags mark the states the executors need not leave:
+ * dead states, from which no accepting state can be reached, and universal states, from
+ * which every continuation is accepted. an executor returns as soon as it enters either.
+ */
+
+#ifndef FROZEN_DFA_H
+#define FROZEN_DFA_H
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "dfa.h"
+
+#define FROZEN_DFA_MAGIC 0x46445852u   // "RXDF"
+#define FROZEN_DFA_VERSION 1
+
+// the dead state of every frozen DFA
+#define FROZEN_DEAD_STATE 0
+
+// state flags stored in the image
+#define FROZEN_ACCEPTING 0x1
+// no accepting state can be reached from the state
+#define FROZEN_DEAD 0x2
+// the state is accepting and every string of symbols other than `EPSILON` leads to an accepting state
+#define FROZEN_UNIVERSAL 0x4
+// the state is accepting and every string of the bytes 1-255 leads to an accepting state
+#define FROZEN_TEXT_UNIVERSAL 0x8
+
+typedef struct frozen_deterministic_finite_automaton * FROZEN_DFA;
+
+/**
+ * creates the frozen form of a DFA. the DFA is not modified and may be
+ * destroyed independently of the frozen DFA.
+ *
+ * @param automaton the DFA to freeze
+ * @return the newly created frozen DFA; null on any error
+ */
+FROZEN_DFA dfa_freeze(DFA automaton);
+
+/**
+ * creates the frozen form of a DFA whose input bytes are folded before they are matched,
+ * e.g. to lowercase. the folding is built into the byte class map, every byte takes the
+ * class of the byte it folds to.
+ *
+ * @param automaton the DFA to freeze
+ * @param fold the byte every byte 0-255 folds to; null if the bytes are not folded
+ * @return the newly created frozen DFA; null on any error
+ */
+FROZEN_DFA dfa_freeze_folded(DFA automaton, const unsigned char *fold);
+
+/**
+ * destroys a frozen DFA. if the frozen DFA was loaded with `dfa_load_mmap`,
+ * the mapping is released.
+ *
+ * @param automaton the frozen DFA to destroy
+ */
+void frozen_dfa_free(FROZEN_DFA automaton);
+
+/**
+ * retrieves the number of states in the frozen DFA, including the dead state
+ *
+ * @param automaton the frozen DFA
+ * @return the number of states in `automaton`
+ */
+size_t frozen_dfa_count_states(FROZEN_DFA automaton);
+
+/**
+ * retrieves the number of symbol equivalence classes in the frozen DFA,
+ * including the class of symbols without any transition
+ *
+ * @param automaton the frozen DFA
+ * @return the number of symbol classes in `automaton`
+ */
+size_t frozen_dfa_count_classes(FROZEN_DFA automaton);
+
+/**
+ * retrieves the size in bytes of the image backing the frozen DFA
+ *
+ * @param automaton the frozen DFA
+ * @return the size of the image of `automaton`
+ */
+size_t frozen_dfa_footprint(FROZEN_DFA automaton);
+
+/**
+ * retrieves the checksum of the image backing the frozen DFA. the images of the same
+ * DFA are identical, so the checksum identifies the numbering of its states.
+ *
+ * @param automaton the frozen DFA
+ * @return the checksum stored in the image of `automaton`
+ */
+uint64_t frozen_dfa_checksum(FROZEN_DFA automaton);
+
+/**
+ * retrieves the starting state of the frozen DFA
+ *
+ * @param automaton the frozen DFA
+ * @return the id of the starting state
+ */
+uint32_t frozen_dfa_start(FROZEN_DFA automaton);
+
+/**
+ * retrieves the state reached from a state on a symbol
+ *
+ * @param automaton the frozen DFA
+ * @param state the id of the state the transition starts from
+ * @param sym the symbol that causes the transition
+ * @return the id of the state reached; `FROZEN_DEAD_STATE` if there is no transition
+ */
+uint32_t frozen_dfa_step(FROZEN_DFA automaton, uint32_t state, SYMBOL sym);
+
+/**
+ * determines if a state of the frozen DFA is accepting
+ *
+ * @param automaton the frozen DFA
+ * @param state the id of the state
+ * @return nonzero if `state` is accepting; zero otherwise
+ */
+int frozen_dfa_is_accepting(FROZEN_DFA automaton, uint32_t state);
+
+/**
+ * determines if no accepting state can be reached from a state of the frozen DFA
+ *
+ * @param automaton the frozen DFA
+ * @param state the id of the state
+ * @return nonzero if `state` is dead; zero otherwise
+ */
+int frozen_dfa_is_dead(FROZEN_DFA automaton, uint32_t state);
+
+/**
+ * determines if a state of the frozen DFA is accepting and every string of symbols
+ * other than `EPSILON` leads from it to an accepting state
+ *
+ * @param automaton the frozen DFA
+ * @param state the id of the state
+ * @return nonzero if `state` is universal; zero otherwise
+ */
+int frozen_dfa_is_universal(FROZEN_DFA automaton, uint32_t state);
+
+/**
+ * determines if the frozen DFA accepts the following string
+ *
+ * @param automaton the frozen DFA
+ * @param string the zero terminated string to check for acceptance
+ * @return true if the automaton accepts the string; false otherwise
+ */
+int frozen_dfa_accept(FROZEN_DFA automaton, SYMBOL *string);
+
+/**
+ * determines if the frozen DFA accepts the following c-style string
+ *
+ * @param automaton the frozen DFA
+ * @param string the null terminated char string to check for acceptance
+ * @return true if the automaton accepts the string; false otherwise
+ */
+int frozen_dfa_accept_cstr(FROZEN_DFA automaton, char *string);
+
+/**
+ * determines if the frozen DFA accepts a string of bytes of a given length.
+ * the string may contain the symbol 0.
+ *
+ * @param automaton the frozen DFA
+ * @param symbols the symbols of the string
+ * @param length the number of symbols
+ * @return true if the automaton accepts the string; false otherwise
+ */
+int frozen_dfa_accept_u8(FROZEN_DFA automaton, const uint8_t *symbols, size_t length);
+
+/**
+ * determines if the frozen DFA accepts a string of 16-bit symbols of a given length.
+ * the string may contain the symbol 0.
+ *
+ * @param automaton the frozen DFA
+ * @param symbols the symbols of the string
+ * @param length the number of symbols
+ * @return true if the automaton accepts the string; false otherwise
+ */
+int frozen_dfa_accept_u16(FROZEN_DFA automaton, const uint16_t *symbols, size_t length);
+
+/**
+ * determines if the frozen DFA accepts a string of symbols of a given length.
+ * the string may contain the symbol 0.
+ *
+ * @param automaton the frozen DFA
+ * @param symbols the symbols of the string
+ * @param length the number of symbols
+ * @return true if the automaton accepts the string; false otherwise
+ */
+int frozen_dfa_accept_symbols(FROZEN_DFA automaton, const SYMBOL *symbols, size_t length);
+
+/**
+ * writes the image of a frozen DFA to a file. the image is written to a temporary file
+ * which atomically replaces `filename`, so concurrent readers never see a partial image.
+ *
+ * @param automaton the frozen DFA to save
+ * @param filename the file to write the image to
+ * @return zero on success; nonzero otherwise
+ */
+int frozen_dfa_save(FROZEN_DFA automaton, const char *filename);
+
+/**
+ * freezes a DFA and writes its image to a file
+ *
+ * @param automaton the DFA to save
+ * @param filename the file to write the image to
+ * @return zero on success; nonzero otherwise
+ */
+int dfa_save(DFA automaton, const char *filename);
+
+/**
+ * maps a saved image read-only into memory. the image is validated (magic,
+ * version, section bounds and checksum) but never copied.
+ *
+ * @param filename the file containing the image
+ * @return the frozen DFA backed by the mapping; null if the file could not be
+ * mapped or is not a valid image
+ * @warning the frozen DFA must be destroyed using `frozen_dfa_free`
+ */
+FROZEN_DFA dfa_load_mmap(const char *filename);
+
+#endif
@@ -2,14 +2,33 @@
 #define NFA_H
 
 #include <stdlib.h>
+#include <stdint.h>
 
 #include "common.h"
 #include "macro.h"
 
+#include "utility/map.h"
+
 typedef int SYMBOL;
 
 typedef struct nondeterministic_state * NSTATE;
 
+// a transition on every symbol of an inclusive range
+struct nstate_range_transition
+{
+    SYMBOL lo, hi;
+    NSTATE to;
+};
+
+/**
+ * an iterator over the transitions of a state, grouped by symbol. the fields are private,
+ * the struct is only public so iterators can be placed on the stack.
+ */
+struct nstate_transition_iterator
+{
+    struct map_iterator transitions;
+};
+
 /**
  * creates a new nondeterministic state
  * 
@@ -42,6 +61,15 @@ NSTATE nstate_debug_new(const char *debug_tag);
  */
 const char *nstate_tag(NSTATE state);
 
+/**
+ * retrieves the id of a state within the NFA owning it. the states of an NFA
+ * are numbered consecutively from zero in breadth-first order.
+ * 
+ * @param state the state
+ * @return the id of the state; -1 if the state has never been owned by an NFA
+ */
+int nstate_id(NSTATE state);
+
 /**
  * adds a new transition to the nondeterministic state
  * 
@@ -119,6 +147,69 @@ NSTATE *nstate_get_transition_states(NSTATE state, SYMBOL sym);
  */
 size_t nstate_count_transition_states(NSTATE state, SYMBOL sym);
 
+/**
+ * borrows the states which are reached via a symbol on a provided state
+ * without copying them.
+ * 
+ * @param state the starting state
+ * @param sym the symbol
+ * @param count the location to store the number of states reached
+ * @return the states reached via `sym` starting at `state`, NULL if none
+ * @warning the view is owned by the state and invalidated the moment the
+ * transitions of the state are modified
+ */
+const NSTATE *nstate_view_transition_states(NSTATE state, SYMBOL sym, size_t *count);
+
+/**
+ * adds a new transition on every symbol of a range to the nondeterministic state. a
+ * range of a single symbol is added as a transition on that symbol. the transitions on
+ * a range are kept apart from the transitions on single symbols, they are only visible
+ * through `nstate_view_range_transitions`.
+ * 
+ * @param from the state the transition starts from
+ * @param lo the smallest symbol of the range
+ * @param hi the largest symbol of the range
+ * @param to the state the transition sends in
+ * @return zero on success; nonzero if the range is empty, contains epsilon or the
+ * transition already exists
+ */
+int nstate_add_range_transition(NSTATE from, SYMBOL lo, SYMBOL hi, NSTATE to);
+
+/**
+ * borrows the transitions on ranges of symbols out of a state. the ranges of different
+ * transitions may overlap.
+ * 
+ * @param state the state
+ * @param count the location to store the number of range transitions
+ * @return the range transitions out of `state`, NULL if none
+ * @warning the view is owned by the state and invalidated the moment the
+ * transitions of the state are modified
+ */
+const struct nstate_range_transition *nstate_view_range_transitions(NSTATE state, size_t *count);
+
+/**
+ * starts an iteration over the transitions of a state with an iterator owned
+ * by the caller. the iterator needs no destruction.
+ * 
+ * @param iterator the iterator to start
+ * @param state the state whose transitions are iterated
+ * @warning the iterator is invalidated the moment the transitions of the state are modified
+ */
+void nstate_transition_iterator_begin(struct nstate_transition_iterator *iterator, NSTATE state);
+
+/**
+ * advances the iterator to the next symbol with transitions and borrows the
+ * states reached via the symbol.
+ * 
+ * @param iterator the iterator to advance
+ * @param sym the location to store the symbol; may be null
+ * @param states the location to store the view of the states reached; may be null
+ * @param count the location to store the number of states reached; may be null
+ * @return nonzero if there was another symbol; zero once all symbols have been visited
+ */
+int nstate_transition_iterator_next(struct nstate_transition_iterator *iterator, SYMBOL *sym,
+    const NSTATE **states, size_t *count);
+
 /**
  * returns if there is a transition from one state to another on a symbol
  * 
@@ -200,6 +291,27 @@ size_t nfa_count_accepting_states(NFA automaton);
  */
 NSTATE *nfa_get_states(NFA automaton);
 
+/**
+ * borrows the list of all the states in the NFA without copying it. the
+ * number of states is given by `nfa_count_states` and every state is
+ * stored at the position given by `nstate_id`
+ * 
+ * @param automaton the NFA to view the states of
+ * @return the list of all the states in the automaton
+ * @warning the list is owned by the automaton and must not be freed
+ */
+const NSTATE *nfa_view_states(NFA automaton);
+
+/**
+ * borrows the list of the accepting states of the NFA without copying it. the
+ * number of states is given by `nfa_count_accepting_states`
+ * 
+ * @param automaton the NFA to view the accepting states of
+ * @return the list of the accepting states of the automaton
+ * @warning the list is owned by the automaton and must not be freed
+ */
+const NSTATE *nfa_view_accepting_states(NFA automaton);
+
 /**
  * retrieves the total number of states in the automaton
  * 
@@ -228,6 +340,39 @@ int nfa_accept(NFA automaton, SYMBOL *string);
  */
 int nfa_accept_cstr(NFA automaton, char *string);
 
+/**
+ * determines if the automaton accepts a string of bytes of a given length.
+ * the string may contain the symbol 0.
+ *
+ * @param automaton the NFA
+ * @param symbols the symbols of the string
+ * @param length the number of symbols
+ * @return true if the automaton accepts the string; false otherwise
+ */
+int nfa_accept_u8(NFA automaton, const uint8_t *symbols, size_t length);
+
+/**
+ * determines if the automaton accepts a string of 16-bit symbols of a given length.
+ * the string may contain the symbol 0.
+ *
+ * @param automaton the NFA
+ * @param symbols the symbols of the string
+ * @param length the number of symbols
+ * @return true if the automaton accepts the string; false otherwise
+ */
+int nfa_accept_u16(NFA automaton, const uint16_t *symbols, size_t length);
+
+/**
+ * determines if the automaton accepts a string of symbols of a given length.
+ * the string may contain the symbol 0.
+ *
+ * @param automaton the NFA
+ * @param symbols the symbols of the string
+ * @param length the number of symbols
+ * @return true if the automaton accepts the string; false otherwise
+ */
+int nfa_accept_symbols(NFA automaton, const SYMBOL *symbols, size_t length);
+
 /**
  * prints the NFA in a debug friendly way
  * 
@@ -240,13 +385,45 @@ void nfa_debug_display(NFA automaton);
 typedef struct NFA_simulator * NFA_SIM;
 
 /**
- * creates a new object for simulating the NFA
+ * creates a new object for simulating the NFA. the first simulator of an NFA flattens its
+ * transitions into per-state lists, which are shared by every later simulator.
  * 
  * @param automaton the automaton to simulate
  * @return the object used to simulate the NFA
+ * @warning the transitions of the states must not change once the NFA is simulated
  */
 NFA_SIM nfa_sim_init(NFA automaton);
 
+/**
+ * retrieves the number of bytes of scratch space a simulator of the NFA needs
+ *
+ * @param automaton the automaton to simulate
+ * @return the size of the scratch space for `nfa_sim_init_scratch`
+ * @warning the size is only valid as long as no states are added to the NFA
+ */
+size_t nfa_sim_scratch_size(NFA automaton);
+
+/**
+ * creates a simulator of the NFA within caller provided scratch space. the simulator never
+ * allocates, so keeping the scratch space around (e.g. per thread) makes matching free
+ * of heap allocations.
+ *
+ * @param automaton the automaton to simulate
+ * @param scratch the scratch space, aligned for any type
+ * @param size the size of the scratch space in bytes
+ * @return the object used to simulate the NFA; null if the scratch space is too small
+ * or misaligned
+ * @warning the scratch space must outlive the simulator
+ */
+NFA_SIM nfa_sim_init_scratch(NFA automaton, void *scratch, size_t size);
+
+/**
+ * restarts the NFA simulator on a new input
+ *
+ * @param sim the simulator to reset
+ */
+void nfa_sim_reset(NFA_SIM sim);
+
 /**
  * steps through the NFA simulator with an input symbol
  * 
@@ -256,7 +433,16 @@ NFA_SIM nfa_sim_init(NFA automaton);
 void nfa_sim_step(NFA_SIM sim, SYMBOL input_sym);
 
 /**
- * destroys the NFA simulator 
+ * retrieves the status of the NFA simulator on the input so far
+ *
+ * @param sim the simulator
+ * @return `SIM_SUCCESS` if the input so far is accepted; `SIM_FAILURE` otherwise
+ */
+SIM_STATUS nfa_sim_status(NFA_SIM sim);
+
+/**
+ * destroys the NFA simulator. the scratch space of a simulator created with
+ * `nfa_sim_init_scratch` is left to the caller.
  * 
  * @param sim the simulator to destroy
  * @return the final simulator status before destruction
@@ -265,12 +451,27 @@ SIM_STATUS nfa_sim_fini(NFA_SIM sim);
 
 // ------------------------------------------------------------------------ //
 
+/**
+ * components are immutable expressions. structurally identical components are shared, so
+ * building the same subexpression twice yields the same component. every function taking
+ * components takes over the components passed to it.
+ */
 typedef struct nfa_component * NFA_COMPONENT;
 
+// emits the states of a component, repetitions are expanded here
 NFA nfa_construct(NFA_COMPONENT component);
 
 NFA_COMPONENT nfa_symbol(SYMBOL sym);
 
+// matches any one of the provided symbols
+NFA_COMPONENT nfa_symbols(const SYMBOL *symbols, size_t count);
+
+// matches any one symbol within the ranges, each range becomes a single transition
+NFA_COMPONENT nfa_ranges(const struct symbol_range *ranges, size_t count);
+
+// matches the empty string
+NFA_COMPONENT nfa_epsilon();
+
 NFA_COMPONENT nfa_union(NFA_COMPONENT a, NFA_COMPONENT b);
 
 NFA_COMPONENT nfa_concat(NFA_COMPONENT a, NFA_COMPONENT b);
@@ -283,6 +484,26 @@ NFA_COMPONENT nfa_repeat_min(NFA_COMPONENT a, size_t min);
 
 NFA_COMPONENT nfa_repeat_min_max(NFA_COMPONENT a, size_t min, size_t max);
 
+/**
+ * concatenates any number of components into a single component. unlike repeated calls
+ * to `nfa_concat`, the result is not nested however many components there are.
+ *
+ * @param components the components to concatenate, the references are taken over
+ * @param count the number of components
+ * @return the concatenation; null if there are no components
+ */
+NFA_COMPONENT nfa_concat_array(const NFA_COMPONENT *components, size_t count);
+
+/**
+ * creates the union of any number of components. unlike repeated calls to `nfa_union`,
+ * the result is not nested however many components there are.
+ *
+ * @param components the alternatives, the references are taken over
+ * @param count the number of components
+ * @return the union; null if there are no components
+ */
+NFA_COMPONENT nfa_union_array(const NFA_COMPONENT *components, size_t count);
+
 NFA_COMPONENT nfa_concat_va(size_t count, ...);
 
 // macro for concat many components together
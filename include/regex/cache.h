@@ -0,0 +1,89 @@
+/**
+ * interface of module for caching compiled regular expressions.
+ *
+ * compiled regexes are keyed by their normalized pattern and compile flags, so patterns
+ * which only differ in their spelling share a single compiled regex. the cache holds a
+ * reference to every cached regex and evicts the least recently used regexes once the
+ * total footprint exceeds the capacity of the cache. the footprint of a cached regex is
+ * sampled again on every hit, so it catches up with the promotion of a tiered regex to a
+ * DFA. all functions are thread-safe.
+ *
+ * a cache may additionally be backed by a directory. compiled automata are then saved to
+ * the directory, named by a hash of the normalized pattern, the flags and the compiler
+ * version, so later processes map them instead of compiling the pattern again.
+ */
+
+#ifndef REGEX_CACHE_H
+#define REGEX_CACHE_H
+
+#include <stdlib.h>
+
+#include "regex.h"
+
+typedef struct regex_cache * REGEX_CACHE;
+
+struct regex_cache_stats
+{
+    size_t hits;
+    size_t misses;
+    size_t evictions;
+    size_t disk_hits;
+    size_t disk_writes;
+    size_t entries;
+    size_t footprint;
+};
+
+/**
+ * creates an empty cache
+ *
+ * @param capacity the maximum total footprint in bytes of the cached regexes
+ * @return the newly created cache
+ */
+REGEX_CACHE regex_cache_init(size_t capacity);
+
+/**
+ * destroys a cache and releases its references to the cached regexes
+ *
+ * @param cache the cache to destroy
+ */
+void regex_cache_fini(REGEX_CACHE cache);
+
+/**
+ * backs the cache with a directory of saved automata. the directory is created if it
+ * does not exist. regexes matched with the NFA simulator are never saved. a miss on a
+ * tiered regex waits for its DFA so the DFA can be saved.
+ *
+ * @param cache the cache
+ * @param directory the directory of saved automata; null to stop using a directory
+ * @return zero on success; nonzero if the directory could not be created
+ */
+int regex_cache_set_directory(REGEX_CACHE cache, const char *directory);
+
+/**
+ * retrieves the compiled regex for a pattern. on a miss, the regex is loaded from the
+ * directory of the cache or compiled and saved to the directory.
+ *
+ * @param cache the cache
+ * @param pattern the null terminated pattern
+ * @param flags the compile flags
+ * @return a new reference to the compiled regex; null if the pattern is invalid
+ * @warning the returned reference must be released using `regex_release`
+ */
+REGEX regex_cache_get(REGEX_CACHE cache, const char *pattern, int flags);
+
+/**
+ * removes all regexes from the cache. the counters are not reset.
+ *
+ * @param cache the cache to clear
+ */
+void regex_cache_clear(REGEX_CACHE cache);
+
+/**
+ * retrieves the counters of the cache
+ *
+ * @param cache the cache
+ * @param stats the location to store the counters
+ */
+void regex_cache_stats(REGEX_CACHE cache, struct regex_cache_stats *stats);
+
+#endif
@@ -0,0 +1,172 @@
+/**
+ * interface of module for matching a regex against many concurrent streams of input.
+ *
+ * a flow table keeps the state of the match of every flow, e.g. a TCP connection, keyed by
+ * a 64-bit flow id. the state of a flow is a packed entry of the id, the DFA state, the
+ * offset and the time it was last seen, stored inline in an open addressing table, so no
+ * memory is allocated per flow. flows are created by their first chunk of input.
+ *
+ * the table is split into shards by the hash of the flow id. every shard has its own lock
+ * and memory, so threads pinned to different cores scan the flows of different shards
+ * without contention. batches of chunks are sorted by shard and flow, so the entry of a
+ * flow is looked up once for all of its chunks in the batch and each shard is locked
+ * once per batch.
+ *
+ * matches are reported like the matches of a stream: for every prefix of the input of a
+ * flow the regex matches, at the length of the prefix.
+ */
+
+#ifndef REGEX_FLOW_TABLE_H
+#define REGEX_FLOW_TABLE_H
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "regex.h"
+
+typedef struct flow_table * FLOW_TABLE;
+
+/**
+ * called by a flow table for every prefix of the input of a flow the regex matches. the
+ * lock of the shard of the flow is held, the callback must not call into the table.
+ *
+ * @param flow_id the id of the flow
+ * @param offset the length of the matched prefix, counted from the start of the flow
+ * @param context the context the table was created with
+ * @return zero to continue matching; nonzero to stop matching the flow
+ */
+typedef int (*FLOW_MATCH_CALLBACK)(uint64_t flow_id, size_t offset, void *context);
+
+// a chunk of input of a flow
+struct flow_chunk
+{
+    uint64_t flow_id;
+    // the time the chunk arrived, in units chosen by the caller
+    uint64_t time;
+    const void *data;
+    size_t length;
+};
+
+struct flow_table_stats
+{
+    size_t flows;
+    size_t scans;
+    size_t bytes;
+    size_t matches;
+    size_t evictions;
+};
+
+// the counters of a pcap replay, see `flow_table_replay_pcap`
+struct flow_replay_stats
+{
+    size_t packets;
+    // packets with a TCP or UDP payload over IPv4, the only ones scanned
+    size_t scanned;
+    size_t bytes;
+};
+
+/**
+ * creates an empty flow table matching a regex
+ *
+ * @param regex the regex, the table holds a reference to it
+ * @param num_shards the number of shards; zero for one shard per online processor
+ * @param on_match the function called for every match
+ * @param context the context passed to `on_match`; may be null
+ * @return the newly created flow table; null if `regex` is not matched with a DFA
+ * @warning waits for the promotion of a tiered regex, see `regex_wait_promotion`
+ */
+FLOW_TABLE flow_table_init(REGEX regex, size_t num_shards, FLOW_MATCH_CALLBACK on_match, void *context);
+
+/**
+ * destroys a flow table and every flow in it. no match is reported.
+ *
+ * @param table the table to destroy
+ */
+void flow_table_fini(FLOW_TABLE table);
+
+/**
+ * retrieves the number of shards of the flow table
+ *
+ * @param table the table
+ * @return the number of shards of `table`
+ */
+size_t flow_table_count_shards(FLOW_TABLE table);
+
+/**
+ * retrieves the shard a flow belongs to, e.g. to hand the flow to the thread of the shard
+ *
+ * @param table the table
+ * @param flow_id the id of the flow
+ * @return the index of the shard of `flow_id`
+ */
+size_t flow_table_shard(FLOW_TABLE table, uint64_t flow_id);
+
+/**
+ * matches the next chunk of input of a flow. the flow is created if it is not in the table.
+ *
+ * @param table the table
+ * @param flow_id the id of the flow
+ * @param data the chunk of input, any byte including 0 is matched
+ * @param length the length of the chunk in bytes
+ * @param time the time the chunk arrived
+ * @return zero on success; nonzero if the callback has stopped the flow, later chunks of
+ * the flow are then ignored
+ */
+int flow_table_scan(FLOW_TABLE table, uint64_t flow_id, const void *data, size_t length, uint64_t time);
+
+/**
+ * matches a batch of chunks of any flows. the chunks of a flow are matched in the order
+ * they appear in the batch.
+ *
+ * @param table the table
+ * @param chunks the chunks
+ * @param count the number of chunks
+ * @return the number of matches reported
+ */
+size_t flow_table_scan_batch(FLOW_TABLE table, const struct flow_chunk *chunks, size_t count);
+
+/**
+ * ends the input of a flow and removes it from the table
+ *
+ * @param table the table
+ * @param flow_id the id of the flow
+ * @return nonzero if the regex matches the entire input of the flow; zero if it does not
+ * or the callback has stopped the flow; negative if the flow is not in the table
+ */
+int flow_table_close(FLOW_TABLE table, uint64_t flow_id);
+
+/**
+ * removes every flow which was last seen before a point in time. no match is reported.
+ *
+ * @param table the table
+ * @param before the time before which flows are idle
+ * @return the number of flows removed
+ */
+size_t flow_table_evict_idle(FLOW_TABLE table, uint64_t before);
+
+/**
+ * retrieves the counters of the table, summed over the shards
+ *
+ * @param table the table
+ * @param stats the location to store the counters
+ */
+void flow_table_stats(FLOW_TABLE table, struct flow_table_stats *stats);
+
+/**
+ * replays the packets of a pcap capture file into a flow table. the TCP and UDP payloads
+ * of IPv4 packets over ethernet or raw IP links are scanned in batches, keyed by the
+ * 5-tuple of the packet, at the capture time in microseconds. packets are scanned in
+ * capture order, TCP segments are neither reordered nor deduplicated. the flows are left
+ * in the table at the end of the capture.
+ *
+ * @param table the table
+ * @param filename the capture file
+ * @param idle_timeout the number of microseconds after which an idle flow is evicted;
+ * zero to never evict flows
+ * @param stats the location to store the counters of the replay; may be null
+ * @return zero on success; nonzero if the file could not be read or is not a pcap capture
+ */
+int flow_table_replay_pcap(FLOW_TABLE table, const char *filename, uint64_t idle_timeout,
+    struct flow_replay_stats *stats);
+
+#endif
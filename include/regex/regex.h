@@ -0,0 +1,363 @@
+/**
+ * interface of module for compiling and matching regular expressions.
+ *
+ * the pattern syntax supports:
+ * 1. literals and escapes (\n, \t, \r, \f, \v, \xHH and escaped metacharacters)
+ * 2. character classes ([abc], [a-z], [^a-z], \d, \w, \s and their negations)
+ * 3. the wildcard `.` which matches any byte except the newline
+ * 4. grouping with parentheses and alternation with `|`
+ * 5. the quantifiers *, +, ?, {m}, {m,} and {m,n}
+ *
+ * patterns are matched against entire byte strings. the byte 0 terminates the input and can
+ * therefore not be matched. a stream matches input which arrives in chunks instead and
+ * reports every prefix of the input the pattern matches, chunks may contain any byte.
+ *
+ * with `REGEX_UTF8`, the symbols of a pattern are codepoints (\xHH and \x{H...} denote
+ * codepoints as well) and are matched by their UTF-8 encodings.
+ */
+
+#ifndef REGEX_H
+#define REGEX_H
+
+#include <stdlib.h>
+
+#include "automata/nfa.h"
+#include "automata/frozen_dfa.h"
+
+// compile flags, without any engine flag the engine is chosen by analyzing the pattern
+#define REGEX_DEFAULT 0x0
+// match with the NFA simulator, the pattern is not determinized
+#define REGEX_NFA 0x1
+// match with the NFA simulator right away and switch to a DFA built in the background
+#define REGEX_TIERED 0x2
+// match with a DFA built before the regex is returned
+#define REGEX_DFA 0x4
+// the pattern and the input are UTF-8: literals, escapes and classes denote codepoints, the
+// wildcard and negated classes match any encoded codepoint. the automaton matches the raw
+// bytes of the encodings, so the input is never decoded.
+#define REGEX_UTF8 0x8
+// letters match regardless of their case. ASCII input is folded to lowercase through the
+// byte class map at scan time, so the automaton is as large as the case-sensitive one.
+// UTF-8 patterns additionally match the latin-1, latin extended-a, greek and cyrillic
+// letters in either case, their multibyte encodings are folded within the pattern.
+#define REGEX_ICASE 0x10
+
+// version of the pattern compiler, bumped whenever the same pattern may compile into a
+// different automaton. saved regexes of another version are never reused.
+#define REGEX_COMPILER_VERSION 2
+
+typedef struct regex * REGEX;
+
+typedef struct regex_stream * REGEX_STREAM;
+
+/**
+ * called by a stream for every prefix of its input the regex matches
+ *
+ * @param offset the length of the matched prefix, counted from the start of the stream
+ * @param context the context the stream was opened with
+ * @return zero to continue matching; nonzero to stop the stream
+ */
+typedef int (*REGEX_MATCH_CALLBACK)(size_t offset, void *context);
+
+// the size in bytes of a snapshot of a stream, see `regex_stream_snapshot`
+#define REGEX_STREAM_SNAPSHOT_SIZE 16
+
+enum regex_engine
+{
+    REGEX_ENGINE_NFA,
+    REGEX_ENGINE_DFA,
+    REGEX_ENGINE_TIERED
+};
+
+// static properties of a pattern, see `regex_analyze`
+struct regex_analysis
+{
+    // number of symbol occurrences after counted repetitions are expanded
+    size_t positions;
+    // positions which may also be consumed by an unbounded repetition in front of them
+    size_t ambiguous_positions;
+    // estimated number of symbol equivalence classes, including the class without transitions
+    size_t symbol_classes;
+    // nonzero if the pattern matches exactly one string
+    int is_literal;
+    // length of the string matched by a literal pattern
+    size_t literal_length;
+    // estimated number of DFA states, including the dead state
+    size_t dfa_states;
+    // estimated number of bytes of the frozen DFA
+    size_t dfa_memory;
+};
+
+// effect of the rewrite pass applied to every pattern, see `regex_simplify`
+struct regex_simplification
+{
+    // number of expression nodes after the rewrite
+    size_t nodes;
+    // number of expression nodes removed by the rewrite
+    size_t nodes_saved;
+    // number of NFA states constructed after the rewrite
+    size_t states;
+    // number of NFA states the rewrite saves
+    size_t states_saved;
+};
+
+/**
+ * parses a pattern into an NFA component
+ *
+ * @param pattern the null terminated pattern
+ * @param flags the compile flags
+ * @return the component matching the pattern; null if the pattern is invalid
+ */
+NFA_COMPONENT regex_parse(const char *pattern, int flags);
+
+/**
+ * creates the normalized form of a pattern. patterns which only differ in their spelling
+ * (redundant groups, equivalent quantifiers, order of class members, escapes) have the
+ * same normalized form.
+ *
+ * @param pattern the null terminated pattern
+ * @param flags the compile flags
+ * @return the dynamically allocated normalized pattern; null if the pattern is invalid
+ * @warning the string returned by this function is dynamically allocated and must be freed
+ */
+char *regex_normalize(const char *pattern, int flags);
+
+/**
+ * reports the effect of the rewrite pass applied to a pattern before construction. the
+ * pass folds nested repetitions such as `(a*)*`, drops duplicate alternatives such as
+ * `a|a`, merges the classes of an alternation, turns empty alternatives into `?` and
+ * adjacent repetitions such as `aa*` into counted forms.
+ *
+ * @param pattern the null terminated pattern
+ * @param flags the compile flags
+ * @param report the location to store the savings
+ * @return zero on success; nonzero if the pattern is invalid
+ */
+int regex_simplify(const char *pattern, int flags, struct regex_simplification *report);
+
+/**
+ * analyzes a pattern without constructing any automaton. the estimated number of DFA
+ * states grows exponentially with the number of ambiguous positions, which is the
+ * textbook blowup of patterns such as `(a|b)*a(a|b){n}`. the estimate predicts the cost
+ * of a pattern before any subset construction is started.
+ *
+ * @param pattern the null terminated pattern
+ * @param flags the compile flags
+ * @param analysis the location to store the analysis
+ * @return zero on success; nonzero if the pattern is invalid
+ */
+int regex_analyze(const char *pattern, int flags, struct regex_analysis *analysis);
+
+/**
+ * compiles a pattern. the compiled regex is immutable and reference counted, it may be
+ * shared between threads.
+ *
+ * @param pattern the null terminated pattern
+ * @param flags the compile flags
+ * @return the compiled regex with a single reference; null if the pattern is invalid
+ */
+REGEX regex_compile(const char *pattern, int flags);
+
+/**
+ * acquires a new reference to a compiled regex
+ *
+ * @param regex the regex
+ * @return `regex`
+ */
+REGEX regex_retain(REGEX regex);
+
+/**
+ * releases a reference to a compiled regex. the regex is destroyed once the last
+ * reference is released.
+ *
+ * @param regex the regex
+ */
+void regex_release(REGEX regex);
+
+/**
+ * retrieves the flags the regex was compiled with
+ *
+ * @param regex the regex
+ * @return the compile flags of `regex`
+ */
+int regex_flags(REGEX regex);
+
+/**
+ * estimates the number of bytes used by a compiled regex
+ *
+ * @param regex the regex
+ * @return the approximate memory footprint of `regex` in bytes
+ */
+size_t regex_footprint(REGEX regex);
+
+/**
+ * retrieves the engine chosen for a regex
+ *
+ * @param regex the regex
+ * @return the engine `regex` is matched with
+ */
+enum regex_engine regex_engine(REGEX regex);
+
+/**
+ * borrows the frozen DFA a regex is matched with, e.g. to drive it with a custom executor.
+ * the DFA of a tiered regex is only present once the promotion is finished, callers which
+ * need it wait for it with `regex_wait_promotion`.
+ *
+ * @param regex the regex
+ * @return the frozen DFA of `regex`; null if `regex` is matched with an NFA
+ * @warning the DFA is owned by the regex and lives as long as the regex
+ */
+FROZEN_DFA regex_dfa(REGEX regex);
+
+/**
+ * describes the plan of a regex: the chosen engine, the reasons for the choice, the
+ * analysis of the pattern and the estimated and actual memory
+ *
+ * @param regex the regex
+ * @return the dynamically allocated, human readable description
+ * @warning the string returned by this function is dynamically allocated and must be freed
+ */
+char *regex_explain(REGEX regex);
+
+/**
+ * waits until the background construction of the DFA of a tiered regex is finished.
+ * returns immediately for regexes which are not tiered.
+ *
+ * @param regex the regex
+ * @return nonzero if `regex` is matched with a DFA; zero otherwise
+ */
+int regex_wait_promotion(REGEX regex);
+
+/**
+ * determines if the regex matches an entire string
+ *
+ * @param regex the regex
+ * @param string the null terminated string
+ * @return nonzero if `regex` matches `string`; zero otherwise
+ */
+int regex_match(REGEX regex, const char *string);
+
+/**
+ * determines if the regex matches an entire buffer of bytes given by its length. the
+ * buffer may contain the byte 0, which no pattern matches.
+ *
+ * @param regex the regex
+ * @param data the bytes to match
+ * @param length the number of bytes
+ * @return nonzero if `regex` matches the bytes; zero otherwise
+ */
+int regex_match_bytes(REGEX regex, const void *data, size_t length);
+
+/**
+ * retrieves the number of bytes of scratch space `regex_match_scratch` needs. a regex
+ * matched with a DFA needs none.
+ *
+ * @param regex the regex
+ * @return the size of the scratch space for matching `regex`
+ */
+size_t regex_scratch_size(REGEX regex);
+
+/**
+ * determines if the regex matches an entire string without allocating any memory. the
+ * scratch space may be reused for any number of matches, e.g. one per thread.
+ *
+ * @param regex the regex
+ * @param string the null terminated string
+ * @param scratch the scratch space, aligned for any type
+ * @param size the size of the scratch space, at least `regex_scratch_size`
+ * @return nonzero if `regex` matches `string`; zero otherwise; negative if the scratch
+ * space is too small or misaligned
+ */
+int regex_match_scratch(REGEX regex, const char *string, void *scratch, size_t size);
+
+/**
+ * opens a stream matching the regex against input fed in chunks. the stream holds a
+ * reference to the regex and keeps matching with the engine in use when it was opened.
+ *
+ * @param regex the regex
+ * @param on_match the function called for every matched prefix of the input
+ * @param context the context passed to `on_match`; may be null
+ * @return the newly opened stream
+ * @warning the stream must be destroyed using `regex_stream_close`
+ */
+REGEX_STREAM regex_stream_open(REGEX regex, REGEX_MATCH_CALLBACK on_match, void *context);
+
+/**
+ * matches the next chunk of input. the state of the match carries across chunks, so the
+ * input is never copied or buffered. matches are reported as soon as their last byte has
+ * been fed, the empty prefix is reported by the first call.
+ *
+ * @param stream the stream
+ * @param data the chunk of input, any byte including 0 is matched
+ * @param length the length of the chunk in bytes
+ * @return zero on success; nonzero if the callback has stopped the stream, later chunks
+ * are then ignored
+ */
+int regex_stream_feed(REGEX_STREAM stream, const void *data, size_t length);
+
+/**
+ * ends the input of a stream and destroys it. a match of the empty input is reported if
+ * no chunk has been fed.
+ *
+ * @param stream the stream to close
+ * @return nonzero if the regex matches the entire input of the stream; zero otherwise or if
+ * the callback has stopped the stream
+ */
+int regex_stream_close(REGEX_STREAM stream);
+
+/**
+ * destroys a stream without ending its input, e.g. once it has been snapshotted. no
+ * match is reported.
+ *
+ * @param stream the stream to destroy
+ */
+void regex_stream_discard(REGEX_STREAM stream);
+
+/**
+ * writes the state of a stream matched with a DFA into `REGEX_STREAM_SNAPSHOT_SIZE` bytes:
+ * the id of the DFA state, a fingerprint of the DFA and the offset. the bytes are in a
+ * fixed byte order and contain no pointers, so they can be stored inline, written to disk
+ * and restored in another process which compiled or loaded the same regex.
+ *
+ * @param stream the stream
+ * @param buffer the location to write the snapshot to
+ * @return zero on success; nonzero if the stream is not matched with a DFA or has been
+ * stopped by its callback
+ */
+int regex_stream_snapshot(REGEX_STREAM stream, void *buffer);
+
+/**
+ * opens a stream which continues the stream a snapshot was taken of. matches are reported
+ * at offsets counted from the start of the original stream.
+ *
+ * @param regex the regex of the original stream
+ * @param buffer the snapshot written by `regex_stream_snapshot`
+ * @param on_match the function called for every matched prefix of the input
+ * @param context the context passed to `on_match`; may be null
+ * @return the newly opened stream; null if `regex` is not matched with a DFA or the
+ * snapshot was taken of a stream of another DFA
+ * @warning the stream must be destroyed using `regex_stream_close` or `regex_stream_discard`
+ */
+REGEX_STREAM regex_stream_restore(REGEX regex, const void *buffer, REGEX_MATCH_CALLBACK on_match, void *context);
+
+/**
+ * writes the compiled automaton of a regex to a file. the file is replaced atomically.
+ *
+ * @param regex the regex
+ * @param filename the file to write the automaton to
+ * @return zero on success; nonzero if the file could not be written or the regex is
+ * matched with the NFA simulator
+ */
+int regex_save(REGEX regex, const char *filename);
+
+/**
+ * loads a regex saved with `regex_save`. the automaton is mapped read-only and shared
+ * with every other process mapping the same file.
+ *
+ * @param filename the file containing the automaton
+ * @param flags the flags the regex was compiled with
+ * @return the loaded regex with a single reference; null if the file is not a valid image
+ */
+REGEX regex_load(const char *filename, int flags);
+
+#endif
@@ -0,0 +1,55 @@
+/**
+ * interface of module for compiling codepoints into UTF-8 byte automata.
+ *
+ * a class of codepoints is compiled into the byte sequences encoding its codepoints, so
+ * an automaton built from it consumes raw UTF-8 input without decoding. every codepoint
+ * range is split into ranges whose encodings only differ in their last bytes, e.g. the
+ * range U+0800-U+FFFF becomes [E0][A0-BF][80-BF] | [E1-EF][80-BF][80-BF]. sequences ending
+ * in the same byte ranges share their suffix, so the automaton stays close to minimal.
+ *
+ * surrogates (U+D800-U+DFFF) and codepoints above U+10FFFF have no valid encoding and
+ * never match.
+ */
+
+#ifndef REGEX_UTF8_H
+#define REGEX_UTF8_H
+
+#include <stdlib.h>
+
+#include "automata/nfa.h"
+
+// the largest codepoint
+#define UTF8_MAX 0x10FFFF
+
+// the longest encoding of a codepoint
+#define UTF8_MAX_LENGTH 4
+
+/**
+ * encodes a codepoint
+ *
+ * @param codepoint the codepoint to encode
+ * @param buffer the location to store the encoding, must have room for `UTF8_MAX_LENGTH` bytes
+ * @return the number of bytes of the encoding; zero if the codepoint has no valid encoding
+ */
+size_t utf8_encode(SYMBOL codepoint, unsigned char *buffer);
+
+/**
+ * decodes the codepoint at the start of a string and advances the string past it.
+ * overlong encodings, surrogates and truncated sequences are rejected.
+ *
+ * @param cursor the location of the string to decode
+ * @param codepoint the location to store the decoded codepoint
+ * @return zero on success; nonzero if the string does not start with a valid encoding
+ */
+int utf8_decode(const char **cursor, SYMBOL *codepoint);
+
+/**
+ * creates the component matching the UTF-8 encoding of any one codepoint within the ranges
+ *
+ * @param ranges the ranges of codepoints
+ * @param count the number of ranges
+ * @return the component matching the encodings of the codepoints
+ */
+NFA_COMPONENT utf8_ranges(const struct symbol_range *ranges, size_t count);
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdlib.h>
+
+typedef struct arena * ARENA;
+
+/**
+ * creates an empty bump allocator. memory allocated from an arena is never freed
+ * individually, it is released all at once when the arena is destroyed.
+ * 
+ * @return the newly created arena
+ */
+ARENA arena_init();
+
+/**
+ * destroys an arena and releases all memory allocated from it. destroying an arena which
+ * was merged into another arena destroys the arena it was merged into.
+ * 
+ * @param arena the arena to destroy
+ * @warning it is an error to use any memory allocated from the arena after it has been destroyed
+ */
+void arena_fini(ARENA arena);
+
+/**
+ * allocates memory from an arena. the memory is aligned for any fundamental type.
+ * 
+ * @param arena the arena to allocate from
+ * @param size the number of bytes to allocate
+ * @return the allocated memory
+ */
+void *arena_alloc(ARENA arena, size_t size);
+
+/**
+ * allocates zeroed memory from an arena
+ * 
+ * @param arena the arena to allocate from
+ * @param count the number of elements to allocate
+ * @param size the size of each element
+ * @return the allocated and zeroed memory
+ */
+void *arena_calloc(ARENA arena, size_t count, size_t size);
+
+/**
+ * moves all memory of an arena into another arena. the merged arena remains valid and
+ * allocates from the arena it was merged into from then on, so objects holding either
+ * arena keep working. merging an arena into itself does nothing.
+ * 
+ * @param into the arena which receives the memory
+ * @param from the arena to merge into `into`
+ * @return the arena which holds the memory of both arenas
+ */
+ARENA arena_merge(ARENA into, ARENA from);
+
+/**
+ * retrieves the number of bytes reserved by an arena
+ * 
+ * @param arena the arena
+ * @return the number of bytes reserved by `arena`
+ */
+size_t arena_footprint(ARENA arena);
+
+#endif
@@ -0,0 +1,48 @@
+/**
+ * hash functions shared by the containers. every bit of the input affects the low bits of
+ * the hash, so tables may be indexed by masking the hash with a power of two.
+ */
+
+#ifndef HASH_H
+#define HASH_H
+
+#include <stdint.h>
+
+// finalizer of murmur3 for 32-bit keys
+static inline uint32_t hash_u32(uint32_t key)
+{
+    key ^= key >> 16;
+    key *= 0x85ebca6bu;
+    key ^= key >> 13;
+    key *= 0xc2b2ae35u;
+    key ^= key >> 16;
+    return key;
+}
+
+// finalizer of murmur3 for 64-bit keys
+static inline uint64_t hash_u64(uint64_t key)
+{
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdull;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ull;
+    key ^= key >> 33;
+    return key;
+}
+
+// pointers are aligned, so their low bits carry no information before mixing
+static inline uint64_t hash_ptr(const void *ptr)
+{
+    return hash_u64((uintptr_t) ptr);
+}
+
+// folds a value into a running hash, the result depends on the order of the values
+static inline uint64_t hash_combine(uint64_t hash, uint64_t value)
+{
+    return hash_u64(hash ^ (value + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2)));
+}
+
+// equality of keys which can be compared with ==
+#define SCALAR_EQ(a, b) ((a) == (b))
+
+#endif
@@ -0,0 +1,171 @@
+/**
+ * an open addressing hash map specialized for a key and a value type. keys and values are
+ * stored by value in parallel arrays next to a byte marking the slot as used. the table
+ * uses linear probing and removes pairs by shifting their successors back, so there are
+ * no tombstones.
+ *
+ * DECLARE_HASH_MAP(ID_MAP, id_map, uint32_t, DSTATE, hash_u32, SCALAR_EQ) declares the
+ * type `ID_MAP` and the functions `id_map_init`, `id_map_get`, ... operating on `ID_MAP *`.
+ * HASH maps a key to an integer and EQ compares two keys, both may be macros.
+ */
+
+#ifndef HASH_MAP_H
+#define HASH_MAP_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "hash.h"
+
+#define DEFAULT_HASH_MAP_CAPACITY 16
+
+#define DECLARE_HASH_MAP(TYPE, PREFIX, K, V, HASH, EQ)                                  \
+                                                                                        \
+typedef struct                                                                          \
+{                                                                                       \
+    K *keys;                                                                            \
+    V *values;                                                                          \
+    uint8_t *used;                                                                      \
+    size_t size;                                                                        \
+    /* always a power of two, zero until the first pair is added */                    \
+    size_t capacity;                                                                    \
+} TYPE;                                                                                 \
+                                                                                        \
+static inline void PREFIX##_init(TYPE *map)                                             \
+{                                                                                       \
+    map->keys = NULL;                                                                   \
+    map->values = NULL;                                                                 \
+    map->used = NULL;                                                                   \
+    map->size = 0;                                                                      \
+    map->capacity = 0;                                                                  \
+}                                                                                       \
+                                                                                        \
+static inline void PREFIX##_fini(TYPE *map)                                             \
+{                                                                                       \
+    free(map->keys);                                                                    \
+    free(map->values);                                                                  \
+    free(map->used);                                                                    \
+    PREFIX##_init(map);                                                                 \
+}                                                                                       \
+                                                                                        \
+/* finds the slot of a key, returns the capacity if the key is not in the map */        \
+static inline size_t PREFIX##_find(const TYPE *map, K key)                              \
+{                                                                                       \
+    if (!map->size) return map->capacity;                                               \
+    size_t mask = map->capacity - 1;                                                    \
+    for (size_t pos = (size_t) HASH(key) & mask; map->used[pos]; pos = (pos + 1) & mask)\
+    {                                                                                   \
+        if (EQ(map->keys[pos], key)) return pos;                                        \
+    }                                                                                   \
+    return map->capacity;                                                               \
+}                                                                                       \
+                                                                                        \
+static inline int PREFIX##_contains(const TYPE *map, K key)                             \
+{                                                                                       \
+    return PREFIX##_find(map, key) != map->capacity;                                    \
+}                                                                                       \
+                                                                                        \
+/* returns the location of the value of a key; null if the key is not in the map */    \
+static inline V *PREFIX##_get(const TYPE *map, K key)                                   \
+{                                                                                       \
+    size_t pos = PREFIX##_find(map, key);                                               \
+    return pos == map->capacity ? NULL : &map->values[pos];                             \
+}                                                                                       \
+                                                                                        \
+/* inserts a key which is not in the map, there must be an empty slot */               \
+static inline V *PREFIX##_insert(TYPE *map, K key, V value)                             \
+{                                                                                       \
+    size_t mask = map->capacity - 1;                                                    \
+    size_t pos = (size_t) HASH(key) & mask;                                             \
+    while (map->used[pos]) pos = (pos + 1) & mask;                                      \
+    map->keys[pos] = key;                                                               \
+    map->values[pos] = value;                                                           \
+    map->used[pos] = 1;                                                                 \
+    map->size++;                                                                        \
+    return &map->values[pos];                                                           \
+}                                                                                       \
+                                                                                        \
+/* makes room for a number of pairs without any further rehash */                      \
+static inline void PREFIX##_reserve(TYPE *map, size_t count)                            \
+{                                                                                       \
+    size_t capacity = map->capacity ? map->capacity : DEFAULT_HASH_MAP_CAPACITY;        \
+    while (4 * count > 3 * capacity) capacity *= 2;                                     \
+    if (capacity == map->capacity) return;                                              \
+                                                                                        \
+    TYPE old = *map;                                                                    \
+    map->keys = malloc(capacity * sizeof(K));                                           \
+    map->values = malloc(capacity * sizeof(V));                                         \
+    map->used = calloc(capacity, sizeof(uint8_t));                                      \
+    map->size = 0;                                                                      \
+    map->capacity = capacity;                                                           \
+    for (size_t i = 0; i < old.capacity; ++i)                                           \
+        if (old.used[i]) PREFIX##_insert(map, old.keys[i], old.values[i]);              \
+    free(old.keys);                                                                     \
+    free(old.values);                                                                   \
+    free(old.used);                                                                     \
+}                                                                                       \
+                                                                                        \
+/* sets the value of a key, adding the key if it is not in the map */                  \
+static inline void PREFIX##_set(TYPE *map, K key, V value)                              \
+{                                                                                       \
+    V *slot = PREFIX##_get(map, key);                                                   \
+    if (slot)                                                                           \
+    {                                                                                   \
+        *slot = value;                                                                  \
+        return;                                                                         \
+    }                                                                                   \
+    PREFIX##_reserve(map, map->size + 1);                                               \
+    PREFIX##_insert(map, key, value);                                                   \
+}                                                                                       \
+                                                                                        \
+/* returns zero if the pair was removed; nonzero if the key was not in the map */      \
+static inline int PREFIX##_remove(TYPE *map, K key)                                     \
+{                                                                                       \
+    size_t hole = PREFIX##_find(map, key);                                              \
+    if (hole == map->capacity) return -1;                                               \
+                                                                                        \
+    /* move back every following pair whose home slot is not between the hole and it */\
+    size_t mask = map->capacity - 1;                                                    \
+    for (size_t pos = (hole + 1) & mask; map->used[pos]; pos = (pos + 1) & mask)        \
+    {                                                                                   \
+        size_t home = (size_t) HASH(map->keys[pos]) & mask;                             \
+        if (((pos - home) & mask) >= ((pos - hole) & mask))                             \
+        {                                                                               \
+            map->keys[hole] = map->keys[pos];                                           \
+            map->values[hole] = map->values[pos];                                       \
+            hole = pos;                                                                 \
+        }                                                                               \
+    }                                                                                   \
+    map->used[hole] = 0;                                                                \
+    map->size--;                                                                        \
+    return 0;                                                                           \
+}                                                                                       \
+                                                                                        \
+/* removes all pairs and keeps the memory */                                           \
+static inline void PREFIX##_clear(TYPE *map)                                            \
+{                                                                                       \
+    if (map->used) memset(map->used, 0, map->capacity);                                 \
+    map->size = 0;                                                                      \
+}                                                                                       \
+                                                                                        \
+/**                                                                                     \
+ * advances a cursor to the next pair. the cursor starts at zero, key and value may be   \
+ * null. returns nonzero if there was another pair; zero once all pairs have been visited\
+ */                                                                                     \
+static inline int PREFIX##_next(const TYPE *map, size_t *cursor, K *key, V *value)      \
+{                                                                                       \
+    for (; *cursor < map->capacity; ++*cursor)                                          \
+    {                                                                                   \
+        if (map->used[*cursor])                                                         \
+        {                                                                               \
+            if (key) *key = map->keys[*cursor];                                         \
+            if (value) *value = map->values[*cursor];                                   \
+            ++*cursor;                                                                  \
+            return 1;                                                                   \
+        }                                                                               \
+    }                                                                                   \
+    return 0;                                                                           \
+}
+
+#endif
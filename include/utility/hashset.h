@@ -0,0 +1,150 @@
+/**
+ * an open addressing hash set specialized for a key type. keys are stored by value next
+ * to a byte marking the slot as used, so a set of 32-bit ids takes half the memory of a
+ * set of pointers and lookups never follow a pointer. the table uses linear probing and
+ * removes keys by shifting their successors back, so there are no tombstones.
+ *
+ * DECLARE_HASH_SET(ID_SET, id_set, uint32_t, hash_u32, SCALAR_EQ) declares the type
+ * `ID_SET` and the functions `id_set_init`, `id_set_add`, ... operating on `ID_SET *`.
+ * HASH maps a key to an integer and EQ compares two keys, both may be macros.
+ */
+
+#ifndef HASH_SET_H
+#define HASH_SET_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "hash.h"
+
+#define DEFAULT_HASH_SET_CAPACITY 16
+
+#define DECLARE_HASH_SET(TYPE, PREFIX, K, HASH, EQ)                                     \
+                                                                                        \
+typedef struct                                                                          \
+{                                                                                       \
+    K *keys;                                                                            \
+    uint8_t *used;                                                                      \
+    size_t size;                                                                        \
+    /* always a power of two, zero until the first key is added */                     \
+    size_t capacity;                                                                    \
+} TYPE;                                                                                 \
+                                                                                        \
+static inline void PREFIX##_init(TYPE *set)                                             \
+{                                                                                       \
+    set->keys = NULL;                                                                   \
+    set->used = NULL;                                                                   \
+    set->size = 0;                                                                      \
+    set->capacity = 0;                                                                  \
+}                                                                                       \
+                                                                                        \
+static inline void PREFIX##_fini(TYPE *set)                                             \
+{                                                                                       \
+    free(set->keys);                                                                    \
+    free(set->used);                                                                    \
+    PREFIX##_init(set);                                                                 \
+}                                                                                       \
+                                                                                        \
+/* finds the slot of a key, returns the capacity if the key is not in the set */        \
+static inline size_t PREFIX##_find(const TYPE *set, K key)                              \
+{                                                                                       \
+    if (!set->size) return set->capacity;                                               \
+    size_t mask = set->capacity - 1;                                                    \
+    for (size_t pos = (size_t) HASH(key) & mask; set->used[pos]; pos = (pos + 1) & mask)\
+    {                                                                                   \
+        if (EQ(set->keys[pos], key)) return pos;                                        \
+    }                                                                                   \
+    return set->capacity;                                                               \
+}                                                                                       \
+                                                                                        \
+static inline int PREFIX##_contains(const TYPE *set, K key)                             \
+{                                                                                       \
+    return PREFIX##_find(set, key) != set->capacity;                                    \
+}                                                                                       \
+                                                                                        \
+/* inserts a key which is not in the set, there must be an empty slot */               \
+static inline void PREFIX##_insert(TYPE *set, K key)                                    \
+{                                                                                       \
+    size_t mask = set->capacity - 1;                                                    \
+    size_t pos = (size_t) HASH(key) & mask;                                             \
+    while (set->used[pos]) pos = (pos + 1) & mask;                                      \
+    set->keys[pos] = key;                                                               \
+    set->used[pos] = 1;                                                                 \
+    set->size++;                                                                        \
+}                                                                                       \
+                                                                                        \
+/* makes room for a number of keys without any further rehash */                       \
+static inline void PREFIX##_reserve(TYPE *set, size_t count)                            \
+{                                                                                       \
+    size_t capacity = set->capacity ? set->capacity : DEFAULT_HASH_SET_CAPACITY;        \
+    while (4 * count > 3 * capacity) capacity *= 2;                                     \
+    if (capacity == set->capacity) return;                                              \
+                                                                                        \
+    TYPE old = *set;                                                                    \
+    set->keys = malloc(capacity * sizeof(K));                                           \
+    set->used = calloc(capacity, sizeof(uint8_t));                                      \
+    set->size = 0;                                                                      \
+    set->capacity = capacity;                                                           \
+    for (size_t i = 0; i < old.capacity; ++i)                                           \
+        if (old.used[i]) PREFIX##_insert(set, old.keys[i]);                             \
+    free(old.keys);                                                                     \
+    free(old.used);                                                                     \
+}                                                                                       \
+                                                                                        \
+/* returns zero if the key was added; nonzero if it was in the set already */          \
+static inline int PREFIX##_add(TYPE *set, K key)                                        \
+{                                                                                       \
+    if (PREFIX##_contains(set, key)) return -1;                                         \
+    PREFIX##_reserve(set, set->size + 1);                                               \
+    PREFIX##_insert(set, key);                                                          \
+    return 0;                                                                           \
+}                                                                                       \
+                                                                                        \
+/* returns zero if the key was removed; nonzero if it was not in the set */            \
+static inline int PREFIX##_remove(TYPE *set, K key)                                     \
+{                                                                                       \
+    size_t hole = PREFIX##_find(set, key);                                              \
+    if (hole == set->capacity) return -1;                                               \
+                                                                                        \
+    /* move back every following key whose home slot is not between the hole and it */ \
+    size_t mask = set->capacity - 1;                                                    \
+    for (size_t pos = (hole + 1) & mask; set->used[pos]; pos = (pos + 1) & mask)        \
+    {                                                                                   \
+        size_t home = (size_t) HASH(set->keys[pos]) & mask;                             \
+        if (((pos - home) & mask) >= ((pos - hole) & mask))                             \
+        {                                                                               \
+            set->keys[hole] = set->keys[pos];                                           \
+            hole = pos;                                                                 \
+        }                                                                               \
+    }                                                                                   \
+    set->used[hole] = 0;                                                                \
+    set->size--;                                                                        \
+    return 0;                                                                           \
+}                                                                                       \
+                                                                                        \
+/* removes all keys and keeps the memory */                                            \
+static inline void PREFIX##_clear(TYPE *set)                                            \
+{                                                                                       \
+    if (set->used) memset(set->used, 0, set->capacity);                                 \
+    set->size = 0;                                                                      \
+}                                                                                       \
+                                                                                        \
+/**                                                                                     \
+ * advances a cursor to the next key. the cursor starts at zero.                        \
+ * returns nonzero if there was another key; zero once all keys have been visited        \
+ */                                                                                     \
+static inline int PREFIX##_next(const TYPE *set, size_t *cursor, K *key)                \
+{                                                                                       \
+    for (; *cursor < set->capacity; ++*cursor)                                          \
+    {                                                                                   \
+        if (set->used[*cursor])                                                         \
+        {                                                                               \
+            *key = set->keys[(*cursor)++];                                              \
+            return 1;                                                                   \
+        }                                                                               \
+    }                                                                                   \
+    return 0;                                                                           \
+}
+
+#endif
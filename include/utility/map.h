@@ -3,9 +3,21 @@
 
 #include <stdlib.h>
 
+#include "arena.h"
+
 typedef struct map * MAP;
 typedef struct map_iterator * MAP_ITERATOR;
 
+/**
+ * an iterator over a map. the fields are private, the struct is only public so iterators
+ * can be placed on the stack with `map_iterator_begin` instead of allocated.
+ */
+struct map_iterator
+{
+    MAP map;
+    size_t idx;
+};
+
 /**
  * initializes an empty map with integer keys and pointer values.
  * all maps initialized via this function should be destroyed using `map_fini`
@@ -14,6 +26,15 @@ typedef struct map_iterator * MAP_ITERATOR;
  */
 MAP map_init();
 
+/**
+ * initializes an empty map allocated from an arena. `map_fini` does not release the
+ * memory of the map, it is released together with the arena.
+ * 
+ * @param arena the arena to allocate the map from; null to allocate from the heap
+ * @return newly created empty map
+ */
+MAP map_init_arena(ARENA arena);
+
 /**
  * destroys a map
  * 
@@ -104,6 +125,16 @@ int * map_keys(MAP map);
  */
 void **map_values(MAP map);
 
+/**
+ * starts an iteration over a map with an iterator owned by the caller, e.g. on the stack.
+ * the iterator needs no destruction.
+ *
+ * @param iterator the iterator to start
+ * @param map the map to iterate
+ * @warning the iterator is invalidated the moment the map is modified in anyway or destroyed
+ */
+void map_iterator_begin(MAP_ITERATOR iterator, MAP map);
+
 /**
  * creates an iterator for a map
  * 
@@ -8,6 +8,16 @@
 typedef struct ptr_map * PTR_MAP;
 typedef struct ptr_map_iterator * PTR_MAP_ITERATOR;
 
+/**
+ * an iterator over a ptr map. the fields are private, the struct is only public so
+ * iterators can be placed on the stack with `ptrmap_iterator_begin` instead of allocated.
+ */
+struct ptr_map_iterator
+{
+    PTR_MAP map;
+    size_t idx;
+};
+
 /**
  * initializes an empty map with integer keys and pointer values.
  * all maps initialized via this function should be destroyed using `map_fini`
@@ -61,6 +71,16 @@ int ptrmap_set(PTR_MAP map, void *key, void *value);
  */
 void * ptrmap_get(PTR_MAP map, void *key);
 
+/**
+ * starts an iteration over a ptr map with an iterator owned by the caller, e.g. on the
+ * stack. the iterator needs no destruction.
+ *
+ * @param iterator the iterator to start
+ * @param map the ptr map to iterate
+ * @warning the iterator is invalidated the moment the map is modified in anyway or destroyed
+ */
+void ptrmap_iterator_begin(PTR_MAP_ITERATOR iterator, PTR_MAP map);
+
 /**
  * creates an iterator for a ptr map
  * 
@@ -3,9 +3,21 @@
 
 #include <stdlib.h>
 
+#include "arena.h"
+
 typedef struct set * SET;
 typedef struct set_iterator * SET_ITERATOR;
 
+/**
+ * an iterator over a set. the fields are private, the struct is only public so iterators
+ * can be placed on the stack with `set_iterator_begin` instead of allocated.
+ */
+struct set_iterator
+{
+    SET set;
+    size_t idx;
+};
+
 /**
  * initializes an empty set of pointers. 
  * all sets initialized via this function should be destroyed using `set_fini`
@@ -14,6 +26,15 @@ typedef struct set_iterator * SET_ITERATOR;
  */
 SET set_init();
 
+/**
+ * initializes an empty set of pointers allocated from an arena. `set_fini` does not
+ * release the memory of the set, it is released together with the arena.
+ * 
+ * @param arena the arena to allocate the set from; null to allocate from the heap
+ * @return newly created set
+ */
+SET set_init_arena(ARENA arena);
+
 /**
  * destroys a set of pointers.
  * 
@@ -74,6 +95,17 @@ void set_clear(SET set);
  */
 void **set_values(SET set);
 
+/**
+ * borrows the values stored in the set in no particular order. the number of values is
+ * given by `set_size`.
+ *
+ * @param set the set to view
+ * @return the values stored in the set
+ * @warning the view is owned by the set and invalidated the moment the set is modified in
+ * anyway or destroyed
+ */
+void * const *set_view(SET set);
+
 /**
  * creates a new set that is the union of the two sets
  * 
@@ -94,6 +126,26 @@ SET set_union(SET A, SET B);
  */
 SET set_intersection(SET A, SET B);
 
+/**
+ * adds every element of a set to another set, i.e. `A` becomes the union of `A` and `B`.
+ * the set is grown at most once.
+ *
+ * @param A the set to add the elements to
+ * @param B the set whose elements are added
+ * @return zero on success; nonzero otherwise
+ */
+int set_union_with(SET A, SET B);
+
+/**
+ * removes every element of a set that is not in another set, i.e. `A` becomes the
+ * intersection of `A` and `B`. no memory is allocated.
+ *
+ * @param A the set to remove the elements from
+ * @param B the set whose elements are kept
+ * @return zero on success; nonzero otherwise
+ */
+int set_intersect_with(SET A, SET B);
+
 /**
  * determines if the set is a subset of another set.
  * 
@@ -103,6 +155,16 @@ SET set_intersection(SET A, SET B);
  */
 int is_subset(SET subset, SET superset);
 
+/**
+ * starts an iteration over a set with an iterator owned by the caller, e.g. on the stack.
+ * the iterator needs no destruction.
+ *
+ * @param iterator the iterator to start
+ * @param set the set to iterate
+ * @warning the iterator is invalidated the moment the set is modified in anyway or destroyed
+ */
+void set_iterator_begin(SET_ITERATOR iterator, SET set);
+
 /**
  * creates an iterator for a set
  * 
@@ -6,6 +6,13 @@
 typedef struct set_map * SET_MAP;
 typedef struct set_map_iterator * SET_MAP_ITERATOR;
 
+// the fields are private, the struct is only public so iterators can be placed on the stack
+struct set_map_iterator
+{
+    SET_MAP map;
+    size_t idx;
+};
+
 SET_MAP setmap_init();
 
 void setmap_fini(SET_MAP map);
@@ -18,6 +25,8 @@ int setmap_set(SET_MAP map, SET key, void *value);
 
 void * setmap_get(SET_MAP map, SET key);
 
+void setmap_iterator_begin(SET_MAP_ITERATOR iterator, SET_MAP map);
+
 SET_MAP_ITERATOR setmap_iterator_init(SET_MAP map);
 
 void setmap_iterator_fini(SET_MAP_ITERATOR iterator);
@@ -0,0 +1,82 @@
+/**
+ * a growable array specialized for an element type which stores up to a fixed number of
+ * elements inline and only allocates once it outgrows them.
+ *
+ * DECLARE_SMALL_VECTOR(STATE_LIST, state_list, NSTATE, 4) declares the type `STATE_LIST`
+ * and the functions `state_list_init`, `state_list_push`, ... operating on `STATE_LIST *`.
+ * the elements are accessed through `state_list_data` and the `size` field. a small vector
+ * must not be copied by value, since it may point into itself.
+ */
+
+#ifndef SMALL_VECTOR_H
+#define SMALL_VECTOR_H
+
+#include <stdlib.h>
+#include <string.h>
+
+#define DECLARE_SMALL_VECTOR(TYPE, PREFIX, T, N)                                        \
+                                                                                        \
+typedef struct                                                                          \
+{                                                                                       \
+    /* the heap buffer, null while the elements are stored inline */                   \
+    T *heap;                                                                            \
+    size_t size;                                                                        \
+    size_t capacity;                                                                    \
+    T inline_data[N];                                                                   \
+} TYPE;                                                                                 \
+                                                                                        \
+static inline void PREFIX##_init(TYPE *vector)                                          \
+{                                                                                       \
+    vector->heap = NULL;                                                                \
+    vector->size = 0;                                                                   \
+    vector->capacity = N;                                                               \
+}                                                                                       \
+                                                                                        \
+static inline void PREFIX##_fini(TYPE *vector)                                          \
+{                                                                                       \
+    free(vector->heap);                                                                 \
+    PREFIX##_init(vector);                                                              \
+}                                                                                       \
+                                                                                        \
+static inline T *PREFIX##_data(TYPE *vector)                                            \
+{                                                                                       \
+    return vector->heap ? vector->heap : vector->inline_data;                           \
+}                                                                                       \
+                                                                                        \
+/* makes room for a number of elements without any further reallocation */             \
+static inline void PREFIX##_reserve(TYPE *vector, size_t count)                         \
+{                                                                                       \
+    if (count <= vector->capacity) return;                                              \
+    size_t capacity = 2 * vector->capacity;                                             \
+    while (capacity < count) capacity *= 2;                                             \
+    if (vector->heap)                                                                   \
+    {                                                                                   \
+        vector->heap = realloc(vector->heap, capacity * sizeof(T));                     \
+    }                                                                                   \
+    else                                                                                \
+    {                                                                                   \
+        vector->heap = malloc(capacity * sizeof(T));                                    \
+        memcpy(vector->heap, vector->inline_data, vector->size * sizeof(T));            \
+    }                                                                                   \
+    vector->capacity = capacity;                                                        \
+}                                                                                       \
+                                                                                        \
+static inline void PREFIX##_push(TYPE *vector, T value)                                 \
+{                                                                                       \
+    if (vector->size == vector->capacity) PREFIX##_reserve(vector, vector->size + 1);   \
+    PREFIX##_data(vector)[vector->size++] = value;                                      \
+}                                                                                       \
+                                                                                        \
+/* removes the last element, the vector must not be empty */                           \
+static inline T PREFIX##_pop(TYPE *vector)                                              \
+{                                                                                       \
+    return PREFIX##_data(vector)[--vector->size];                                       \
+}                                                                                       \
+                                                                                        \
+/* removes all elements and keeps the memory */                                        \
+static inline void PREFIX##_clear(TYPE *vector)                                         \
+{                                                                                       \
+    vector->size = 0;                                                                   \
+}
+
+#endif
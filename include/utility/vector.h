@@ -0,0 +1,69 @@
+/**
+ * a growable array specialized for an element type. a vector is a plain struct which is
+ * usually placed on the stack or inside another struct, all functions are inline.
+ *
+ * DECLARE_VECTOR(U32_VECTOR, u32_vector, uint32_t) declares the type `U32_VECTOR` and
+ * the functions `u32_vector_init`, `u32_vector_push`, ... operating on `U32_VECTOR *`.
+ * the elements are accessed directly through the `data` and `size` fields.
+ */
+
+#ifndef VECTOR_H
+#define VECTOR_H
+
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_VECTOR_CAPACITY 8
+
+#define DECLARE_VECTOR(TYPE, PREFIX, T)                                                 \
+                                                                                        \
+typedef struct                                                                          \
+{                                                                                       \
+    T *data;                                                                            \
+    size_t size;                                                                        \
+    size_t capacity;                                                                    \
+} TYPE;                                                                                 \
+                                                                                        \
+/* initializes an empty vector, no memory is allocated until the first push */          \
+static inline void PREFIX##_init(TYPE *vector)                                          \
+{                                                                                       \
+    vector->data = NULL;                                                                \
+    vector->size = 0;                                                                   \
+    vector->capacity = 0;                                                               \
+}                                                                                       \
+                                                                                        \
+static inline void PREFIX##_fini(TYPE *vector)                                          \
+{                                                                                       \
+    free(vector->data);                                                                 \
+    PREFIX##_init(vector);                                                              \
+}                                                                                       \
+                                                                                        \
+/* makes room for a number of elements without any further reallocation */             \
+static inline void PREFIX##_reserve(TYPE *vector, size_t count)                         \
+{                                                                                       \
+    if (count <= vector->capacity) return;                                              \
+    size_t capacity = vector->capacity ? vector->capacity : DEFAULT_VECTOR_CAPACITY;    \
+    while (capacity < count) capacity *= 2;                                             \
+    vector->data = realloc(vector->data, capacity * sizeof(T));                         \
+    vector->capacity = capacity;                                                        \
+}                                                                                       \
+                                                                                        \
+static inline void PREFIX##_push(TYPE *vector, T value)                                 \
+{                                                                                       \
+    if (vector->size == vector->capacity) PREFIX##_reserve(vector, vector->size + 1);   \
+    vector->data[vector->size++] = value;                                               \
+}                                                                                       \
+                                                                                        \
+/* removes the last element, the vector must not be empty */                           \
+static inline T PREFIX##_pop(TYPE *vector)                                              \
+{                                                                                       \
+    return vector->data[--vector->size];                                                \
+}                                                                                       \
+                                                                                        \
+/* removes all elements and keeps the memory */                                        \
+static inline void PREFIX##_clear(TYPE *vector)                                         \
+{                                                                                       \
+    vector->size = 0;                                                                   \
+}
+
+#endif
@@ -0,0 +1,185 @@
+#include "utility/arena.h"
+
+#include <stddef.h>
+#include <string.h>
+#include <stdalign.h>
+
+#ifdef DEBUG
+    #undef DEBUG
+#endif
+
+#include "debug.h"
+
+// size of a regular block, larger allocations receive a block of their own
+#define ARENA_BLOCK_SIZE 16384
+
+#define ALIGN(size) (((size) + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1))
+
+struct arena_block
+{
+    struct arena_block *next;
+    size_t size;
+    alignas(max_align_t) unsigned char data[];
+};
+
+/**
+ * merged arenas form a tree. objects keep pointers to the arena they were allocated from,
+ * so a merged arena is not destroyed but forwards to the arena it was merged into. the
+ * root owns all blocks and keeps a list of the arenas merged into it.
+ */
+struct arena
+{
+    // the head is the block currently bumped into
+    struct arena_block *blocks;
+    size_t used;
+    size_t footprint;
+    // the arena this arena was merged into, null for a root
+    struct arena *parent;
+    // arenas merged into this root, linked through `next_merged`
+    struct arena *merged;
+    struct arena *next_merged;
+};
+
+static struct arena_block *block_new(size_t size)
+{
+    struct arena_block *block = malloc(sizeof(struct arena_block) + size);
+    block->next = NULL;
+    block->size = size;
+    return block;
+}
+
+ARENA arena_init()
+{
+    ARENA arena = malloc(sizeof(struct arena));
+    arena->blocks = NULL;
+    arena->used = 0;
+    arena->footprint = 0;
+    arena->parent = NULL;
+    arena->merged = NULL;
+    arena->next_merged = NULL;
+    info("Arena[%p] initialized.", arena);
+    return arena;
+}
+
+// finds the root of a merged arena, compressing the path on the way
+static ARENA arena_root(ARENA arena)
+{
+    ARENA root = arena;
+    while (root->parent) root = root->parent;
+    while (arena->parent && arena->parent != root)
+    {
+        ARENA parent = arena->parent;
+        arena->parent = root;
+        arena = parent;
+    }
+    return root;
+}
+
+void arena_fini(ARENA arena)
+{
+    arena = arena_root(arena);
+    struct arena_block *block = arena->blocks, *next_block;
+    for (; block; block = next_block)
+    {
+        next_block = block->next;
+        free(block);
+    }
+
+    ARENA merged = arena->merged, next_merged;
+    for (; merged; merged = next_merged)
+    {
+        next_merged = merged->next_merged;
+        free(merged);
+    }
+    info("Arena[%p] destroyed.", arena);
+    free(arena);
+}
+
+void *arena_alloc(ARENA arena, size_t size)
+{
+    arena = arena_root(arena);
+    size = ALIGN(size ? size : 1);
+    if (arena->blocks && arena->used + size <= arena->blocks->size)
+    {
+        void *ptr = arena->blocks->data + arena->used;
+        arena->used += size;
+        return ptr;
+    }
+
+    if (size > ARENA_BLOCK_SIZE / 4)
+    {
+        // large allocations are placed behind the current block so it can still be bumped into
+        struct arena_block *block = block_new(size);
+        arena->footprint += size;
+        if (arena->blocks)
+        {
+            block->next = arena->blocks->next;
+            arena->blocks->next = block;
+        }
+        else
+        {
+            arena->blocks = block;
+            arena->used = size;
+        }
+        return block->data;
+    }
+
+    struct arena_block *block = block_new(ARENA_BLOCK_SIZE);
+    arena->footprint += ARENA_BLOCK_SIZE;
+    block->next = arena->blocks;
+    arena->blocks = block;
+    arena->used = size;
+    return block->data;
+}
+
+void *arena_calloc(ARENA arena, size_t count, size_t size)
+{
+    void *ptr = arena_alloc(arena, count * size);
+    memset(ptr, 0, count * size);
+    return ptr;
+}
+
+ARENA arena_merge(ARENA into, ARENA from)
+{
+    into = arena_root(into);
+    from = arena_root(from);
+    if (into == from) return into;
+
+    // the blocks of `from` are placed behind the current block of `into`
+    struct arena_block *last = from->blocks;
+    if (last)
+    {
+        while (last->next) last = last->next;
+        if (into->blocks)
+        {
+            last->next = into->blocks->next;
+            into->blocks->next = from->blocks;
+        }
+        else
+        {
+            into->blocks = from->blocks;
+            into->used = from->used;
+        }
+    }
+    into->footprint += from->footprint;
+    from->blocks = NULL;
+    from->footprint = 0;
+
+    // `from` and the arenas merged into it now forward to `into`
+    from->parent = into;
+    ARENA last_merged = from;
+    while (last_merged->next_merged) last_merged = last_merged->next_merged;
+    last_merged->next_merged = from->merged;
+    while (last_merged->next_merged) last_merged = last_merged->next_merged;
+    last_merged->next_merged = into->merged;
+    into->merged = from;
+    from->merged = NULL;
+
+    info("Arena[%p] merged into Arena[%p].", from, into);
+    return into;
+}
+
+size_t arena_footprint(ARENA arena)
+{
+    return arena_root(arena)->footprint;
+}
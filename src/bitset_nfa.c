@@ -0,0 +1,524 @@
+#include "automata/bitset_nfa.h"
+
+#include "debug.h"
+
+#include <string.h>
+
+#include "utility/hash.h"
+#include "utility/vector.h"
+
+// rows are aligned to cache lines, so the unions of whole rows can use aligned vector loads
+#define ROW_ALIGNMENT 64
+
+#define WORD(bit) ((bit) >> 6)
+#define MASK(bit) ((uint64_t) 1 << ((bit) & 63))
+
+DECLARE_VECTOR(PAIR_VECTOR, pair_vector, uint64_t)
+DECLARE_VECTOR(ID_VECTOR, id_vector, uint32_t)
+
+struct bitset_nfa_range
+{
+    SYMBOL lo;
+    SYMBOL hi;
+    uint32_t class;
+};
+
+struct bitset_nondeterministic_finite_automaton
+{
+    size_t num_bits;
+    size_t words;
+    size_t num_classes;
+    uint32_t byte_class[256];
+    // the classes of the symbols outside of 0-255 as sorted, disjoint ranges
+    struct bitset_nfa_range *ranges;
+    size_t num_ranges;
+    uint64_t *start;
+    uint64_t *accepting;
+    // row (c - 1) * num_bits + b holds the states reached from bit b on class c
+    uint64_t *successors;
+    size_t footprint;
+};
+
+struct boundary
+{
+    int64_t at;
+    int delta;
+};
+
+static int compare_boundaries(const void *a, const void *b)
+{
+    const struct boundary *x = a, *y = b;
+    return (x->at > y->at) - (x->at < y->at);
+}
+
+static int compare_pairs(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t*) a, y = *(const uint64_t*) b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * splits the alphabet of the automaton into elementary ranges: the symbols between two
+ * neighbouring boundaries of any transition, single symbols and ranges alike, behave
+ * alike in every state. only ranges covered by some transition are kept.
+ */
+static struct symbol_range *elementary_ranges(const NSTATE *states, size_t num_states, size_t *num_ranges)
+{
+    size_t count = 0, capacity = 16;
+    struct boundary *boundaries = malloc(capacity * sizeof(struct boundary));
+    for (size_t i = 0; i < num_states; ++i)
+    {
+        size_t state_symbols_sz = nstate_count_transition_symbols(states[i]);
+        size_t ranges_sz;
+        const struct nstate_range_transition *ranges = nstate_view_range_transitions(states[i], &ranges_sz);
+
+        if (count + 2 * (state_symbols_sz + ranges_sz) > capacity)
+        {
+            while (count + 2 * (state_symbols_sz + ranges_sz) > capacity) capacity *= 2;
+            boundaries = realloc(boundaries, capacity * sizeof(struct boundary));
+        }
+
+        struct nstate_transition_iterator iter;
+        SYMBOL sym;
+        nstate_transition_iterator_begin(&iter, states[i]);
+        while (nstate_transition_iterator_next(&iter, &sym, NULL, NULL))
+        {
+            if (sym == EPSILON) continue;
+            boundaries[count++] = (struct boundary){ sym, 1 };
+            boundaries[count++] = (struct boundary){ (int64_t) sym + 1, -1 };
+        }
+        for (size_t j = 0; j < ranges_sz; ++j)
+        {
+            boundaries[count++] = (struct boundary){ ranges[j].lo, 1 };
+            boundaries[count++] = (struct boundary){ (int64_t) ranges[j].hi + 1, -1 };
+        }
+    }
+    qsort(boundaries, count, sizeof(struct boundary), compare_boundaries);
+
+    struct symbol_range *elementary = malloc(count * sizeof(struct symbol_range) + 1);
+    *num_ranges = 0;
+    int open = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        open += boundaries[i].delta;
+        if (i + 1 == count || boundaries[i + 1].at == boundaries[i].at || !open) continue;
+        elementary[(*num_ranges)++] = (struct symbol_range){ boundaries[i].at, boundaries[i + 1].at - 1 };
+    }
+    free(boundaries);
+    return elementary;
+}
+
+// finds the elementary range containing a symbol of a transition
+static size_t find_range(const struct symbol_range *ranges, size_t num_ranges, SYMBOL sym)
+{
+    size_t lo = 0, hi = num_ranges;
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (ranges[mid].hi < sym) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// appends a range of wide symbols, merging it with the previous range of the same class
+static void add_wide_range(struct bitset_nfa_range *ranges, size_t *num_ranges, int64_t lo, int64_t hi, uint32_t class)
+{
+    if (lo > hi) return;
+    if (*num_ranges && ranges[*num_ranges - 1].class == class && (int64_t) ranges[*num_ranges - 1].hi + 1 == lo)
+    {
+        ranges[*num_ranges - 1].hi = hi;
+        return;
+    }
+    ranges[(*num_ranges)++] = (struct bitset_nfa_range){ lo, hi, class };
+}
+
+// determines if a state can be left on a symbol
+static int has_symbol_transitions(NSTATE state)
+{
+    size_t ranges_sz;
+    nstate_view_range_transitions(state, &ranges_sz);
+    if (ranges_sz) return 1;
+
+    struct nstate_transition_iterator iter;
+    SYMBOL sym;
+    nstate_transition_iterator_begin(&iter, state);
+    while (nstate_transition_iterator_next(&iter, &sym, NULL, NULL))
+        if (sym != EPSILON) return 1;
+    return 0;
+}
+
+/**
+ * computes the epsilon closure of every state as a row of bits. states without a bit
+ * are walked through but left out of the rows.
+ */
+static uint64_t *epsilon_closures(const NSTATE *states, size_t num_states, const int32_t *bits, size_t words)
+{
+    uint64_t *closures = calloc(num_states * words + 1, sizeof(uint64_t));
+    uint32_t *visited = calloc(num_states + 1, sizeof(uint32_t));
+    ID_VECTOR stack;
+    id_vector_init(&stack);
+
+    for (size_t root = 0; root < num_states; ++root)
+    {
+        uint64_t *closure = closures + root * words;
+        id_vector_push(&stack, root);
+        visited[root] = root + 1;
+        while (stack.size)
+        {
+            uint32_t id = id_vector_pop(&stack);
+            if (bits[id] >= 0) closure[WORD(bits[id])] |= MASK(bits[id]);
+
+            size_t count;
+            const NSTATE *targets = nstate_view_transition_states(states[id], EPSILON, &count);
+            for (size_t i = 0; i < count; ++i)
+            {
+                uint32_t target = nstate_id(targets[i]);
+                if (visited[target] == root + 1) continue;
+                visited[target] = root + 1;
+                id_vector_push(&stack, target);
+            }
+        }
+    }
+
+    id_vector_fini(&stack);
+    free(visited);
+    return closures;
+}
+
+BITSET_NFA nfa_bitset(NFA automaton)
+{
+    return nfa_bitset_folded(automaton, NULL);
+}
+
+BITSET_NFA nfa_bitset_folded(NFA automaton, const unsigned char *fold)
+{
+    if (!automaton) return NULL;
+    size_t num_states = nfa_count_states(automaton);
+    if (!num_states || num_states > BITSET_NFA_MAX_STATES) return NULL;
+    const NSTATE *states = nfa_view_states(automaton);
+
+    // only the states which can be left on a symbol or accept need a bit
+    const NSTATE *accepting = nfa_view_accepting_states(automaton);
+    size_t accepting_sz = nfa_count_accepting_states(automaton);
+    uint8_t *is_accepting = calloc(num_states + 1, sizeof(uint8_t));
+    for (size_t i = 0; i < accepting_sz; ++i)
+        is_accepting[nstate_id(accepting[i])] = 1;
+
+    int32_t *bits = malloc((num_states + 1) * sizeof(int32_t));
+    size_t num_bits = 0;
+    for (size_t i = 0; i < num_states; ++i)
+        bits[i] = is_accepting[i] || has_symbol_transitions(states[i]) ? (int32_t) num_bits++ : -1;
+    size_t words = num_bits ? (num_bits + 63) / 64 : 1;
+
+    // the alphabet of the automaton, as sorted elementary ranges
+    size_t num_symbols;
+    struct symbol_range *symbols = elementary_ranges(states, num_states, &num_symbols);
+
+    // the transitions on each elementary range as sorted (bit of source, id of target) pairs
+    PAIR_VECTOR *pairs = malloc((num_symbols + 1) * sizeof(PAIR_VECTOR));
+    for (size_t i = 0; i < num_symbols; ++i)
+        pair_vector_init(&pairs[i]);
+    for (size_t i = 0; i < num_states; ++i)
+    {
+        uint64_t source = (uint64_t) bits[i] << 32;
+        struct nstate_transition_iterator iter;
+        SYMBOL sym;
+        const NSTATE *targets;
+        size_t count;
+        nstate_transition_iterator_begin(&iter, states[i]);
+        while (nstate_transition_iterator_next(&iter, &sym, &targets, &count))
+        {
+            if (sym == EPSILON) continue;
+            PAIR_VECTOR *column = &pairs[find_range(symbols, num_symbols, sym)];
+            for (size_t j = 0; j < count; ++j)
+                pair_vector_push(column, source | (uint32_t) nstate_id(targets[j]));
+        }
+
+        size_t ranges_sz;
+        const struct nstate_range_transition *ranges = nstate_view_range_transitions(states[i], &ranges_sz);
+        for (size_t j = 0; j < ranges_sz; ++j)
+        {
+            uint64_t pair = source | (uint32_t) nstate_id(ranges[j].to);
+            for (size_t column = find_range(symbols, num_symbols, ranges[j].lo);
+                column < num_symbols && symbols[column].hi <= ranges[j].hi; ++column)
+                pair_vector_push(&pairs[column], pair);
+        }
+    }
+
+    // symbols with identical transitions form an equivalence class. class 0 is reserved
+    // for the symbols without any transition
+    size_t table_capacity = 16;
+    while (table_capacity < 2 * num_symbols) table_capacity *= 2;
+    uint32_t *table = calloc(table_capacity, sizeof(uint32_t));
+    uint32_t *representative = malloc((num_symbols + 1) * sizeof(uint32_t));
+    uint32_t *symbol_class = malloc((num_symbols + 1) * sizeof(uint32_t));
+    size_t num_classes = 1;
+
+    for (size_t i = 0; i < num_symbols; ++i)
+    {
+        PAIR_VECTOR *column = &pairs[i];
+        qsort(column->data, column->size, sizeof(uint64_t), compare_pairs);
+        uint64_t h = hash_u64(column->size);
+        for (size_t j = 0; j < column->size; ++j)
+            h = hash_combine(h, hash_u64(column->data[j]));
+
+        size_t pos = h & (table_capacity - 1);
+        while (table[pos])
+        {
+            const PAIR_VECTOR *other = &pairs[representative[table[pos]]];
+            if (other->size == column->size && !memcmp(column->data, other->data, column->size * sizeof(uint64_t)))
+                break;
+            pos = (pos + 1) & (table_capacity - 1);
+        }
+        if (!table[pos])
+        {
+            table[pos] = num_classes;
+            representative[num_classes++] = i;
+        }
+        symbol_class[i] = table[pos];
+    }
+
+    BITSET_NFA nfa = NULL;
+    size_t table_size = (num_classes - 1) * num_bits * words * sizeof(uint64_t);
+    if (table_size > BITSET_NFA_MAX_MEMORY)
+    {
+        info("NFA[%p] needs a table of %lu bytes, too large for a bitset NFA.", automaton, table_size);
+        goto cleanup;
+    }
+
+    nfa = calloc(1, sizeof(struct bitset_nondeterministic_finite_automaton));
+    nfa->num_bits = num_bits;
+    nfa->words = words;
+    nfa->num_classes = num_classes;
+
+    for (size_t i = 0; i < num_symbols; ++i)
+        for (int64_t sym = symbols[i].lo < 0 ? 0 : symbols[i].lo; sym <= symbols[i].hi && sym < 256; ++sym)
+            nfa->byte_class[sym] = symbol_class[i];
+
+    // every byte takes the class of the byte it folds to, so folding costs nothing at scan time
+    if (fold)
+    {
+        uint32_t unfolded[256];
+        memcpy(unfolded, nfa->byte_class, sizeof(unfolded));
+        for (size_t sym = 0; sym < 256; ++sym)
+            nfa->byte_class[sym] = unfolded[fold[sym]];
+    }
+
+    nfa->ranges = malloc((2 * num_symbols + 1) * sizeof(struct bitset_nfa_range));
+    for (size_t i = 0; i < num_symbols; ++i)
+    {
+        add_wide_range(nfa->ranges, &nfa->num_ranges, symbols[i].lo, symbols[i].hi < 0 ? symbols[i].hi : -1, symbol_class[i]);
+        add_wide_range(nfa->ranges, &nfa->num_ranges, symbols[i].lo > 256 ? symbols[i].lo : 256, symbols[i].hi, symbol_class[i]);
+    }
+
+    uint64_t *closures = epsilon_closures(states, num_states, bits, words);
+
+    nfa->start = calloc(words, sizeof(uint64_t));
+    memcpy(nfa->start, closures + nstate_id(nfa_get_starting_state(automaton)) * words, words * sizeof(uint64_t));
+    nfa->accepting = calloc(words, sizeof(uint64_t));
+    for (size_t i = 0; i < num_states; ++i)
+        if (is_accepting[i]) nfa->accepting[WORD(bits[i])] |= MASK(bits[i]);
+
+    // the row of a bit on a class is the union of the closures of its targets
+    nfa->successors = aligned_alloc(ROW_ALIGNMENT, (table_size + ROW_ALIGNMENT) & ~(size_t) (ROW_ALIGNMENT - 1));
+    memset(nfa->successors, 0, table_size);
+    for (size_t c = 1; c < num_classes; ++c)
+    {
+        const PAIR_VECTOR *column = &pairs[representative[c]];
+        for (size_t j = 0; j < column->size; ++j)
+        {
+            uint64_t *row = nfa->successors + ((c - 1) * num_bits + (column->data[j] >> 32)) * words;
+            const uint64_t *closure = closures + (uint32_t) column->data[j] * words;
+            for (size_t w = 0; w < words; ++w)
+                row[w] |= closure[w];
+        }
+    }
+    free(closures);
+
+    nfa->footprint = sizeof(struct bitset_nondeterministic_finite_automaton) + table_size
+        + nfa->num_ranges * sizeof(struct bitset_nfa_range) + 2 * words * sizeof(uint64_t);
+    info("Converted NFA[%p] into BITSET_NFA[%p] with %lu bits and %lu classes.", automaton, nfa, num_bits, num_classes);
+
+cleanup:
+    free(symbol_class);
+    free(representative);
+    free(table);
+    for (size_t i = 0; i < num_symbols; ++i)
+        pair_vector_fini(&pairs[i]);
+    free(pairs);
+    free(symbols);
+    free(bits);
+    free(is_accepting);
+    return nfa;
+}
+
+void bitset_nfa_free(BITSET_NFA automaton)
+{
+    if (!automaton) return;
+
+    info("Destroying BITSET_NFA[%p].", automaton);
+    free(automaton->successors);
+    free(automaton->accepting);
+    free(automaton->start);
+    free(automaton->ranges);
+    free(automaton);
+}
+
+size_t bitset_nfa_count_bits(BITSET_NFA automaton)
+{
+    return automaton->num_bits;
+}
+
+size_t bitset_nfa_count_classes(BITSET_NFA automaton)
+{
+    return automaton->num_classes;
+}
+
+size_t bitset_nfa_words(BITSET_NFA automaton)
+{
+    return automaton->words;
+}
+
+size_t bitset_nfa_footprint(BITSET_NFA automaton)
+{
+    return automaton->footprint;
+}
+
+static inline uint32_t symbol_class(BITSET_NFA automaton, SYMBOL sym)
+{
+    if ((unsigned) sym < 256) return automaton->byte_class[sym];
+
+    // binary search the ranges of the wide symbols
+    const struct bitset_nfa_range *ranges = automaton->ranges;
+    size_t lo = 0, hi = automaton->num_ranges;
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (sym < ranges[mid].lo) hi = mid;
+        else if (sym > ranges[mid].hi) lo = mid + 1;
+        else return ranges[mid].class;
+    }
+    return 0;
+}
+
+void bitset_nfa_start(BITSET_NFA automaton, uint64_t *active)
+{
+    memcpy(active, automaton->start, automaton->words * sizeof(uint64_t));
+}
+
+int bitset_nfa_step(BITSET_NFA automaton, const uint64_t *restrict active, uint64_t *restrict next, SYMBOL sym)
+{
+    size_t words = automaton->words;
+    memset(next, 0, words * sizeof(uint64_t));
+    uint32_t class = symbol_class(automaton, sym);
+    if (!class) return 0;
+
+    const uint64_t *rows = automaton->successors + (class - 1) * automaton->num_bits * words;
+    for (size_t w = 0; w < words; ++w)
+    {
+        for (uint64_t pending = active[w]; pending; pending &= pending - 1)
+        {
+            // the union of whole rows has no dependence between words and is vectorized
+            const uint64_t *restrict row = rows + (w * 64 + __builtin_ctzll(pending)) * words;
+            for (size_t i = 0; i < words; ++i)
+                next[i] |= row[i];
+        }
+    }
+
+    uint64_t any = 0;
+    for (size_t i = 0; i < words; ++i)
+        any |= next[i];
+    return any != 0;
+}
+
+int bitset_nfa_is_accepting(BITSET_NFA automaton, const uint64_t *active)
+{
+    uint64_t any = 0;
+    for (size_t i = 0; i < automaton->words; ++i)
+        any |= active[i] & automaton->accepting[i];
+    return any != 0;
+}
+
+int bitset_nfa_accept(BITSET_NFA automaton, SYMBOL *string)
+{
+    uint64_t buffers[2][BITSET_NFA_MAX_WORDS];
+    uint64_t *active = buffers[0], *next = buffers[1];
+    bitset_nfa_start(automaton, active);
+
+    SYMBOL sym;
+    while ((sym = *string++))
+    {
+        // once no state is active, no suffix is accepted
+        if (!bitset_nfa_step(automaton, active, next, sym)) return 0;
+        uint64_t *tmp = active;
+        active = next;
+        next = tmp;
+    }
+    return bitset_nfa_is_accepting(automaton, active);
+}
+
+int bitset_nfa_accept_cstr(BITSET_NFA automaton, const char *string)
+{
+    uint64_t buffers[2][BITSET_NFA_MAX_WORDS];
+    uint64_t *active = buffers[0], *next = buffers[1];
+    bitset_nfa_start(automaton, active);
+
+    const unsigned char *cursor = (const unsigned char*) string;
+    while (*cursor)
+    {
+        if (!bitset_nfa_step(automaton, active, next, *cursor++)) return 0;
+        uint64_t *tmp = active;
+        active = next;
+        next = tmp;
+    }
+    return bitset_nfa_is_accepting(automaton, active);
+}
+
+int bitset_nfa_accept_u8(BITSET_NFA automaton, const uint8_t *symbols, size_t length)
+{
+    uint64_t buffers[2][BITSET_NFA_MAX_WORDS];
+    uint64_t *active = buffers[0], *next = buffers[1];
+    bitset_nfa_start(automaton, active);
+
+    for (size_t i = 0; i < length; ++i)
+    {
+        if (!bitset_nfa_step(automaton, active, next, symbols[i])) return 0;
+        uint64_t *tmp = active;
+        active = next;
+        next = tmp;
+    }
+    return bitset_nfa_is_accepting(automaton, active);
+}
+
+int bitset_nfa_accept_u16(BITSET_NFA automaton, const uint16_t *symbols, size_t length)
+{
+    uint64_t buffers[2][BITSET_NFA_MAX_WORDS];
+    uint64_t *active = buffers[0], *next = buffers[1];
+    bitset_nfa_start(automaton, active);
+
+    for (size_t i = 0; i < length; ++i)
+    {
+        if (!bitset_nfa_step(automaton, active, next, symbols[i])) return 0;
+        uint64_t *tmp = active;
+        active = next;
+        next = tmp;
+    }
+    return bitset_nfa_is_accepting(automaton, active);
+}
+
+int bitset_nfa_accept_symbols(BITSET_NFA automaton, const SYMBOL *symbols, size_t length)
+{
+    uint64_t buffers[2][BITSET_NFA_MAX_WORDS];
+    uint64_t *active = buffers[0], *next = buffers[1];
+    bitset_nfa_start(automaton, active);
+
+    for (size_t i = 0; i < length; ++i)
+    {
+        if (!bitset_nfa_step(automaton, active, next, symbols[i])) return 0;
+        uint64_t *tmp = active;
+        active = next;
+        next = tmp;
+    }
+    return bitset_nfa_is_accepting(automaton, active);
+}
@@ -0,0 +1,355 @@
+#include "regex/cache.h"
+
+#include "debug.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "automata/frozen_dfa.h"
+
+#define DEFAULT_CACHE_BUCKETS 16
+
+#define FNV_OFFSET 0xcbf29ce484222325ull
+#define FNV_PRIME 0x100000001b3ull
+
+// second seed for the upper half of the file name hash
+#define DISK_SEED 0x9e3779b97f4a7c15ull
+
+struct cache_entry
+{
+    char *pattern;
+    int flags;
+    uint64_t hash;
+    REGEX regex;
+    size_t footprint;
+    // chain of the bucket
+    struct cache_entry *bucket_next;
+    // recency list, the head is the most recently used entry
+    struct cache_entry *prev, *next;
+};
+
+struct regex_cache
+{
+    pthread_mutex_t lock;
+    struct cache_entry **buckets;
+    size_t num_buckets;
+    size_t size;
+    struct cache_entry *head, *tail;
+    size_t capacity;
+    size_t footprint;
+    size_t hits, misses, evictions;
+    // directory of saved automata, may be null
+    char *directory;
+    size_t disk_hits, disk_writes;
+};
+
+static uint64_t key_hash(const char *pattern, int flags)
+{
+    uint64_t hash = FNV_OFFSET;
+    for (const unsigned char *c = (const unsigned char*) pattern; *c; ++c)
+    {
+        hash ^= *c;
+        hash *= FNV_PRIME;
+    }
+    hash ^= (unsigned) flags;
+    return hash * FNV_PRIME;
+}
+
+static uint64_t fnv1a(uint64_t hash, const void *data, size_t size)
+{
+    const unsigned char *bytes = data;
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+/**
+ * builds the name of the file a pattern is saved to. the name is derived from everything
+ * which determines the compiled automaton, so a stale file is never picked up.
+ */
+static char *disk_path(const char *directory, const char *pattern, int flags)
+{
+    uint32_t key[] = { REGEX_COMPILER_VERSION, FROZEN_DFA_VERSION, (uint32_t) flags };
+    uint64_t hi = fnv1a(fnv1a(FNV_OFFSET ^ DISK_SEED, key, sizeof(key)), pattern, strlen(pattern));
+    uint64_t lo = fnv1a(fnv1a(FNV_OFFSET, pattern, strlen(pattern)), key, sizeof(key));
+
+    size_t length = strlen(directory) + 38;
+    char *path = malloc(length);
+    snprintf(path, length, "%s/%016lx%016lx.dfa", directory, hi, lo);
+    return path;
+}
+
+REGEX_CACHE regex_cache_init(size_t capacity)
+{
+    REGEX_CACHE cache = calloc(1, sizeof(struct regex_cache));
+    pthread_mutex_init(&cache->lock, NULL);
+    cache->num_buckets = DEFAULT_CACHE_BUCKETS;
+    cache->buckets = calloc(cache->num_buckets, sizeof(struct cache_entry*));
+    cache->capacity = capacity;
+    info("Initialized REGEX_CACHE[%p] with capacity %lu.", cache, capacity);
+    return cache;
+}
+
+static void entry_free(struct cache_entry *entry)
+{
+    regex_release(entry->regex);
+    free(entry->pattern);
+    free(entry);
+}
+
+static void lru_unlink(REGEX_CACHE cache, struct cache_entry *entry)
+{
+    if (entry->prev) entry->prev->next = entry->next;
+    else cache->head = entry->next;
+    if (entry->next) entry->next->prev = entry->prev;
+    else cache->tail = entry->prev;
+    entry->prev = entry->next = NULL;
+}
+
+static void lru_push_front(REGEX_CACHE cache, struct cache_entry *entry)
+{
+    entry->prev = NULL;
+    entry->next = cache->head;
+    if (cache->head) cache->head->prev = entry;
+    else cache->tail = entry;
+    cache->head = entry;
+}
+
+static struct cache_entry *cache_find(REGEX_CACHE cache, const char *pattern, int flags, uint64_t hash)
+{
+    struct cache_entry *entry = cache->buckets[hash & (cache->num_buckets - 1)];
+    for (; entry; entry = entry->bucket_next)
+    {
+        if (entry->hash == hash && entry->flags == flags && !strcmp(entry->pattern, pattern))
+            return entry;
+    }
+    return NULL;
+}
+
+static void cache_grow(REGEX_CACHE cache)
+{
+    size_t num_buckets = cache->num_buckets * 2;
+    struct cache_entry **buckets = calloc(num_buckets, sizeof(struct cache_entry*));
+    for (size_t i = 0; i < cache->num_buckets; ++i)
+    {
+        struct cache_entry *entry = cache->buckets[i], *next;
+        for (; entry; entry = next)
+        {
+            next = entry->bucket_next;
+            entry->bucket_next = buckets[entry->hash & (num_buckets - 1)];
+            buckets[entry->hash & (num_buckets - 1)] = entry;
+        }
+    }
+    free(cache->buckets);
+    cache->buckets = buckets;
+    cache->num_buckets = num_buckets;
+}
+
+// removes an entry from the cache without destroying it
+static void cache_remove(REGEX_CACHE cache, struct cache_entry *entry)
+{
+    struct cache_entry **link = &cache->buckets[entry->hash & (cache->num_buckets - 1)];
+    while (*link != entry) link = &(*link)->bucket_next;
+    *link = entry->bucket_next;
+
+    lru_unlink(cache, entry);
+    cache->size--;
+    cache->footprint -= entry->footprint;
+}
+
+// evicts the least recently used entries until the cache is within its capacity
+static void cache_evict(REGEX_CACHE cache)
+{
+    while (cache->footprint > cache->capacity && cache->tail)
+    {
+        struct cache_entry *victim = cache->tail;
+        cache_remove(cache, victim);
+        cache->evictions++;
+        info("Evicted \"%s\" from REGEX_CACHE[%p].", victim->pattern, cache);
+        entry_free(victim);
+    }
+}
+
+static void cache_insert(REGEX_CACHE cache, struct cache_entry *entry)
+{
+    if (cache->size >= cache->num_buckets) cache_grow(cache);
+
+    size_t bucket = entry->hash & (cache->num_buckets - 1);
+    entry->bucket_next = cache->buckets[bucket];
+    cache->buckets[bucket] = entry;
+
+    lru_push_front(cache, entry);
+    cache->size++;
+    cache->footprint += entry->footprint;
+
+    // this may evict the new entry if it is larger than the entire cache
+    cache_evict(cache);
+}
+
+/**
+ * marks an entry as the most recently used. the footprint of a tiered regex grows when its
+ * DFA is promoted after the entry was inserted, so it is sampled again on every hit.
+ */
+static void cache_touch(REGEX_CACHE cache, struct cache_entry *entry)
+{
+    lru_unlink(cache, entry);
+    lru_push_front(cache, entry);
+
+    size_t footprint = regex_footprint(entry->regex);
+    cache->footprint = cache->footprint - entry->footprint + footprint;
+    entry->footprint = footprint;
+
+    // this may evict the entry itself if it outgrew the entire cache
+    cache_evict(cache);
+}
+
+void regex_cache_fini(REGEX_CACHE cache)
+{
+    regex_cache_clear(cache);
+    pthread_mutex_destroy(&cache->lock);
+    free(cache->buckets);
+    free(cache->directory);
+    info("Destroyed REGEX_CACHE[%p].", cache);
+    free(cache);
+}
+
+int regex_cache_set_directory(REGEX_CACHE cache, const char *directory)
+{
+    char *copy = NULL;
+    if (directory)
+    {
+        if (mkdir(directory, 0755) && errno != EEXIST) return -1;
+        struct stat info;
+        if (stat(directory, &info) || !S_ISDIR(info.st_mode)) return -1;
+        copy = strdup(directory);
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    free(cache->directory);
+    cache->directory = copy;
+    pthread_mutex_unlock(&cache->lock);
+    return 0;
+}
+
+/**
+ * loads a regex from the directory of the cache or compiles it and saves it there. the file
+ * is named after the normalized pattern, but the original pattern is compiled: the normalized
+ * form of a case-insensitive class is already closed under case and does not parse back to it.
+ * the DFA of a tiered regex is built in the background, it is waited for so it can be saved.
+ */
+static REGEX disk_compile(REGEX_CACHE cache, const char *pattern, const char *normalized, int flags)
+{
+    char *path = NULL;
+    pthread_mutex_lock(&cache->lock);
+    if (cache->directory && !(flags & REGEX_NFA)) path = disk_path(cache->directory, normalized, flags);
+    pthread_mutex_unlock(&cache->lock);
+
+    if (!path) return regex_compile(pattern, flags);
+
+    REGEX regex = regex_load(path, flags);
+    if (regex)
+    {
+        pthread_mutex_lock(&cache->lock);
+        cache->disk_hits++;
+        pthread_mutex_unlock(&cache->lock);
+        free(path);
+        return regex;
+    }
+
+    regex = regex_compile(pattern, flags);
+    if (regex && regex_wait_promotion(regex) && !regex_save(regex, path))
+    {
+        pthread_mutex_lock(&cache->lock);
+        cache->disk_writes++;
+        pthread_mutex_unlock(&cache->lock);
+    }
+    free(path);
+    return regex;
+}
+
+REGEX regex_cache_get(REGEX_CACHE cache, const char *pattern, int flags)
+{
+    char *normalized = regex_normalize(pattern, flags);
+    if (!normalized) return NULL;
+    uint64_t hash = key_hash(normalized, flags);
+
+    pthread_mutex_lock(&cache->lock);
+    struct cache_entry *entry = cache_find(cache, normalized, flags, hash);
+    if (entry)
+    {
+        cache->hits++;
+        REGEX regex = regex_retain(entry->regex);
+        cache_touch(cache, entry);
+        pthread_mutex_unlock(&cache->lock);
+
+        free(normalized);
+        return regex;
+    }
+    cache->misses++;
+    pthread_mutex_unlock(&cache->lock);
+
+    // compiling can take a long time, other lookups must not wait for it
+    REGEX regex = disk_compile(cache, pattern, normalized, flags);
+    if (!regex)
+    {
+        free(normalized);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    entry = cache_find(cache, normalized, flags, hash);
+    if (entry)
+    {
+        // another thread compiled the same pattern in the meantime, keep the cached one
+        REGEX cached = regex_retain(entry->regex);
+        cache_touch(cache, entry);
+        pthread_mutex_unlock(&cache->lock);
+
+        regex_release(regex);
+        free(normalized);
+        return cached;
+    }
+
+    entry = calloc(1, sizeof(struct cache_entry));
+    entry->pattern = normalized;
+    entry->flags = flags;
+    entry->hash = hash;
+    entry->regex = regex_retain(regex);
+    entry->footprint = regex_footprint(regex);
+    cache_insert(cache, entry);
+    pthread_mutex_unlock(&cache->lock);
+
+    return regex;
+}
+
+void regex_cache_clear(REGEX_CACHE cache)
+{
+    pthread_mutex_lock(&cache->lock);
+    while (cache->head)
+    {
+        struct cache_entry *entry = cache->head;
+        cache_remove(cache, entry);
+        entry_free(entry);
+    }
+    pthread_mutex_unlock(&cache->lock);
+}
+
+void regex_cache_stats(REGEX_CACHE cache, struct regex_cache_stats *stats)
+{
+    pthread_mutex_lock(&cache->lock);
+    stats->hits = cache->hits;
+    stats->misses = cache->misses;
+    stats->evictions = cache->evictions;
+    stats->disk_hits = cache->disk_hits;
+    stats->disk_writes = cache->disk_writes;
+    stats->entries = cache->size;
+    stats->footprint = cache->footprint;
+    pthread_mutex_unlock(&cache->lock);
+}
@@ -4,9 +4,17 @@
 
 #include <stdio.h>
 #include <ctype.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdalign.h>
+#include <pthread.h>
 
 #include "utility/map.h"
 #include "utility/set.h"
+#include "utility/arena.h"
+#include "utility/hash.h"
+#include "utility/hashmap.h"
 
 /**
  * DFA_STATE_LOCKING toggles if the states owned by an DFA should be locked so that they are immutable
@@ -44,35 +52,102 @@
 
 #endif
 
-#define GET_TAG(state) ((state)->debug_tag ? (state)->debug_tag : "")
-
 struct deterministic_state
 {
-    const char *debug_tag;
     // MAP_KEY = symbols
     // MAP_VALUE = NSTATE
     MAP transitions;
+    // transitions on disjoint ranges of symbols, sorted so they can be binary searched
+    struct dstate_range_transition *ranges;
+    size_t num_ranges;
+    size_t ranges_capacity;
     int flags;
     int dfa_id;
+    // the arena holding the state and its transition table, null for heap states
+    ARENA arena;
 };   
 
+/**
+ * debug tags are cold, so they are kept in a side table keyed by the state instead of
+ * widening every state. only states marked with STATE_TAGGED have an entry.
+ */
+#define STATE_TAGGED 0x2
+
+DECLARE_HASH_MAP(TAG_TABLE, tag_table, DSTATE, const char *, hash_ptr, SCALAR_EQ)
+
+static pthread_mutex_t tag_lock = PTHREAD_MUTEX_INITIALIZER;
+static TAG_TABLE tags;
+
+static void dstate_set_tag(DSTATE state, const char *debug_tag)
+{
+    if (!debug_tag) return;
+    state->flags |= STATE_TAGGED;
+    pthread_mutex_lock(&tag_lock);
+    tag_table_set(&tags, state, debug_tag);
+    pthread_mutex_unlock(&tag_lock);
+}
+
+static void dstate_clear_tag(DSTATE state)
+{
+    if (!(state->flags & STATE_TAGGED)) return;
+    pthread_mutex_lock(&tag_lock);
+    tag_table_remove(&tags, state);
+    if (!tags.size) tag_table_fini(&tags);
+    pthread_mutex_unlock(&tag_lock);
+}
+
+const char *dstate_tag(DSTATE state)
+{
+    if (!(state->flags & STATE_TAGGED)) return NULL;
+    pthread_mutex_lock(&tag_lock);
+    const char **debug_tag = tag_table_get(&tags, state);
+    const char *result = debug_tag ? *debug_tag : NULL;
+    pthread_mutex_unlock(&tag_lock);
+    return result;
+}
+
+static const char *dstate_display_tag(DSTATE state)
+{
+    const char *debug_tag = dstate_tag(state);
+    return debug_tag ? debug_tag : "";
+}
+
+#define GET_TAG(state) dstate_display_tag(state)
+
 DSTATE dstate_new()
 {
     DSTATE state = malloc(sizeof(struct deterministic_state));
-    state->debug_tag = NULL;
     state->transitions = map_init();
+    state->ranges = NULL;
+    state->num_ranges = state->ranges_capacity = 0;
     state->flags = 0;
-    state->dfa_id = 0;
+    state->dfa_id = -1;
+    state->arena = NULL;
     info("Initialized DSTATE[%p:%s].", state, GET_TAG(state));
     return state;
 }
 
+DSTATE dstate_arena_new(ARENA arena)
+{
+    DSTATE state = arena_alloc(arena, sizeof(struct deterministic_state));
+    state->transitions = map_init_arena(arena);
+    state->ranges = NULL;
+    state->num_ranges = state->ranges_capacity = 0;
+    state->flags = 0;
+    state->dfa_id = -1;
+    state->arena = arena;
+    return state;
+}
+
 /**
  * force frees the object regardless of lock
  */
 static void __dstate_force_free(DSTATE state)
 {
+    if (state->arena) return;
     map_fini(state->transitions);
+    free(state->ranges);
+    dstate_clear_tag(state);
     free(state);
 }
 
@@ -85,7 +160,10 @@ int dstate_free(DSTATE state)
     }
 
     info("Destroying DSTATE[%p:%s].", state, GET_TAG(state));
+    if (state->arena) return 0;
     map_fini(state->transitions);
+    free(state->ranges);
+    dstate_clear_tag(state);
     free(state);
     return 0;
 }
@@ -93,17 +171,41 @@ int dstate_free(DSTATE state)
 DSTATE dstate_debug_new(const char *debug_tag)
 {
     DSTATE state = malloc(sizeof(struct deterministic_state));
-    state->debug_tag = debug_tag;
     state->transitions = map_init();
+    state->ranges = NULL;
+    state->num_ranges = state->ranges_capacity = 0;
     state->flags = 0;
-    state->dfa_id = 0;
+    state->dfa_id = -1;
+    state->arena = NULL;
+    dstate_set_tag(state, debug_tag);
     info("Initialized DSTATE[%p:%s].", state, GET_TAG(state));
     return state;
 }
 
-const char *dstate_tag(DSTATE state)
+int dstate_id(DSTATE state)
+{
+    return state->dfa_id;
+}
+
+// finds the position of the first range whose largest symbol is not below a symbol
+static size_t dstate_range_position(DSTATE state, SYMBOL sym)
 {
-    return state->debug_tag;
+    size_t lo = 0, hi = state->num_ranges;
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (state->ranges[mid].hi < sym) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// finds the range transition on a symbol, null if there is none
+static struct dstate_range_transition *dstate_find_range(DSTATE state, SYMBOL sym)
+{
+    size_t pos = dstate_range_position(state, sym);
+    if (pos < state->num_ranges && state->ranges[pos].lo <= sym) return &state->ranges[pos];
+    return NULL;
 }
 
 int dstate_add_transition(DSTATE from, SYMBOL sym, DSTATE to)
@@ -123,7 +225,7 @@ int dstate_add_transition(DSTATE from, SYMBOL sym, DSTATE to)
     info("Attempting to add transition on symbol %d from DSTATE[%p:%s] to DSTATE[%p:%s].", sym,
         from, GET_TAG(from), to, GET_TAG(to));
 
-    if (map_contains_key(from->transitions, sym))
+    if (map_contains_key(from->transitions, sym) || dstate_find_range(from, sym))
     {
         info("Failed to add transition on symbol %d from DSTATE[%p:%s] to DSTATE[%p:%s].", sym,
             from, GET_TAG(from), to, GET_TAG(to));
@@ -137,6 +239,73 @@ int dstate_add_transition(DSTATE from, SYMBOL sym, DSTATE to)
     return 0;
 }
 
+int dstate_add_range_transition(DSTATE from, SYMBOL lo, SYMBOL hi, DSTATE to)
+{
+    if (IS_STATE_LOCKED(from)) 
+    {
+        info("Attempting to modify locked DSTATE[%p:%s].", from, GET_TAG(from));
+        return -1;
+    }
+
+    if (lo > hi || (lo <= EPSILON && EPSILON <= hi))
+    {
+        info("Invalid range [%d, %d] for a transition from DSTATE[%p:%s].", lo, hi, from, GET_TAG(from));
+        return -1;
+    }
+    if (lo == hi) return dstate_add_transition(from, lo, to);
+
+    // the state must stay deterministic
+    size_t pos = dstate_range_position(from, lo);
+    if (pos < from->num_ranges && from->ranges[pos].lo <= hi)
+    {
+        info("Failed to add transition on range [%d, %d] from DSTATE[%p:%s] (overlapping range).", lo, hi,
+            from, GET_TAG(from));
+        return -1;
+    }
+
+    int sym;
+    struct map_iterator iter;
+    map_iterator_begin(&iter, from->transitions);
+    while (map_iterator_has_next(&iter))
+    {
+        map_iterator_next(&iter, &sym, NULL);
+        if (lo <= sym && sym <= hi)
+        {
+            info("Failed to add transition on range [%d, %d] from DSTATE[%p:%s] (overlapping symbol).", lo, hi,
+                from, GET_TAG(from));
+            return -1;
+        }
+    }
+
+    if (from->num_ranges == from->ranges_capacity)
+    {
+        size_t capacity = from->ranges_capacity ? 2 * from->ranges_capacity : 2;
+        if (from->arena)
+        {
+            // the old array is released with the arena
+            struct dstate_range_transition *ranges = arena_alloc(from->arena, capacity * sizeof(struct dstate_range_transition));
+            if (from->num_ranges) memcpy(ranges, from->ranges, from->num_ranges * sizeof(struct dstate_range_transition));
+            from->ranges = ranges;
+        }
+        else from->ranges = realloc(from->ranges, capacity * sizeof(struct dstate_range_transition));
+        from->ranges_capacity = capacity;
+    }
+
+    memmove(&from->ranges[pos + 1], &from->ranges[pos], (from->num_ranges - pos) * sizeof(struct dstate_range_transition));
+    from->ranges[pos] = (struct dstate_range_transition){ lo, hi, to };
+    from->num_ranges++;
+
+    info("Successfully added transition on range [%d, %d] from DSTATE[%p:%s] to DSTATE[%p:%s].", lo, hi,
+        from, GET_TAG(from), to, GET_TAG(to));
+    return 0;
+}
+
+const struct dstate_range_transition *dstate_view_range_transitions(DSTATE state, size_t *count)
+{
+    *count = state->num_ranges;
+    return state->num_ranges ? state->ranges : NULL;
+}
+
 int dstate_remove_transition(DSTATE from, SYMBOL sym, DSTATE to)
 {
     if (IS_STATE_LOCKED(from)) 
@@ -169,6 +338,7 @@ int dstate_clear_all_transitions(DSTATE from)
     }
 
     map_clear(from->transitions);
+    from->num_ranges = 0;
     return 0;
 }
 
@@ -185,7 +355,11 @@ size_t dstate_count_transition_symbols(DSTATE state)
 DSTATE dstate_get_transition_state(DSTATE state, SYMBOL sym)
 {
     if (!state) return NULL;
-    return map_get(state->transitions, sym);
+    DSTATE to = map_get(state->transitions, sym);
+    if (to || !state->num_ranges) return to;
+
+    struct dstate_range_transition *range = dstate_find_range(state, sym);
+    return range ? range->to : NULL;
 }
 
 int dstate_has_transition(DSTATE from, SYMBOL sym, DSTATE to)
@@ -196,7 +370,7 @@ int dstate_has_transition(DSTATE from, SYMBOL sym, DSTATE to)
 void dstate_debug_display(DSTATE state, size_t indent)
 {
     for (size_t i = 0; i < indent; ++i) printf("\t");
-    if (state->debug_tag) printf("DSTATE[%s|%p]\n", state->debug_tag, state);
+    if (dstate_tag(state)) printf("DSTATE[%s|%p]\n", dstate_tag(state), state);
     else printf("DSTATE[%p]\n", state);
     
     SYMBOL sym;    
@@ -212,10 +386,20 @@ void dstate_debug_display(DSTATE state, size_t indent)
         if (isprint(sym)) printf("----[%c]--> ", sym);
         else printf("----[%d]--> ", sym);
 
-        if (to->debug_tag) printf("DSTATE[%s|%p] ", to->debug_tag, to);
+        if (dstate_tag(to)) printf("DSTATE[%s|%p] ", dstate_tag(to), to);
         else printf("DSTATE[%p] ", to);
     }
     map_iterator_fini(iter);
+
+    for (size_t i = 0; i < state->num_ranges; ++i)
+    {
+        to = state->ranges[i].to;
+        for (size_t j = 0; j < indent + 1; ++j) printf("\t");
+        printf("----[%d-%d]--> ", state->ranges[i].lo, state->ranges[i].hi);
+
+        if (dstate_tag(to)) printf("DSTATE[%s|%p] ", dstate_tag(to), to);
+        else printf("DSTATE[%p] ", to);
+    }
 }
 
 // -------------------------------------------------------------------------------------- //
@@ -225,21 +409,35 @@ struct deterministic_finite_automaton
     DSTATE starting_state;
     SET accepting_states;
     SET all_states;  
+    // the arena holding all states, null if the states are heap states
+    ARENA arena;
 };
 
-static void aggregate_states(DSTATE state, SET state_set, int *uid_counter)
+/**
+ * collects and numbers the states reachable from the starting state in breadth-first
+ * order. the set keeps its elements in insertion order, so it doubles as the queue.
+ */
+static void aggregate_states(DSTATE starting_state, SET state_set)
 {
-    set_add(state_set, state);
-    state->dfa_id = (*uid_counter)++;
-
-    void *data;
-    MAP_ITERATOR iter = map_iterator_init(state->transitions);
-    while (map_iterator_has_next(iter))
+    set_add(state_set, starting_state);
+    for (size_t head = 0; head < set_size(state_set); ++head)
     {
-        map_iterator_next(iter, NULL, &data);
-        if (!set_contains(state_set, data)) aggregate_states(data, state_set, uid_counter);
+        // the view is taken anew, adding states may move the elements
+        DSTATE state = set_view(state_set)[head];
+        state->dfa_id = head;
+
+        void *data;
+        struct map_iterator iter;
+        map_iterator_begin(&iter, state->transitions);
+        while (map_iterator_has_next(&iter))
+        {
+            map_iterator_next(&iter, NULL, &data);
+            set_add(state_set, data);
+        }
+
+        for (size_t i = 0; i < state->num_ranges; ++i)
+            set_add(state_set, state->ranges[i].to);
     }
-    map_iterator_fini(iter);
 }
 
 DFA dfa_new(DSTATE starting_state, DSTATE *accepting_states, size_t num_accepting_states)
@@ -250,13 +448,12 @@ DFA dfa_new(DSTATE starting_state, DSTATE *accepting_states, size_t num_acceptin
         return NULL;
     }
 
-    int dfa_id = 0;
     SET accepting = set_init();
     for (size_t i = 0; i < num_accepting_states; ++i)
         set_add(accepting, accepting_states[i]);
     
     SET all = set_init();
-    aggregate_states(starting_state, all, &dfa_id);
+    aggregate_states(starting_state, all);
 
     if (!is_subset(accepting, all))
     {
@@ -283,22 +480,38 @@ DFA dfa_new(DSTATE starting_state, DSTATE *accepting_states, size_t num_acceptin
     dfa->starting_state = starting_state;
     dfa->accepting_states = accepting;
     dfa->all_states = all;
+    dfa->arena = NULL;
 
     info("Initializing DFA[%p].", dfa);
 
     return dfa;
 }
 
+DFA dfa_new_arena(DSTATE starting_state, DSTATE *accepting_states, size_t num_accepting_states, ARENA arena)
+{
+    DFA dfa = dfa_new(starting_state, accepting_states, num_accepting_states);
+    if (dfa) dfa->arena = arena;
+    return dfa;
+}
+
 void dfa_free(DFA automaton)
 {
-    DSTATE state; 
-    SET_ITERATOR iter = set_iterator_init(automaton->all_states);
-    while (set_iterator_has_next(iter))
+    if (automaton->arena)
     {
-        state = set_iterator_next(iter);
-        __dstate_force_free(state);
+        // every state lives in the arena
+        arena_fini(automaton->arena);
+    }
+    else
+    {
+        DSTATE state; 
+        SET_ITERATOR iter = set_iterator_init(automaton->all_states);
+        while (set_iterator_has_next(iter))
+        {
+            state = set_iterator_next(iter);
+            __dstate_force_free(state);
+        }
+        set_iterator_fini(iter);
     }
-    set_iterator_fini(iter);
 
     set_fini(automaton->all_states);
     set_fini(automaton->accepting_states);
@@ -332,11 +545,22 @@ size_t dfa_count_states(DFA automaton)
     return set_size(automaton->all_states);
 }
 
+struct DFA_simulator
+{
+    DFA dfa;
+    DSTATE active;
+    // nonzero if the simulator is released by dfa_sim_fini
+    int owned;
+};
+
 int dfa_accept(DFA automaton, SYMBOL *string)
 {
-    DFA_SIM sim = dfa_sim_init(automaton);
+    // the simulator is small enough to always live on the stack
+    alignas(max_align_t) struct DFA_simulator stack;
+    DFA_SIM sim = dfa_sim_init_scratch(automaton, &stack, sizeof(stack));
+    // once there is no active state the rest of the string cannot be accepted
     SYMBOL sym;
-    while ((sym = *string++))
+    while (sim->active && (sym = *string++))
         dfa_sim_step(sim, sym);
     SIM_STATUS status = dfa_sim_fini(sim);
     return status == SIM_SUCCESS;
@@ -344,14 +568,41 @@ int dfa_accept(DFA automaton, SYMBOL *string)
 
 int dfa_accept_cstr(DFA automaton, char *string)
 {
-    DFA_SIM sim = dfa_sim_init(automaton);
+    alignas(max_align_t) struct DFA_simulator stack;
+    DFA_SIM sim = dfa_sim_init_scratch(automaton, &stack, sizeof(stack));
     SYMBOL sym;
-    while ((sym = *string++))
+    while (sim->active && (sym = (unsigned char) *string++))
         dfa_sim_step(sim, sym);
     SIM_STATUS status = dfa_sim_fini(sim);
     return status == SIM_SUCCESS;
 }
 
+// the length delimited accept functions walk the states directly, without a simulator
+
+int dfa_accept_u8(DFA automaton, const uint8_t *symbols, size_t length)
+{
+    DSTATE state = automaton->starting_state;
+    for (size_t i = 0; i < length && state; ++i)
+        state = dstate_get_transition_state(state, symbols[i]);
+    return state && set_contains(automaton->accepting_states, state);
+}
+
+int dfa_accept_u16(DFA automaton, const uint16_t *symbols, size_t length)
+{
+    DSTATE state = automaton->starting_state;
+    for (size_t i = 0; i < length && state; ++i)
+        state = dstate_get_transition_state(state, symbols[i]);
+    return state && set_contains(automaton->accepting_states, state);
+}
+
+int dfa_accept_symbols(DFA automaton, const SYMBOL *symbols, size_t length)
+{
+    DSTATE state = automaton->starting_state;
+    for (size_t i = 0; i < length && state; ++i)
+        state = dstate_get_transition_state(state, symbols[i]);
+    return state && set_contains(automaton->accepting_states, state);
+}
+
 void dfa_debug_display(DFA automaton)
 {
     SET_ITERATOR iter;
@@ -364,7 +615,7 @@ void dfa_debug_display(DFA automaton)
     printf("DFA[%p]\n", automaton);
     printf("\tSTARTING STATE: ");
 
-    if (starting_state->debug_tag) printf("STATE[%s|%p]\n", starting_state->debug_tag, starting_state);
+    if (dstate_tag(starting_state)) printf("STATE[%s|%p]\n", dstate_tag(starting_state), starting_state);
     else printf("STATE[%p]\n", starting_state);
 
     printf("\tACCEPTING STATES:\n");
@@ -372,7 +623,7 @@ void dfa_debug_display(DFA automaton)
     while (set_iterator_has_next(iter))
     {
         state = set_iterator_next(iter);
-        if (state->debug_tag) printf("\t\tSTATE[%s|%p]\n", state->debug_tag, state);
+        if (dstate_tag(state)) printf("\t\tSTATE[%s|%p]\n", dstate_tag(state), state);
         else printf("\t\tSTATE[%p]\n", state);
     }
     set_iterator_fini(iter);
@@ -389,22 +640,37 @@ void dfa_debug_display(DFA automaton)
 
 // -------------------------------------------------------------------------------------- //
 
-struct DFA_simulator
+size_t dfa_sim_scratch_size(DFA automaton)
 {
-    DFA dfa;
-    DSTATE active;
-};
+    return sizeof(struct DFA_simulator);
+}
+
+DFA_SIM dfa_sim_init_scratch(DFA automaton, void *scratch, size_t size)
+{
+    if (!automaton || !scratch || (uintptr_t) scratch % alignof(max_align_t)) return NULL;
+    if (size < dfa_sim_scratch_size(automaton)) return NULL;
+
+    DFA_SIM sim = scratch;
+    sim->dfa = automaton;
+    sim->owned = 0;
+    dfa_sim_reset(sim);
+    return sim;
+}
 
 DFA_SIM dfa_sim_init(DFA automaton)
 {
     if (!automaton) return NULL;
 
-    DFA_SIM sim = malloc(sizeof(struct DFA_simulator));
-    sim->dfa = automaton;
-    sim->active = automaton->starting_state;
+    DFA_SIM sim = dfa_sim_init_scratch(automaton, malloc(sizeof(struct DFA_simulator)), sizeof(struct DFA_simulator));
+    sim->owned = 1;
     return sim;
 }
 
+void dfa_sim_reset(DFA_SIM sim)
+{
+    sim->active = sim->dfa->starting_state;
+}
+
 void dfa_sim_step(DFA_SIM sim, SYMBOL input_sym)
 {
     if (!sim) return;
@@ -413,9 +679,14 @@ void dfa_sim_step(DFA_SIM sim, SYMBOL input_sym)
         sim->active = dstate_get_transition_state(sim->active, input_sym);
 }
 
+SIM_STATUS dfa_sim_status(DFA_SIM sim)
+{
+    return set_contains(sim->dfa->accepting_states, sim->active) ? SIM_SUCCESS : SIM_FAILURE;
+}
+
 SIM_STATUS dfa_sim_fini(DFA_SIM sim)
 {
-    SIM_STATUS result = set_contains(sim->dfa->accepting_states, sim->active) ? SIM_SUCCESS : SIM_FAILURE;
-    free(sim);
+    SIM_STATUS result = dfa_sim_status(sim);
+    if (sim->owned) free(sim);
     return result;
 }
@@ -118,32 +118,34 @@ static void gen_transition(int fd, void *from, SYMBOL sym, void *to, ID_MAP map)
 
 }
 
-static void nstate_assign_id(NSTATE state, ID_MAP map)
+static void gen_range_transition(int fd, void *from, SYMBOL lo, SYMBOL hi, void *to, ID_MAP map)
 {
-    id_map_get(map, state);
+    gen_message(fd, id_map_get(map, from));
+    gen_message(fd, " -> ");
+    gen_message(fd, id_map_get(map, to));
 
-    SYMBOL *symbols = nstate_get_transition_symbols(state);
-    size_t symbols_sz = nstate_count_transition_symbols(state);
+    char buf[32] = { 0 };
+    if (lo >= 0 && hi < 0x80 && isprint(lo) && isprint(hi) && lo != '"' && hi != '"' && lo != '\\' && hi != '\\')
+        snprintf(buf, sizeof(buf), "%c-%c", lo, hi);
+    else snprintf(buf, sizeof(buf), "%d-%d", lo, hi);
 
-    for (size_t i = 0; i < symbols_sz; ++i)
-    {
-        NSTATE *states = nstate_get_transition_states(state, symbols[i]);
-        size_t states_sz = nstate_count_transition_states(state, symbols[i]);
-        for (size_t j = 0; j < states_sz; ++j)
-        {
-            NSTATE new_state = states[j];
-            if (!ptrmap_contains_key(map->map, new_state))
-                nstate_assign_id(new_state, map);
-        }
-        free(states);
-    }
-    free(symbols);
+    gen_message(fd, "[label=\"");
+    gen_message(fd, buf);
+    gen_message(fd, "\"];");
+}
+
+// numbers the states in the breadth-first order of the automaton
+static void nfa_assign_ids(NFA nfa, ID_MAP map)
+{
+    const NSTATE *states = nfa_view_states(nfa);
+    for (size_t i = 0; i < nfa_count_states(nfa); ++i)
+        id_map_get(map, states[i]);
 }
 
 static int nfa_gen_dot_fd(NFA nfa, int fd)
 {
     ID_MAP map = id_map_new();
-    nstate_assign_id(nfa_get_starting_state(nfa), map);
+    nfa_assign_ids(nfa, map);
 
     // generate the header
     gen_message(fd, dot_header);
@@ -185,6 +187,11 @@ static int nfa_gen_dot_fd(NFA nfa, int fd)
             free(to_states);
         }
         free(transition_symbols);
+
+        size_t ranges_sz;
+        const struct nstate_range_transition *ranges = nstate_view_range_transitions(from, &ranges_sz);
+        for (size_t j = 0; j < ranges_sz; ++j)
+            gen_range_transition(fd, from, ranges[j].lo, ranges[j].hi, ranges[j].to, map);
     }
     free(all_states);
 
@@ -325,26 +332,19 @@ int nfa_display(NFA nfa)
     return -1;
 }
 
-static void dstate_assign_id(DSTATE state, ID_MAP map)
+// numbers the states in the breadth-first order of the automaton
+static void dfa_assign_ids(DFA dfa, ID_MAP map)
 {
-    id_map_get(map, state);
-
-    SYMBOL *symbols = dstate_get_transition_symbols(state);
-    size_t symbols_sz = dstate_count_transition_symbols(state);
-
-    for (size_t i = 0; i < symbols_sz; ++i)
-    {
-        DSTATE to = dstate_get_transition_state(state, symbols[i]);
-        if (!ptrmap_contains_key(map->map, to))
-            dstate_assign_id(to, map);
-    }
-    free(symbols);
+    DSTATE *states = dfa_get_states(dfa);
+    for (size_t i = 0; i < dfa_count_states(dfa); ++i)
+        id_map_get(map, states[i]);
+    free(states);
 }
 
 static int dfa_gen_dot_fd(DFA dfa, int fd)
 {
     ID_MAP map = id_map_new();
-    dstate_assign_id(dfa_get_starting_state(dfa), map);
+    dfa_assign_ids(dfa, map);
 
     // generate the header
     gen_message(fd, dot_header);
@@ -380,6 +380,11 @@ static int dfa_gen_dot_fd(DFA dfa, int fd)
             gen_transition(fd, from, sym, to, map);
         }
         free(transition_symbols);
+
+        size_t ranges_sz;
+        const struct dstate_range_transition *ranges = dstate_view_range_transitions(from, &ranges_sz);
+        for (size_t j = 0; j < ranges_sz; ++j)
+            gen_range_transition(fd, from, ranges[j].lo, ranges[j].hi, ranges[j].to, map);
     }
     free(all_states);
 
@@ -0,0 +1,204 @@
+#include "regex/flow_table.h"
+
+#include "debug.h"
+
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "utility/hash.h"
+
+// magic numbers of pcap files with microsecond and nanosecond timestamps
+#define PCAP_MAGIC_USEC 0xa1b2c3d4u
+#define PCAP_MAGIC_NSEC 0xa1b23c4du
+
+#define PCAP_HEADER_SIZE 24
+#define PCAP_RECORD_SIZE 16
+
+// link types
+#define LINKTYPE_ETHERNET 1
+#define LINKTYPE_RAW 101
+#define LINKTYPE_IPV4 228
+
+#define ETHERTYPE_IPV4 0x0800
+#define ETHERTYPE_VLAN 0x8100
+
+#define IPPROTO_TCP_NUMBER 6
+#define IPPROTO_UDP_NUMBER 17
+
+// number of packets scanned in one batch
+#define REPLAY_BATCH 256
+
+// a capture file mapped into memory
+struct capture
+{
+    const unsigned char *data;
+    size_t size;
+    // the byte order of the file differs from the byte order of the host
+    int swapped;
+    int nanoseconds;
+    uint32_t link_type;
+};
+
+static uint32_t read_u32(const struct capture *capture, const unsigned char *at)
+{
+    uint32_t value;
+    memcpy(&value, at, sizeof(value));
+    return capture->swapped ? __builtin_bswap32(value) : value;
+}
+
+// fields of network headers are big endian
+static uint16_t read_be16(const unsigned char *at)
+{
+    return (uint16_t) (at[0] << 8 | at[1]);
+}
+
+static uint32_t read_be32(const unsigned char *at)
+{
+    return (uint32_t) at[0] << 24 | (uint32_t) at[1] << 16 | (uint32_t) at[2] << 8 | at[3];
+}
+
+static int capture_open(struct capture *capture, const char *filename)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return -1;
+
+    struct stat info;
+    if (fstat(fd, &info) || (size_t) info.st_size < PCAP_HEADER_SIZE)
+    {
+        close(fd);
+        return -1;
+    }
+    void *data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return -1;
+
+    capture->data = data;
+    capture->size = info.st_size;
+    uint32_t magic;
+    memcpy(&magic, capture->data, sizeof(magic));
+    capture->swapped = magic == __builtin_bswap32(PCAP_MAGIC_USEC) || magic == __builtin_bswap32(PCAP_MAGIC_NSEC);
+    magic = read_u32(capture, capture->data);
+    if (magic != PCAP_MAGIC_USEC && magic != PCAP_MAGIC_NSEC)
+    {
+        munmap(data, capture->size);
+        return -1;
+    }
+    capture->nanoseconds = magic == PCAP_MAGIC_NSEC;
+    capture->link_type = read_u32(capture, capture->data + 20);
+    return 0;
+}
+
+/**
+ * extracts the payload of a TCP or UDP packet over IPv4 and derives the id of its flow from
+ * the 5-tuple. returns nonzero if the packet has no such payload.
+ */
+static int packet_payload(uint32_t link_type, const unsigned char *packet, size_t length, struct flow_chunk *chunk)
+{
+    if (link_type == LINKTYPE_ETHERNET)
+    {
+        if (length < 14) return -1;
+        uint16_t ethertype = read_be16(packet + 12);
+        packet += 14;
+        length -= 14;
+        while (ethertype == ETHERTYPE_VLAN)
+        {
+            if (length < 4) return -1;
+            ethertype = read_be16(packet + 2);
+            packet += 4;
+            length -= 4;
+        }
+        if (ethertype != ETHERTYPE_IPV4) return -1;
+    }
+    else if (link_type != LINKTYPE_RAW && link_type != LINKTYPE_IPV4) return -1;
+
+    if (length < 20 || (packet[0] >> 4) != 4) return -1;
+    size_t header_length = (packet[0] & 0x0F) * 4;
+    size_t total_length = read_be16(packet + 2);
+    // only the first fragment carries the ports
+    if (header_length < 20 || total_length < header_length || (read_be16(packet + 6) & 0x1FFF)) return -1;
+    if (total_length < length) length = total_length;
+    if (length < header_length) return -1;
+
+    uint8_t protocol = packet[9];
+    uint32_t source = read_be32(packet + 12), destination = read_be32(packet + 16);
+    packet += header_length;
+    length -= header_length;
+
+    size_t transport_length;
+    if (protocol == IPPROTO_TCP_NUMBER)
+    {
+        if (length < 20) return -1;
+        transport_length = (packet[12] >> 4) * 4;
+    }
+    else if (protocol == IPPROTO_UDP_NUMBER) transport_length = 8;
+    else return -1;
+    if (length < transport_length || transport_length < 8) return -1;
+
+    uint64_t id = hash_combine(hash_combine(hash_u64(protocol), source), destination);
+    chunk->flow_id = hash_combine(id, (uint32_t) read_be16(packet) << 16 | read_be16(packet + 2));
+    chunk->data = packet + transport_length;
+    chunk->length = length - transport_length;
+    return chunk->length ? 0 : -1;
+}
+
+int flow_table_replay_pcap(FLOW_TABLE table, const char *filename, uint64_t idle_timeout,
+    struct flow_replay_stats *stats)
+{
+    struct capture capture;
+    if (capture_open(&capture, filename)) return -1;
+
+    struct flow_replay_stats counters = { 0 };
+    struct flow_chunk batch[REPLAY_BATCH];
+    size_t batch_size = 0;
+    uint64_t last_sweep = 0;
+    int started = 0;
+
+    size_t position = PCAP_HEADER_SIZE;
+    while (position + PCAP_RECORD_SIZE <= capture.size)
+    {
+        const unsigned char *record = capture.data + position;
+        uint64_t seconds = read_u32(&capture, record);
+        uint64_t fraction = read_u32(&capture, record + 4);
+        size_t captured = read_u32(&capture, record + 8);
+        if (captured > capture.size - position - PCAP_RECORD_SIZE) break;
+        position += PCAP_RECORD_SIZE + captured;
+        counters.packets++;
+
+        uint64_t time = seconds * 1000000 + (capture.nanoseconds ? fraction / 1000 : fraction);
+        if (!started)
+        {
+            last_sweep = time;
+            started = 1;
+        }
+
+        // flows are evicted at most once per timeout, after the chunks before are scanned
+        if (idle_timeout && time >= last_sweep + idle_timeout)
+        {
+            flow_table_scan_batch(table, batch, batch_size);
+            batch_size = 0;
+            flow_table_evict_idle(table, time - idle_timeout);
+            last_sweep = time;
+        }
+
+        struct flow_chunk *chunk = &batch[batch_size];
+        if (packet_payload(capture.link_type, record + PCAP_RECORD_SIZE, captured, chunk)) continue;
+        chunk->time = time;
+        counters.scanned++;
+        counters.bytes += chunk->length;
+
+        if (++batch_size == REPLAY_BATCH)
+        {
+            flow_table_scan_batch(table, batch, batch_size);
+            batch_size = 0;
+        }
+    }
+    flow_table_scan_batch(table, batch, batch_size);
+
+    munmap((void*) capture.data, capture.size);
+    info("Replayed %lu packets of \"%s\" into FLOW_TABLE[%p].", counters.packets, filename, table);
+    if (stats) *stats = counters;
+    return 0;
+}
@@ -0,0 +1,358 @@
+#include "regex/flow_table.h"
+
+#include "debug.h"
+
+#include <string.h>
+#include <stdalign.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "utility/hash.h"
+
+// initial number of slots of a shard
+#define DEFAULT_SHARD_CAPACITY 64
+
+// the capacity of a shard is always a power of two and at most 3/4 of the slots are used
+#define FITS(count, capacity) (4 * (count) <= 3 * (capacity))
+
+// entry flags
+#define FLOW_OCCUPIED 0x1
+#define FLOW_STOPPED 0x2
+
+// the packed state of a flow
+struct flow_entry
+{
+    uint64_t flow_id;
+    uint64_t offset;
+    uint64_t last_seen;
+    uint32_t state;
+    uint32_t flags;
+};
+
+// shards are aligned to cache lines, so the threads of different shards share no lines
+struct flow_shard
+{
+    alignas(64) pthread_mutex_t lock;
+    // open addressing table with linear probing
+    struct flow_entry *slots;
+    size_t capacity;
+    size_t size;
+    size_t scans, bytes, matches, evictions;
+};
+
+struct flow_table
+{
+    REGEX regex;
+    FROZEN_DFA dfa;
+    FLOW_MATCH_CALLBACK on_match;
+    void *context;
+    struct flow_shard *shards;
+    size_t num_shards;
+};
+
+// the low bits of the hash index the slots of a shard, the high bits choose the shard
+static inline uint64_t flow_hash(uint64_t flow_id)
+{
+    return hash_u64(flow_id);
+}
+
+static inline size_t hash_shard(FLOW_TABLE table, uint64_t hash)
+{
+    return (hash >> 32) % table->num_shards;
+}
+
+FLOW_TABLE flow_table_init(REGEX regex, size_t num_shards, FLOW_MATCH_CALLBACK on_match, void *context)
+{
+    // the DFA of a tiered regex may still be under construction
+    if (!regex_wait_promotion(regex)) return NULL;
+    FROZEN_DFA dfa = regex_dfa(regex);
+
+    if (!num_shards)
+    {
+        long processors = sysconf(_SC_NPROCESSORS_ONLN);
+        num_shards = processors > 0 ? processors : 1;
+    }
+
+    FLOW_TABLE table = calloc(1, sizeof(struct flow_table));
+    table->regex = regex_retain(regex);
+    table->dfa = dfa;
+    table->on_match = on_match;
+    table->context = context;
+    table->num_shards = num_shards;
+    table->shards = aligned_alloc(alignof(struct flow_shard), num_shards * sizeof(struct flow_shard));
+    memset(table->shards, 0, num_shards * sizeof(struct flow_shard));
+    for (size_t i = 0; i < num_shards; ++i)
+    {
+        pthread_mutex_init(&table->shards[i].lock, NULL);
+        table->shards[i].capacity = DEFAULT_SHARD_CAPACITY;
+        table->shards[i].slots = calloc(DEFAULT_SHARD_CAPACITY, sizeof(struct flow_entry));
+    }
+
+    info("Initialized FLOW_TABLE[%p] with %lu shards.", table, num_shards);
+    return table;
+}
+
+void flow_table_fini(FLOW_TABLE table)
+{
+    for (size_t i = 0; i < table->num_shards; ++i)
+    {
+        pthread_mutex_destroy(&table->shards[i].lock);
+        free(table->shards[i].slots);
+    }
+    free(table->shards);
+    regex_release(table->regex);
+    info("Destroyed FLOW_TABLE[%p].", table);
+    free(table);
+}
+
+size_t flow_table_count_shards(FLOW_TABLE table)
+{
+    return table->num_shards;
+}
+
+size_t flow_table_shard(FLOW_TABLE table, uint64_t flow_id)
+{
+    return hash_shard(table, flow_hash(flow_id));
+}
+
+// it is guaranteed that the flow is not in the shard and there is an empty slot
+static struct flow_entry *no_rehash_add_entry(struct flow_entry *slots, size_t capacity, const struct flow_entry *entry)
+{
+    size_t mask = capacity - 1;
+    size_t pos = flow_hash(entry->flow_id) & mask;
+    while (slots[pos].flags & FLOW_OCCUPIED)
+        pos = (pos + 1) & mask;
+    slots[pos] = *entry;
+    return &slots[pos];
+}
+
+static void shard_grow(struct flow_shard *shard)
+{
+    size_t capacity = 2 * shard->capacity;
+    struct flow_entry *slots = calloc(capacity, sizeof(struct flow_entry));
+    for (size_t i = 0; i < shard->capacity; ++i)
+        if (shard->slots[i].flags & FLOW_OCCUPIED)
+            no_rehash_add_entry(slots, capacity, &shard->slots[i]);
+    free(shard->slots);
+    shard->slots = slots;
+    shard->capacity = capacity;
+}
+
+// finds the entry of a flow, returns null if the flow is not in the shard
+static struct flow_entry *shard_find(struct flow_shard *shard, uint64_t flow_id, uint64_t hash)
+{
+    size_t mask = shard->capacity - 1;
+    for (size_t pos = hash & mask; shard->slots[pos].flags & FLOW_OCCUPIED; pos = (pos + 1) & mask)
+        if (shard->slots[pos].flow_id == flow_id) return &shard->slots[pos];
+    return NULL;
+}
+
+// removes the entry at a position by shifting the following entries of its probe sequence back
+static void shard_remove_at(struct flow_shard *shard, size_t pos)
+{
+    size_t mask = shard->capacity - 1;
+    size_t next = pos;
+    for (;;)
+    {
+        next = (next + 1) & mask;
+        if (!(shard->slots[next].flags & FLOW_OCCUPIED)) break;
+        // an entry may only move back if its home slot is not between the hole and itself
+        size_t home = flow_hash(shard->slots[next].flow_id) & mask;
+        if (((next - home) & mask) >= ((next - pos) & mask))
+        {
+            shard->slots[pos] = shard->slots[next];
+            pos = next;
+        }
+    }
+    shard->slots[pos].flags = 0;
+    shard->size--;
+}
+
+/**
+ * matches a chunk against the state of a flow and reports every match. returns the
+ * number of matches.
+ */
+static size_t scan_entry(FLOW_TABLE table, struct flow_entry *entry, const unsigned char *bytes, size_t length)
+{
+    size_t base = entry->offset, matches = 0;
+    entry->offset += length;
+    uint32_t state = entry->state;
+    if (frozen_dfa_is_dead(table->dfa, state) || (entry->flags & FLOW_STOPPED)) return 0;
+
+    for (size_t i = 0; i < length; ++i)
+    {
+        state = frozen_dfa_step(table->dfa, state, bytes[i]);
+        // no longer prefix of the flow can be matched
+        if (frozen_dfa_is_dead(table->dfa, state)) break;
+        if (!frozen_dfa_is_accepting(table->dfa, state)) continue;
+
+        matches++;
+        if (table->on_match && table->on_match(entry->flow_id, base + i + 1, table->context))
+        {
+            entry->flags |= FLOW_STOPPED;
+            break;
+        }
+    }
+    entry->state = state;
+    return matches;
+}
+
+// finds the entry of a flow or creates it, reporting the empty prefix of a new flow
+static struct flow_entry *shard_get(FLOW_TABLE table, struct flow_shard *shard, uint64_t flow_id, uint64_t hash,
+    size_t *matches)
+{
+    struct flow_entry *entry = shard_find(shard, flow_id, hash);
+    if (entry) return entry;
+
+    if (!FITS(shard->size + 1, shard->capacity)) shard_grow(shard);
+    struct flow_entry created = { flow_id, 0, 0, frozen_dfa_start(table->dfa), FLOW_OCCUPIED };
+    entry = no_rehash_add_entry(shard->slots, shard->capacity, &created);
+    shard->size++;
+
+    if (frozen_dfa_is_accepting(table->dfa, entry->state))
+    {
+        (*matches)++;
+        if (table->on_match && table->on_match(flow_id, 0, table->context))
+            entry->flags |= FLOW_STOPPED;
+    }
+    return entry;
+}
+
+int flow_table_scan(FLOW_TABLE table, uint64_t flow_id, const void *data, size_t length, uint64_t time)
+{
+    uint64_t hash = flow_hash(flow_id);
+    struct flow_shard *shard = &table->shards[hash_shard(table, hash)];
+
+    pthread_mutex_lock(&shard->lock);
+    size_t matches = 0;
+    struct flow_entry *entry = shard_get(table, shard, flow_id, hash, &matches);
+    matches += scan_entry(table, entry, data, length);
+    entry->last_seen = time;
+    int stopped = (entry->flags & FLOW_STOPPED) != 0;
+
+    shard->scans++;
+    shard->bytes += length;
+    shard->matches += matches;
+    pthread_mutex_unlock(&shard->lock);
+    return stopped;
+}
+
+// a chunk of a batch together with its position in the batch and its shard
+struct batch_item
+{
+    uint64_t hash;
+    size_t shard;
+    size_t index;
+};
+
+static int compare_batch_items(const void *a, const void *b)
+{
+    const struct batch_item *x = a, *y = b;
+    if (x->shard != y->shard) return (x->shard > y->shard) - (x->shard < y->shard);
+    if (x->hash != y->hash) return (x->hash > y->hash) - (x->hash < y->hash);
+    // the chunks of a flow keep their order
+    return (x->index > y->index) - (x->index < y->index);
+}
+
+size_t flow_table_scan_batch(FLOW_TABLE table, const struct flow_chunk *chunks, size_t count)
+{
+    struct batch_item *items = malloc(count * sizeof(struct batch_item) + 1);
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint64_t hash = flow_hash(chunks[i].flow_id);
+        items[i] = (struct batch_item){ hash, hash_shard(table, hash), i };
+    }
+    qsort(items, count, sizeof(struct batch_item), compare_batch_items);
+
+    size_t total = 0;
+    for (size_t i = 0; i < count;)
+    {
+        struct flow_shard *shard = &table->shards[items[i].shard];
+        size_t matches = 0, bytes = 0, end = i;
+
+        pthread_mutex_lock(&shard->lock);
+        while (end < count && items[end].shard == items[i].shard)
+        {
+            // the hash is a bijection, so the chunks of a flow are exactly a run of equal hashes
+            const struct flow_chunk *chunk = &chunks[items[end].index];
+            struct flow_entry *entry = shard_get(table, shard, chunk->flow_id, items[end].hash, &matches);
+            uint64_t hash = items[end].hash;
+            for (; end < count && items[end].hash == hash; ++end)
+            {
+                chunk = &chunks[items[end].index];
+                matches += scan_entry(table, entry, chunk->data, chunk->length);
+                if (chunk->time > entry->last_seen) entry->last_seen = chunk->time;
+                bytes += chunk->length;
+            }
+        }
+        shard->scans += end - i;
+        shard->bytes += bytes;
+        shard->matches += matches;
+        pthread_mutex_unlock(&shard->lock);
+
+        total += matches;
+        i = end;
+    }
+
+    free(items);
+    return total;
+}
+
+int flow_table_close(FLOW_TABLE table, uint64_t flow_id)
+{
+    uint64_t hash = flow_hash(flow_id);
+    struct flow_shard *shard = &table->shards[hash_shard(table, hash)];
+
+    pthread_mutex_lock(&shard->lock);
+    struct flow_entry *entry = shard_find(shard, flow_id, hash);
+    int matched = -1;
+    if (entry)
+    {
+        matched = !(entry->flags & FLOW_STOPPED) && frozen_dfa_is_accepting(table->dfa, entry->state);
+        shard_remove_at(shard, entry - shard->slots);
+    }
+    pthread_mutex_unlock(&shard->lock);
+    return matched;
+}
+
+size_t flow_table_evict_idle(FLOW_TABLE table, uint64_t before)
+{
+    size_t evicted = 0;
+    for (size_t i = 0; i < table->num_shards; ++i)
+    {
+        struct flow_shard *shard = &table->shards[i];
+        pthread_mutex_lock(&shard->lock);
+        size_t shard_evicted = 0;
+        for (size_t pos = 0; pos < shard->capacity; ++pos)
+        {
+            // removing an entry shifts a later one into its slot, which is checked again
+            while ((shard->slots[pos].flags & FLOW_OCCUPIED) && shard->slots[pos].last_seen < before)
+            {
+                shard_remove_at(shard, pos);
+                shard_evicted++;
+            }
+        }
+        shard->evictions += shard_evicted;
+        pthread_mutex_unlock(&shard->lock);
+        evicted += shard_evicted;
+    }
+
+    info("Evicted %lu idle flows from FLOW_TABLE[%p].", evicted, table);
+    return evicted;
+}
+
+void flow_table_stats(FLOW_TABLE table, struct flow_table_stats *stats)
+{
+    memset(stats, 0, sizeof(struct flow_table_stats));
+    for (size_t i = 0; i < table->num_shards; ++i)
+    {
+        struct flow_shard *shard = &table->shards[i];
+        pthread_mutex_lock(&shard->lock);
+        stats->flows += shard->size;
+        stats->scans += shard->scans;
+        stats->bytes += shard->bytes;
+        stats->matches += shard->matches;
+        stats->evictions += shard->evictions;
+        pthread_mutex_unlock(&shard->lock);
+    }
+}
@@ -0,0 +1,766 @@
+#include "automata/frozen_dfa.h"
+
+#include "debug.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "utility/ptrmap.h"
+
+#define ALIGN(offset) (((offset) + 7) & ~((uint64_t) 7))
+
+// state ids start at 1 so they can be stored in the maps directly
+#define ID_PTR(id) ((void*) (uintptr_t) (id))
+#define PTR_ID(ptr) ((uint32_t) (uintptr_t) (ptr))
+
+#define FNV_OFFSET 0xcbf29ce484222325ull
+#define FNV_PRIME 0x100000001b3ull
+
+struct frozen_dfa_header
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;
+    uint32_t num_states;
+    uint32_t num_classes;
+    uint32_t num_ranges;
+    uint32_t start_state;
+    uint64_t image_size;
+    uint64_t byte_class_offset;
+    uint64_t ranges_offset;
+    uint64_t transitions_offset;
+    uint64_t flags_offset;
+    // must be the last field, it is not covered by the checksum
+    uint64_t checksum;
+};
+
+struct frozen_dfa_range
+{
+    int32_t lo;
+    int32_t hi;
+    uint32_t class;
+};
+
+struct frozen_deterministic_finite_automaton
+{
+    const struct frozen_dfa_header *header;
+    const uint32_t *byte_class;
+    const struct frozen_dfa_range *ranges;
+    const uint32_t *transitions;
+    const uint8_t *flags;
+    void *image;
+    size_t image_size;
+    int mapped;
+};
+
+static uint64_t fnv1a(uint64_t hash, const void *data, size_t sz)
+{
+    const unsigned char *bytes = data;
+    for (size_t i = 0; i < sz; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+static uint64_t image_checksum(const void *image, size_t image_size)
+{
+    const struct frozen_dfa_header *header = image;
+    uint64_t hash = fnv1a(FNV_OFFSET, image, offsetof(struct frozen_dfa_header, checksum));
+    return fnv1a(hash, (const char*) image + header->header_size, image_size - header->header_size);
+}
+
+// sets up the section pointers of the frozen DFA from its image
+static FROZEN_DFA frozen_dfa_wrap(void *image, size_t image_size, int mapped)
+{
+    const struct frozen_dfa_header *header = image;
+    const char *base = image;
+
+    FROZEN_DFA automaton = malloc(sizeof(struct frozen_deterministic_finite_automaton));
+    automaton->header = header;
+    automaton->byte_class = (const uint32_t*) (base + header->byte_class_offset);
+    automaton->ranges = (const struct frozen_dfa_range*) (base + header->ranges_offset);
+    automaton->transitions = (const uint32_t*) (base + header->transitions_offset);
+    automaton->flags = (const uint8_t*) (base + header->flags_offset);
+    automaton->image = image;
+    automaton->image_size = image_size;
+    automaton->mapped = mapped;
+    return automaton;
+}
+
+// numbers the states of the DFA in breadth-first order starting at 1, the id 0 is the dead state
+static DSTATE *number_states(DFA automaton, PTR_MAP ids, size_t *num_states)
+{
+    size_t capacity = dfa_count_states(automaton);
+    DSTATE *order = malloc(capacity * sizeof(DSTATE));
+    size_t count = 0;
+
+    DSTATE start = dfa_get_starting_state(automaton);
+    order[count++] = start;
+    ptrmap_set(ids, start, ID_PTR(1));
+
+    for (size_t head = 0; head < count; ++head)
+    {
+        DSTATE state = order[head];
+        SYMBOL *symbols = dstate_get_transition_symbols(state);
+        size_t symbols_sz = dstate_count_transition_symbols(state);
+        for (size_t i = 0; i < symbols_sz; ++i)
+        {
+            DSTATE to = dstate_get_transition_state(state, symbols[i]);
+            if (ptrmap_contains_key(ids, to)) continue;
+
+            order[count++] = to;
+            ptrmap_set(ids, to, ID_PTR(count));
+        }
+        free(symbols);
+
+        size_t ranges_sz;
+        const struct dstate_range_transition *ranges = dstate_view_range_transitions(state, &ranges_sz);
+        for (size_t i = 0; i < ranges_sz; ++i)
+        {
+            if (ptrmap_contains_key(ids, ranges[i].to)) continue;
+
+            order[count++] = ranges[i].to;
+            ptrmap_set(ids, ranges[i].to, ID_PTR(count));
+        }
+    }
+
+    *num_states = count + 1;
+    return order;
+}
+
+struct boundary
+{
+    int64_t at;
+    int delta;
+};
+
+static int compare_boundaries(const void *a, const void *b)
+{
+    const struct boundary *x = a, *y = b;
+    return (x->at > y->at) - (x->at < y->at);
+}
+
+/**
+ * splits the alphabet of the automaton into elementary ranges: the symbols between two
+ * neighbouring boundaries of any transition, single symbols and ranges alike, behave
+ * alike in every state. only ranges covered by some transition are kept.
+ */
+static struct symbol_range *elementary_ranges(DSTATE *order, size_t num_states, size_t *num_ranges)
+{
+    size_t count = 0, capacity = 16;
+    struct boundary *boundaries = malloc(capacity * sizeof(struct boundary));
+    for (size_t i = 0; i + 1 < num_states; ++i)
+    {
+        SYMBOL *state_symbols = dstate_get_transition_symbols(order[i]);
+        size_t state_symbols_sz = dstate_count_transition_symbols(order[i]);
+        size_t ranges_sz;
+        const struct dstate_range_transition *ranges = dstate_view_range_transitions(order[i], &ranges_sz);
+
+        if (count + 2 * (state_symbols_sz + ranges_sz) > capacity)
+        {
+            while (count + 2 * (state_symbols_sz + ranges_sz) > capacity) capacity *= 2;
+            boundaries = realloc(boundaries, capacity * sizeof(struct boundary));
+        }
+        for (size_t j = 0; j < state_symbols_sz; ++j)
+        {
+            boundaries[count++] = (struct boundary){ state_symbols[j], 1 };
+            boundaries[count++] = (struct boundary){ (int64_t) state_symbols[j] + 1, -1 };
+        }
+        for (size_t j = 0; j < ranges_sz; ++j)
+        {
+            boundaries[count++] = (struct boundary){ ranges[j].lo, 1 };
+            boundaries[count++] = (struct boundary){ (int64_t) ranges[j].hi + 1, -1 };
+        }
+        free(state_symbols);
+    }
+    qsort(boundaries, count, sizeof(struct boundary), compare_boundaries);
+
+    struct symbol_range *elementary = malloc(count * sizeof(struct symbol_range) + 1);
+    *num_ranges = 0;
+    int open = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        open += boundaries[i].delta;
+        if (i + 1 == count || boundaries[i + 1].at == boundaries[i].at || !open) continue;
+        elementary[(*num_ranges)++] = (struct symbol_range){ boundaries[i].at, boundaries[i + 1].at - 1 };
+    }
+    free(boundaries);
+    return elementary;
+}
+
+// finds the elementary range containing a symbol of a transition
+static size_t find_range(const struct symbol_range *ranges, size_t num_ranges, SYMBOL sym)
+{
+    size_t lo = 0, hi = num_ranges;
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (ranges[mid].hi < sym) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// appends a range of wide symbols, merging it with the previous range of the same class
+static void add_wide_range(struct frozen_dfa_range *ranges, size_t *num_ranges, int64_t lo, int64_t hi, uint32_t class)
+{
+    if (lo > hi) return;
+    if (*num_ranges && ranges[*num_ranges - 1].class == class && (int64_t) ranges[*num_ranges - 1].hi + 1 == lo)
+    {
+        ranges[*num_ranges - 1].hi = hi;
+        return;
+    }
+    ranges[(*num_ranges)++] = (struct frozen_dfa_range){ lo, hi, class };
+}
+
+/**
+ * removes every state with a transition on one of the chosen classes to a state without
+ * the flag from the states with the flag, until the states left are closed under these
+ * transitions. `predecessors` holds the transitions into every state as state x class ids,
+ * those into state i start at `offsets[i]`.
+ */
+static void close_flag(const uint32_t *transitions, size_t num_states, size_t num_classes, const size_t *offsets,
+    const size_t *predecessors, const uint8_t *chosen, uint8_t *flags, uint8_t flag)
+{
+    uint32_t *stack = malloc(num_states * sizeof(uint32_t));
+    size_t top = 0;
+    for (size_t s = 0; s < num_states; ++s)
+    {
+        if (!(flags[s] & flag)) continue;
+        for (size_t c = 0; c < num_classes; ++c)
+        {
+            if (chosen[c] && !(flags[transitions[s * num_classes + c]] & flag))
+            {
+                flags[s] &= ~flag;
+                stack[top++] = s;
+                break;
+            }
+        }
+    }
+
+    // a state loses the flag as soon as one of its targets does
+    while (top)
+    {
+        uint32_t to = stack[--top];
+        for (size_t i = offsets[to]; i < offsets[to + 1]; ++i)
+        {
+            size_t from = predecessors[i] / num_classes;
+            if (chosen[predecessors[i] % num_classes] && (flags[from] & flag))
+            {
+                flags[from] &= ~flag;
+                stack[top++] = from;
+            }
+        }
+    }
+    free(stack);
+}
+
+/**
+ * marks in `all` the classes of every symbol but `EPSILON`, which is never part of a string,
+ * and in `text` the classes of the bytes 1-255. both arrays must be zeroed. the class 0 of
+ * symbols without any transition may not be the class of any symbol.
+ */
+static void symbol_classes(const uint32_t *byte_class, const struct frozen_dfa_range *ranges, size_t num_ranges,
+    uint8_t *all, uint8_t *text)
+{
+    for (size_t sym = 0; sym < 256; ++sym)
+    {
+        all[byte_class[sym]] = 1;
+        if (sym) text[byte_class[sym]] = 1;
+    }
+
+    // the ranges are disjoint, they cover the whole alphabet if their sizes add up
+    uint64_t covered = 256;
+    for (size_t i = 0; i < num_ranges; ++i)
+    {
+        covered += (uint64_t) ((int64_t) ranges[i].hi - ranges[i].lo + 1);
+        if (ranges[i].lo <= EPSILON && EPSILON <= ranges[i].hi)
+        {
+            covered--;
+            if (ranges[i].lo == ranges[i].hi) continue;
+        }
+        all[ranges[i].class] = 1;
+    }
+    if (covered < (1ull << 32) - 1) all[0] = 1;
+}
+
+// marks the dead and the universal states, the accepting states must already be marked
+static void mark_sink_states(const uint32_t *transitions, size_t num_states, size_t num_classes,
+    const uint32_t *byte_class, const struct frozen_dfa_range *ranges, size_t num_ranges, uint8_t *flags)
+{
+    size_t num_transitions = num_states * num_classes;
+    size_t *offsets = calloc(num_states + 1, sizeof(size_t));
+    size_t *predecessors = malloc(num_transitions * sizeof(size_t));
+    for (size_t i = 0; i < num_transitions; ++i)
+        offsets[transitions[i] + 1]++;
+    for (size_t s = 0; s < num_states; ++s)
+        offsets[s + 1] += offsets[s];
+    size_t *fill = malloc(num_states * sizeof(size_t));
+    memcpy(fill, offsets, num_states * sizeof(size_t));
+    for (size_t i = 0; i < num_transitions; ++i)
+        predecessors[fill[transitions[i]]++] = i;
+    free(fill);
+
+    uint8_t *all = calloc(num_classes, 1);
+    uint8_t *text = calloc(num_classes, 1);
+    symbol_classes(byte_class, ranges, num_ranges, all, text);
+
+    // every state starts out as a candidate, the candidates that can leave the set are dropped
+    for (size_t s = 0; s < num_states; ++s)
+        flags[s] |= (flags[s] & FROZEN_ACCEPTING) ? FROZEN_UNIVERSAL | FROZEN_TEXT_UNIVERSAL : FROZEN_DEAD;
+    close_flag(transitions, num_states, num_classes, offsets, predecessors, all, flags, FROZEN_DEAD);
+    close_flag(transitions, num_states, num_classes, offsets, predecessors, all, flags, FROZEN_UNIVERSAL);
+    close_flag(transitions, num_states, num_classes, offsets, predecessors, text, flags, FROZEN_TEXT_UNIVERSAL);
+
+    free(all);
+    free(text);
+    free(predecessors);
+    free(offsets);
+}
+
+FROZEN_DFA dfa_freeze(DFA automaton)
+{
+    return dfa_freeze_folded(automaton, NULL);
+}
+
+FROZEN_DFA dfa_freeze_folded(DFA automaton, const unsigned char *fold)
+{
+    if (!automaton) return NULL;
+
+    PTR_MAP ids = ptrmap_init();
+    size_t num_states;
+    DSTATE *order = number_states(automaton, ids, &num_states);
+
+    // the alphabet of the automaton, as sorted elementary ranges
+    size_t num_symbols;
+    struct symbol_range *symbols = elementary_ranges(order, num_states, &num_symbols);
+
+    // column i holds the target of every state on symbols[i]
+    uint32_t *columns = calloc(num_symbols * num_states + 1, sizeof(uint32_t));
+    for (size_t i = 0; i + 1 < num_states; ++i)
+    {
+        SYMBOL *state_symbols = dstate_get_transition_symbols(order[i]);
+        size_t state_symbols_sz = dstate_count_transition_symbols(order[i]);
+        for (size_t j = 0; j < state_symbols_sz; ++j)
+        {
+            size_t column = find_range(symbols, num_symbols, state_symbols[j]);
+            DSTATE to = dstate_get_transition_state(order[i], state_symbols[j]);
+            columns[column * num_states + i + 1] = PTR_ID(ptrmap_get(ids, to));
+        }
+        free(state_symbols);
+
+        size_t ranges_sz;
+        const struct dstate_range_transition *ranges = dstate_view_range_transitions(order[i], &ranges_sz);
+        for (size_t j = 0; j < ranges_sz; ++j)
+        {
+            uint32_t to = PTR_ID(ptrmap_get(ids, ranges[j].to));
+            for (size_t column = find_range(symbols, num_symbols, ranges[j].lo);
+                column < num_symbols && symbols[column].hi <= ranges[j].hi; ++column)
+                columns[column * num_states + i + 1] = to;
+        }
+    }
+
+    // symbols with identical columns form an equivalence class. class 0 is reserved
+    // for the symbols without any transition
+    size_t table_capacity = 16;
+    while (table_capacity < 2 * num_symbols) table_capacity *= 2;
+    uint32_t *table = calloc(table_capacity, sizeof(uint32_t));
+    uint32_t *representative = malloc((num_symbols + 1) * sizeof(uint32_t));
+    uint32_t *symbol_class = malloc((num_symbols + 1) * sizeof(uint32_t));
+    size_t num_classes = 1;
+
+    for (size_t i = 0; i < num_symbols; ++i)
+    {
+        const uint32_t *column = columns + i * num_states;
+        size_t pos = fnv1a(FNV_OFFSET, column, num_states * sizeof(uint32_t)) & (table_capacity - 1);
+        while (table[pos])
+        {
+            const uint32_t *other = columns + representative[table[pos]] * num_states;
+            if (!memcmp(column, other, num_states * sizeof(uint32_t))) break;
+            pos = (pos + 1) & (table_capacity - 1);
+        }
+        if (!table[pos])
+        {
+            table[pos] = num_classes;
+            representative[num_classes++] = i;
+        }
+        symbol_class[i] = table[pos];
+    }
+
+    // symbols outside of 0-255 are stored as maximal runs of consecutive symbols in the same class
+    size_t num_ranges = 0;
+    struct frozen_dfa_range *ranges = malloc((2 * num_symbols + 1) * sizeof(struct frozen_dfa_range));
+    for (size_t i = 0; i < num_symbols; ++i)
+    {
+        add_wide_range(ranges, &num_ranges, symbols[i].lo, symbols[i].hi < 0 ? symbols[i].hi : -1, symbol_class[i]);
+        add_wide_range(ranges, &num_ranges, symbols[i].lo > 256 ? symbols[i].lo : 256, symbols[i].hi, symbol_class[i]);
+    }
+
+    // lay out the image
+    uint64_t byte_class_offset = ALIGN(sizeof(struct frozen_dfa_header));
+    uint64_t ranges_offset = ALIGN(byte_class_offset + 256 * sizeof(uint32_t));
+    uint64_t transitions_offset = ALIGN(ranges_offset + num_ranges * sizeof(struct frozen_dfa_range));
+    uint64_t flags_offset = ALIGN(transitions_offset + num_states * num_classes * sizeof(uint32_t));
+    uint64_t image_size = ALIGN(flags_offset + num_states);
+
+    char *image = calloc(1, image_size);
+    struct frozen_dfa_header *header = (struct frozen_dfa_header*) image;
+    header->magic = FROZEN_DFA_MAGIC;
+    header->version = FROZEN_DFA_VERSION;
+    header->header_size = byte_class_offset;
+    header->num_states = num_states;
+    header->num_classes = num_classes;
+    header->num_ranges = num_ranges;
+    header->start_state = 1;
+    header->image_size = image_size;
+    header->byte_class_offset = byte_class_offset;
+    header->ranges_offset = ranges_offset;
+    header->transitions_offset = transitions_offset;
+    header->flags_offset = flags_offset;
+
+    uint32_t *byte_class = (uint32_t*) (image + byte_class_offset);
+    for (size_t i = 0; i < num_symbols; ++i)
+        for (int64_t sym = symbols[i].lo < 0 ? 0 : symbols[i].lo; sym <= symbols[i].hi && sym < 256; ++sym)
+            byte_class[sym] = symbol_class[i];
+
+    // every byte takes the class of the byte it folds to, so folding costs nothing at scan time
+    if (fold)
+    {
+        uint32_t unfolded[256];
+        memcpy(unfolded, byte_class, sizeof(unfolded));
+        for (size_t sym = 0; sym < 256; ++sym)
+            byte_class[sym] = unfolded[fold[sym]];
+    }
+
+    memcpy(image + ranges_offset, ranges, num_ranges * sizeof(struct frozen_dfa_range));
+
+    uint32_t *transitions = (uint32_t*) (image + transitions_offset);
+    for (size_t c = 1; c < num_classes; ++c)
+    {
+        const uint32_t *column = columns + representative[c] * num_states;
+        for (size_t s = 0; s < num_states; ++s)
+            transitions[s * num_classes + c] = column[s];
+    }
+
+    uint8_t *flags = (uint8_t*) (image + flags_offset);
+    DSTATE *accepting_states = dfa_get_accepting_states(automaton);
+    size_t accepting_states_sz = dfa_count_accepting_states(automaton);
+    for (size_t i = 0; i < accepting_states_sz; ++i)
+        flags[PTR_ID(ptrmap_get(ids, accepting_states[i]))] |= FROZEN_ACCEPTING;
+    free(accepting_states);
+    mark_sink_states(transitions, num_states, num_classes, byte_class, ranges, num_ranges, flags);
+
+    header->checksum = image_checksum(image, image_size);
+
+    free(ranges);
+    free(symbol_class);
+    free(representative);
+    free(table);
+    free(columns);
+    free(symbols);
+    free(order);
+    ptrmap_fini(ids);
+
+    FROZEN_DFA frozen = frozen_dfa_wrap(image, image_size, 0);
+    info("Froze DFA[%p] into FROZEN_DFA[%p] with %lu states and %lu classes.", automaton, frozen, num_states, num_classes);
+    return frozen;
+}
+
+void frozen_dfa_free(FROZEN_DFA automaton)
+{
+    if (!automaton) return;
+
+    info("Destroying FROZEN_DFA[%p].", automaton);
+    if (automaton->mapped) munmap(automaton->image, automaton->image_size);
+    else free(automaton->image);
+    free(automaton);
+}
+
+size_t frozen_dfa_count_states(FROZEN_DFA automaton)
+{
+    return automaton->header->num_states;
+}
+
+size_t frozen_dfa_count_classes(FROZEN_DFA automaton)
+{
+    return automaton->header->num_classes;
+}
+
+size_t frozen_dfa_footprint(FROZEN_DFA automaton)
+{
+    return automaton->image_size;
+}
+
+uint64_t frozen_dfa_checksum(FROZEN_DFA automaton)
+{
+    return automaton->header->checksum;
+}
+
+uint32_t frozen_dfa_start(FROZEN_DFA automaton)
+{
+    return automaton->header->start_state;
+}
+
+static inline uint32_t symbol_class(FROZEN_DFA automaton, SYMBOL sym)
+{
+    if ((unsigned) sym < 256) return automaton->byte_class[sym];
+
+    // binary search the ranges of the wide symbols
+    const struct frozen_dfa_range *ranges = automaton->ranges;
+    size_t lo = 0, hi = automaton->header->num_ranges;
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (sym < ranges[mid].lo) hi = mid;
+        else if (sym > ranges[mid].hi) lo = mid + 1;
+        else return ranges[mid].class;
+    }
+    return 0;
+}
+
+uint32_t frozen_dfa_step(FROZEN_DFA automaton, uint32_t state, SYMBOL sym)
+{
+    return automaton->transitions[state * automaton->header->num_classes + symbol_class(automaton, sym)];
+}
+
+int frozen_dfa_is_accepting(FROZEN_DFA automaton, uint32_t state)
+{
+    return automaton->flags[state] & FROZEN_ACCEPTING;
+}
+
+int frozen_dfa_is_dead(FROZEN_DFA automaton, uint32_t state)
+{
+    return automaton->flags[state] & FROZEN_DEAD;
+}
+
+int frozen_dfa_is_universal(FROZEN_DFA automaton, uint32_t state)
+{
+    return automaton->flags[state] & FROZEN_UNIVERSAL;
+}
+
+int frozen_dfa_accept(FROZEN_DFA automaton, SYMBOL *string)
+{
+    const uint32_t *transitions = automaton->transitions;
+    size_t num_classes = automaton->header->num_classes;
+    const uint8_t *flags = automaton->flags;
+    uint32_t state = automaton->header->start_state;
+
+    // no later symbol can change the outcome once a dead or universal state is entered
+    SYMBOL sym;
+    while (!(flags[state] & (FROZEN_DEAD | FROZEN_UNIVERSAL)) && (sym = *string++))
+        state = transitions[state * num_classes + symbol_class(automaton, sym)];
+    return flags[state] & FROZEN_ACCEPTING;
+}
+
+int frozen_dfa_accept_cstr(FROZEN_DFA automaton, char *string)
+{
+    const uint32_t *transitions = automaton->transitions;
+    size_t num_classes = automaton->header->num_classes;
+    const uint8_t *flags = automaton->flags;
+    uint32_t state = automaton->header->start_state;
+
+    // a c-style string holds only the bytes 1-255, for which more states are universal
+    SYMBOL sym;
+    while (!(flags[state] & (FROZEN_DEAD | FROZEN_TEXT_UNIVERSAL)) && (sym = (unsigned char) *string++))
+        state = transitions[state * num_classes + symbol_class(automaton, sym)];
+    return flags[state] & FROZEN_ACCEPTING;
+}
+
+int frozen_dfa_accept_u8(FROZEN_DFA automaton, const uint8_t *symbols, size_t length)
+{
+    // every byte has an entry in the class map, no symbol takes the path of the wide ranges
+    const uint32_t *transitions = automaton->transitions;
+    const uint32_t *byte_class = automaton->byte_class;
+    size_t num_classes = automaton->header->num_classes;
+    const uint8_t *flags = automaton->flags;
+    uint32_t state = automaton->header->start_state;
+
+    for (size_t i = 0; i < length && !(flags[state] & (FROZEN_DEAD | FROZEN_UNIVERSAL)); ++i)
+        state = transitions[state * num_classes + byte_class[symbols[i]]];
+    return flags[state] & FROZEN_ACCEPTING;
+}
+
+int frozen_dfa_accept_u16(FROZEN_DFA automaton, const uint16_t *symbols, size_t length)
+{
+    const uint32_t *transitions = automaton->transitions;
+    const uint32_t *byte_class = automaton->byte_class;
+    size_t num_classes = automaton->header->num_classes;
+    const uint8_t *flags = automaton->flags;
+    uint32_t state = automaton->header->start_state;
+
+    for (size_t i = 0; i < length && !(flags[state] & (FROZEN_DEAD | FROZEN_UNIVERSAL)); ++i)
+    {
+        uint16_t sym = symbols[i];
+        uint32_t class = sym < 256 ? byte_class[sym] : symbol_class(automaton, sym);
+        state = transitions[state * num_classes + class];
+    }
+    return flags[state] & FROZEN_ACCEPTING;
+}
+
+int frozen_dfa_accept_symbols(FROZEN_DFA automaton, const SYMBOL *symbols, size_t length)
+{
+    const uint32_t *transitions = automaton->transitions;
+    size_t num_classes = automaton->header->num_classes;
+    const uint8_t *flags = automaton->flags;
+    uint32_t state = automaton->header->start_state;
+
+    for (size_t i = 0; i < length && !(flags[state] & (FROZEN_DEAD | FROZEN_UNIVERSAL)); ++i)
+        state = transitions[state * num_classes + symbol_class(automaton, symbols[i])];
+    return flags[state] & FROZEN_ACCEPTING;
+}
+
+int frozen_dfa_save(FROZEN_DFA automaton, const char *filename)
+{
+    // the image is written to a temporary file in the same directory which is renamed over
+    // the destination, readers never observe a partially written image
+    size_t len = strlen(filename);
+    char *temporary = malloc(len + sizeof(".XXXXXX"));
+    memcpy(temporary, filename, len);
+    memcpy(temporary + len, ".XXXXXX", sizeof(".XXXXXX"));
+
+    int fd = mkstemp(temporary);
+    if (fd < 0)
+    {
+        free(temporary);
+        return -1;
+    }
+
+    const char *buffer = automaton->image;
+    size_t offset = 0;
+    ssize_t ret = 0;
+    while (offset != automaton->image_size)
+    {
+        ret = write(fd, buffer + offset, automaton->image_size - offset);
+        if (ret < 0) break;
+        offset += ret;
+    }
+
+    int failed = ret < 0 || fchmod(fd, 0644) || fsync(fd);
+    failed = close(fd) || failed;
+    if (failed || rename(temporary, filename))
+    {
+        unlink(temporary);
+        free(temporary);
+        return -1;
+    }
+    free(temporary);
+
+    info("Saved FROZEN_DFA[%p] to %s.", automaton, filename);
+    return 0;
+}
+
+int dfa_save(DFA automaton, const char *filename)
+{
+    FROZEN_DFA frozen = dfa_freeze(automaton);
+    if (!frozen) return -1;
+
+    int ret = frozen_dfa_save(frozen, filename);
+    frozen_dfa_free(frozen);
+    return ret;
+}
+
+// checks that a section lies within the image and is aligned
+static int valid_section(const struct frozen_dfa_header *header, uint64_t offset, uint64_t sz)
+{
+    if (offset % 8 || offset < header->header_size) return 0;
+    return offset <= header->image_size && sz <= header->image_size - offset;
+}
+
+static int valid_image(const void *image, size_t image_size)
+{
+    const struct frozen_dfa_header *header = image;
+
+    if (image_size < sizeof(struct frozen_dfa_header)) return 0;
+    if (header->magic != FROZEN_DFA_MAGIC || header->version != FROZEN_DFA_VERSION) return 0;
+    if (header->header_size < sizeof(struct frozen_dfa_header) || header->image_size != image_size) return 0;
+    if (!header->num_states || !header->num_classes || header->start_state >= header->num_states) return 0;
+
+    uint64_t transitions_sz = (uint64_t) header->num_states * header->num_classes * sizeof(uint32_t);
+    if (!valid_section(header, header->byte_class_offset, 256 * sizeof(uint32_t))) return 0;
+    if (!valid_section(header, header->ranges_offset, (uint64_t) header->num_ranges * sizeof(struct frozen_dfa_range))) return 0;
+    if (!valid_section(header, header->transitions_offset, transitions_sz)) return 0;
+    if (!valid_section(header, header->flags_offset, header->num_states)) return 0;
+
+    if (header->checksum != image_checksum(image, image_size)) return 0;
+
+    // every class and state referenced by the tables must exist, the executors do not check bounds
+    const char *base = image;
+    const uint32_t *byte_class = (const uint32_t*) (base + header->byte_class_offset);
+    for (size_t i = 0; i < 256; ++i)
+        if (byte_class[i] >= header->num_classes) return 0;
+
+    // the ranges must be sorted, disjoint and outside of 0-255
+    const struct frozen_dfa_range *ranges = (const struct frozen_dfa_range*) (base + header->ranges_offset);
+    for (size_t i = 0; i < header->num_ranges; ++i)
+    {
+        if (ranges[i].class >= header->num_classes || ranges[i].lo > ranges[i].hi) return 0;
+        if (ranges[i].lo < 256 && ranges[i].hi >= 0) return 0;
+        if (i && ranges[i].lo <= ranges[i - 1].hi) return 0;
+    }
+
+    const uint32_t *transitions = (const uint32_t*) (base + header->transitions_offset);
+    for (uint64_t i = 0; i < (uint64_t) header->num_states * header->num_classes; ++i)
+        if (transitions[i] >= header->num_states) return 0;
+
+    // the executors stop at dead and universal states, which must be closed under their transitions
+    const uint8_t *flags = (const uint8_t*) (base + header->flags_offset);
+    uint8_t *all = calloc(header->num_classes, 1);
+    uint8_t *text = calloc(header->num_classes, 1);
+    symbol_classes(byte_class, ranges, header->num_ranges, all, text);
+    int valid = 1;
+    for (uint64_t s = 0; s < header->num_states && valid; ++s)
+    {
+        const uint32_t *row = transitions + s * header->num_classes;
+        uint8_t accepting = flags[s] & FROZEN_ACCEPTING;
+        if ((flags[s] & FROZEN_DEAD) && accepting) valid = 0;
+        if ((flags[s] & (FROZEN_UNIVERSAL | FROZEN_TEXT_UNIVERSAL)) && !accepting) valid = 0;
+
+        for (size_t c = 0; c < header->num_classes; ++c)
+        {
+            if ((flags[s] & FROZEN_DEAD) && !(flags[row[c]] & FROZEN_DEAD)) valid = 0;
+            if ((flags[s] & FROZEN_UNIVERSAL) && all[c] && !(flags[row[c]] & FROZEN_UNIVERSAL)) valid = 0;
+            if ((flags[s] & FROZEN_TEXT_UNIVERSAL) && text[c] && !(flags[row[c]] & FROZEN_TEXT_UNIVERSAL)) valid = 0;
+        }
+    }
+    free(all);
+    free(text);
+    if (!valid) return 0;
+
+    return 1;
+}
+
+FROZEN_DFA dfa_load_mmap(const char *filename)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) || st.st_size < (off_t) sizeof(struct frozen_dfa_header))
+    {
+        close(fd);
+        return NULL;
+    }
+
+    size_t image_size = st.st_size;
+    void *image = mmap(NULL, image_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (image == MAP_FAILED) return NULL;
+
+    if (!valid_image(image, image_size))
+    {
+        info("Rejected invalid DFA image %s.", filename);
+        munmap(image, image_size);
+        return NULL;
+    }
+
+    FROZEN_DFA automaton = frozen_dfa_wrap(image, image_size, 1);
+    info("Mapped FROZEN_DFA[%p] from %s.", automaton, filename);
+    return automaton;
+}
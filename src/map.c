@@ -1,4 +1,6 @@
 #include "utility/map.h"
+#include "utility/arena.h"
+#include "utility/hash.h"
 
 #ifdef DEBUG
     #undef DEBUG
@@ -7,72 +9,80 @@
 #include "debug.h"
 
 #include <stdint.h>
+#include <string.h>
 
-// reasonable default set size
-#define DEFAULT_MAP_CAPACITY 32
+/**
+ * almost every state has only a handful of transitions, so small maps store their pairs
+ * inline and are searched linearly. a map spills into an open addressing hash table once
+ * it outgrows the inline storage.
+ */
+#define MAP_INLINE_CAPACITY 4
 
-#define MAP_LOADFACTOR 0.5
+// initial capacity of the hash table of a spilled map, always a power of two
+#define DEFAULT_MAP_CAPACITY 16
 
-#define REACHED_THRESHOLD(map) ((size_t) ((map)->capacity * MAP_LOADFACTOR) == (map)->size)
+// the table is rebuilt once 3/4 of the slots are either full or tombstones
+#define REACHED_THRESHOLD(map) (4 * ((map)->size + (map)->tombstones) >= 3 * (map)->capacity)
 
-#define TOMBSTONE ((size_t) -1)
-#define EMPTY (0xFFFFFFFF00000000ul)
+#define IS_SPILLED(map) ((map)->capacity != 0)
 
-// a tombstone is any value whose upper 32 bits is non-zero
-#define IS_TOMBSTONE(value) ( ((size_t) (value)) == TOMBSTONE )
-
-#define IS_EMPTY(value) ( ((size_t) (value)) == EMPTY )
-
-// we do not want to sign extend any integer value, so we cast the integer to an unsigned integer
-// next we cast the unsigned integer to a size_t which is will zero extend instead
-#define ZERO_EXTEND(int_value) ( (size_t) ((unsigned) int_value) )
-
-#define KEY(pair) ( (int) ((pair).key) )
-
-#define VALUE(pair) ( (pair).value )
-
-#define HAS_PAIR(buf, pos) (!IS_TOMBSTONE((buf)[pos].key) && !IS_EMPTY((buf)[pos].key))
-
-#define INSERT_PAIR(buf, pos, key, value) do {  \
-    (buf)[pos].key = ZERO_EXTEND(key);          \
-    (buf)[pos].value = value;                   \
-} while(0)
-
-#define CLEAR_BUF(buf, buf_size) do { \
-    for (size_t i = 0; i < buf_size; ++i) (buf)[i].key = EMPTY; \
-} while(0)
-
-typedef uint64_t hash_t;
-
-// random hash function
-#define HASH(value) (value * 67 + 0x123456)
+enum slot_state
+{
+    SLOT_EMPTY = 0,
+    SLOT_FULL,
+    SLOT_TOMBSTONE
+};
 
 struct key_value_pair
 {
-    size_t key;
+    int key;
+    // the state of the slot, only used by the hash table
+    int state;
     void *value;
 };
 
 struct map
 {
-    struct key_value_pair *buffer;
-    size_t capacity;
     size_t size;
+    // number of slots in the hash table, zero while the pairs are stored inline
+    size_t capacity;
+    size_t tombstones;
+    struct key_value_pair *buffer;
+    struct key_value_pair pairs[MAP_INLINE_CAPACITY];
+    // the arena the map is allocated from, null if it is allocated from the heap
+    ARENA arena;
 };
 
-struct map_iterator
+static inline uint32_t hash(int key)
 {
-    MAP map;
-    size_t idx;
-};
+    return hash_u32((uint32_t) key);
+}
+
+static struct key_value_pair *buffer_alloc(ARENA arena, size_t capacity)
+{
+    if (arena) return arena_calloc(arena, capacity, sizeof(struct key_value_pair));
+    return calloc(capacity, sizeof(struct key_value_pair));
+}
+
+static void buffer_free(MAP map)
+{
+    if (!map->arena) free(map->buffer);
+    map->buffer = NULL;
+}
 
 MAP map_init()
 {
-    MAP map = malloc(sizeof(struct map));
-    map->capacity = DEFAULT_MAP_CAPACITY;
+    return map_init_arena(NULL);
+}
+
+MAP map_init_arena(ARENA arena)
+{
+    MAP map = arena ? arena_alloc(arena, sizeof(struct map)) : malloc(sizeof(struct map));
+    map->arena = arena;
     map->size = 0;
-    map->buffer = calloc(map->capacity, sizeof(struct key_value_pair));
-    CLEAR_BUF(map->buffer, map->capacity);
+    map->capacity = 0;
+    map->tombstones = 0;
+    map->buffer = NULL;
     info("Map[%p] initialized.", map);
     return map;
 }
@@ -80,6 +90,8 @@ MAP map_init()
 void map_fini(MAP map)
 {
     info("Map[%p] destroyed.", map);
+    // the memory of arena maps is released with the arena
+    if (map->arena) return;
     free(map->buffer);
     free(map);
 }
@@ -89,40 +101,26 @@ size_t map_size(MAP map)
     return map->size;
 }
 
-static struct key_value_pair * map_find_pair(MAP map, int key)
+static struct key_value_pair *map_find_pair(MAP map, int key)
 {
     info("Searching for %d in Map[%p].", key, map);
-    size_t init_pos, pos;
-    hash_t hash = HASH(key);
-
-    pos = init_pos = hash % map->capacity;
-    while (1)
+    if (!IS_SPILLED(map))
     {
-        info("\tChecking index %lu which contains [%d : %p].", pos, KEY(map->buffer[pos]), VALUE(map->buffer[pos]));
-        // if we run into an empty cell, then the set does not contain key
-        if (IS_EMPTY( KEY(map->buffer[pos]) ))
-        {
-            info("\tKey %d is not in Map[%p] (empty cell).", key, map);
-            return NULL;
-        }
+        for (size_t i = 0; i < map->size; ++i)
+            if (map->pairs[i].key == key) return &map->pairs[i];
+        return NULL;
+    }
 
-        // return nonzero if we find the key
-        if (HAS_PAIR(map->buffer, pos) && KEY(map->buffer[pos]) == key)
-        {
-            info("\tKey %d is in Map[%p].", key, map);
+    size_t mask = map->capacity - 1;
+    size_t pos = hash(key) & mask;
+    // the table always has an empty slot, so the search terminates
+    while (map->buffer[pos].state != SLOT_EMPTY)
+    {
+        if (map->buffer[pos].state == SLOT_FULL && map->buffer[pos].key == key)
             return &map->buffer[pos];
-        }
-
-        // we move the position forward and loop to the beginning of the buffer if necessary
-        pos = (pos + 1) % map->capacity;
-
-        // if we returned to the initial position, then the key is not in the map
-        if (pos == init_pos)
-        {
-            info("\tKey %d is not in Map[%p] (complete search).", key, map);
-            return NULL;
-        }
+        pos = (pos + 1) & mask;
     }
+    return NULL;
 }
 
 int map_contains_key(MAP map, int key)
@@ -130,42 +128,75 @@ int map_contains_key(MAP map, int key)
     return map_find_pair(map, key) != NULL;
 }
 
-// it is guaranteed that the buf does not need to be resized, i.e. there is an empty slot
-// in the buffer for the element that is being added
-static void no_rehash_add_pair(struct key_value_pair *buf, size_t buf_size, int key, void *value)
+// it is guaranteed that the key is not in the table and that there is an empty slot
+static void no_rehash_add_pair(struct key_value_pair *buf, size_t capacity, int key, void *value)
 {
-    hash_t hash = HASH(key);
-    size_t pos = hash % buf_size;
-
-    // find a TOMBSTONE or EMPTY
-    while (HAS_PAIR(buf, pos))
-    {
-        ++pos;
-        if (pos == buf_size) pos = 0;
-    }
-    INSERT_PAIR(buf, pos, key, value);
+    size_t mask = capacity - 1;
+    size_t pos = hash(key) & mask;
+    while (buf[pos].state == SLOT_FULL)
+        pos = (pos + 1) & mask;
+    buf[pos].key = key;
+    buf[pos].state = SLOT_FULL;
+    buf[pos].value = value;
     info("\t[%d : %p] inserted into index %lu.", key, value, pos);
 }
 
-static void rehash(MAP map)
+// moves the pairs into a new table, dropping all tombstones
+static void rehash(MAP map, size_t new_capacity)
 {
     info("Map[%p] rehashed.", map);
-    size_t new_capacity;
-
-    // double the capacity
-    new_capacity = map->capacity * 2;
-    struct key_value_pair *new_buffer = calloc(new_capacity, sizeof(struct key_value_pair));
-    CLEAR_BUF(new_buffer, new_capacity);
+    struct key_value_pair *new_buffer = buffer_alloc(map->arena, new_capacity);
 
-    for (size_t i = 0; i < map->capacity; ++i)
+    if (IS_SPILLED(map))
+    {
+        for (size_t i = 0; i < map->capacity; ++i)
+        {
+            if (map->buffer[i].state == SLOT_FULL)
+                no_rehash_add_pair(new_buffer, new_capacity, map->buffer[i].key, map->buffer[i].value);
+        }
+        buffer_free(map);
+    }
+    else
     {
-        if (HAS_PAIR(map->buffer, i))
-            no_rehash_add_pair(new_buffer, new_capacity, KEY(map->buffer[i]), VALUE(map->buffer[i]));
+        for (size_t i = 0; i < map->size; ++i)
+            no_rehash_add_pair(new_buffer, new_capacity, map->pairs[i].key, map->pairs[i].value);
     }
 
-    map->capacity = new_capacity;
-    free(map->buffer);
     map->buffer = new_buffer;
+    map->capacity = new_capacity;
+    map->tombstones = 0;
+}
+
+// inserts a pair whose key is not in the map
+static void map_insert(MAP map, int key, void *value)
+{
+    if (!IS_SPILLED(map))
+    {
+        if (map->size < MAP_INLINE_CAPACITY)
+        {
+            map->pairs[map->size].key = key;
+            map->pairs[map->size].value = value;
+            map->size++;
+            return;
+        }
+        rehash(map, DEFAULT_MAP_CAPACITY);
+    }
+    else if (REACHED_THRESHOLD(map))
+    {
+        // only grow if the table is actually full, otherwise purge the tombstones
+        size_t new_capacity = 2 * map->size >= map->capacity ? 2 * map->capacity : map->capacity;
+        rehash(map, new_capacity);
+    }
+
+    size_t mask = map->capacity - 1;
+    size_t pos = hash(key) & mask;
+    while (map->buffer[pos].state == SLOT_FULL)
+        pos = (pos + 1) & mask;
+    if (map->buffer[pos].state == SLOT_TOMBSTONE) map->tombstones--;
+    map->buffer[pos].key = key;
+    map->buffer[pos].state = SLOT_FULL;
+    map->buffer[pos].value = value;
+    map->size++;
 }
 
 int map_set(MAP map, int key, void *value)
@@ -179,16 +210,14 @@ int map_set(MAP map, int key, void *value)
     }
 
     struct key_value_pair *pair = map_find_pair(map, key);
-    if (pair) // if the pair is in the set already, we just set the value
+    if (pair) // if the pair is in the map already, we just set the value
     {
         pair->value = value;
         info("Successfully set [%d : %p] in Map[%p].", key, value, map);
         return 0;
     }
-    
-    if (REACHED_THRESHOLD(map)) rehash(map);
-    no_rehash_add_pair(map->buffer, map->capacity, key, value);
-    map->size++;
+
+    map_insert(map, key, value);
     info("Successfully set [%d : %p] to Map[%p].", key, value, map);
     return 0;
 }
@@ -203,16 +232,14 @@ int map_add(MAP map, int key, void *value)
         return -1;
     }
 
-    // we cannot add duplicate keys to the set
+    // we cannot add duplicate keys to the map
     if (map_contains_key(map, key))
     {
         info("Failed to add new pair [%d : %p] to Map[%p] (key already in map).", key, value, map);
         return -1;
     }
-    
-    if (REACHED_THRESHOLD(map)) rehash(map);
-    no_rehash_add_pair(map->buffer, map->capacity, key, value);
-    map->size++;
+
+    map_insert(map, key, value);
     info("Successfully added [%d : %p] to Map[%p].", key, value, map);
     return 0;
 }
@@ -221,16 +248,7 @@ void * map_get(MAP map, int key)
 {
     info("Attempting to retrieve key %d from Map[%p].", key, map);
     struct key_value_pair *pair = map_find_pair(map, key);
-    if (pair)
-    {
-        info("\tFound pair [%d : %p] in Map[%p].", KEY(*pair), VALUE(*pair), map);
-        return VALUE(*pair);
-    }
-    else
-    {
-        info("\tDid not find key %d in Map[%p].", key, map);
-        return NULL;
-    }
+    return pair ? pair->value : NULL;
 }
 
 int map_remove(MAP map, int key)
@@ -243,8 +261,16 @@ int map_remove(MAP map, int key)
         return -1;
     }
 
-    info("\tSuccessfully removed [%d : %p] in Map[%p].", KEY(*pair), VALUE(*pair), map);
-    pair->key = TOMBSTONE;
+    if (IS_SPILLED(map))
+    {
+        pair->state = SLOT_TOMBSTONE;
+        map->tombstones++;
+    }
+    else
+    {
+        // the inline pairs are kept dense
+        *pair = map->pairs[map->size - 1];
+    }
     map->size--;
     return 0;
 }
@@ -252,7 +278,9 @@ int map_remove(MAP map, int key)
 void map_clear(MAP map)
 {
     info("Clearing Map[%p].", map);
-    CLEAR_BUF(map->buffer, map->capacity);
+    if (IS_SPILLED(map)) buffer_free(map);
+    map->capacity = 0;
+    map->tombstones = 0;
     map->size = 0;
 }
 
@@ -264,10 +292,10 @@ int * map_keys(MAP map)
     int *keys = malloc(sz * sizeof(int));
 
     size_t i = 0;
-    MAP_ITERATOR iter = map_iterator_init(map);
-    while (map_iterator_has_next(iter))
-        map_iterator_next(iter, &keys[i++], NULL);
-    map_iterator_fini(iter);
+    struct map_iterator iter;
+    map_iterator_begin(&iter, map);
+    while (map_iterator_has_next(&iter))
+        map_iterator_next(&iter, &keys[i++], NULL);
 
     return keys;
 }
@@ -278,25 +306,32 @@ void **map_values(MAP map)
     void **values = malloc(sz * sizeof(void*));
 
     size_t i = 0;
-    MAP_ITERATOR iter = map_iterator_init(map);
-    while (map_iterator_has_next(iter))
-        map_iterator_next(iter, NULL, &values[i++]);
-    map_iterator_fini(iter);
+    struct map_iterator iter;
+    map_iterator_begin(&iter, map);
+    while (map_iterator_has_next(&iter))
+        map_iterator_next(&iter, NULL, &values[i++]);
 
     return values;
 }
 
+// finds the first slot holding a pair at or after a position
+static size_t next_pair(MAP map, size_t pos)
+{
+    if (!IS_SPILLED(map)) return pos < map->size ? pos : map->size;
+    while (pos < map->capacity && map->buffer[pos].state != SLOT_FULL) pos++;
+    return pos;
+}
+
+void map_iterator_begin(MAP_ITERATOR iterator, MAP map)
+{
+    iterator->map = map;
+    iterator->idx = next_pair(map, 0);
+}
+
 MAP_ITERATOR map_iterator_init(MAP map)
 {
     MAP_ITERATOR iter = malloc(sizeof(struct map_iterator));
-    iter->map = map;
-    size_t pos = 0;
-    while (pos < map->capacity)
-    {
-        if (HAS_PAIR(map->buffer, pos)) break;
-        pos++;
-    }
-    iter->idx = pos;
+    map_iterator_begin(iter, map);
     return iter;
 }
 
@@ -307,21 +342,17 @@ void map_iterator_fini(MAP_ITERATOR iterator)
 
 int map_iterator_has_next(MAP_ITERATOR iterator)
 {
-    return iterator->idx != iterator->map->capacity;
+    MAP map = iterator->map;
+    return iterator->idx < (IS_SPILLED(map) ? map->capacity : map->size);
 }
 
 void map_iterator_next(MAP_ITERATOR iterator, int *key, void **value)
 {
     MAP map = iterator->map;
-    
-    if (key) *key = KEY(map->buffer[iterator->idx]);
-    if (value) *value = VALUE(map->buffer[iterator->idx]);
+    struct key_value_pair *pair = IS_SPILLED(map) ? &map->buffer[iterator->idx] : &map->pairs[iterator->idx];
 
-    size_t pos = iterator->idx + 1;
-    while (pos < map->capacity)
-    {
-        if (HAS_PAIR(map->buffer, pos)) break;
-        pos++;
-    }
-    iterator->idx = pos;
+    if (key) *key = pair->key;
+    if (value) *value = pair->value;
+
+    iterator->idx = next_pair(map, iterator->idx + 1);
 }
@@ -5,11 +5,20 @@
 #include <stdio.h>
 #include <ctype.h>
 #include <stdarg.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdalign.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
 #include "utility/map.h"
 #include "utility/set.h"
-#include "utility/stack.h"
-#include "utility/ptrmap.h"
+#include "utility/arena.h"
+#include "utility/hash.h"
+#include "utility/vector.h"
+#include "utility/hashmap.h"
+#include "utility/hashset.h"
 
 /**
  * NFA_STATE_LOCKING toggles if the states owned by an NFA should be locked so that they are immutable
@@ -49,22 +58,92 @@
 
 struct nondeterministic_state
 {
-    const char *debug_tag;
     // MAP_KEY = symbol
     // MAP_VALUE = SET<NSTATE>
     MAP transitions;
+    // transitions on ranges of symbols, in the order they were added
+    struct nstate_range_transition *ranges;
+    size_t num_ranges;
+    size_t ranges_capacity;
     int flags;
     int nfa_id;
+    // the arena holding the state and its transition tables, null for heap states
+    ARENA arena;
 };
 
+/**
+ * debug tags are cold, so they are kept in a side table keyed by the state instead of
+ * widening every state. only states marked with STATE_TAGGED have an entry.
+ */
+#define STATE_TAGGED 0x2
+
+DECLARE_HASH_MAP(TAG_TABLE, tag_table, NSTATE, const char *, hash_ptr, SCALAR_EQ)
+
+static pthread_mutex_t tag_lock = PTHREAD_MUTEX_INITIALIZER;
+static TAG_TABLE tags;
+
+static void nstate_set_tag(NSTATE state, const char *debug_tag)
+{
+    if (!debug_tag) return;
+    state->flags |= STATE_TAGGED;
+    pthread_mutex_lock(&tag_lock);
+    tag_table_set(&tags, state, debug_tag);
+    pthread_mutex_unlock(&tag_lock);
+}
+
+static void nstate_clear_tag(NSTATE state)
+{
+    if (!(state->flags & STATE_TAGGED)) return;
+    pthread_mutex_lock(&tag_lock);
+    tag_table_remove(&tags, state);
+    if (!tags.size) tag_table_fini(&tags);
+    pthread_mutex_unlock(&tag_lock);
+}
+
+const char *nstate_tag(NSTATE state)
+{
+    if (!(state->flags & STATE_TAGGED)) return NULL;
+    pthread_mutex_lock(&tag_lock);
+    const char **debug_tag = tag_table_get(&tags, state);
+    const char *result = debug_tag ? *debug_tag : NULL;
+    pthread_mutex_unlock(&tag_lock);
+    return result;
+}
+
+static const char *nstate_display_tag(NSTATE state)
+{
+    const char *debug_tag = nstate_tag(state);
+    return debug_tag ? debug_tag : "";
+}
+
+#define GET_TAG(state) nstate_display_tag(state)
+
 NSTATE nstate_new()
 {
     NSTATE state = malloc(sizeof(struct nondeterministic_state));
-    state->debug_tag = NULL;
     state->transitions = map_init();
+    state->ranges = NULL;
+    state->num_ranges = state->ranges_capacity = 0;
+    state->flags = 0;
+    state->nfa_id = -1;
+    state->arena = NULL;
+    info("Initialized NSTATE[%p:%s].", state, GET_TAG(state));
+    return state;
+}
+
+/**
+ * creates a state in an arena. the state and its transition tables are released with
+ * the arena, destroying the state itself does nothing.
+ */
+static NSTATE nstate_arena_new(ARENA arena)
+{
+    NSTATE state = arena_alloc(arena, sizeof(struct nondeterministic_state));
+    state->transitions = map_init_arena(arena);
+    state->ranges = NULL;
+    state->num_ranges = state->ranges_capacity = 0;
     state->flags = 0;
     state->nfa_id = -1;
-    info("Initialized NSTATE[%p:%s].", state, state->debug_tag ? state->debug_tag : "");
+    state->arena = arena;
     return state;
 }
 
@@ -72,21 +151,25 @@ int nstate_free(NSTATE state)
 {
     if (IS_STATE_LOCKED(state)) 
     {
-        info("Attempting to free locked NSTATE[%p:%s].", state, state->debug_tag ? state->debug_tag : "");
+        info("Attempting to free locked NSTATE[%p:%s].", state, GET_TAG(state));
         return -1;
     }
 
-    info("Destroying NSTATE[%p:%s].", state, state->debug_tag ? state->debug_tag : "");
-    MAP_ITERATOR iter = map_iterator_init(state->transitions);
+    info("Destroying NSTATE[%p:%s].", state, GET_TAG(state));
+    if (state->arena) return 0;
+
+    struct map_iterator iter;
     void *data;
-    while (map_iterator_has_next(iter))
+    map_iterator_begin(&iter, state->transitions);
+    while (map_iterator_has_next(&iter))
     {
-        map_iterator_next(iter, NULL, &data);
+        map_iterator_next(&iter, NULL, &data);
         set_fini(data);
     }
-    map_iterator_fini(iter);
 
     map_fini(state->transitions);
+    free(state->ranges);
+    nstate_clear_tag(state);
     free(state);
     return 0;
 }
@@ -96,67 +179,75 @@ int nstate_free(NSTATE state)
  */
 static void __nstate_force_free(NSTATE state)
 {
-    MAP_ITERATOR iter = map_iterator_init(state->transitions);
+    if (state->arena) return;
+
+    struct map_iterator iter;
     void *data;
-    while (map_iterator_has_next(iter))
+    map_iterator_begin(&iter, state->transitions);
+    while (map_iterator_has_next(&iter))
     {
-        map_iterator_next(iter, NULL, &data);
+        map_iterator_next(&iter, NULL, &data);
         set_fini(data);
     }
-    map_iterator_fini(iter);
 
     map_fini(state->transitions);
+    free(state->ranges);
+    nstate_clear_tag(state);
     free(state);
 }
 
 NSTATE nstate_debug_new(const char *debug_tag)
 {
     NSTATE state = malloc(sizeof(struct nondeterministic_state));
-    state->debug_tag = debug_tag;
     state->transitions = map_init();
+    state->ranges = NULL;
+    state->num_ranges = state->ranges_capacity = 0;
     state->flags = 0;
-    info("Initialized NSTATE[%p:%s].", state, state->debug_tag ? state->debug_tag : "");
+    state->nfa_id = -1;
+    state->arena = NULL;
+    nstate_set_tag(state, debug_tag);
+    info("Initialized NSTATE[%p:%s].", state, GET_TAG(state));
     return state;
 }
 
-const char *nstate_tag(NSTATE state)
+int nstate_id(NSTATE state)
 {
-    return state->debug_tag;   
+    return state->nfa_id;
 }
 
 int nstate_add_transition(NSTATE from, SYMBOL sym, NSTATE to)
 {
     if (IS_STATE_LOCKED(from)) 
     {
-        info("Attempting to modify locked NSTATE[%p:%s].", from, from->debug_tag ? from->debug_tag : "");
+        info("Attempting to modify locked NSTATE[%p:%s].", from, GET_TAG(from));
         return -1;
     }
 
     info("Attempting to add transition on symbol %d from NSTATE[%p:%s] to NSTATE[%p:%s].", sym,
-        from, from->debug_tag ? from->debug_tag : "",
-        to, to->debug_tag ? to->debug_tag : "");
+        from, GET_TAG(from),
+        to, GET_TAG(to));
 
     SET sym_set = map_get(from->transitions, sym);
     if (!sym_set)
     {
-        sym_set = set_init();
+        sym_set = set_init_arena(from->arena);
         map_add(from->transitions, sym, sym_set);
         info("No prior transitions on symbol %d from NSTATE[%p:%s]. Created new Set[%p].", sym,
-            from, from->debug_tag ? from->debug_tag : "", sym_set);
+            from, GET_TAG(from), sym_set);
     }
 
     int ret = set_add(sym_set, to);
     if (ret) 
     {
         info("Failed to add transition on symbol %d from NSTATE[%p:%s] to NSTATE[%p:%s].", sym,
-            from, from->debug_tag ? from->debug_tag : "",
-            to, to->debug_tag ? to->debug_tag : "");
+            from, GET_TAG(from),
+            to, GET_TAG(to));
     }
     else 
     {
         info("Successfully added transition on symbol %d from NSTATE[%p:%s] to NSTATE[%p:%s].", sym,
-            from, from->debug_tag ? from->debug_tag : "",
-            to, to->debug_tag ? to->debug_tag : "");
+            from, GET_TAG(from),
+            to, GET_TAG(to));
     }
     return ret;
 }
@@ -165,20 +256,20 @@ int nstate_remove_transition(NSTATE from, SYMBOL sym, NSTATE to)
 {
     if (IS_STATE_LOCKED(from)) 
     {
-        info("Attempting to modify locked NSTATE[%p:%s].", from, from->debug_tag ? from->debug_tag : "");
+        info("Attempting to modify locked NSTATE[%p:%s].", from, GET_TAG(from));
         return -1;
     }
 
     info("Attempting to remove transition on symbol %d from NSTATE[%p:%s] to NSTATE[%p:%s].", sym,
-        from, from->debug_tag ? from->debug_tag : "",
-        to, to->debug_tag ? to->debug_tag : "");
+        from, GET_TAG(from),
+        to, GET_TAG(to));
 
     SET sym_set = map_get(from->transitions, sym);
     if (!sym_set) 
     {
         info("Failed to remove transition on symbol %d from NSTATE[%p:%s] to NSTATE[%p:%s]. Transition did not exist.", sym,
-            from, from->debug_tag ? from->debug_tag : "",
-            to, to->debug_tag ? to->debug_tag : "");
+            from, GET_TAG(from),
+            to, GET_TAG(to));
         return -1;
     }
     int ret = set_remove(sym_set, to);
@@ -187,12 +278,12 @@ int nstate_remove_transition(NSTATE from, SYMBOL sym, NSTATE to)
         set_fini(sym_set);
         map_remove(from->transitions, sym);
         info("No more transitions on symbol %d from NSTATE[%p:%s] exist after deletion. Freed Set[%p].", sym,
-            from, from->debug_tag ? from->debug_tag : "", sym_set);
+            from, GET_TAG(from), sym_set);
     }
 
     info("Successfully removed transition on symbol %d from NSTATE[%p:%s] to NSTATE[%p:%s].", sym,
-        from, from->debug_tag ? from->debug_tag : "",
-        to, to->debug_tag ? to->debug_tag : "");
+        from, GET_TAG(from),
+        to, GET_TAG(to));
 
     return ret;
 }
@@ -201,7 +292,7 @@ int nstate_clear_transition_symbol(NSTATE from, SYMBOL sym)
 {
     if (IS_STATE_LOCKED(from)) 
     {
-        info("Attempting to modify locked NSTATE[%p:%s].", from, from->debug_tag ? from->debug_tag : "");
+        info("Attempting to modify locked NSTATE[%p:%s].", from, GET_TAG(from));
         return -1;
     }
 
@@ -210,12 +301,12 @@ int nstate_clear_transition_symbol(NSTATE from, SYMBOL sym)
     {
         set_fini(sym_set);
         info("No more transitions on symbol %d from NSTATE[%p:%s] exist after deletion. Freed Set[%p].", sym,
-            from, from->debug_tag ? from->debug_tag : "", sym_set);
+            from, GET_TAG(from), sym_set);
     }
     map_remove(from->transitions, sym);
 
     info("Successfully cleared all transitions on symbol %d from NSTATE[%p:%s].", sym,
-        from, from->debug_tag ? from->debug_tag : "");
+        from, GET_TAG(from));
 
     return 0;
 }
@@ -224,25 +315,26 @@ int nstate_clear_all_transitions(NSTATE from)
 {
     if (IS_STATE_LOCKED(from)) 
     {
-        info("Attempting to modify locked NSTATE[%p:%s].", from, from->debug_tag ? from->debug_tag : "");
+        info("Attempting to modify locked NSTATE[%p:%s].", from, GET_TAG(from));
         return -1;
     }
 
     SYMBOL sym;
     void *set;
-    MAP_ITERATOR iter = map_iterator_init(from->transitions);
-    while (map_iterator_has_next(iter))
+    struct map_iterator iter;
+    map_iterator_begin(&iter, from->transitions);
+    while (map_iterator_has_next(&iter))
     {
-        map_iterator_next(iter, &sym, &set);
+        map_iterator_next(&iter, &sym, &set);
         set_fini(set);
         info("No more transitions on symbol %d from NSTATE[%p:%s] exist after deletion. Freed Set[%p].", sym,
-            from, from->debug_tag ? from->debug_tag : "", set);
+            from, GET_TAG(from), set);
     }
-    map_iterator_fini(iter);
     map_clear(from->transitions);
+    from->num_ranges = 0;
 
     info("Successfully cleared all transitions on symbol %d from NSTATE[%p:%s].", sym,
-        from, from->debug_tag ? from->debug_tag : "");
+        from, GET_TAG(from));
 
     return 0;
 }
@@ -271,6 +363,80 @@ size_t nstate_count_transition_states(NSTATE state, SYMBOL sym)
     return 0;
 }
 
+const NSTATE *nstate_view_transition_states(NSTATE state, SYMBOL sym, size_t *count)
+{
+    SET sym_set = map_get(state->transitions, sym);
+    *count = sym_set ? set_size(sym_set) : 0;
+    if (sym_set) return (const NSTATE*) set_view(sym_set);
+    return NULL;
+}
+
+int nstate_add_range_transition(NSTATE from, SYMBOL lo, SYMBOL hi, NSTATE to)
+{
+    if (IS_STATE_LOCKED(from)) 
+    {
+        info("Attempting to modify locked NSTATE[%p:%s].", from, GET_TAG(from));
+        return -1;
+    }
+
+    if (lo > hi || (lo <= EPSILON && EPSILON <= hi))
+    {
+        info("Invalid range [%d, %d] for a transition from NSTATE[%p:%s].", lo, hi,
+            from, GET_TAG(from));
+        return -1;
+    }
+    if (lo == hi) return nstate_add_transition(from, lo, to);
+
+    for (size_t i = 0; i < from->num_ranges; ++i)
+    {
+        struct nstate_range_transition *range = &from->ranges[i];
+        if (range->lo == lo && range->hi == hi && range->to == to) return -1;
+    }
+
+    if (from->num_ranges == from->ranges_capacity)
+    {
+        size_t capacity = from->ranges_capacity ? 2 * from->ranges_capacity : 2;
+        if (from->arena)
+        {
+            // the old array is released with the arena
+            struct nstate_range_transition *ranges = arena_alloc(from->arena, capacity * sizeof(struct nstate_range_transition));
+            if (from->num_ranges) memcpy(ranges, from->ranges, from->num_ranges * sizeof(struct nstate_range_transition));
+            from->ranges = ranges;
+        }
+        else from->ranges = realloc(from->ranges, capacity * sizeof(struct nstate_range_transition));
+        from->ranges_capacity = capacity;
+    }
+    from->ranges[from->num_ranges++] = (struct nstate_range_transition){ lo, hi, to };
+
+    info("Successfully added transition on range [%d, %d] from NSTATE[%p:%s] to NSTATE[%p:%s].", lo, hi,
+        from, GET_TAG(from),
+        to, GET_TAG(to));
+    return 0;
+}
+
+const struct nstate_range_transition *nstate_view_range_transitions(NSTATE state, size_t *count)
+{
+    *count = state->num_ranges;
+    return state->num_ranges ? state->ranges : NULL;
+}
+
+void nstate_transition_iterator_begin(struct nstate_transition_iterator *iterator, NSTATE state)
+{
+    map_iterator_begin(&iterator->transitions, state->transitions);
+}
+
+int nstate_transition_iterator_next(struct nstate_transition_iterator *iterator, SYMBOL *sym,
+    const NSTATE **states, size_t *count)
+{
+    if (!map_iterator_has_next(&iterator->transitions)) return 0;
+
+    void *data;
+    map_iterator_next(&iterator->transitions, sym, &data);
+    if (states) *states = (const NSTATE*) set_view(data);
+    if (count) *count = set_size(data);
+    return 1;
+}
+
 int nstate_has_transition(NSTATE from, SYMBOL sym, NSTATE to)
 {
     SET sym_set = map_get(from->transitions, sym);
@@ -281,36 +447,39 @@ int nstate_has_transition(NSTATE from, SYMBOL sym, NSTATE to)
 void nstate_debug_display(NSTATE state, size_t indent)
 {
     for (size_t i = 0; i < indent; ++i) printf("\t");
-    if (state->debug_tag) printf("NSTATE[%s|%p]\n", state->debug_tag, state);
+    if (nstate_tag(state)) printf("NSTATE[%s|%p]\n", nstate_tag(state), state);
     else printf("NSTATE[%p]\n", state);
     
-    int transition_key;
-    NSTATE to;
-    void *data;
-    SET transition_states;
-    SET_ITERATOR state_iter;
+    SYMBOL transition_key;
+    const NSTATE *transition_states;
+    size_t count;
 
-    MAP_ITERATOR transition_iter = map_iterator_init(state->transitions);
-    while (map_iterator_has_next(transition_iter))
+    struct nstate_transition_iterator transition_iter;
+    nstate_transition_iterator_begin(&transition_iter, state);
+    while (nstate_transition_iterator_next(&transition_iter, &transition_key, &transition_states, &count))
     {
-        map_iterator_next(transition_iter, &transition_key, &data);
-        transition_states = data;
-
-        state_iter = set_iterator_init(transition_states);
-        while (set_iterator_has_next(state_iter))
+        for (size_t j = 0; j < count; ++j)
         {
-            to = set_iterator_next(state_iter);
+            NSTATE to = transition_states[j];
             for (size_t i = 0; i < indent + 1; ++i) printf("\t");
 
             if (isprint(transition_key)) printf("----[%c]--> ", transition_key);
             else printf("----[%d]--> ", transition_key);
             
-            if (to->debug_tag) printf("STATE[%s|%p]\n", to->debug_tag, to);
+            if (nstate_tag(to)) printf("STATE[%s|%p]\n", nstate_tag(to), to);
             else printf("NSTATE[%p]\n", to);
         }
-        set_iterator_fini(state_iter);
     }
-    map_iterator_fini(transition_iter);
+
+    for (size_t j = 0; j < state->num_ranges; ++j)
+    {
+        NSTATE to = state->ranges[j].to;
+        for (size_t i = 0; i < indent + 1; ++i) printf("\t");
+        printf("----[%d-%d]--> ", state->ranges[j].lo, state->ranges[j].hi);
+
+        if (nstate_tag(to)) printf("STATE[%s|%p]\n", nstate_tag(to), to);
+        else printf("NSTATE[%p]\n", to);
+    }
 }
 
 // -------------------------------------------------------------------------------------- //
@@ -320,34 +489,42 @@ struct nondeterministic_finite_automaton
     NSTATE starting_state;
     SET accepting_states;
     SET all_states;
+    // the arena holding all states of an NFA built from a component, null otherwise
+    ARENA arena;
+    // the transition lists of the simulator, built on first use
+    _Atomic(struct nfa_program*) program;
 };
 
-// O(n + m)
-static void aggregate_states(NSTATE state, SET state_set, int *uid_counter)
+static void program_free(struct nfa_program *program);
+
+/**
+ * collects and numbers the states reachable from the starting state in breadth-first
+ * order. the set keeps its elements in insertion order, so it doubles as the queue.
+ * O(n + m)
+ */
+static void aggregate_states(NSTATE starting_state, SET state_set)
 {
-    set_add(state_set, state);
-    state->nfa_id = (*uid_counter)++;
+    set_add(state_set, starting_state);
+    for (size_t head = 0; head < set_size(state_set); ++head)
+    {
+        // the view is taken anew, adding states may move the elements
+        NSTATE state = set_view(state_set)[head];
+        state->nfa_id = head;
 
-    void *data;
-    SET transition_set;
-    SET_ITERATOR state_iter;
-    NSTATE next_state;
+        const NSTATE *next_states;
+        size_t count;
 
-    MAP_ITERATOR transition_iter = map_iterator_init(state->transitions);
-    while (map_iterator_has_next(transition_iter))
-    {
-        map_iterator_next(transition_iter, NULL, &data);
-        transition_set = data;
-        state_iter = set_iterator_init(transition_set);
-        while (set_iterator_has_next(state_iter))
+        struct nstate_transition_iterator transition_iter;
+        nstate_transition_iterator_begin(&transition_iter, state);
+        while (nstate_transition_iterator_next(&transition_iter, NULL, &next_states, &count))
         {
-            next_state = set_iterator_next(state_iter);
-            if (!set_contains(state_set, next_state))
-                aggregate_states(next_state, state_set, uid_counter);
+            for (size_t i = 0; i < count; ++i)
+                set_add(state_set, next_states[i]);
         }
-        set_iterator_fini(state_iter);
+
+        for (size_t i = 0; i < state->num_ranges; ++i)
+            set_add(state_set, state->ranges[i].to);
     }
-    map_iterator_fini(transition_iter);
 }
 
 // O(n + m)
@@ -359,14 +536,12 @@ NFA nfa_new(NSTATE starting_state, NSTATE *accepting_states, size_t num_acceptin
         return NULL;
     }
 
-    int nfa_id = 0;
-
     SET accepting = set_init();
     for (size_t i = 0; i < num_accepting_states; ++i) 
         set_add(accepting, accepting_states[i]);
 
     SET all = set_init();
-    aggregate_states(starting_state, all, &nfa_id);
+    aggregate_states(starting_state, all);
 
     // invariant violated, error
     if (!is_subset(accepting, all))
@@ -379,14 +554,9 @@ NFA nfa_new(NSTATE starting_state, NSTATE *accepting_states, size_t num_acceptin
 
 #ifdef NFA_STATE_LOCKING
     // we have a valid NFA, we lock all the states
-    NSTATE state;
-    SET_ITERATOR iter = set_iterator_init(all);
-    while (set_iterator_has_next(iter))
-    {
-        state = set_iterator_next(iter);
-        LOCK_STATE(state);
-    }
-    set_iterator_fini(iter);
+    NSTATE const *states = (NSTATE const*) set_view(all);
+    for (size_t i = 0; i < set_size(all); ++i)
+        LOCK_STATE(states[i]);
 #endif
 
     // allocate now
@@ -394,6 +564,8 @@ NFA nfa_new(NSTATE starting_state, NSTATE *accepting_states, size_t num_acceptin
     nfa->starting_state = starting_state;
     nfa->accepting_states = accepting;
     nfa->all_states = all;
+    nfa->arena = NULL;
+    atomic_init(&nfa->program, NULL);
 
     info("Initializing NFA[%p].", nfa);
 
@@ -402,17 +574,21 @@ NFA nfa_new(NSTATE starting_state, NSTATE *accepting_states, size_t num_acceptin
 
 void nfa_free(NFA automaton)
 {
-    NSTATE state;
-    SET_ITERATOR iter = set_iterator_init(automaton->all_states);
-    while (set_iterator_has_next(iter))
+    if (automaton->arena)
     {
-        state = set_iterator_next(iter);
-        __nstate_force_free(state);
+        // every state lives in the arena
+        arena_fini(automaton->arena);
+    }
+    else
+    {
+        const NSTATE *states = nfa_view_states(automaton);
+        for (size_t i = 0; i < nfa_count_states(automaton); ++i)
+            __nstate_force_free(states[i]);
     }
-    set_iterator_fini(iter);
 
     set_fini(automaton->all_states);
     set_fini(automaton->accepting_states);
+    program_free(atomic_load_explicit(&automaton->program, memory_order_acquire));
 
     info("Destroying NFA[%p].", automaton);
 
@@ -425,14 +601,9 @@ void nfa_free(NFA automaton)
 static void __nfa_unlock_all(NFA automaton)
 {
 #ifdef NFA_STATE_LOCKING
-    NSTATE state;
-    SET_ITERATOR iter = set_iterator_init(automaton->all_states);
-    while (set_iterator_has_next(iter))
-    {
-        state = set_iterator_next(iter);
-        UNLOCK_STATE(state);
-    }
-    set_iterator_fini(iter);
+    const NSTATE *states = nfa_view_states(automaton);
+    for (size_t i = 0; i < nfa_count_states(automaton); ++i)
+        UNLOCK_STATE(states[i]);
 #endif
 }
 
@@ -443,6 +614,7 @@ static void __nfa_destroy(NFA automaton)
 {
     set_fini(automaton->all_states);
     set_fini(automaton->accepting_states);
+    program_free(atomic_load_explicit(&automaton->program, memory_order_acquire));
     free(automaton);
 }
 
@@ -466,14 +638,35 @@ NSTATE *nfa_get_states(NFA automaton)
     return (NSTATE*) set_values(automaton->all_states);
 }
 
+const NSTATE *nfa_view_states(NFA automaton)
+{
+    return (const NSTATE*) set_view(automaton->all_states);
+}
+
+const NSTATE *nfa_view_accepting_states(NFA automaton)
+{
+    return (const NSTATE*) set_view(automaton->accepting_states);
+}
+
 size_t nfa_count_states(NFA automaton)
 {
     return set_size(automaton->all_states);
 }
 
+// scratch space of at most this many bytes is taken from the stack by the accept functions
+#define SIM_STACK_SCRATCH 4096
+
+// small simulators live on the stack of the accept functions, larger ones on the heap
+static NFA_SIM accept_sim_init(NFA automaton, void *stack)
+{
+    NFA_SIM sim = nfa_sim_init_scratch(automaton, stack, SIM_STACK_SCRATCH);
+    return sim ? sim : nfa_sim_init(automaton);
+}
+
 int nfa_accept(NFA automaton, SYMBOL *string)
 {
-    NFA_SIM sim = nfa_sim_init(automaton);
+    alignas(max_align_t) unsigned char stack[SIM_STACK_SCRATCH];
+    NFA_SIM sim = accept_sim_init(automaton, stack);
     SYMBOL sym;
     while ((sym = *string++))
         nfa_sim_step(sim, sym);
@@ -483,14 +676,42 @@ int nfa_accept(NFA automaton, SYMBOL *string)
 
 int nfa_accept_cstr(NFA automaton, char *string)
 {
-    NFA_SIM sim = nfa_sim_init(automaton);
+    alignas(max_align_t) unsigned char stack[SIM_STACK_SCRATCH];
+    NFA_SIM sim = accept_sim_init(automaton, stack);
     SYMBOL sym;
-    while ((sym = *string++))
+    while ((sym = (unsigned char) *string++))
         nfa_sim_step(sim, sym);
     SIM_STATUS status = nfa_sim_fini(sim);
     return status == SIM_SUCCESS;
 }
 
+int nfa_accept_u8(NFA automaton, const uint8_t *symbols, size_t length)
+{
+    alignas(max_align_t) unsigned char stack[SIM_STACK_SCRATCH];
+    NFA_SIM sim = accept_sim_init(automaton, stack);
+    for (size_t i = 0; i < length; ++i)
+        nfa_sim_step(sim, symbols[i]);
+    return nfa_sim_fini(sim) == SIM_SUCCESS;
+}
+
+int nfa_accept_u16(NFA automaton, const uint16_t *symbols, size_t length)
+{
+    alignas(max_align_t) unsigned char stack[SIM_STACK_SCRATCH];
+    NFA_SIM sim = accept_sim_init(automaton, stack);
+    for (size_t i = 0; i < length; ++i)
+        nfa_sim_step(sim, symbols[i]);
+    return nfa_sim_fini(sim) == SIM_SUCCESS;
+}
+
+int nfa_accept_symbols(NFA automaton, const SYMBOL *symbols, size_t length)
+{
+    alignas(max_align_t) unsigned char stack[SIM_STACK_SCRATCH];
+    NFA_SIM sim = accept_sim_init(automaton, stack);
+    for (size_t i = 0; i < length; ++i)
+        nfa_sim_step(sim, symbols[i]);
+    return nfa_sim_fini(sim) == SIM_SUCCESS;
+}
+
 void nfa_debug_display(NFA automaton)
 {
     SET_ITERATOR iter;
@@ -503,7 +724,7 @@ void nfa_debug_display(NFA automaton)
     printf("NFA[%p]\n", automaton);
     printf("\tSTARTING STATE: ");
 
-    if (starting_state->debug_tag) printf("STATE[%s|%p]\n", starting_state->debug_tag, starting_state);
+    if (nstate_tag(starting_state)) printf("STATE[%s|%p]\n", nstate_tag(starting_state), starting_state);
     else printf("STATE[%p]\n", starting_state);
 
     printf("\tACCEPTING STATES:\n");
@@ -511,7 +732,7 @@ void nfa_debug_display(NFA automaton)
     while (set_iterator_has_next(iter))
     {
         state = set_iterator_next(iter);
-        if (state->debug_tag) printf("\t\tSTATE[%s|%p]\n", state->debug_tag, state);
+        if (nstate_tag(state)) printf("\t\tSTATE[%s|%p]\n", nstate_tag(state), state);
         else printf("\t\tSTATE[%p]\n", state);
     }
     set_iterator_fini(iter);
@@ -528,362 +749,807 @@ void nfa_debug_display(NFA automaton)
 
 // -------------------------------------------------------------------------------------- //
 
+/**
+ * the simulator runs on a program: flat per-state transition lists indexed by nfa_id,
+ * which are built once per NFA when it is first simulated. the symbol transitions of a
+ * state are sorted by symbol, so a step looks up a state's targets without touching its
+ * transition map.
+ */
+struct nfa_program
+{
+    size_t num_states;
+    uint32_t start;
+    uint8_t *accepting;
+    // the transitions of state i are epsilons[epsilon_offsets[i]..epsilon_offsets[i + 1]], etc.
+    size_t *epsilon_offsets;
+    uint32_t *epsilons;
+    size_t *symbol_offsets;
+    struct program_transition
+    {
+        SYMBOL sym;
+        uint32_t to;
+    } *symbols;
+    size_t *range_offsets;
+    struct program_range
+    {
+        SYMBOL lo, hi;
+        uint32_t to;
+    } *ranges;
+};
+
+static int compare_program_transitions(const void *a, const void *b)
+{
+    const struct program_transition *x = a, *y = b;
+    if (x->sym != y->sym) return (x->sym > y->sym) - (x->sym < y->sym);
+    return (x->to > y->to) - (x->to < y->to);
+}
+
+static void program_free(struct nfa_program *program)
+{
+    if (!program) return;
+    free(program->accepting);
+    free(program->epsilon_offsets);
+    free(program->epsilons);
+    free(program->symbol_offsets);
+    free(program->symbols);
+    free(program->range_offsets);
+    free(program->ranges);
+    free(program);
+}
+
+static struct nfa_program *program_build(NFA automaton)
+{
+    const NSTATE *states = nfa_view_states(automaton);
+    size_t num_states = nfa_count_states(automaton);
+
+    struct nfa_program *program = malloc(sizeof(struct nfa_program));
+    program->num_states = num_states;
+    program->start = automaton->starting_state->nfa_id;
+    program->accepting = calloc(num_states + 1, sizeof(uint8_t));
+    program->epsilon_offsets = calloc(num_states + 1, sizeof(size_t));
+    program->symbol_offsets = calloc(num_states + 1, sizeof(size_t));
+    program->range_offsets = calloc(num_states + 1, sizeof(size_t));
+
+    const NSTATE *accepting = nfa_view_accepting_states(automaton);
+    for (size_t i = 0; i < nfa_count_accepting_states(automaton); ++i)
+        program->accepting[accepting[i]->nfa_id] = 1;
+
+    // count the transitions of every state, the offsets of state i + 1 hold the counts of state i
+    const NSTATE *targets;
+    size_t count;
+    SYMBOL sym;
+    struct nstate_transition_iterator iter;
+    for (size_t i = 0; i < num_states; ++i)
+    {
+        size_t id = states[i]->nfa_id;
+        nstate_transition_iterator_begin(&iter, states[i]);
+        while (nstate_transition_iterator_next(&iter, &sym, &targets, &count))
+        {
+            if (sym == EPSILON) program->epsilon_offsets[id + 1] += count;
+            else program->symbol_offsets[id + 1] += count;
+        }
+        program->range_offsets[id + 1] = states[i]->num_ranges;
+    }
+    for (size_t i = 0; i < num_states; ++i)
+    {
+        program->epsilon_offsets[i + 1] += program->epsilon_offsets[i];
+        program->symbol_offsets[i + 1] += program->symbol_offsets[i];
+        program->range_offsets[i + 1] += program->range_offsets[i];
+    }
+
+    program->epsilons = malloc((program->epsilon_offsets[num_states] + 1) * sizeof(uint32_t));
+    program->symbols = malloc((program->symbol_offsets[num_states] + 1) * sizeof(struct program_transition));
+    program->ranges = malloc((program->range_offsets[num_states] + 1) * sizeof(struct program_range));
+
+    for (size_t i = 0; i < num_states; ++i)
+    {
+        size_t id = states[i]->nfa_id;
+        size_t epsilon = program->epsilon_offsets[id], symbol = program->symbol_offsets[id];
+        nstate_transition_iterator_begin(&iter, states[i]);
+        while (nstate_transition_iterator_next(&iter, &sym, &targets, &count))
+        {
+            for (size_t j = 0; j < count; ++j)
+            {
+                if (sym == EPSILON) program->epsilons[epsilon++] = targets[j]->nfa_id;
+                else program->symbols[symbol++] = (struct program_transition){ sym, targets[j]->nfa_id };
+            }
+        }
+        qsort(program->symbols + program->symbol_offsets[id], symbol - program->symbol_offsets[id],
+            sizeof(struct program_transition), compare_program_transitions);
+
+        struct program_range *ranges = program->ranges + program->range_offsets[id];
+        for (size_t j = 0; j < states[i]->num_ranges; ++j)
+        {
+            const struct nstate_range_transition *range = &states[i]->ranges[j];
+            ranges[j] = (struct program_range){ range->lo, range->hi, range->to->nfa_id };
+        }
+    }
+
+    info("Built the program of NFA[%p] with %lu epsilon, %lu symbol and %lu range transitions.", automaton,
+        program->epsilon_offsets[num_states], program->symbol_offsets[num_states], program->range_offsets[num_states]);
+    return program;
+}
+
+// retrieves the program of an NFA, building it on first use
+static struct nfa_program *nfa_program(NFA automaton)
+{
+    struct nfa_program *program = atomic_load_explicit(&automaton->program, memory_order_acquire);
+    if (program) return program;
+
+    // concurrent simulators may race to build the program, only one of them publishes it
+    struct nfa_program *expected = NULL;
+    program = program_build(automaton);
+    if (atomic_compare_exchange_strong_explicit(&automaton->program, &expected, program,
+        memory_order_acq_rel, memory_order_acquire)) return program;
+    program_free(program);
+    return expected;
+}
+
+/**
+ * a set of state ids supporting constant time insertion, membership and clearing. an id
+ * is in the set if its sparse entry points to a dense entry holding the id.
+ */
+struct sparse_set
+{
+    uint32_t *dense;
+    uint32_t *sparse;
+    size_t size;
+};
+
+static inline int sparse_set_contains(const struct sparse_set *set, uint32_t id)
+{
+    uint32_t position = set->sparse[id];
+    return position < set->size && set->dense[position] == id;
+}
+
+static inline void sparse_set_add(struct sparse_set *set, uint32_t id)
+{
+    set->sparse[id] = set->size;
+    set->dense[set->size++] = id;
+}
+
+/**
+ * the simulator keeps everything it needs in a single block: the simulator itself followed
+ * by the arrays of two sparse sets of states and a work stack, each holding every state at
+ * most once. the block is sized by the number of states, so a step never allocates and
+ * takes time proportional to the active states and their transitions.
+ */
 struct NFA_simulator
 {
     NFA nfa;
-    STACK old_states;
-    STACK new_states;
-    unsigned char *already_on;
+    const struct nfa_program *program;
+    // the active states
+    struct sparse_set current;
+    // the states reached by the current step
+    struct sparse_set next;
+    // the states whose epsilon closure is pending
+    uint32_t *stack;
+    // nonzero if the block is owned by the simulator and released by nfa_sim_fini
+    int owned;
 };
 
+// the simulator is followed by its arrays, which must stay aligned
+#define SIM_HEADER_SIZE ((sizeof(struct NFA_simulator) + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1))
+
 static void merge_sets(SET A, SET B)
 {
-    SET_ITERATOR iter = set_iterator_init(B);
-    void *state;
-    while (set_iterator_has_next(iter))
-    {   
-        state = set_iterator_next(iter);
-        set_add(A, state);
-    }
-    set_iterator_fini(iter);
+    set_union_with(A, B);
 }
 
-static void add_state(NFA_SIM sim, NSTATE state)
+// adds a state and every state reachable from it on epsilon transitions to the next states
+static void add_state(NFA_SIM sim, uint32_t id)
 {
-    stack_push(sim->new_states, state);
-    sim->already_on[state->nfa_id] = 1;
+    if (sparse_set_contains(&sim->next, id)) return;
 
-    SET epsilon_transitions = map_get(state->transitions, EPSILON);
-    if (epsilon_transitions)
+    const struct nfa_program *program = sim->program;
+    size_t top = 0;
+    sparse_set_add(&sim->next, id);
+    sim->stack[top++] = id;
+    while (top)
     {
-        SET_ITERATOR iter = set_iterator_init(epsilon_transitions);
-        NSTATE t;
-        while (set_iterator_has_next(iter))
+        uint32_t state = sim->stack[--top];
+        for (size_t i = program->epsilon_offsets[state]; i < program->epsilon_offsets[state + 1]; ++i)
         {
-            t = set_iterator_next(iter);
-            if (!sim->already_on[t->nfa_id])
-                add_state(sim, t);
+            uint32_t to = program->epsilons[i];
+            if (sparse_set_contains(&sim->next, to)) continue;
+            sparse_set_add(&sim->next, to);
+            sim->stack[top++] = to;
         }
-        set_iterator_fini(iter);
     }
 }
 
+// the next states become the active states
 static void transfer_states(NFA_SIM sim)
 {
-    NSTATE state;
-    void *data;
-    while (stack_size(sim->new_states) != 0)
-    {
-        stack_pop(sim->new_states, &data);
-        state = data;
-        stack_push(sim->old_states, state);
-        sim->already_on[state->nfa_id] = 0;
-    }
+    struct sparse_set states = sim->current;
+    sim->current = sim->next;
+    sim->next = states;
+    sim->next.size = 0;
 }
 
-NFA_SIM nfa_sim_init(NFA automaton)
+size_t nfa_sim_scratch_size(NFA automaton)
 {
-    NFA_SIM sim = malloc(sizeof(struct NFA_simulator));
-    sim->nfa = automaton;
-    sim->old_states = stack_init();
-    sim->new_states = stack_init();
     size_t sz = set_size(automaton->all_states);
-    sim->already_on = calloc(sz, sizeof(unsigned char));
+    return SIM_HEADER_SIZE + 5 * sz * sizeof(uint32_t);
+}
 
-    add_state(sim, automaton->starting_state);
-    transfer_states(sim);
+NFA_SIM nfa_sim_init_scratch(NFA automaton, void *scratch, size_t size)
+{
+    if (!automaton || !scratch || (uintptr_t) scratch % alignof(max_align_t)) return NULL;
+    if (size < nfa_sim_scratch_size(automaton)) return NULL;
 
+    size_t sz = set_size(automaton->all_states);
+    uint32_t *arrays = (uint32_t*) ((char*) scratch + SIM_HEADER_SIZE);
+    NFA_SIM sim = scratch;
+    sim->nfa = automaton;
+    sim->program = nfa_program(automaton);
+    sim->current = (struct sparse_set){ arrays, arrays + sz, 0 };
+    sim->next = (struct sparse_set){ arrays + 2 * sz, arrays + 3 * sz, 0 };
+    sim->stack = arrays + 4 * sz;
+    sim->owned = 0;
+
+    // the sparse arrays may hold anything, they are only cleared to keep memory checkers quiet
+    memset(sim->current.sparse, 0, sz * sizeof(uint32_t));
+    memset(sim->next.sparse, 0, sz * sizeof(uint32_t));
+
+    nfa_sim_reset(sim);
+    return sim;
+}
+
+NFA_SIM nfa_sim_init(NFA automaton)
+{
+    size_t size = nfa_sim_scratch_size(automaton);
+    void *scratch = aligned_alloc(alignof(max_align_t), (size + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1));
+    NFA_SIM sim = nfa_sim_init_scratch(automaton, scratch, size);
+    sim->owned = 1;
     return sim;
 }
 
+void nfa_sim_reset(NFA_SIM sim)
+{
+    sim->current.size = 0;
+    sim->next.size = 0;
+    add_state(sim, sim->program->start);
+    transfer_states(sim);
+}
+
+// finds the first symbol transition of a state on a symbol
+static size_t find_transition(const struct nfa_program *program, uint32_t state, SYMBOL sym)
+{
+    size_t lo = program->symbol_offsets[state], hi = program->symbol_offsets[state + 1];
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (program->symbols[mid].sym < sym) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
 void nfa_sim_step(NFA_SIM sim, SYMBOL input_sym)
 {
-    void *data;
-    NSTATE state;
-    SET set;
-    SET_ITERATOR iter;
+    const struct nfa_program *program = sim->program;
 
-    while (stack_size(sim->old_states) != 0)
+    for (size_t j = 0; j < sim->current.size; ++j)
     {
-        stack_pop(sim->old_states, &data);
-        state = data;
+        uint32_t state = sim->current.dense[j];
+        size_t end = program->symbol_offsets[state + 1];
+        for (size_t i = find_transition(program, state, input_sym); i < end && program->symbols[i].sym == input_sym; ++i)
+            add_state(sim, program->symbols[i].to);
 
-        set = map_get(state->transitions, input_sym);
-        if (set)
+        for (size_t i = program->range_offsets[state]; i < program->range_offsets[state + 1]; ++i)
         {
-            iter = set_iterator_init(set);
-            while (set_iterator_has_next(iter))
-            {
-                state = set_iterator_next(iter);
-                if (!sim->already_on[state->nfa_id])
-                    add_state(sim, state);
-            }
-            set_iterator_fini(iter);
+            const struct program_range *range = &program->ranges[i];
+            if (range->lo <= input_sym && input_sym <= range->hi)
+                add_state(sim, range->to);
         }
     }
 
     transfer_states(sim);
 }
 
-SIM_STATUS nfa_sim_fini(NFA_SIM sim)
+SIM_STATUS nfa_sim_status(NFA_SIM sim)
 {
-    SIM_STATUS status = SIM_FAILURE;
-
-    void *data;
-    while (stack_size(sim->old_states) != 0)
+    for (size_t i = 0; i < sim->current.size; ++i)
     {
-        stack_pop(sim->old_states, &data);
-        info("Popped NSTATE[%p:%s] from the old states.", data, ((NSTATE) data)->debug_tag ? ((NSTATE) data)->debug_tag : "");
-        if (set_contains(sim->nfa->accepting_states, data))
+        if (sim->program->accepting[sim->current.dense[i]])
         {
-            status = SIM_SUCCESS;
-            break;
+            info("Found accepting state %u among the active states.", sim->current.dense[i]);
+            return SIM_SUCCESS;
         }
     }
+    return SIM_FAILURE;
+}
 
-    stack_fini(sim->old_states);
-    stack_fini(sim->new_states);
-    free(sim->already_on);
-    free(sim);
-
+SIM_STATUS nfa_sim_fini(NFA_SIM sim)
+{
+    SIM_STATUS status = nfa_sim_status(sim);
+    if (sim->owned) free(sim);
     return status;
 }
 
-static NSTATE nstate_clone(NSTATE state, PTR_MAP ptrmap)
+/**
+ * components are immutable expressions which are hash-consed: every constructor looks up
+ * a structurally identical expression before creating a new one, so identical subterms
+ * within and across patterns share a single node. a component is reference counted and
+ * owned by its references, the constructors take over the references passed to them.
+ *
+ * no states exist until `nfa_construct` emits the expression. repetitions are expanded
+ * by emitting the repeated expression once per copy, so nothing is ever cloned.
+ */
+typedef enum component_kind
 {
-    NSTATE copy = nstate_new();
-    copy->debug_tag = state->debug_tag;
-    copy->flags = state->flags;
-    copy->nfa_id = state->nfa_id;
+    COMPONENT_SYMBOLS,
+    COMPONENT_RANGES,
+    COMPONENT_EPSILON,
+    COMPONENT_UNION,
+    COMPONENT_CONCAT,
+    COMPONENT_REPEAT
+} COMPONENT_KIND;
 
-    ptrmap_set(ptrmap, state, copy);
+// the maximum of a repetition without an upper bound
+#define UNBOUNDED SIZE_MAX
 
-    MAP_ITERATOR map_iter = map_iterator_init(state->transitions);
-    SET_ITERATOR set_iter;
-    SYMBOL sym;
-    void *data;
-    while (map_iterator_has_next(map_iter))
+struct nfa_component
+{
+    COMPONENT_KIND kind;
+    // only modified while holding the lock of the intern table
+    size_t references;
+    uint64_t hash;
+    // bounds of a repetition
+    size_t min, max;
+    // the number of symbols, ranges or children
+    size_t count;
+    union
     {
-        map_iterator_next(map_iter, &sym, &data);
+        SYMBOL symbol;
+        struct symbol_range range;
+        NFA_COMPONENT child;
+    } operands[];
+};
 
-        set_iter = set_iterator_init(data);
-        while (set_iterator_has_next(set_iter))
-        {
-            NSTATE to = set_iterator_next(set_iter);
+// symbols and ranges are leaves, every other component refers to its children
+#define HAS_CHILDREN(component) ((component)->kind != COMPONENT_SYMBOLS && (component)->kind != COMPONENT_RANGES)
 
-            NSTATE to_copy = ptrmap_get(ptrmap, to);            
-            if (!to_copy) to_copy = nstate_clone(to, ptrmap);
+static uint64_t component_hash(NFA_COMPONENT component)
+{
+    return component->hash;
+}
 
-            nstate_add_transition(copy, sym, to_copy);
-        }
-        set_iterator_fini(set_iter);
+static uint64_t operand_hash(NFA_COMPONENT component, size_t i)
+{
+    switch (component->kind)
+    {
+    case COMPONENT_SYMBOLS:
+        return (uint32_t) component->operands[i].symbol;
+    case COMPONENT_RANGES:
+        return hash_combine((uint32_t) component->operands[i].range.lo, (uint32_t) component->operands[i].range.hi);
+    default:
+        return hash_ptr(component->operands[i].child);
     }
-    map_iterator_fini(map_iter);
-    return copy;
 }
 
-struct nfa_component
+static int operand_eq(NFA_COMPONENT a, NFA_COMPONENT b, size_t i)
 {
-    NSTATE starting_state;
-    NSTATE accepting_state;
-};
+    switch (a->kind)
+    {
+    case COMPONENT_SYMBOLS:
+        return a->operands[i].symbol == b->operands[i].symbol;
+    case COMPONENT_RANGES:
+        return a->operands[i].range.lo == b->operands[i].range.lo && a->operands[i].range.hi == b->operands[i].range.hi;
+    default:
+        return a->operands[i].child == b->operands[i].child;
+    }
+}
 
-static NFA_COMPONENT component_new(NSTATE start, NSTATE accepting)
+// children are interned already, so they are equal exactly if they are identical
+static int component_eq(NFA_COMPONENT a, NFA_COMPONENT b)
 {
-    NFA_COMPONENT component = malloc(sizeof(struct nfa_component));
-    component->starting_state = start;
-    component->accepting_state = accepting;
+    if (a->hash != b->hash || a->kind != b->kind || a->count != b->count) return 0;
+    if (a->min != b->min || a->max != b->max) return 0;
+    for (size_t i = 0; i < a->count; ++i)
+    {
+        if (!operand_eq(a, b, i)) return 0;
+    }
+    return 1;
+}
+
+DECLARE_HASH_SET(COMPONENT_TABLE, component_table, NFA_COMPONENT, component_hash, component_eq)
+DECLARE_VECTOR(COMPONENT_VECTOR, component_vector, NFA_COMPONENT)
+
+static pthread_mutex_t intern_lock = PTHREAD_MUTEX_INITIALIZER;
+static COMPONENT_TABLE interned;
+
+static NFA_COMPONENT component_alloc(COMPONENT_KIND kind, size_t count)
+{
+    NFA_COMPONENT component = malloc(sizeof(struct nfa_component) + count * sizeof(component->operands[0]));
+    component->kind = kind;
+    component->references = 1;
+    component->min = component->max = 0;
+    component->count = count;
     return component;
 }
 
-static void component_free(NFA_COMPONENT component)
+// drops references to components, destroying the components which are no longer referenced
+static void component_release_locked(COMPONENT_VECTOR *released)
 {
-    free(component);
+    while (released->size)
+    {
+        NFA_COMPONENT component = component_vector_pop(released);
+        if (--component->references) continue;
+
+        component_table_remove(&interned, component);
+        if (HAS_CHILDREN(component))
+        {
+            for (size_t i = 0; i < component->count; ++i)
+                component_vector_push(released, component->operands[i].child);
+        }
+        free(component);
+    }
 }
 
-static void component_free_internals(NFA_COMPONENT component)
+static void component_release(NFA_COMPONENT component)
 {
-    NFA nfa = nfa_construct(component);
-    nfa_free(nfa);
+    COMPONENT_VECTOR released;
+    component_vector_init(&released);
+    component_vector_push(&released, component);
+
+    pthread_mutex_lock(&intern_lock);
+    component_release_locked(&released);
+    pthread_mutex_unlock(&intern_lock);
+
+    component_vector_fini(&released);
 }
 
-static NFA_COMPONENT component_clone(NFA_COMPONENT component)
+/**
+ * returns the interned component structurally identical to a new component. if there is
+ * one, the new component is destroyed and its references to its children are dropped.
+ */
+static NFA_COMPONENT component_intern(NFA_COMPONENT component)
 {
-    PTR_MAP map = ptrmap_init();
-    NSTATE clone_start = nstate_clone(component->starting_state, map);
+    uint64_t hash = hash_combine(component->kind, component->count);
+    hash = hash_combine(hash_combine(hash, component->min), component->max);
+    for (size_t i = 0; i < component->count; ++i)
+        hash = hash_combine(hash, operand_hash(component, i));
+    component->hash = hash;
+
+    pthread_mutex_lock(&intern_lock);
+    size_t pos = component_table_find(&interned, component);
+    if (pos == interned.capacity)
+    {
+        component_table_add(&interned, component);
+        pthread_mutex_unlock(&intern_lock);
+        return component;
+    }
 
-    NSTATE clone_accept = ptrmap_get(map, component->accepting_state);
-    ptrmap_fini(map);
+    NFA_COMPONENT existing = interned.keys[pos];
+    existing->references++;
+    // the existing component holds references to the same children
+    if (HAS_CHILDREN(component))
+    {
+        for (size_t i = 0; i < component->count; ++i)
+            component->operands[i].child->references--;
+    }
+    pthread_mutex_unlock(&intern_lock);
 
-    NFA_COMPONENT copy = component_new(clone_start, clone_accept);
-    return copy;
+    free(component);
+    info("Shared Component[%p].", existing);
+    return existing;
 }
 
-NFA nfa_construct(NFA_COMPONENT component)
+static NFA_COMPONENT component_repeat(NFA_COMPONENT a, size_t min, size_t max)
 {
-    info("Constructing NFA from Component[%p].", component);
+    NFA_COMPONENT component = component_alloc(COMPONENT_REPEAT, 1);
+    component->min = min;
+    component->max = max;
+    component->operands[0].child = a;
+    return component_intern(component);
+}
 
-    NSTATE starting_state = component->starting_state;
-    NSTATE accepting_state = component->accepting_state;
-    NFA nfa = nfa_new(starting_state, &accepting_state, 1);
-    component_free(component);
-    return nfa;
+static int compare_symbols(const void *a, const void *b)
+{
+    SYMBOL x = *(const SYMBOL*) a, y = *(const SYMBOL*) b;
+    return (x > y) - (x < y);
 }
 
-NFA_COMPONENT nfa_symbol(SYMBOL sym)
+// ----- //
+
+/**
+ * the emission of one component. components nest arbitrarily deep, e.g. a union built from
+ * repeated calls to `nfa_union`, so they are emitted from an explicit stack of frames.
+ */
+struct emit_frame
 {
-    NSTATE start = nstate_new();
-    NSTATE end = nstate_new();
-    nstate_add_transition(start, sym, end);
+    NFA_COMPONENT component;
+    NSTATE start;
+    // the state the next child or copy follows
+    NSTATE cursor;
+    // the accepting state of a union, a bounded repetition or a star
+    NSTATE end;
+    // the starting state of the loop of a star
+    NSTATE loop;
+    // the number of children or copies emitted so far
+    size_t next;
+    // the number of copies of the current alternative of a bounded repetition
+    size_t copies;
+};
 
-    NFA_COMPONENT component = component_new(start, end);
-    info("Creating symbol %d construct in Component[%p].", sym, component);
+DECLARE_VECTOR(EMIT_STACK, emit_stack, struct emit_frame)
 
-    return component;
+/**
+ * advances the emission of a repetition. `result` is the accepting state of the copy emitted
+ * last. returns the state the next copy follows, or null once the repetition is complete and
+ * `result` holds its accepting state.
+ */
+static NSTATE emit_repeat(struct emit_frame *frame, NSTATE *result, ARENA arena)
+{
+    NFA_COMPONENT component = frame->component;
+    if (component->max == UNBOUNDED)
+    {
+        // the minimum number of copies followed by any number of copies
+        if (frame->end)
+        {
+            nstate_add_transition(*result, EPSILON, frame->end);
+            nstate_add_transition(*result, EPSILON, frame->loop);
+            *result = frame->end;
+            return NULL;
+        }
+        if (frame->next) frame->cursor = *result;
+        if (frame->next < component->min)
+        {
+            frame->next++;
+            return frame->cursor;
+        }
+        frame->end = nstate_arena_new(arena);
+        frame->loop = nstate_arena_new(arena);
+        nstate_add_transition(frame->cursor, EPSILON, frame->end);
+        nstate_add_transition(frame->cursor, EPSILON, frame->loop);
+        return frame->loop;
+    }
+
+    if (component->min == component->max)
+    {
+        if (frame->next) frame->cursor = *result;
+        if (frame->next < component->min)
+        {
+            frame->next++;
+            return frame->cursor;
+        }
+        *result = frame->cursor;
+        return NULL;
+    }
+
+    // the union of every number of copies within the bounds, each a chain of its own
+    if (!frame->end)
+    {
+        frame->end = nstate_arena_new(arena);
+        frame->copies = component->min;
+        frame->cursor = nstate_arena_new(arena);
+        nstate_add_transition(frame->start, EPSILON, frame->cursor);
+    }
+    else frame->cursor = *result;
+
+    for (;;)
+    {
+        if (frame->next < frame->copies)
+        {
+            frame->next++;
+            return frame->cursor;
+        }
+        nstate_add_transition(frame->cursor, EPSILON, frame->end);
+        if (frame->copies == component->max)
+        {
+            *result = frame->end;
+            return NULL;
+        }
+        frame->copies++;
+        frame->next = 0;
+        frame->cursor = nstate_arena_new(arena);
+        nstate_add_transition(frame->start, EPSILON, frame->cursor);
+    }
 }
 
-NFA_COMPONENT nfa_union(NFA_COMPONENT a, NFA_COMPONENT b)
+/**
+ * emits the states of a component following a given starting state and returns the
+ * accepting state of the component. only transitions out of the starting state are added,
+ * so the accepting state of one component is the starting state of the next.
+ */
+static NSTATE emit(NFA_COMPONENT component, NSTATE start, ARENA arena)
 {
-    // if either is null, just return the other
-    if (!a) return b;
-    else if (!b) return a;
+    EMIT_STACK stack;
+    emit_stack_init(&stack);
+    emit_stack_push(&stack, (struct emit_frame){ component, start, start, NULL, NULL, 0, 0 });
 
-    info("Attempting to form the union of Component[%p] and Component[%p].", a, b);
+    // the accepting state of the component emitted last
+    NSTATE result = NULL;
+    while (stack.size)
+    {
+        struct emit_frame *frame = &stack.data[stack.size - 1];
+        NFA_COMPONENT current = frame->component;
+        // the component to emit next and the state it follows, if the frame is not complete
+        NFA_COMPONENT child = NULL;
+        NSTATE child_start = NULL;
 
-    NSTATE start = nstate_new();
-    NSTATE end = nstate_new();
-    
-    nstate_add_transition(start, EPSILON, a->starting_state);
-    nstate_add_transition(start, EPSILON, b->starting_state);
+        switch (current->kind)
+        {
+        case COMPONENT_SYMBOLS:
+            result = nstate_arena_new(arena);
+            for (size_t i = 0; i < current->count; ++i)
+                nstate_add_transition(frame->start, current->operands[i].symbol, result);
+            break;
+        case COMPONENT_RANGES:
+            result = nstate_arena_new(arena);
+            for (size_t i = 0; i < current->count; ++i)
+                nstate_add_range_transition(frame->start, current->operands[i].range.lo, current->operands[i].range.hi, result);
+            break;
+        case COMPONENT_EPSILON:
+            result = nstate_arena_new(arena);
+            nstate_add_transition(frame->start, EPSILON, result);
+            break;
+        case COMPONENT_UNION:
+            if (!frame->next) frame->end = nstate_arena_new(arena);
+            else nstate_add_transition(result, EPSILON, frame->end);
+            if (frame->next < current->count)
+            {
+                child = current->operands[frame->next++].child;
+                child_start = nstate_arena_new(arena);
+                nstate_add_transition(frame->start, EPSILON, child_start);
+            }
+            else result = frame->end;
+            break;
+        case COMPONENT_CONCAT:
+            if (frame->next) frame->cursor = result;
+            if (frame->next < current->count)
+            {
+                child = current->operands[frame->next++].child;
+                child_start = frame->cursor;
+            }
+            else result = frame->cursor;
+            break;
+        case COMPONENT_REPEAT:
+            child_start = emit_repeat(frame, &result, arena);
+            if (child_start) child = current->operands[0].child;
+            break;
+        }
+
+        if (child) emit_stack_push(&stack, (struct emit_frame){ child, child_start, child_start, NULL, NULL, 0, 0 });
+        else emit_stack_pop(&stack);
+    }
 
-    nstate_add_transition(a->accepting_state, EPSILON, end);
-    nstate_add_transition(b->accepting_state, EPSILON, end);
+    emit_stack_fini(&stack);
+    return result;
+}
 
-    NFA_COMPONENT component = component_new(start, end);
+NFA nfa_construct(NFA_COMPONENT component)
+{
+    info("Constructing NFA from Component[%p].", component);
 
-    info("Successfully formed the union of Component[%p] and Component[%p] into Component[%p].", a, b, component);
+    ARENA arena = arena_init();
+    NSTATE starting_state = nstate_arena_new(arena);
+    NSTATE accepting_state = emit(component, starting_state, arena);
+    component_release(component);
 
-    component_free(a);
-    component_free(b);
-    return component;
+    NFA nfa = nfa_new(starting_state, &accepting_state, 1);
+    if (nfa) nfa->arena = arena;
+    else arena_fini(arena);
+    return nfa;
 }
 
-NFA_COMPONENT nfa_concat(NFA_COMPONENT a, NFA_COMPONENT b)
+NFA_COMPONENT nfa_symbol(SYMBOL sym)
 {
-    // if either is null, just return the other
-    if (!a) return b;
-    else if (!b) return a;
+    return nfa_symbols(&sym, 1);
+}
 
-    info("Attempting to form the concatenation of Component[%p] and Component[%p].", a, b);
+NFA_COMPONENT nfa_symbols(const SYMBOL *symbols, size_t count)
+{
+    // the order of the symbols does not matter, sorting them lets equal sets be shared
+    SYMBOL *sorted = malloc(count * sizeof(SYMBOL) + 1);
+    memcpy(sorted, symbols, count * sizeof(SYMBOL));
+    qsort(sorted, count, sizeof(SYMBOL), compare_symbols);
 
-    NSTATE start = a->starting_state;
-    NSTATE end = b->accepting_state;
-    
-    NSTATE a_accepting = a->accepting_state;
-    NSTATE b_starting = b->starting_state;
+    size_t unique = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (!unique || sorted[unique - 1] != sorted[i])
+            sorted[unique++] = sorted[i];
+    }
 
-    SYMBOL sym;
-    void *set;
-    NSTATE to;
-    MAP_ITERATOR transition_iter = map_iterator_init(b_starting->transitions);
-    while (map_iterator_has_next(transition_iter))
+    NFA_COMPONENT component = component_alloc(COMPONENT_SYMBOLS, unique);
+    for (size_t i = 0; i < unique; ++i)
+        component->operands[i].symbol = sorted[i];
+    free(sorted);
+
+    info("Creating symbol set construct of %lu symbols in Component[%p].", count, component);
+    return component_intern(component);
+}
+
+static int compare_ranges(const void *a, const void *b)
+{
+    const struct symbol_range *x = a, *y = b;
+    return (x->lo > y->lo) - (x->lo < y->lo);
+}
+
+NFA_COMPONENT nfa_ranges(const struct symbol_range *ranges, size_t count)
+{
+    // overlapping and adjacent ranges are merged, so equal sets of symbols are shared
+    struct symbol_range *sorted = malloc(count * sizeof(struct symbol_range) + 1);
+    memcpy(sorted, ranges, count * sizeof(struct symbol_range));
+    qsort(sorted, count, sizeof(struct symbol_range), compare_ranges);
+
+    size_t merged = 0;
+    for (size_t i = 0; i < count; ++i)
     {
-        map_iterator_next(transition_iter, &sym, &set);
-        SET_ITERATOR state_iter = set_iterator_init(set);
-        while (set_iterator_has_next(state_iter))
+        if (sorted[i].lo > sorted[i].hi) continue;
+        if (merged && (long) sorted[i].lo <= (long) sorted[merged - 1].hi + 1)
         {
-            to = set_iterator_next(state_iter);
-            nstate_add_transition(a_accepting, sym, to);
+            if (sorted[i].hi > sorted[merged - 1].hi) sorted[merged - 1].hi = sorted[i].hi;
         }
-        set_iterator_fini(state_iter);
+        else sorted[merged++] = sorted[i];
     }
-    map_iterator_fini(transition_iter);
-    nstate_free(b_starting); // no longer needed
-
-    // this may be faster overall
-    // nstate_add_transition(a->accepting_state, EPSILON, b->starting_state);
 
-    NFA_COMPONENT component = component_new(start, end);
+    NFA_COMPONENT component = component_alloc(COMPONENT_RANGES, merged);
+    for (size_t i = 0; i < merged; ++i)
+        component->operands[i].range = sorted[i];
+    free(sorted);
 
-    info("Successfully formed the concatenation of Component[%p] and Component[%p] into Component[%p].", a, b, component);
-    
-    component_free(a);
-    component_free(b);
+    info("Creating range construct of %lu ranges in Component[%p].", merged, component);
+    return component_intern(component);
+}
 
-    return component;
+NFA_COMPONENT nfa_epsilon()
+{
+    return component_intern(component_alloc(COMPONENT_EPSILON, 0));
 }
 
-NFA_COMPONENT nfa_repeat(NFA_COMPONENT a)
+NFA_COMPONENT nfa_union(NFA_COMPONENT a, NFA_COMPONENT b)
 {
-    NSTATE start = nstate_new();
-    NSTATE end = nstate_new();
+    // if either is null, just return the other
+    if (!a) return b;
+    else if (!b) return a;
 
-    nstate_add_transition(start, EPSILON, end);
-    nstate_add_transition(start, EPSILON, a->starting_state);
-    nstate_add_transition(a->accepting_state, EPSILON, end);
-    nstate_add_transition(a->accepting_state, EPSILON, a->starting_state);
+    NFA_COMPONENT component = component_alloc(COMPONENT_UNION, 2);
+    component->operands[0].child = a;
+    component->operands[1].child = b;
+    return component_intern(component);
+}
 
-    NFA_COMPONENT component = component_new(start, end);
-    component_free(a);
+NFA_COMPONENT nfa_concat(NFA_COMPONENT a, NFA_COMPONENT b)
+{
+    // if either is null, just return the other
+    if (!a) return b;
+    else if (!b) return a;
 
-    return component;
+    NFA_COMPONENT component = component_alloc(COMPONENT_CONCAT, 2);
+    component->operands[0].child = a;
+    component->operands[1].child = b;
+    return component_intern(component);
 }
 
-NFA_COMPONENT nfa_repeat_exact(NFA_COMPONENT a, size_t count)
+NFA_COMPONENT nfa_repeat(NFA_COMPONENT a)
 {
-    // trivial state
-    if (count == 0)
-    {
-        NSTATE state = nstate_new();
-        component_free_internals(a);
-        return component_new(state, state);
-    }
-    else if (count == 1) return a;
-
-    NFA_COMPONENT aggregate = component_clone(a);
-    while (--count)
-    {
-        NFA_COMPONENT clone = component_clone(a);
-        aggregate = nfa_concat(aggregate, clone);
-    }
-    component_free_internals(a);
+    return component_repeat(a, 0, UNBOUNDED);
+}
 
-    return aggregate;
+NFA_COMPONENT nfa_repeat_exact(NFA_COMPONENT a, size_t count)
+{
+    if (count == 1) return a;
+    return component_repeat(a, count, count);
 }
 
 NFA_COMPONENT nfa_repeat_min(NFA_COMPONENT a, size_t min)
 {
-    if (min == 0) return nfa_repeat(a);
-    
-    NFA_COMPONENT head = component_clone(a);
-    while (--min)
-    {
-        NFA_COMPONENT clone = component_clone(a);
-        head = nfa_concat(head, clone);
-    }
-    
-    NFA_COMPONENT tail = nfa_repeat(component_clone(a));
-    NFA_COMPONENT final = nfa_concat(head, tail);
-
-    component_free_internals(a);
-    return final;
+    return component_repeat(a, min, UNBOUNDED);
 }
 
 // inclusive-inclusive
 NFA_COMPONENT nfa_repeat_min_max(NFA_COMPONENT a, size_t min, size_t max)
 {
-    NFA_COMPONENT aggregate = NULL;
-
-    while (min <= max)
+    if (min > max)
     {
-        NFA_COMPONENT clone = component_clone(a);
-        NFA_COMPONENT repeat = nfa_repeat_exact(clone, min);
-        aggregate = nfa_union(aggregate, repeat);
-        min++;
+        component_release(a);
+        return NULL;
     }
-
-    component_free_internals(a);
-    return aggregate;
+    return component_repeat(a, min, max);
 }
 
 NFA_COMPONENT nfa_concat_va(size_t count, ...)
@@ -900,26 +1566,37 @@ NFA_COMPONENT nfa_concat_va(size_t count, ...)
     return aggregate;
 }
 
+NFA_COMPONENT nfa_concat_array(const NFA_COMPONENT *components, size_t count)
+{
+    if (!count) return NULL;
+    if (count == 1) return components[0];
+
+    NFA_COMPONENT component = component_alloc(COMPONENT_CONCAT, count);
+    for (size_t i = 0; i < count; ++i)
+        component->operands[i].child = components[i];
+    return component_intern(component);
+}
+
+NFA_COMPONENT nfa_union_array(const NFA_COMPONENT *components, size_t count)
+{
+    if (!count) return NULL;
+    if (count == 1) return components[0];
+
+    NFA_COMPONENT component = component_alloc(COMPONENT_UNION, count);
+    for (size_t i = 0; i < count; ++i)
+        component->operands[i].child = components[i];
+    return component_intern(component);
+}
+
 NFA_COMPONENT nfa_union_va(size_t count, ...)
 {
-    NSTATE starting = nstate_new();
-    NSTATE accepting = nstate_new();
+    NFA_COMPONENT component = component_alloc(COMPONENT_UNION, count);
 
     va_list va;
     va_start(va, count);
     for (size_t i = 0; i < count; ++i)
-    {
-        NFA_COMPONENT next_component = va_arg(va, NFA_COMPONENT);
-        NSTATE next_starting = next_component->starting_state;
-        NSTATE next_accepting = next_component->accepting_state;
-
-        nstate_add_transition(starting, EPSILON, next_starting);
-        nstate_add_transition(next_accepting, EPSILON, accepting);
-
-        component_free(next_component);
-    }
+        component->operands[i].child = va_arg(va, NFA_COMPONENT);
     va_end(va);
 
-    NFA_COMPONENT component = component_new(starting, accepting);
-    return component;
+    return component_intern(component);
 }
@@ -0,0 +1,1319 @@
+#include "regex/regex.h"
+#include "regex/utf8.h"
+
+#include "debug.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+
+#define REPEAT_INF ((size_t) -1)
+
+// counted repetitions are expanded during construction, so they are bounded
+#define REPEAT_LIMIT 1000
+
+// the passes over a parsed pattern recurse once per level, so groups and repetitions nest boundedly
+#define NESTING_LIMIT 1000
+
+// the symbols a byte string can contain, 0 terminates the string
+#define BYTE_MIN 1
+#define BYTE_MAX 255
+
+// the largest symbol of a pattern, codepoints are encoded into bytes when the class is built
+#define SYMBOL_MAX(flags) ((flags) & REGEX_UTF8 ? UTF8_MAX : BYTE_MAX)
+
+enum node_type
+{
+    NODE_EMPTY,
+    NODE_CLASS,
+    NODE_CONCAT,
+    NODE_UNION,
+    NODE_REPEAT
+};
+
+struct range
+{
+    SYMBOL lo, hi;
+};
+
+struct node
+{
+    enum node_type type;
+    // NODE_CLASS: sorted, disjoint and non-adjacent ranges
+    struct range *ranges;
+    size_t num_ranges;
+    // NODE_CONCAT, NODE_UNION and NODE_REPEAT (exactly one child)
+    struct node **children;
+    size_t num_children;
+    // NODE_REPEAT
+    size_t min, max;
+    // the number of levels below the node as it was parsed, simplification only lowers it
+    size_t height;
+};
+
+struct parser
+{
+    const char *cursor;
+    int flags;
+    // the number of open groups
+    size_t depth;
+};
+
+struct string_buffer
+{
+    char *data;
+    size_t size;
+    size_t capacity;
+};
+
+enum precedence
+{
+    PREC_UNION,
+    PREC_CONCAT,
+    PREC_REPEAT,
+    PREC_ATOM
+};
+
+static struct node *node_new(enum node_type type)
+{
+    struct node *node = calloc(1, sizeof(struct node));
+    node->type = type;
+    return node;
+}
+
+static void node_free(struct node *node)
+{
+    if (!node) return;
+    for (size_t i = 0; i < node->num_children; ++i)
+        node_free(node->children[i]);
+    free(node->children);
+    free(node->ranges);
+    free(node);
+}
+
+static void node_add_child(struct node *node, struct node *child)
+{
+    // nested concatenations and unions are flattened, empty factors of a concatenation are dropped
+    if (child->type == node->type && node->type != NODE_REPEAT)
+    {
+        for (size_t i = 0; i < child->num_children; ++i)
+            node_add_child(node, child->children[i]);
+        child->num_children = 0;
+        node_free(child);
+        return;
+    }
+    if (node->type == NODE_CONCAT && child->type == NODE_EMPTY)
+    {
+        node_free(child);
+        return;
+    }
+
+    node->children = realloc(node->children, (node->num_children + 1) * sizeof(struct node*));
+    node->children[node->num_children++] = child;
+    if (child->height >= node->height) node->height = child->height + 1;
+}
+
+// replaces a concatenation or union with fewer than two children by its only child
+static struct node *node_collapse(struct node *node)
+{
+    if (node->num_children > 1) return node;
+
+    struct node *child = node->num_children ? node->children[0] : node_new(NODE_EMPTY);
+    node->num_children = 0;
+    node_free(node);
+    return child;
+}
+
+static void class_add_range(struct node *node, SYMBOL lo, SYMBOL hi)
+{
+    node->ranges = realloc(node->ranges, (node->num_ranges + 1) * sizeof(struct range));
+    node->ranges[node->num_ranges++] = (struct range){ lo, hi };
+}
+
+static int compare_ranges(const void *a, const void *b)
+{
+    const struct range *x = a, *y = b;
+    return (x->lo > y->lo) - (x->lo < y->lo);
+}
+
+// sorts the ranges and merges overlapping or adjacent ranges
+static void class_canonicalize(struct node *node)
+{
+    if (!node->num_ranges) return;
+
+    qsort(node->ranges, node->num_ranges, sizeof(struct range), compare_ranges);
+    size_t count = 1;
+    for (size_t i = 1; i < node->num_ranges; ++i)
+    {
+        struct range *last = &node->ranges[count - 1];
+        if ((long) node->ranges[i].lo <= (long) last->hi + 1)
+        {
+            if (node->ranges[i].hi > last->hi) last->hi = node->ranges[i].hi;
+        }
+        else node->ranges[count++] = node->ranges[i];
+    }
+    node->num_ranges = count;
+}
+
+// complements a canonical class within the symbols up to max
+static void class_negate(struct node *node, SYMBOL max)
+{
+    struct range *ranges = node->ranges;
+    size_t num_ranges = node->num_ranges;
+
+    node->ranges = NULL;
+    node->num_ranges = 0;
+
+    SYMBOL next = BYTE_MIN;
+    for (size_t i = 0; i < num_ranges && ranges[i].lo <= max; ++i)
+    {
+        if (ranges[i].lo > next) class_add_range(node, next, ranges[i].lo - 1);
+        if (ranges[i].hi + 1 > next) next = ranges[i].hi + 1;
+    }
+    if (next <= max) class_add_range(node, next, max);
+    free(ranges);
+}
+
+// removes the symbols lo-hi from a canonical class
+static void class_subtract(struct node *node, SYMBOL lo, SYMBOL hi)
+{
+    struct range *ranges = node->ranges;
+    size_t num_ranges = node->num_ranges;
+
+    node->ranges = NULL;
+    node->num_ranges = 0;
+
+    for (size_t i = 0; i < num_ranges; ++i)
+    {
+        if (ranges[i].lo < lo) class_add_range(node, ranges[i].lo, ranges[i].hi < lo ? ranges[i].hi : lo - 1);
+        if (ranges[i].hi > hi) class_add_range(node, ranges[i].lo > hi ? ranges[i].lo : hi + 1, ranges[i].hi);
+    }
+    free(ranges);
+}
+
+/**
+ * simple case folding of a run of letters, every stride-th symbol of lo-hi is an uppercase
+ * letter whose lowercase letter is delta symbols above it. the first entry covers ASCII,
+ * the others only apply to UTF-8 patterns.
+ */
+struct case_fold
+{
+    SYMBOL lo, hi, delta, stride;
+};
+
+static const struct case_fold case_folds[] = {
+    { 'A', 'Z', 32, 1 },
+    // latin-1 supplement
+    { 0xC0, 0xD6, 32, 1 },
+    { 0xD8, 0xDE, 32, 1 },
+    // latin extended-a
+    { 0x100, 0x12E, 1, 2 },
+    { 0x132, 0x136, 1, 2 },
+    { 0x139, 0x147, 1, 2 },
+    { 0x14A, 0x176, 1, 2 },
+    { 0x179, 0x17D, 1, 2 },
+    // greek
+    { 0x391, 0x3A1, 32, 1 },
+    { 0x3A3, 0x3AB, 32, 1 },
+    // cyrillic
+    { 0x400, 0x40F, 80, 1 },
+    { 0x410, 0x42F, 32, 1 },
+};
+
+// adds the letters of lo-hi which are on the stride of base, shifted to their other case
+static void class_add_case(struct node *node, const struct case_fold *fold, SYMBOL base, SYMBOL lo, SYMBOL hi, SYMBOL shift)
+{
+    if (lo > hi) return;
+    if (fold->stride == 1)
+    {
+        class_add_range(node, lo + shift, hi + shift);
+        return;
+    }
+    for (SYMBOL sym = lo; sym <= hi; ++sym)
+        if ((sym - base) % fold->stride == 0) class_add_range(node, sym + shift, sym + shift);
+}
+
+// adds the other case of every letter of a canonical class
+static void class_close_case(struct node *node, int flags)
+{
+    size_t num_folds = flags & REGEX_UTF8 ? sizeof(case_folds) / sizeof(case_folds[0]) : 1;
+    size_t num_ranges = node->num_ranges;
+    for (size_t f = 0; f < num_folds; ++f)
+    {
+        const struct case_fold *fold = &case_folds[f];
+        SYMBOL lower_lo = fold->lo + fold->delta, lower_hi = fold->hi + fold->delta;
+        for (size_t i = 0; i < num_ranges; ++i)
+        {
+            struct range range = node->ranges[i];
+            class_add_case(node, fold, fold->lo, range.lo > fold->lo ? range.lo : fold->lo,
+                range.hi < fold->hi ? range.hi : fold->hi, fold->delta);
+            class_add_case(node, fold, lower_lo, range.lo > lower_lo ? range.lo : lower_lo,
+                range.hi < lower_hi ? range.hi : lower_hi, -fold->delta);
+        }
+    }
+    class_canonicalize(node);
+}
+
+/**
+ * finishes a parsed class. case-insensitive classes are closed under case folding before
+ * they are negated. the input is folded to lowercase ASCII before it reaches the automaton,
+ * so the uppercase ASCII letters are dropped and the automaton has no transitions for them.
+ */
+static struct node *class_finish(struct parser *parser, struct node *node, int negate)
+{
+    if (parser->flags & REGEX_ICASE) class_close_case(node, parser->flags);
+    if (negate) class_negate(node, SYMBOL_MAX(parser->flags));
+    if (parser->flags & REGEX_ICASE) class_subtract(node, 'A', 'Z');
+    return node;
+}
+
+static size_t class_count_symbols(struct node *node)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < node->num_ranges; ++i)
+        count += (size_t) ((long) node->ranges[i].hi - node->ranges[i].lo + 1);
+    return count;
+}
+
+static struct node *class_symbol(SYMBOL sym)
+{
+    struct node *node = node_new(NODE_CLASS);
+    class_add_range(node, sym, sym);
+    return node;
+}
+
+static struct node *class_wildcard(SYMBOL max)
+{
+    struct node *node = node_new(NODE_CLASS);
+    class_add_range(node, BYTE_MIN, '\n' - 1);
+    class_add_range(node, '\n' + 1, max);
+    return node;
+}
+
+static int hex_value(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// adds the ranges of a class escape (\d, \w, \s and their negations), returns zero if
+// the escape is not a class escape
+static int add_class_escape(struct node *node, char escape, SYMBOL max)
+{
+    struct node *class = node_new(NODE_CLASS);
+    switch (tolower((unsigned char) escape))
+    {
+    case 'd':
+        class_add_range(class, '0', '9');
+        break;
+    case 'w':
+        class_add_range(class, '0', '9');
+        class_add_range(class, 'A', 'Z');
+        class_add_range(class, '_', '_');
+        class_add_range(class, 'a', 'z');
+        break;
+    case 's':
+        class_add_range(class, '\t', '\r');
+        class_add_range(class, ' ', ' ');
+        break;
+    default:
+        node_free(class);
+        return 0;
+    }
+    if (isupper((unsigned char) escape)) class_negate(class, max);
+
+    for (size_t i = 0; i < class->num_ranges; ++i)
+        class_add_range(node, class->ranges[i].lo, class->ranges[i].hi);
+    node_free(class);
+    return 1;
+}
+
+// parses the escape following a backslash which denotes a single symbol
+static int parse_escape_symbol(struct parser *parser, SYMBOL *sym)
+{
+    char c = *parser->cursor++;
+    switch (c)
+    {
+    case 'n': *sym = '\n'; return 0;
+    case 't': *sym = '\t'; return 0;
+    case 'r': *sym = '\r'; return 0;
+    case 'f': *sym = '\f'; return 0;
+    case 'v': *sym = '\v'; return 0;
+    case 'x':
+        if (*parser->cursor == '{')
+        {
+            // \x{H...}
+            long value = 0;
+            const char *start = ++parser->cursor;
+            while (hex_value(*parser->cursor) >= 0 && parser->cursor - start < 8)
+                value = value * 16 + hex_value(*parser->cursor++);
+            if (parser->cursor == start || *parser->cursor != '}' || value <= 0 || value > 0x7FFFFFFF) return -1;
+            parser->cursor++;
+            *sym = (SYMBOL) value;
+            return 0;
+        }
+        if (hex_value(parser->cursor[0]) < 0 || hex_value(parser->cursor[1]) < 0) return -1;
+        *sym = hex_value(parser->cursor[0]) * 16 + hex_value(parser->cursor[1]);
+        parser->cursor += 2;
+        return *sym ? 0 : -1;
+    default:
+        // only punctuation can be escaped to a literal, everything else is reserved
+        if (!c || isalnum((unsigned char) c) || !isprint((unsigned char) c)) return -1;
+        *sym = (unsigned char) c;
+        return 0;
+    }
+}
+
+// parses an unescaped literal symbol, which is a whole encoded codepoint in UTF-8 patterns
+static int parse_literal_symbol(struct parser *parser, SYMBOL *sym)
+{
+    unsigned char c = *parser->cursor;
+    if (!(parser->flags & REGEX_UTF8) || c < 0x80)
+    {
+        parser->cursor++;
+        *sym = c;
+        return 0;
+    }
+    return utf8_decode(&parser->cursor, sym);
+}
+
+static struct node *parse_union(struct parser *parser);
+
+static struct node *parse_class(struct parser *parser)
+{
+    struct node *node = node_new(NODE_CLASS);
+    int negate = 0;
+    if (*parser->cursor == '^')
+    {
+        negate = 1;
+        parser->cursor++;
+    }
+
+    int first = 1;
+    while (first || *parser->cursor != ']')
+    {
+        first = 0;
+        SYMBOL lo, hi;
+        char c = *parser->cursor;
+        if (!c) goto error;
+
+        if (c == '\\')
+        {
+            parser->cursor++;
+            if (add_class_escape(node, *parser->cursor, SYMBOL_MAX(parser->flags)))
+            {
+                parser->cursor++;
+                continue;
+            }
+            if (parse_escape_symbol(parser, &lo)) goto error;
+        }
+        else if (parse_literal_symbol(parser, &lo)) goto error;
+
+        hi = lo;
+        if (parser->cursor[0] == '-' && parser->cursor[1] && parser->cursor[1] != ']')
+        {
+            parser->cursor++;
+            if (*parser->cursor == '\\')
+            {
+                parser->cursor++;
+                if (parse_escape_symbol(parser, &hi)) goto error;
+            }
+            else if (parse_literal_symbol(parser, &hi)) goto error;
+
+            if (hi < lo) goto error;
+        }
+        class_add_range(node, lo, hi);
+    }
+    parser->cursor++;
+
+    class_canonicalize(node);
+    class_finish(parser, node, negate);
+    if (!node->num_ranges) goto error;
+    return node;
+
+error:
+    node_free(node);
+    return NULL;
+}
+
+static struct node *parse_atom(struct parser *parser)
+{
+    struct node *node;
+    char c = *parser->cursor++;
+    switch (c)
+    {
+    case '(':
+        if (++parser->depth > NESTING_LIMIT)
+        {
+            info("Pattern nests deeper than %d levels.", NESTING_LIMIT);
+            return NULL;
+        }
+        node = parse_union(parser);
+        if (!node) return NULL;
+        if (*parser->cursor != ')')
+        {
+            node_free(node);
+            return NULL;
+        }
+        parser->cursor++;
+        parser->depth--;
+        return node;
+    case '[':
+        return parse_class(parser);
+    case '.':
+        return class_finish(parser, class_wildcard(SYMBOL_MAX(parser->flags)), 0);
+    case '\\':
+        node = node_new(NODE_CLASS);
+        if (add_class_escape(node, *parser->cursor, SYMBOL_MAX(parser->flags)))
+        {
+            parser->cursor++;
+            class_canonicalize(node);
+            return class_finish(parser, node, 0);
+        }
+        node_free(node);
+
+        SYMBOL sym;
+        if (parse_escape_symbol(parser, &sym)) return NULL;
+        return class_finish(parser, class_symbol(sym), 0);
+    case '*':
+    case '+':
+    case '?':
+    case '{':
+    case ']':
+    case '}':
+        // nothing to repeat or unbalanced
+        return NULL;
+    default:
+        parser->cursor--;
+        SYMBOL literal;
+        if (parse_literal_symbol(parser, &literal)) return NULL;
+        return class_finish(parser, class_symbol(literal), 0);
+    }
+}
+
+static int parse_count(struct parser *parser, size_t *count)
+{
+    if (!isdigit(*parser->cursor)) return -1;
+
+    size_t value = 0;
+    while (isdigit(*parser->cursor))
+    {
+        value = value * 10 + (*parser->cursor++ - '0');
+        if (value > REPEAT_LIMIT) return -1;
+    }
+    *count = value;
+    return 0;
+}
+
+// parses a quantifier if there is one, returns nonzero on a malformed quantifier
+static int parse_quantifier(struct parser *parser, int *found, size_t *min, size_t *max)
+{
+    *found = 1;
+    switch (*parser->cursor)
+    {
+    case '*': *min = 0; *max = REPEAT_INF; break;
+    case '+': *min = 1; *max = REPEAT_INF; break;
+    case '?': *min = 0; *max = 1; break;
+    case '{':
+        parser->cursor++;
+        if (parse_count(parser, min)) return -1;
+        *max = *min;
+        if (*parser->cursor == ',')
+        {
+            parser->cursor++;
+            *max = REPEAT_INF;
+            if (*parser->cursor != '}' && parse_count(parser, max)) return -1;
+        }
+        if (*parser->cursor != '}' || *max < *min) return -1;
+        break;
+    default:
+        *found = 0;
+        return 0;
+    }
+    parser->cursor++;
+    return 0;
+}
+
+static struct node *simplify_repeat(struct node *node);
+
+static struct node *parse_repeat(struct parser *parser)
+{
+    struct node *node = parse_atom(parser);
+    if (!node) return NULL;
+
+    int found, stacked = 0;
+    size_t min, max;
+    while (1)
+    {
+        if (node->height > NESTING_LIMIT)
+        {
+            info("Pattern nests deeper than %d levels.", NESTING_LIMIT);
+            node_free(node);
+            return NULL;
+        }
+        if (parse_quantifier(parser, &found, &min, &max))
+        {
+            node_free(node);
+            return NULL;
+        }
+        if (!found) break;
+
+        // a single repetition is the expression itself
+        if (min == 1 && max == 1) continue;
+        if (max == 0)
+        {
+            node_free(node);
+            node = node_new(NODE_EMPTY);
+            continue;
+        }
+
+        struct node *repeat = node_new(NODE_REPEAT);
+        node_add_child(repeat, node);
+        repeat->min = min;
+        repeat->max = max;
+        node = repeat;
+
+        // stacked quantifiers such as `a**` fold into one repetition instead of nesting
+        if (stacked)
+        {
+            node = simplify_repeat(node);
+            if (node->type == NODE_REPEAT) node->height = node->children[0]->height + 1;
+        }
+        stacked = 1;
+    }
+    return node;
+}
+
+static struct node *parse_concat(struct parser *parser)
+{
+    struct node *node = node_new(NODE_CONCAT);
+    while (*parser->cursor && *parser->cursor != '|' && *parser->cursor != ')')
+    {
+        struct node *child = parse_repeat(parser);
+        if (!child)
+        {
+            node_free(node);
+            return NULL;
+        }
+        node_add_child(node, child);
+    }
+    return node_collapse(node);
+}
+
+static struct node *parse_union(struct parser *parser)
+{
+    struct node *node = node_new(NODE_UNION);
+    while (1)
+    {
+        struct node *child = parse_concat(parser);
+        if (!child)
+        {
+            node_free(node);
+            return NULL;
+        }
+        node_add_child(node, child);
+
+        if (*parser->cursor != '|') break;
+        parser->cursor++;
+    }
+    return node_collapse(node);
+}
+
+static struct node *parse(const char *pattern, int flags)
+{
+    if (!pattern) return NULL;
+
+    struct parser parser = { pattern, flags, 0 };
+    struct node *node = parse_union(&parser);
+    if (node && *parser.cursor)
+    {
+        // unbalanced closing parenthesis
+        node_free(node);
+        node = NULL;
+    }
+    if (!node) info("Failed to parse pattern \"%s\" at offset %ld.", pattern, parser.cursor - pattern);
+    return node;
+}
+
+// ------------------------------------------------------------------------ //
+
+static size_t saturating_add(size_t a, size_t b)
+{
+    return a > (size_t) -1 - b ? (size_t) -1 : a + b;
+}
+
+static size_t saturating_mul(size_t a, size_t b)
+{
+    if (a && b > (size_t) -1 / a) return (size_t) -1;
+    return a * b;
+}
+
+static int node_equal(struct node *a, struct node *b)
+{
+    if (a->type != b->type || a->num_ranges != b->num_ranges || a->num_children != b->num_children) return 0;
+    if (a->type == NODE_REPEAT && (a->min != b->min || a->max != b->max)) return 0;
+    if (a->num_ranges && memcmp(a->ranges, b->ranges, a->num_ranges * sizeof(struct range))) return 0;
+    for (size_t i = 0; i < a->num_children; ++i)
+        if (!node_equal(a->children[i], b->children[i])) return 0;
+    return 1;
+}
+
+static size_t node_count(struct node *node)
+{
+    size_t count = 1;
+    for (size_t i = 0; i < node->num_children; ++i)
+        count += node_count(node->children[i]);
+    return count;
+}
+
+// the number of states emitted for a repetition of an expression emitting `states` states
+static size_t repeat_states(size_t min, size_t max, size_t states)
+{
+    if (max == REPEAT_INF) return saturating_add(saturating_mul(min + 1, states), 2);
+    if (min == max) return saturating_mul(min, states);
+
+    // a branch per number of copies, each with its own starting state
+    size_t branches = max - min + 1;
+    size_t copies = saturating_mul(min + max, branches) / 2;
+    return saturating_add(saturating_mul(copies, states), branches + 1);
+}
+
+// the number of states `nfa_construct` emits for a node, not counting the starting state
+static size_t node_states(struct node *node)
+{
+    size_t states = 0;
+    switch (node->type)
+    {
+    case NODE_EMPTY:
+    case NODE_CLASS:
+        return 1;
+    case NODE_UNION:
+        // every alternative has its own starting state, the alternatives share an accepting state
+        states = saturating_add(node->num_children, 1);
+        // fall through
+    case NODE_CONCAT:
+        for (size_t i = 0; i < node->num_children; ++i)
+            states = saturating_add(states, node_states(node->children[i]));
+        return states;
+    case NODE_REPEAT:
+        return repeat_states(node->min, node->max, node_states(node->children[0]));
+    }
+    return states;
+}
+
+// determines the bounds of a node seen as a repetition, any other node occurs exactly once
+static struct node *repeat_base(struct node *node, size_t *min, size_t *max)
+{
+    if (node->type == NODE_REPEAT)
+    {
+        *min = node->min;
+        *max = node->max;
+        return node->children[0];
+    }
+    *min = *max = 1;
+    return node;
+}
+
+static size_t bound_mul(size_t a, size_t b)
+{
+    return a == REPEAT_INF || b == REPEAT_INF ? REPEAT_INF : a * b;
+}
+
+static size_t bound_add(size_t a, size_t b)
+{
+    return a == REPEAT_INF || b == REPEAT_INF ? REPEAT_INF : a + b;
+}
+
+/**
+ * determines if r{a,b}{c,d} is r{ac,bd}, which holds exactly if the numbers of copies
+ * reachable with c to d outer repetitions leave no gaps.
+ */
+static int repeat_foldable(size_t a, size_t b, size_t c, size_t d)
+{
+    if (c == d) return 1;
+    if (b == REPEAT_INF) return c > 0 || a <= 1;
+    return c * (b - a) + 1 >= a;
+}
+
+// replaces a node by one of its children, the rest of the node is destroyed
+static struct node *node_replace(struct node *node, size_t child)
+{
+    struct node *replacement = node->children[child];
+    node->children[child] = node->children[--node->num_children];
+    node_free(node);
+    return replacement;
+}
+
+// folds nested repetitions and drops repetitions which are no repetitions
+static struct node *simplify_repeat(struct node *node)
+{
+    struct node *child = node->children[0];
+    if (child->type == NODE_EMPTY) return node_replace(node, 0);
+
+    if (child->type == NODE_REPEAT && repeat_foldable(child->min, child->max, node->min, node->max))
+    {
+        size_t min = child->min * node->min, max = bound_mul(child->max, node->max);
+        size_t states = node_states(child->children[0]);
+        // counted ranges are expanded into a branch per count, so folding them may cost states
+        if (repeat_states(min, max, states) <= repeat_states(node->min, node->max, node_states(child)))
+        {
+            node->children[0] = node_replace(child, 0);
+            node->min = min;
+            node->max = max;
+        }
+    }
+
+    if (node->min == 1 && node->max == 1) return node_replace(node, 0);
+    return node;
+}
+
+// replaces the children of a concatenation or union by their simplified list
+static void set_children(struct node *node, struct node **children, size_t count)
+{
+    free(node->children);
+    node->children = children;
+    node->num_children = count;
+}
+
+// splices the children of nested nodes of the same type into a new list
+static struct node **flatten(struct node *node, size_t *count)
+{
+    size_t total = 0;
+    for (size_t i = 0; i < node->num_children; ++i)
+        total += node->children[i]->type == node->type ? node->children[i]->num_children : 1;
+
+    struct node **children = malloc(total * sizeof(struct node*) + 1);
+    *count = 0;
+    for (size_t i = 0; i < node->num_children; ++i)
+    {
+        struct node *child = node->children[i];
+        if (child->type != node->type)
+        {
+            children[(*count)++] = child;
+            continue;
+        }
+        for (size_t j = 0; j < child->num_children; ++j)
+            children[(*count)++] = child->children[j];
+        child->num_children = 0;
+        node_free(child);
+    }
+    node->num_children = 0;
+    return children;
+}
+
+// merges classes, drops duplicate alternatives and turns an empty alternative into `?`
+static struct node *simplify_union(struct node *node)
+{
+    size_t total, count = 0;
+    struct node **children = flatten(node, &total);
+    struct node *class = NULL;
+    int optional = 0;
+
+    for (size_t i = 0; i < total; ++i)
+    {
+        struct node *child = children[i];
+        if (child->type == NODE_EMPTY)
+        {
+            optional = 1;
+            node_free(child);
+            continue;
+        }
+        // the order of the alternatives does not matter, so every class joins the first one
+        if (child->type == NODE_CLASS && class)
+        {
+            for (size_t r = 0; r < child->num_ranges; ++r)
+                class_add_range(class, child->ranges[r].lo, child->ranges[r].hi);
+            node_free(child);
+            continue;
+        }
+
+        int duplicate = 0;
+        for (size_t j = 0; j < count && !duplicate; ++j)
+            duplicate = node_equal(children[j], child);
+        if (duplicate)
+        {
+            node_free(child);
+            continue;
+        }
+
+        if (child->type == NODE_CLASS) class = child;
+        children[count++] = child;
+    }
+    if (class) class_canonicalize(class);
+    set_children(node, children, count);
+
+    node = node_collapse(node);
+    if (!optional || node->type == NODE_EMPTY) return node;
+
+    struct node *repeat = node_new(NODE_REPEAT);
+    node_add_child(repeat, node);
+    repeat->min = 0;
+    repeat->max = 1;
+    return simplify_repeat(repeat);
+}
+
+// drops empty factors and folds adjacent repetitions of the same expression into counted forms
+static struct node *simplify_concat(struct node *node)
+{
+    size_t total, count = 0;
+    struct node **children = flatten(node, &total);
+
+    for (size_t i = 0; i < total; ++i)
+    {
+        struct node *child = children[i];
+        if (child->type == NODE_EMPTY)
+        {
+            node_free(child);
+            continue;
+        }
+
+        if (count)
+        {
+            struct node *previous = children[count - 1];
+            size_t min_a, max_a, min_b, max_b;
+            struct node *base = repeat_base(previous, &min_a, &max_a);
+            if (node_equal(base, repeat_base(child, &min_b, &max_b)))
+            {
+                size_t min = min_a + min_b, max = bound_add(max_a, max_b);
+                size_t states = node_states(base);
+                if (repeat_states(min, max, states) <= saturating_add(repeat_states(min_a, max_a, states),
+                    repeat_states(min_b, max_b, states)))
+                {
+                    if (previous->type != NODE_REPEAT)
+                    {
+                        previous = node_new(NODE_REPEAT);
+                        node_add_child(previous, base);
+                        children[count - 1] = previous;
+                    }
+                    previous->min = min;
+                    previous->max = max;
+                    node_free(child);
+                    continue;
+                }
+            }
+        }
+        children[count++] = child;
+    }
+    set_children(node, children, count);
+    return node_collapse(node);
+}
+
+/**
+ * rewrites a node into an equivalent node which is no larger: nested repetitions are
+ * folded, duplicate alternatives dropped, the classes of a union merged and adjacent
+ * repetitions of the same expression turned into counted forms. a rewrite is only applied
+ * if the construction emits no more states for it.
+ */
+static struct node *simplify(struct node *node)
+{
+    for (size_t i = 0; i < node->num_children; ++i)
+        node->children[i] = simplify(node->children[i]);
+
+    switch (node->type)
+    {
+    case NODE_REPEAT:
+        return simplify_repeat(node);
+    case NODE_UNION:
+        return simplify_union(node);
+    case NODE_CONCAT:
+        return simplify_concat(node);
+    default:
+        return node;
+    }
+}
+
+// parses a pattern and simplifies it, optionally reporting the savings
+static struct node *parse_simplified(const char *pattern, int flags, struct regex_simplification *report)
+{
+    struct node *node = parse(pattern, flags);
+    if (!node) return NULL;
+
+    size_t nodes = node_count(node), states = saturating_add(node_states(node), 1);
+    node = simplify(node);
+
+    struct regex_simplification simplification;
+    simplification.nodes = node_count(node);
+    simplification.states = saturating_add(node_states(node), 1);
+    simplification.nodes_saved = nodes - simplification.nodes;
+    simplification.states_saved = states - simplification.states;
+    info("Simplified pattern \"%s\", saving %lu nodes and %lu states.", pattern,
+        simplification.nodes_saved, simplification.states_saved);
+
+    if (report) *report = simplification;
+    return node;
+}
+
+int regex_simplify(const char *pattern, int flags, struct regex_simplification *report)
+{
+    struct node *node = parse_simplified(pattern, flags, report);
+    if (!node) return -1;
+    node_free(node);
+    return 0;
+}
+
+// ------------------------------------------------------------------------ //
+
+static NFA_COMPONENT build(struct node *node, int flags)
+{
+    NFA_COMPONENT component = NULL;
+    switch (node->type)
+    {
+    case NODE_EMPTY:
+        return nfa_epsilon();
+    case NODE_CLASS:
+    {
+        // every range of a class is a single transition, however many symbols it spans
+        if (class_count_symbols(node) == 1 && !(flags & REGEX_UTF8)) return nfa_symbol(node->ranges[0].lo);
+
+        struct symbol_range *ranges = malloc(node->num_ranges * sizeof(struct symbol_range));
+        for (size_t i = 0; i < node->num_ranges; ++i)
+            ranges[i] = (struct symbol_range){ node->ranges[i].lo, node->ranges[i].hi };
+        // codepoints are matched by the byte sequences encoding them
+        if (flags & REGEX_UTF8) component = utf8_ranges(ranges, node->num_ranges);
+        else component = nfa_ranges(ranges, node->num_ranges);
+        free(ranges);
+        return component;
+    }
+    case NODE_CONCAT:
+    case NODE_UNION:
+    {
+        // the children form a single component, so long unions and concatenations stay flat
+        NFA_COMPONENT *children = malloc(node->num_children * sizeof(NFA_COMPONENT) + 1);
+        for (size_t i = 0; i < node->num_children; ++i)
+            children[i] = build(node->children[i], flags);
+        if (node->type == NODE_CONCAT) component = nfa_concat_array(children, node->num_children);
+        else component = nfa_union_array(children, node->num_children);
+        free(children);
+        return component;
+    }
+    case NODE_REPEAT:
+        component = build(node->children[0], flags);
+        if (node->max == REPEAT_INF)
+            return node->min ? nfa_repeat_min(component, node->min) : nfa_repeat(component);
+        if (node->min == node->max)
+            return nfa_repeat_exact(component, node->min);
+        return nfa_repeat_min_max(component, node->min, node->max);
+    }
+    return NULL;
+}
+
+NFA_COMPONENT regex_parse(const char *pattern, int flags)
+{
+    struct node *node = parse_simplified(pattern, flags, NULL);
+    if (!node) return NULL;
+
+    NFA_COMPONENT component = build(node, flags);
+    node_free(node);
+    return component;
+}
+
+// ------------------------------------------------------------------------ //
+
+// approximate size of the header and the byte class map of a frozen DFA
+#define FROZEN_DFA_OVERHEAD 1088
+
+// bitmaps over the byte symbols, wider symbols never collide with a loop
+#define BITMAP_WORDS 4
+
+struct analyzer
+{
+    // symbols at which an equivalence class may begin, bit 256 is unused
+    uint64_t boundaries[BITMAP_WORDS + 1];
+};
+
+static void bitmap_set(uint64_t *bitmap, SYMBOL sym)
+{
+    bitmap[sym >> 6] |= 1ull << (sym & 63);
+}
+
+static void class_bitmap(struct node *node, uint64_t *bitmap)
+{
+    for (size_t i = 0; i < node->num_ranges; ++i)
+        for (long sym = node->ranges[i].lo; sym <= node->ranges[i].hi && sym <= BYTE_MAX; ++sym)
+            bitmap_set(bitmap, sym);
+}
+
+// collects every byte symbol occurring in a node
+static void node_bitmap(struct node *node, uint64_t *bitmap)
+{
+    if (node->type == NODE_CLASS) class_bitmap(node, bitmap);
+    for (size_t i = 0; i < node->num_children; ++i)
+        node_bitmap(node->children[i], bitmap);
+}
+
+/**
+ * walks a node to count its symbol positions. a position is ambiguous if its symbols can
+ * also be consumed by an unbounded repetition in front of it (the loop); the DFA then has
+ * to track every combination of the ambiguous positions in flight.
+ */
+static void analyze(struct analyzer *analyzer, struct node *node, const uint64_t *loop,
+    size_t *positions, size_t *ambiguous)
+{
+    uint64_t inner[BITMAP_WORDS];
+    size_t child_positions, child_ambiguous;
+
+    switch (node->type)
+    {
+    case NODE_EMPTY:
+        break;
+    case NODE_CLASS:
+        *positions += 1;
+        memset(inner, 0, sizeof(inner));
+        class_bitmap(node, inner);
+        for (int i = 0; i < BITMAP_WORDS; ++i)
+        {
+            if (inner[i] & loop[i])
+            {
+                *ambiguous += 1;
+                break;
+            }
+        }
+        for (size_t i = 0; i < node->num_ranges; ++i)
+        {
+            if (node->ranges[i].lo <= BYTE_MAX) bitmap_set(analyzer->boundaries, node->ranges[i].lo);
+            if (node->ranges[i].hi < BYTE_MAX) bitmap_set(analyzer->boundaries, node->ranges[i].hi + 1);
+        }
+        break;
+    case NODE_CONCAT:
+        memcpy(inner, loop, sizeof(inner));
+        for (size_t i = 0; i < node->num_children; ++i)
+        {
+            struct node *child = node->children[i];
+            analyze(analyzer, child, inner, positions, ambiguous);
+            if (child->type == NODE_REPEAT && child->max == REPEAT_INF) node_bitmap(child, inner);
+        }
+        break;
+    case NODE_UNION:
+        // the alternatives are in flight together, so only the most ambiguous one counts
+        child_ambiguous = 0;
+        for (size_t i = 0; i < node->num_children; ++i)
+        {
+            size_t alternative = 0;
+            analyze(analyzer, node->children[i], loop, positions, &alternative);
+            if (alternative > child_ambiguous) child_ambiguous = alternative;
+        }
+        *ambiguous += child_ambiguous;
+        break;
+    case NODE_REPEAT:
+    {
+        child_positions = child_ambiguous = 0;
+        analyze(analyzer, node->children[0], loop, &child_positions, &child_ambiguous);
+        size_t copies = node->max == REPEAT_INF ? (node->min ? node->min : 1) : node->max;
+        *positions += saturating_mul(child_positions, copies);
+        *ambiguous += saturating_mul(child_ambiguous, copies);
+        break;
+    }
+    }
+}
+
+// determines if a node matches exactly one string, counting its length
+static int node_literal_length(struct node *node, size_t *length)
+{
+    switch (node->type)
+    {
+    case NODE_EMPTY:
+        return 1;
+    case NODE_CLASS:
+        *length += 1;
+        return class_count_symbols(node) == 1;
+    case NODE_CONCAT:
+        for (size_t i = 0; i < node->num_children; ++i)
+            if (!node_literal_length(node->children[i], length)) return 0;
+        return 1;
+    case NODE_REPEAT:
+    {
+        // runs such as `aa` are folded into `a{2}`
+        size_t child_length = 0;
+        if (node->min != node->max || !node_literal_length(node->children[0], &child_length)) return 0;
+        *length += saturating_mul(child_length, node->min);
+        return 1;
+    }
+    default:
+        return 0;
+    }
+}
+
+int regex_analyze(const char *pattern, int flags, struct regex_analysis *analysis)
+{
+    struct node *node = parse_simplified(pattern, flags, NULL);
+    if (!node) return -1;
+
+    memset(analysis, 0, sizeof(struct regex_analysis));
+    struct analyzer analyzer = { { 0 } };
+    uint64_t loop[BITMAP_WORDS] = { 0 };
+    analyze(&analyzer, node, loop, &analysis->positions, &analysis->ambiguous_positions);
+
+    analysis->is_literal = node_literal_length(node, &analysis->literal_length);
+    if (!analysis->is_literal) analysis->literal_length = 0;
+
+    // the symbols between two boundaries behave alike, plus the class without transitions
+    size_t classes = 1;
+    for (int i = 0; i < BITMAP_WORDS; ++i)
+        classes += __builtin_popcountll(analyzer.boundaries[i]);
+    analysis->symbol_classes = classes;
+
+    // one DFA state per position, and a state per subset of the ambiguous positions
+    size_t states = analysis->positions < (size_t) -3 ? analysis->positions + 2 : (size_t) -1;
+    if (analysis->ambiguous_positions)
+    {
+        size_t subsets = analysis->ambiguous_positions < 8 * sizeof(size_t) - 1 ?
+            (size_t) 1 << analysis->ambiguous_positions : (size_t) -1;
+        states = states < (size_t) -1 - subsets ? states + subsets : (size_t) -1;
+    }
+    analysis->dfa_states = states;
+
+    // every state has a row of transitions and a byte of flags in the frozen DFA
+    size_t row = classes * sizeof(uint32_t) + 1;
+    analysis->dfa_memory = states <= ((size_t) -1 - FROZEN_DFA_OVERHEAD) / row ?
+        FROZEN_DFA_OVERHEAD + states * row : (size_t) -1;
+
+    node_free(node);
+    return 0;
+}
+
+// ------------------------------------------------------------------------ //
+
+static void buffer_append(struct string_buffer *buffer, const char *string)
+{
+    size_t len = strlen(string);
+    if (buffer->size + len + 1 > buffer->capacity)
+    {
+        while (buffer->size + len + 1 > buffer->capacity) buffer->capacity *= 2;
+        buffer->data = realloc(buffer->data, buffer->capacity);
+    }
+    memcpy(buffer->data + buffer->size, string, len + 1);
+    buffer->size += len;
+}
+
+static void print_symbol(struct string_buffer *buffer, SYMBOL sym, const char *specials)
+{
+    char buf[16];
+    if (sym > 0xFF) snprintf(buf, sizeof(buf), "\\x{%X}", sym);
+    else if (sym < 0x20 || sym >= 0x7F) snprintf(buf, sizeof(buf), "\\x%02X", sym);
+    else if (strchr(specials, sym)) snprintf(buf, sizeof(buf), "\\%c", sym);
+    else snprintf(buf, sizeof(buf), "%c", sym);
+    buffer_append(buffer, buf);
+}
+
+static void print_ranges(struct string_buffer *buffer, struct range *ranges, size_t num_ranges)
+{
+    static const char *specials = "\\[]^-";
+    for (size_t i = 0; i < num_ranges; ++i)
+    {
+        print_symbol(buffer, ranges[i].lo, specials);
+        if (ranges[i].hi == ranges[i].lo) continue;
+        if (ranges[i].hi > ranges[i].lo + 1) buffer_append(buffer, "-");
+        print_symbol(buffer, ranges[i].hi, specials);
+    }
+}
+
+static void print_class(struct string_buffer *buffer, struct node *node)
+{
+    if (class_count_symbols(node) == 1)
+    {
+        print_symbol(buffer, node->ranges[0].lo, "\\.|()[]{}*+?");
+        return;
+    }
+
+    struct node *wildcard = class_wildcard(BYTE_MAX);
+    int is_wildcard = node->num_ranges == wildcard->num_ranges &&
+        !memcmp(node->ranges, wildcard->ranges, node->num_ranges * sizeof(struct range));
+    node_free(wildcard);
+    if (is_wildcard)
+    {
+        buffer_append(buffer, ".");
+        return;
+    }
+
+    // classes covering most of the bytes are printed as their complement
+    int bytes_only = node->ranges[0].lo >= BYTE_MIN && node->ranges[node->num_ranges - 1].hi <= BYTE_MAX;
+    if (bytes_only && class_count_symbols(node) > (BYTE_MAX - BYTE_MIN + 1) / 2)
+    {
+        struct node *complement = node_new(NODE_CLASS);
+        complement->ranges = malloc(node->num_ranges * sizeof(struct range));
+        memcpy(complement->ranges, node->ranges, node->num_ranges * sizeof(struct range));
+        complement->num_ranges = node->num_ranges;
+        class_negate(complement, BYTE_MAX);
+
+        if (complement->num_ranges)
+        {
+            buffer_append(buffer, "[^");
+            print_ranges(buffer, complement->ranges, complement->num_ranges);
+            buffer_append(buffer, "]");
+            node_free(complement);
+            return;
+        }
+        node_free(complement);
+    }
+
+    buffer_append(buffer, "[");
+    print_ranges(buffer, node->ranges, node->num_ranges);
+    buffer_append(buffer, "]");
+}
+
+static void print_node(struct string_buffer *buffer, struct node *node, enum precedence precedence)
+{
+    char buf[48];
+    switch (node->type)
+    {
+    case NODE_EMPTY:
+        if (precedence >= PREC_REPEAT) buffer_append(buffer, "()");
+        break;
+    case NODE_CLASS:
+        print_class(buffer, node);
+        break;
+    case NODE_CONCAT:
+        if (precedence > PREC_CONCAT) buffer_append(buffer, "(");
+        for (size_t i = 0; i < node->num_children; ++i)
+            print_node(buffer, node->children[i], PREC_CONCAT);
+        if (precedence > PREC_CONCAT) buffer_append(buffer, ")");
+        break;
+    case NODE_UNION:
+        if (precedence > PREC_UNION) buffer_append(buffer, "(");
+        for (size_t i = 0; i < node->num_children; ++i)
+        {
+            if (i) buffer_append(buffer, "|");
+            print_node(buffer, node->children[i], PREC_UNION);
+        }
+        if (precedence > PREC_UNION) buffer_append(buffer, ")");
+        break;
+    case NODE_REPEAT:
+        if (precedence > PREC_REPEAT) buffer_append(buffer, "(");
+        print_node(buffer, node->children[0], PREC_ATOM);
+        if (node->min == 0 && node->max == REPEAT_INF) buffer_append(buffer, "*");
+        else if (node->min == 1 && node->max == REPEAT_INF) buffer_append(buffer, "+");
+        else if (node->min == 0 && node->max == 1) buffer_append(buffer, "?");
+        else if (node->min == node->max)
+        {
+            snprintf(buf, sizeof(buf), "{%lu}", node->min);
+            buffer_append(buffer, buf);
+        }
+        else if (node->max == REPEAT_INF)
+        {
+            snprintf(buf, sizeof(buf), "{%lu,}", node->min);
+            buffer_append(buffer, buf);
+        }
+        else
+        {
+            snprintf(buf, sizeof(buf), "{%lu,%lu}", node->min, node->max);
+            buffer_append(buffer, buf);
+        }
+        if (precedence > PREC_REPEAT) buffer_append(buffer, ")");
+        break;
+    }
+}
+
+char *regex_normalize(const char *pattern, int flags)
+{
+    struct node *node = parse(pattern, flags);
+    if (!node) return NULL;
+
+    struct string_buffer buffer = { malloc(32), 0, 32 };
+    buffer.data[0] = '\0';
+    print_node(&buffer, node, PREC_UNION);
+    node_free(node);
+    return buffer.data;
+}
@@ -4,6 +4,8 @@
 
 #include "debug.h"
 
+#include "utility/hash.h"
+
 #define DEFAULT_MAP_CAPACITY 32
 
 #define MAP_LOADFACTOR 0.5
@@ -28,14 +30,7 @@
 
 typedef uint64_t hash_t;
 
-typedef union
-{ 
-    void *ptr;
-    uint64_t val;
-} CVT;
-
-// random hash function
-#define HASH(ptr) ( (CVT){ptr}.val * 67 + 0x123456 );
+#define HASH(ptr) hash_ptr(ptr);
 
 struct key_value_pair { void *key, *value; };
 
@@ -46,12 +41,6 @@ struct ptr_map
     size_t size;
 };
 
-struct ptr_map_iterator
-{
-    PTR_MAP map; 
-    size_t idx;
-};
-
 PTR_MAP ptrmap_init()
 {
     PTR_MAP map = malloc(sizeof(struct ptr_map));
@@ -199,17 +188,22 @@ void * ptrmap_get(PTR_MAP map, void *key)
     }
 }
 
-PTR_MAP_ITERATOR ptrmap_iterator_init(PTR_MAP map)
+void ptrmap_iterator_begin(PTR_MAP_ITERATOR iterator, PTR_MAP map)
 {
-    PTR_MAP_ITERATOR iter = malloc(sizeof(struct ptr_map_iterator));
-    iter->map = map;
+    iterator->map = map;
     size_t pos = 0;
     while (pos < map->capacity)
     {
         if (HAS_PAIR(map->buffer, pos)) break;
         pos++;
     }
-    iter->idx = pos;
+    iterator->idx = pos;
+}
+
+PTR_MAP_ITERATOR ptrmap_iterator_init(PTR_MAP map)
+{
+    PTR_MAP_ITERATOR iter = malloc(sizeof(struct ptr_map_iterator));
+    ptrmap_iterator_begin(iter, map);
     return iter;
 }
 
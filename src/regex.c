@@ -0,0 +1,724 @@
+#include "regex/regex.h"
+
+#include "debug.h"
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdalign.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "automata/algorithm.h"
+#include "automata/frozen_dfa.h"
+#include "automata/bitset_nfa.h"
+
+// approximate size of an NSTATE together with its transition map and one transition set
+#define NSTATE_FOOTPRINT 448
+
+// DFAs estimated to be at most this large are built before the regex is returned
+#define PLAN_EAGER_DFA_STATES 1024
+// DFAs estimated to be larger than either limit are never built
+#define PLAN_MAX_DFA_STATES (1 << 16)
+#define PLAN_MAX_DFA_MEMORY (64ul << 20)
+
+// limits of the subset construction of automatically planned regexes, the estimate of
+// the DFA may be too low
+#define PLAN_CONSTRUCTION_MEMORY (256ul << 20)
+#define PLAN_CONSTRUCTION_MILLISECONDS 5000
+
+// NFAs with at least this many states are simulated as bitset NFAs, smaller ones have
+// too few active states for the union of whole rows to pay off
+#define PLAN_MIN_BITSET_STATES 64
+
+// scratch space of at most this many bytes is taken from the stack by regex_match
+#define MATCH_STACK_SCRATCH 4096
+
+// reasons behind a plan, a plan may have several
+enum plan_reason
+{
+    REASON_REQUESTED = 0x1,
+    REASON_LITERAL = 0x2,
+    REASON_SMALL_DFA = 0x4,
+    REASON_MEDIUM_DFA = 0x8,
+    REASON_LARGE_DFA = 0x10,
+    REASON_LOADED = 0x20,
+    REASON_LIMIT_EXCEEDED = 0x40
+};
+
+struct regex_plan
+{
+    enum regex_engine engine;
+    int reasons;
+    struct regex_analysis analysis;
+    size_t nfa_states;
+    // estimated memory of the automata in bytes
+    size_t nfa_memory;
+    size_t dfa_memory;
+    // outcome of the subset construction
+    SUBSET_STATUS construction;
+};
+
+struct regex
+{
+    atomic_size_t references;
+    int flags;
+    // the byte every input byte folds to, null if the input is matched as is
+    const unsigned char *fold;
+    // the DFA is used for matching once it is present, the bitset NFA or the NFA otherwise
+    NFA nfa;
+    BITSET_NFA bitset;
+    _Atomic(FROZEN_DFA) dfa;
+    size_t nfa_footprint;
+    struct regex_plan plan;
+
+    // state of the background promotion of a tiered regex
+    char *pattern;
+    pthread_mutex_t lock;
+    pthread_cond_t promoted;
+    int pending;
+};
+
+struct regex_stream
+{
+    REGEX regex;
+    // the engine in use when the stream was opened, exactly one of them is set
+    FROZEN_DFA dfa;
+    uint32_t state;
+    BITSET_NFA bitset;
+    // the two state vectors of a bitset NFA share one buffer
+    uint64_t *vectors, *active, *next;
+    NFA_SIM sim;
+
+    REGEX_MATCH_CALLBACK on_match;
+    void *context;
+    // number of bytes fed so far
+    size_t offset;
+    int started;
+    int stopped;
+    // no state is active, so no longer prefix can be matched
+    int dead;
+};
+
+// the input of case-insensitive regexes, uppercase ASCII letters fold to lowercase
+static unsigned char ascii_fold[256];
+static pthread_once_t ascii_fold_once = PTHREAD_ONCE_INIT;
+
+static void ascii_fold_init()
+{
+    for (size_t i = 0; i < 256; ++i)
+        ascii_fold[i] = i >= 'A' && i <= 'Z' ? i - 'A' + 'a' : i;
+}
+
+static const unsigned char *regex_fold(int flags)
+{
+    if (!(flags & REGEX_ICASE)) return NULL;
+    pthread_once(&ascii_fold_once, ascii_fold_init);
+    return ascii_fold;
+}
+
+static REGEX regex_create(int flags)
+{
+    REGEX regex = calloc(1, sizeof(struct regex));
+    atomic_init(&regex->references, 1);
+    atomic_init(&regex->dfa, NULL);
+    regex->flags = flags;
+    regex->fold = regex_fold(flags);
+    pthread_mutex_init(&regex->lock, NULL);
+    pthread_cond_init(&regex->promoted, NULL);
+    return regex;
+}
+
+/**
+ * determinizes and freezes an NFA. the construction of automatically planned regexes is
+ * limited, explicitly requested DFAs are always built.
+ */
+static FROZEN_DFA regex_determinize(NFA nfa, int flags, SUBSET_STATUS *status)
+{
+    struct subset_construction_options options = {
+        .max_states = PLAN_MAX_DFA_STATES,
+        .max_memory = PLAN_CONSTRUCTION_MEMORY,
+        .max_milliseconds = PLAN_CONSTRUCTION_MILLISECONDS
+    };
+    int limited = !(flags & (REGEX_TIERED | REGEX_DFA));
+
+    DFA dfa = subset_construction_limited(nfa, limited ? &options : NULL, status);
+    if (!dfa) return NULL;
+    // the folding of the input is built into the byte class map
+    FROZEN_DFA frozen = dfa_freeze_folded(dfa, regex_fold(flags));
+    dfa_free(dfa);
+    return frozen;
+}
+
+/**
+ * builds the DFA of a tiered regex in the background. the thread works on its own NFA
+ * since the NFA of the regex is simultaneously used for matching.
+ */
+static void *regex_promote(void *arg)
+{
+    REGEX regex = arg;
+    FROZEN_DFA dfa = NULL;
+    SUBSET_STATUS status = SUBSET_SUCCESS;
+
+    NFA_COMPONENT component = regex_parse(regex->pattern, regex->flags);
+    if (component)
+    {
+        NFA nfa = nfa_construct(component);
+        dfa = regex_determinize(nfa, regex->flags, &status);
+        nfa_free(nfa);
+    }
+
+    // matchers pick up the DFA with their next match
+    if (dfa) atomic_store_explicit(&regex->dfa, dfa, memory_order_release);
+    info("Promoted REGEX[%p] to FROZEN_DFA[%p].", regex, dfa);
+
+    pthread_mutex_lock(&regex->lock);
+    regex->plan.construction = status;
+    if (status != SUBSET_SUCCESS)
+    {
+        // keep matching with the NFA
+        regex->plan.engine = REGEX_ENGINE_NFA;
+        regex->plan.reasons |= REASON_LIMIT_EXCEEDED;
+    }
+    regex->pending = 0;
+    free(regex->pattern);
+    regex->pattern = NULL;
+    pthread_cond_broadcast(&regex->promoted);
+    pthread_mutex_unlock(&regex->lock);
+
+    regex_release(regex);
+    return NULL;
+}
+
+static void regex_start_promotion(REGEX regex, const char *pattern)
+{
+    pthread_t thread;
+    regex->pattern = strdup(pattern);
+    regex->pending = 1;
+
+    // the background thread holds a reference until it is done
+    regex_retain(regex);
+    if (pthread_create(&thread, NULL, regex_promote, regex))
+    {
+        // keep matching with the NFA
+        regex->pending = 0;
+        free(regex->pattern);
+        regex->pattern = NULL;
+        regex_release(regex);
+        return;
+    }
+    pthread_detach(thread);
+}
+
+/**
+ * chooses the engine of a pattern. small DFAs are built up front, DFAs which take a while
+ * to build are built in the background while the NFA matches, and DFAs which would blow
+ * up are never built at all. the compile flags override the choice.
+ */
+static void regex_plan(struct regex_plan *plan, struct regex_analysis *analysis, size_t nfa_states, int flags)
+{
+    memset(plan, 0, sizeof(struct regex_plan));
+    plan->analysis = *analysis;
+    plan->nfa_states = nfa_states;
+    plan->nfa_memory = nfa_states * NSTATE_FOOTPRINT;
+    plan->dfa_memory = analysis->dfa_memory;
+
+    if (flags & (REGEX_NFA | REGEX_TIERED | REGEX_DFA))
+    {
+        plan->reasons |= REASON_REQUESTED;
+        if (flags & REGEX_NFA) plan->engine = REGEX_ENGINE_NFA;
+        else if (flags & REGEX_TIERED) plan->engine = REGEX_ENGINE_TIERED;
+        else plan->engine = REGEX_ENGINE_DFA;
+        return;
+    }
+
+    if (analysis->is_literal)
+    {
+        plan->reasons |= REASON_LITERAL;
+        plan->engine = REGEX_ENGINE_DFA;
+    }
+    else if (analysis->dfa_states > PLAN_MAX_DFA_STATES || plan->dfa_memory > PLAN_MAX_DFA_MEMORY)
+    {
+        plan->reasons |= REASON_LARGE_DFA;
+        plan->engine = REGEX_ENGINE_NFA;
+    }
+    else if (analysis->dfa_states > PLAN_EAGER_DFA_STATES)
+    {
+        plan->reasons |= REASON_MEDIUM_DFA;
+        plan->engine = REGEX_ENGINE_TIERED;
+    }
+    else
+    {
+        plan->reasons |= REASON_SMALL_DFA;
+        plan->engine = REGEX_ENGINE_DFA;
+    }
+}
+
+REGEX regex_compile(const char *pattern, int flags)
+{
+    struct regex_analysis analysis;
+    if (regex_analyze(pattern, flags, &analysis)) return NULL;
+    NFA_COMPONENT component = regex_parse(pattern, flags);
+    if (!component) return NULL;
+
+    REGEX regex = regex_create(flags);
+    regex->nfa = nfa_construct(component);
+    regex_plan(&regex->plan, &analysis, nfa_count_states(regex->nfa), flags);
+
+    // once the promotion thread runs it owns the plan, the engine chosen here is kept apart
+    enum regex_engine engine = regex->plan.engine;
+    switch (engine)
+    {
+    case REGEX_ENGINE_NFA:
+        break;
+    case REGEX_ENGINE_TIERED:
+        regex_start_promotion(regex, pattern);
+        break;
+    case REGEX_ENGINE_DFA:
+    {
+        FROZEN_DFA dfa = regex_determinize(regex->nfa, flags, &regex->plan.construction);
+        if (!dfa)
+        {
+            // the estimate was too low, keep matching with the NFA
+            engine = regex->plan.engine = REGEX_ENGINE_NFA;
+            regex->plan.reasons |= REASON_LIMIT_EXCEEDED;
+            break;
+        }
+        atomic_store_explicit(&regex->dfa, dfa, memory_order_relaxed);
+
+        // the frozen DFA is self-contained
+        nfa_free(regex->nfa);
+        regex->nfa = NULL;
+        break;
+    }
+    }
+
+    // medium NFAs are simulated on bit vectors, the bitset NFA is self-contained
+    if (engine == REGEX_ENGINE_NFA && regex->plan.nfa_states >= PLAN_MIN_BITSET_STATES)
+    {
+        regex->bitset = nfa_bitset_folded(regex->nfa, regex->fold);
+        if (regex->bitset)
+        {
+            nfa_free(regex->nfa);
+            regex->nfa = NULL;
+        }
+    }
+
+    if (regex->nfa) regex->nfa_footprint = regex->plan.nfa_memory;
+
+    info("Compiled \"%s\" into REGEX[%p] (%lu bytes).", pattern, regex, regex_footprint(regex));
+    return regex;
+}
+
+REGEX regex_retain(REGEX regex)
+{
+    atomic_fetch_add_explicit(&regex->references, 1, memory_order_relaxed);
+    return regex;
+}
+
+void regex_release(REGEX regex)
+{
+    if (!regex) return;
+    if (atomic_fetch_sub_explicit(&regex->references, 1, memory_order_acq_rel) != 1) return;
+
+    info("Destroying REGEX[%p].", regex);
+    FROZEN_DFA dfa = atomic_load_explicit(&regex->dfa, memory_order_acquire);
+    if (regex->nfa) nfa_free(regex->nfa);
+    if (regex->bitset) bitset_nfa_free(regex->bitset);
+    if (dfa) frozen_dfa_free(dfa);
+    pthread_mutex_destroy(&regex->lock);
+    pthread_cond_destroy(&regex->promoted);
+    free(regex);
+}
+
+int regex_flags(REGEX regex)
+{
+    return regex->flags;
+}
+
+size_t regex_footprint(REGEX regex)
+{
+    FROZEN_DFA dfa = atomic_load_explicit(&regex->dfa, memory_order_acquire);
+    size_t footprint = sizeof(struct regex) + regex->nfa_footprint;
+    if (regex->bitset) footprint += bitset_nfa_footprint(regex->bitset);
+    if (dfa) footprint += frozen_dfa_footprint(dfa);
+    return footprint;
+}
+
+int regex_wait_promotion(REGEX regex)
+{
+    pthread_mutex_lock(&regex->lock);
+    while (regex->pending)
+        pthread_cond_wait(&regex->promoted, &regex->lock);
+    pthread_mutex_unlock(&regex->lock);
+    return atomic_load_explicit(&regex->dfa, memory_order_acquire) != NULL;
+}
+
+size_t regex_scratch_size(REGEX regex)
+{
+    // the NFA of a tiered regex is kept, so the size never shrinks below what matching needs
+    return regex->nfa ? nfa_sim_scratch_size(regex->nfa) : 0;
+}
+
+int regex_match_scratch(REGEX regex, const char *string, void *scratch, size_t size)
+{
+    const unsigned char *cursor = (const unsigned char*) string;
+
+    // the frozen DFA returns as soon as the outcome is decided
+    FROZEN_DFA dfa = atomic_load_explicit(&regex->dfa, memory_order_acquire);
+    if (dfa) return frozen_dfa_accept_cstr(dfa, (char*) string);
+
+    // the state vectors of a bitset NFA always fit on the stack
+    if (regex->bitset) return bitset_nfa_accept_cstr(regex->bitset, string);
+
+    NFA_SIM sim = nfa_sim_init_scratch(regex->nfa, scratch, size);
+    if (!sim) return -1;
+    if (regex->fold)
+    {
+        while (*cursor)
+            nfa_sim_step(sim, regex->fold[*cursor++]);
+    }
+    else
+    {
+        while (*cursor)
+            nfa_sim_step(sim, *cursor++);
+    }
+    return nfa_sim_fini(sim) == SIM_SUCCESS;
+}
+
+int regex_match(REGEX regex, const char *string)
+{
+    // small simulators live on the stack, larger ones get their scratch space from the heap
+    alignas(max_align_t) unsigned char stack[MATCH_STACK_SCRATCH];
+    size_t size = regex_scratch_size(regex);
+    if (size <= sizeof(stack)) return regex_match_scratch(regex, string, stack, sizeof(stack));
+
+    void *scratch = aligned_alloc(alignof(max_align_t), (size + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1));
+    int result = regex_match_scratch(regex, string, scratch, size);
+    free(scratch);
+    return result;
+}
+
+int regex_match_bytes(REGEX regex, const void *data, size_t length)
+{
+    const uint8_t *bytes = data;
+    FROZEN_DFA dfa = atomic_load_explicit(&regex->dfa, memory_order_acquire);
+    if (dfa) return frozen_dfa_accept_u8(dfa, bytes, length);
+    if (regex->bitset) return bitset_nfa_accept_u8(regex->bitset, bytes, length);
+
+    alignas(max_align_t) unsigned char stack[MATCH_STACK_SCRATCH];
+    NFA_SIM sim = nfa_sim_init_scratch(regex->nfa, stack, sizeof(stack));
+    if (!sim) sim = nfa_sim_init(regex->nfa);
+    if (regex->fold)
+    {
+        for (size_t i = 0; i < length; ++i)
+            nfa_sim_step(sim, regex->fold[bytes[i]]);
+    }
+    else
+    {
+        for (size_t i = 0; i < length; ++i)
+            nfa_sim_step(sim, bytes[i]);
+    }
+    return nfa_sim_fini(sim) == SIM_SUCCESS;
+}
+
+REGEX_STREAM regex_stream_open(REGEX regex, REGEX_MATCH_CALLBACK on_match, void *context)
+{
+    REGEX_STREAM stream = calloc(1, sizeof(struct regex_stream));
+    stream->regex = regex_retain(regex);
+    stream->on_match = on_match;
+    stream->context = context;
+
+    // a DFA promoted later is not picked up, the states of the engines are unrelated
+    stream->dfa = atomic_load_explicit(&regex->dfa, memory_order_acquire);
+    if (stream->dfa) stream->state = frozen_dfa_start(stream->dfa);
+    else if (regex->bitset)
+    {
+        stream->bitset = regex->bitset;
+        size_t words = bitset_nfa_words(regex->bitset);
+        stream->vectors = malloc(2 * words * sizeof(uint64_t));
+        stream->active = stream->vectors;
+        stream->next = stream->vectors + words;
+        bitset_nfa_start(regex->bitset, stream->active);
+    }
+    else stream->sim = nfa_sim_init(regex->nfa);
+
+    info("Opened REGEX_STREAM[%p] on REGEX[%p].", stream, regex);
+    return stream;
+}
+
+// determines if the input fed to a stream so far is matched
+static int stream_accepting(REGEX_STREAM stream)
+{
+    if (stream->dead) return 0;
+    if (stream->dfa) return frozen_dfa_is_accepting(stream->dfa, stream->state);
+    if (stream->bitset) return bitset_nfa_is_accepting(stream->bitset, stream->active);
+    return nfa_sim_status(stream->sim) == SIM_SUCCESS;
+}
+
+// reports a match to the callback of a stream, returns nonzero if the stream is stopped
+static int stream_report(REGEX_STREAM stream, size_t offset)
+{
+    if (stream->on_match && stream->on_match(offset, stream->context))
+    {
+        info("REGEX_STREAM[%p] stopped at offset %lu.", stream, offset);
+        stream->stopped = 1;
+    }
+    return stream->stopped;
+}
+
+// reports the empty prefix before the first byte is matched
+static int stream_start(REGEX_STREAM stream)
+{
+    if (stream->started) return 0;
+    stream->started = 1;
+    return stream_accepting(stream) && stream_report(stream, 0);
+}
+
+int regex_stream_feed(REGEX_STREAM stream, const void *data, size_t length)
+{
+    if (stream->stopped || stream_start(stream)) return 1;
+
+    const unsigned char *bytes = data;
+    size_t base = stream->offset;
+    stream->offset += length;
+    if (stream->dead) return 0;
+
+    if (stream->dfa)
+    {
+        uint32_t state = stream->state;
+        for (size_t i = 0; i < length; ++i)
+        {
+            state = frozen_dfa_step(stream->dfa, state, bytes[i]);
+            if (frozen_dfa_is_dead(stream->dfa, state))
+            {
+                stream->dead = 1;
+                break;
+            }
+            if (frozen_dfa_is_accepting(stream->dfa, state) && stream_report(stream, base + i + 1)) break;
+        }
+        stream->state = state;
+    }
+    else if (stream->bitset)
+    {
+        for (size_t i = 0; i < length; ++i)
+        {
+            int alive = bitset_nfa_step(stream->bitset, stream->active, stream->next, bytes[i]);
+            uint64_t *tmp = stream->active;
+            stream->active = stream->next;
+            stream->next = tmp;
+            if (!alive)
+            {
+                stream->dead = 1;
+                break;
+            }
+            if (bitset_nfa_is_accepting(stream->bitset, stream->active) && stream_report(stream, base + i + 1)) break;
+        }
+    }
+    else
+    {
+        const unsigned char *fold = stream->regex->fold;
+        for (size_t i = 0; i < length; ++i)
+        {
+            nfa_sim_step(stream->sim, fold ? fold[bytes[i]] : bytes[i]);
+            if (nfa_sim_status(stream->sim) == SIM_SUCCESS && stream_report(stream, base + i + 1)) break;
+        }
+    }
+    return stream->stopped;
+}
+
+void regex_stream_discard(REGEX_STREAM stream)
+{
+    info("Discarding REGEX_STREAM[%p] after %lu bytes.", stream, stream->offset);
+    if (stream->sim) nfa_sim_fini(stream->sim);
+    free(stream->vectors);
+    regex_release(stream->regex);
+    free(stream);
+}
+
+int regex_stream_close(REGEX_STREAM stream)
+{
+    // the empty input is only known to be complete now
+    int matched = !stream->stopped && !stream_start(stream) && stream_accepting(stream);
+    regex_stream_discard(stream);
+    return matched;
+}
+
+// the fingerprint of a DFA in a snapshot, the top bit holds whether the stream was started
+#define SNAPSHOT_STARTED 0x80000000u
+
+static void store_le(unsigned char *buffer, uint64_t value, size_t size)
+{
+    for (size_t i = 0; i < size; ++i)
+        buffer[i] = value >> (8 * i);
+}
+
+static uint64_t load_le(const unsigned char *buffer, size_t size)
+{
+    uint64_t value = 0;
+    for (size_t i = 0; i < size; ++i)
+        value |= (uint64_t) buffer[i] << (8 * i);
+    return value;
+}
+
+static uint32_t snapshot_fingerprint(FROZEN_DFA dfa)
+{
+    return frozen_dfa_checksum(dfa) & ~SNAPSHOT_STARTED;
+}
+
+int regex_stream_snapshot(REGEX_STREAM stream, void *buffer)
+{
+    if (!stream->dfa || stream->stopped) return -1;
+
+    unsigned char *bytes = buffer;
+    store_le(bytes, stream->state, 4);
+    store_le(bytes + 4, snapshot_fingerprint(stream->dfa) | (stream->started ? SNAPSHOT_STARTED : 0), 4);
+    store_le(bytes + 8, stream->offset, 8);
+    return 0;
+}
+
+REGEX_STREAM regex_stream_restore(REGEX regex, const void *buffer, REGEX_MATCH_CALLBACK on_match, void *context)
+{
+    FROZEN_DFA dfa = atomic_load_explicit(&regex->dfa, memory_order_acquire);
+    if (!dfa) return NULL;
+
+    const unsigned char *bytes = buffer;
+    uint32_t state = load_le(bytes, 4);
+    uint32_t tag = load_le(bytes + 4, 4);
+    if ((tag & ~SNAPSHOT_STARTED) != snapshot_fingerprint(dfa) || state >= frozen_dfa_count_states(dfa))
+    {
+        info("Rejected a snapshot of another DFA for REGEX[%p].", regex);
+        return NULL;
+    }
+
+    REGEX_STREAM stream = regex_stream_open(regex, on_match, context);
+    stream->state = state;
+    stream->offset = load_le(bytes + 8, 8);
+    stream->started = (tag & SNAPSHOT_STARTED) != 0;
+    stream->dead = frozen_dfa_is_dead(dfa, state) != 0;
+    return stream;
+}
+
+int regex_save(REGEX regex, const char *filename)
+{
+    FROZEN_DFA dfa = atomic_load_explicit(&regex->dfa, memory_order_acquire);
+    if (!dfa) return -1;
+    return frozen_dfa_save(dfa, filename);
+}
+
+REGEX regex_load(const char *filename, int flags)
+{
+    if (flags & REGEX_NFA) return NULL;
+    FROZEN_DFA dfa = dfa_load_mmap(filename);
+    if (!dfa) return NULL;
+
+    REGEX regex = regex_create(flags);
+    atomic_store_explicit(&regex->dfa, dfa, memory_order_relaxed);
+    regex->plan.engine = REGEX_ENGINE_DFA;
+    regex->plan.reasons = REASON_LOADED;
+    regex->plan.dfa_memory = frozen_dfa_footprint(dfa);
+
+    info("Loaded \"%s\" into REGEX[%p] (%lu bytes).", filename, regex, regex_footprint(regex));
+    return regex;
+}
+
+enum regex_engine regex_engine(REGEX regex)
+{
+    // the promotion of a tiered regex may fall back to the NFA
+    pthread_mutex_lock(&regex->lock);
+    enum regex_engine engine = regex->plan.engine;
+    pthread_mutex_unlock(&regex->lock);
+    return engine;
+}
+
+FROZEN_DFA regex_dfa(REGEX regex)
+{
+    return atomic_load_explicit(&regex->dfa, memory_order_acquire);
+}
+
+static const char *construction_limit(SUBSET_STATUS status)
+{
+    switch (status)
+    {
+    case SUBSET_STATE_LIMIT: return "state";
+    case SUBSET_MEMORY_LIMIT: return "memory";
+    case SUBSET_TIME_LIMIT: return "time";
+    default: return "no";
+    }
+}
+
+static const char *engine_name(enum regex_engine engine)
+{
+    switch (engine)
+    {
+    case REGEX_ENGINE_NFA: return "nfa";
+    case REGEX_ENGINE_DFA: return "dfa";
+    case REGEX_ENGINE_TIERED: return "tiered";
+    }
+    return "unknown";
+}
+
+// appends formatted text to a dynamically allocated string
+static void explain_append(char **text, size_t *size, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+
+    *text = realloc(*text, *size + length + 1);
+    va_start(args, format);
+    vsnprintf(*text + *size, length + 1, format, args);
+    va_end(args);
+    *size += length;
+}
+
+char *regex_explain(REGEX regex)
+{
+    pthread_mutex_lock(&regex->lock);
+    struct regex_plan copy = regex->plan, *plan = &copy;
+    pthread_mutex_unlock(&regex->lock);
+    char *text = NULL;
+    size_t size = 0;
+
+    explain_append(&text, &size, "engine: %s\n", engine_name(plan->engine));
+    if (plan->reasons & REASON_REQUESTED)
+        explain_append(&text, &size, "reason: the engine was requested by the compile flags\n");
+    if (plan->reasons & REASON_LITERAL)
+        explain_append(&text, &size, "reason: the pattern is a literal of %lu bytes, its DFA is linear\n",
+            plan->analysis.literal_length);
+    if (plan->reasons & REASON_SMALL_DFA)
+        explain_append(&text, &size, "reason: the estimated DFA of %lu states is small enough to build up front\n",
+            plan->analysis.dfa_states);
+    if (plan->reasons & REASON_MEDIUM_DFA)
+        explain_append(&text, &size, "reason: the estimated DFA of %lu states is built in the background "
+            "while the NFA matches\n", plan->analysis.dfa_states);
+    if (plan->reasons & REASON_LARGE_DFA)
+        explain_append(&text, &size, "reason: the estimated DFA of %lu states exceeds the limit of %d states "
+            "or %lu bytes\n", plan->analysis.dfa_states, PLAN_MAX_DFA_STATES, PLAN_MAX_DFA_MEMORY);
+    if (plan->reasons & REASON_LIMIT_EXCEEDED)
+        explain_append(&text, &size, "reason: the DFA construction exceeded the %s limit, "
+            "the NFA is used instead\n", construction_limit(plan->construction));
+    if (plan->reasons & REASON_LOADED)
+    {
+        explain_append(&text, &size, "reason: the DFA was loaded from a file\n");
+        explain_append(&text, &size, "dfa: %lu bytes\n", plan->dfa_memory);
+    }
+    else
+    {
+        explain_append(&text, &size, "analysis: %lu positions, %lu ambiguous, %lu symbol classes, %s\n",
+            plan->analysis.positions, plan->analysis.ambiguous_positions, plan->analysis.symbol_classes,
+            plan->analysis.is_literal ? "literal" : "not literal");
+        explain_append(&text, &size, "nfa: %lu states, %lu bytes estimated\n", plan->nfa_states, plan->nfa_memory);
+        if (regex->bitset)
+            explain_append(&text, &size, "nfa: simulated as a bitset of %lu states and %lu symbol classes, %lu bytes\n",
+                bitset_nfa_count_bits(regex->bitset), bitset_nfa_count_classes(regex->bitset),
+                bitset_nfa_footprint(regex->bitset));
+        explain_append(&text, &size, "dfa: %lu states, %lu bytes estimated\n",
+            plan->analysis.dfa_states, plan->dfa_memory);
+    }
+    explain_append(&text, &size, "captures: none, every engine reports whole matches only\n");
+    explain_append(&text, &size, "memory: %lu bytes in use\n", regex_footprint(regex));
+    return text;
+}
@@ -1,4 +1,6 @@
 #include "utility/set.h"
+#include "utility/arena.h"
+#include "utility/hash.h"
 
 #ifdef DEBUG
     #undef DEBUG
@@ -9,55 +11,96 @@
 #include <stdint.h>
 #include <string.h>
 
-// reasonable default set size
-#define DEFAULT_SET_CAPACITY 32
+/**
+ * the elements of a set are stored densely, so they can be handed out as a borrowed view
+ * and iterated without skipping empty slots. small sets are searched linearly. once a set
+ * outgrows the linear search, it is indexed by an open addressing hash table with robin
+ * hood probing, whose slots hold the position of an element in the dense array together
+ * with the low bits of its hash. an element which is further away from its home slot
+ * takes the slot of an element closer to its own, which keeps the probe sequences short
+ * and allows a lookup to stop as soon as it passes the distance of the current slot.
+ * slots are removed by shifting their successors back, so there are no tombstones.
+ */
 
-#define SET_LOADFACTOR 0.5
+// largest set which is searched linearly
+#define SET_LINEAR_LIMIT 8
 
-#define REACHED_THRESHOLD(set) ((size_t) ((set)->capacity * SET_LOADFACTOR) == (set)->size)
+// initial number of elements a set has room for
+#define DEFAULT_SET_ROOM 4
 
-// magic number for the tombstone. should be 0xFFFFFF
-#define TOMBSTONE ((void*) -1)
-#define HAS_VALUE(buf, pos) ((buf)[pos] != NULL && (buf)[pos] != TOMBSTONE)
+// the capacity of the index is always a power of two and at most 3/4 of the slots are used
+#define FITS(count, capacity) (4 * (count) <= 3 * (capacity))
 
-typedef uint64_t hash_t;
+#define IS_INDEXED(set) ((set)->capacity != 0)
 
-typedef union {
-    void * ptr;
-    hash_t val;
-} CVT;
-
-// random hash function
-#define HASH(ptr) ((CVT){ ptr }.val * 67 + 0x123456)
+struct slot
+{
+    // the low bits of the hash of the element
+    uint32_t hash;
+    // the position of the element in the dense array plus one, zero if the slot is empty
+    uint32_t position;
+};
 
 struct set
 {
-    void **buffer;
+    void **values;
+    size_t size;
+    // number of elements the dense array has room for
+    size_t room;
+    // the hash table indexing the values, null while the set is searched linearly
+    struct slot *index;
     size_t capacity;
-    size_t size; 
+    // the arena the set is allocated from, null if it is allocated from the heap
+    ARENA arena;
 };
 
-struct set_iterator
+static inline uint32_t hash(void *ptr)
 {
-    SET set;
-    size_t idx;
-};
+    return (uint32_t) hash_ptr(ptr);
+}
+
+// the number of slots between the home slot of an entry and its position
+static inline size_t probe_distance(uint32_t h, size_t pos, size_t mask)
+{
+    return (pos - (h & mask)) & mask;
+}
 
+static void *buffer_alloc(ARENA arena, size_t count, size_t size)
+{
+    if (arena) return arena_calloc(arena, count, size);
+    return calloc(count, size);
+}
+
+static void buffer_free(SET set, void *buffer)
+{
+    if (!set->arena) free(buffer);
+}
 
 SET set_init()
 {
-    SET set = malloc(sizeof(struct set));
-    set->capacity = DEFAULT_SET_CAPACITY;
+    return set_init_arena(NULL);
+}
+
+SET set_init_arena(ARENA arena)
+{
+    SET set = arena ? arena_alloc(arena, sizeof(struct set)) : malloc(sizeof(struct set));
+    set->arena = arena;
     set->size = 0;
-    set->buffer = calloc(set->capacity, sizeof(void*));  
+    set->room = DEFAULT_SET_ROOM;
+    set->values = buffer_alloc(arena, set->room, sizeof(void*));
+    set->index = NULL;
+    set->capacity = 0;
     info("Set[%p] initialized.", set);
-    return set; 
+    return set;
 }
 
 void set_fini(SET set)
 {
     info("Set[%p] destroyed.", set);
-    free(set->buffer);
+    // the memory of arena sets is released with the arena
+    if (set->arena) return;
+    free(set->values);
+    free(set->index);
     free(set);
 }
 
@@ -67,146 +110,182 @@ size_t set_size(SET set)
     return set->size;
 }
 
-int set_contains(SET set, void *ptr)
+void * const *set_view(SET set)
 {
-    info("Searching for %p in Set[%p].", ptr, set);
-    size_t init_pos, pos;
-    hash_t p_hash = HASH(ptr);
+    return set->values;
+}
 
-    pos = init_pos = p_hash % set->capacity;
-    while (1)
+// finds the slot of the index referring to a pointer, returns the capacity if there is none
+static size_t set_find_slot(SET set, void *ptr, uint32_t h)
+{
+    size_t mask = set->capacity - 1;
+    size_t pos = h & mask;
+    for (size_t distance = 0; ; ++distance)
     {
-        info("\tChecking index %lu which contains %p.", pos, set->buffer[pos]);
-        // if we run into a NULL ptr, then the set does not contain the ptr
-        if (!set->buffer[pos]) 
-        {
-            info("\tPointer %p is not in Set[%p].", ptr, set);
-            return 0;
-        }
+        struct slot slot = set->index[pos];
+        if (!slot.position) return set->capacity;
+        if (slot.hash == h && set->values[slot.position - 1] == ptr) return pos;
+        // the pointer would have displaced this entry
+        if (probe_distance(slot.hash, pos, mask) < distance) return set->capacity;
+        pos = (pos + 1) & mask;
+    }
+}
 
-        // return nonzero if the ptr is found in the set 
-        if (set->buffer[pos] == ptr) 
-        {
-            info("\tPointer %p is in Set[%p].", ptr, set);
-            return 1; 
-        }
+// finds the position of a pointer in the dense array, returns the size if it is not in the set
+static size_t set_find(SET set, void *ptr)
+{
+    if (!IS_INDEXED(set))
+    {
+        for (size_t i = 0; i < set->size; ++i)
+            if (set->values[i] == ptr) return i;
+        return set->size;
+    }
 
-        // we move the position forward and loop to the beginning of the buffer
-        // if necessary
-        pos = (pos + 1) % set->capacity; 
+    size_t slot = set_find_slot(set, ptr, hash(ptr));
+    return slot == set->capacity ? set->size : set->index[slot].position - 1;
+}
 
-        // if we have come back to our initial position, then the ptr is not 
-        // in the set
-        if (pos == init_pos) 
+int set_contains(SET set, void *ptr)
+{
+    info("Searching for %p in Set[%p].", ptr, set);
+    return set_find(set, ptr) != set->size;
+}
+
+// it is guaranteed that the entry is not in the index and there is an empty slot
+static void no_rehash_add_slot(struct slot *index, size_t capacity, struct slot entry)
+{
+    size_t mask = capacity - 1;
+    size_t pos = entry.hash & mask;
+    size_t distance = 0;
+    while (index[pos].position)
+    {
+        size_t other = probe_distance(index[pos].hash, pos, mask);
+        if (other < distance)
         {
-            info("\tPointer %p is not in Set[%p].", ptr, set);
-            return 0;
+            // the entry takes the slot of the closer one, which moves on
+            struct slot displaced = index[pos];
+            index[pos] = entry;
+            entry = displaced;
+            distance = other;
         }
+        pos = (pos + 1) & mask;
+        distance++;
     }
+    index[pos] = entry;
 }
 
-// it is guaranteed that the buf does not need to be resized, i.e. there is
-// an empty slot in the buffer for the element that is being added
-static void no_rehash_add_elem(void **buf, size_t buf_size, void *elem)
+static void reindex(SET set, size_t new_capacity)
 {
-    hash_t elem_hash = HASH(elem);
-    size_t pos = elem_hash % buf_size;
-    
-    // find a TOMBSTONE or NULL
-    while (HAS_VALUE(buf, pos)) 
+    info("Set[%p] rehashed.", set);
+    struct slot *new_index = buffer_alloc(set->arena, new_capacity, sizeof(struct slot));
+    for (size_t i = 0; i < set->size; ++i)
     {
-        ++pos;
-        if (pos == buf_size) pos = 0;
+        struct slot entry = { hash(set->values[i]), i + 1 };
+        no_rehash_add_slot(new_index, new_capacity, entry);
     }
-    buf[pos] = elem;
-    info("\tPointer %p inserted into index %lu.", elem, pos);
+
+    buffer_free(set, set->index);
+    set->index = new_index;
+    set->capacity = new_capacity;
 }
 
-// if size reaches the capacity, we need to increase the capacity of the set 
-// and rehash its entries
-static void rehash(SET set)
+// makes room for a number of elements without any further reallocation
+static void set_reserve(SET set, size_t count)
 {
-    info("Set[%p] rehashed.", set);
-    size_t new_capacity;
+    if (count > set->room)
+    {
+        size_t room = set->room;
+        while (room < count) room *= 2;
+        void **values = buffer_alloc(set->arena, room, sizeof(void*));
+        memcpy(values, set->values, set->size * sizeof(void*));
+        buffer_free(set, set->values);
+        set->values = values;
+        set->room = room;
+    }
+
+    if (count <= SET_LINEAR_LIMIT || (IS_INDEXED(set) && FITS(count, set->capacity))) return;
 
-    // double the capacity
-    new_capacity = set->capacity * 2;
-    void **new_buffer = calloc(new_capacity, sizeof(void*));
+    size_t capacity = IS_INDEXED(set) ? set->capacity : 2 * SET_LINEAR_LIMIT;
+    while (!FITS(count, capacity)) capacity *= 2;
+    reindex(set, capacity);
+}
 
-    for (size_t i = 0; i < set->capacity; ++i)
+// appends a pointer which is not in the set, there must be room for it
+static void set_append(SET set, void *ptr)
+{
+    set->values[set->size] = ptr;
+    set->size++;
+    if (IS_INDEXED(set))
     {
-        if (HAS_VALUE(set->buffer, i)) 
-            no_rehash_add_elem(new_buffer, new_capacity, set->buffer[i]);
+        struct slot entry = { hash(ptr), set->size };
+        no_rehash_add_slot(set->index, set->capacity, entry);
     }
-
-    set->capacity = new_capacity;
-    free(set->buffer);
-    set->buffer = new_buffer;
+    info("\tPointer %p inserted into position %lu.", ptr, set->size - 1);
 }
 
 int set_add(SET set, void *ptr)
 {
     info("Attempting to add %p to Set[%p].", ptr, set);
     // we cannot add duplicate elements in the set
-    if (set_contains(set, ptr)) 
+    if (set_contains(set, ptr))
     {
         info("Failed to add %p to Set[%p] (ptr in set already).", ptr, set);
         return -1;
     }
 
-    if (REACHED_THRESHOLD(set)) rehash(set);
-
-    // add the element to the buffer
-    no_rehash_add_elem(set->buffer, set->capacity, ptr);
-    set->size++;
+    set_reserve(set, set->size + 1);
+    set_append(set, ptr);
     info("Successfully added %p to Set[%p].", ptr, set);
     return 0;
 }
 
-int set_remove(SET set, void *ptr)
+// removes the slot at a position by shifting the following displaced slots back
+static void index_remove_at(SET set, size_t pos)
 {
-    info("Attempting to remove %p to Set[%p].", ptr, set);
-    size_t init_pos, pos;
-    hash_t p_hash = HASH(ptr);
-
-    pos = init_pos = p_hash % set->capacity;
-    while (1)
+    size_t mask = set->capacity - 1;
+    size_t next = (pos + 1) & mask;
+    while (set->index[next].position && probe_distance(set->index[next].hash, next, mask) != 0)
     {
-        // if we run into a NULL ptr, then the set does not contain the ptr
-        if (!set->buffer[pos]) 
-        {
-            info("Failed to remove %p from Set[%p] (ptr not in set).", ptr, set);
-            return -1;
-        }
-
-        // return nonzero if the ptr is found in the set 
-        if (set->buffer[pos] == ptr) 
-        {
-            // make it a tombstone
-            set->buffer[pos] = TOMBSTONE;
-            set->size--;
-            info("Successfully removed %p from Set[%p].", ptr, set);
-            return 0; 
-        }
+        set->index[pos] = set->index[next];
+        pos = next;
+        next = (next + 1) & mask;
+    }
+    set->index[pos] = (struct slot){ 0, 0 };
+}
 
-        // we move the position forward and loop to the beginning of the buffer
-        // if necessary
-        pos = (pos + 1) % set->capacity; 
+// removes the element at a position of the dense array, the last element takes its place
+static void set_remove_at(SET set, size_t position)
+{
+    void *last = set->values[set->size - 1];
+    if (IS_INDEXED(set))
+    {
+        index_remove_at(set, set_find_slot(set, set->values[position], hash(set->values[position])));
+        if (position != set->size - 1)
+            set->index[set_find_slot(set, last, hash(last))].position = position + 1;
+    }
+    set->values[position] = last;
+    set->size--;
+}
 
-        // if we have come back to our initial position, then the ptr is not 
-        // in the set
-        if (pos == init_pos) 
-        {
-            info("Failed to remove %p from Set[%p] (ptr not in set).", ptr, set);
-            return -1;
-        }
+int set_remove(SET set, void *ptr)
+{
+    info("Attempting to remove %p to Set[%p].", ptr, set);
+    size_t position = set_find(set, ptr);
+    if (position == set->size)
+    {
+        info("Failed to remove %p from Set[%p] (ptr not in set).", ptr, set);
+        return -1;
     }
+
+    set_remove_at(set, position);
+    info("Successfully removed %p from Set[%p].", ptr, set);
+    return 0;
 }
 
 void set_clear(SET set)
 {
-    // set all the data to zero except the capacity
-    memset(set->buffer, 0, set->capacity * sizeof(void*));
+    // keep the memory, the set is likely to be filled again
+    if (IS_INDEXED(set)) memset(set->index, 0, set->capacity * sizeof(struct slot));
     set->size = 0;
     info("Cleared Set[%p].", set);
 }
@@ -214,70 +293,76 @@ void set_clear(SET set)
 void **set_values(SET set)
 {
     void **values = malloc(set->size * sizeof(void*));
-    size_t i = 0;
-    SET_ITERATOR iter = set_iterator_init(set);
-    while (set_iterator_has_next(iter))
-        values[i++] = set_iterator_next(iter);
-    set_iterator_fini(iter);
+    memcpy(values, set->values, set->size * sizeof(void*));
     return values;
 }
 
-SET set_union(SET A, SET B)
+int set_union_with(SET A, SET B)
 {
-    SET set_union = set_init();
-    
-    for (size_t i = 0; i < A->capacity; ++i)
+    if (A == B) return 0;
+
+    // at most every element of B is added
+    set_reserve(A, A->size + B->size);
+    for (size_t i = 0; i < B->size; ++i)
     {
-        if (HAS_VALUE(A->buffer, i))
-            set_add(set_union, A->buffer[i]);
+        if (set_find(A, B->values[i]) == A->size)
+            set_append(A, B->values[i]);
     }
+    return 0;
+}
+
+int set_intersect_with(SET A, SET B)
+{
+    if (A == B) return 0;
 
-    for (size_t i = 0; i < B->capacity; ++i)
+    // walk backwards, so the last element moved into a removed position was already checked
+    for (size_t i = A->size; i-- > 0;)
     {
-        if (HAS_VALUE(B->buffer, i))
-            set_add(set_union, B->buffer[i]);
+        if (!set_contains(B, A->values[i]))
+            set_remove_at(A, i);
     }
+    return 0;
+}
 
+SET set_union(SET A, SET B)
+{
+    SET set_union = set_init();
+    set_reserve(set_union, A->size + B->size);
+    set_union_with(set_union, A);
+    set_union_with(set_union, B);
     return set_union;
 }
 
 SET set_intersection(SET A, SET B)
 {
+    // only the smaller set is copied and then filtered
     SET set_intersection = set_init();
-
-    SET smaller_set = A, larger_set = B;
-    if (A->capacity > B->capacity)
+    if (A->size > B->size)
     {
-        smaller_set = B; 
-        larger_set = A;
+        SET tmp = A;
+        A = B;
+        B = tmp;
     }
-    
-    for (size_t i = 0; i < smaller_set->capacity; ++i)
-    {
-        if (HAS_VALUE(smaller_set->buffer, i) && 
-            set_contains(larger_set, smaller_set->buffer[i]))
-                set_add(set_intersection, smaller_set->buffer[i]);
-    }
-
+    set_union_with(set_intersection, A);
+    set_intersect_with(set_intersection, B);
     return set_intersection;
 }
 
 int is_subset(SET subset, SET superset)
 {
-    void *elem;
-    int is_subset = 1;
-    SET_ITERATOR iter = set_iterator_init(subset);
-    while (set_iterator_has_next(iter))
+    if (subset->size > superset->size) return 0;
+    for (size_t i = 0; i < subset->size; ++i)
     {
-        elem = set_iterator_next(iter);
-        if (!set_contains(superset, elem))
-        {
-            is_subset = 0;
-            break;
-        }
+        if (!set_contains(superset, subset->values[i]))
+            return 0;
     }
-    set_iterator_fini(iter);
-    return is_subset;
+    return 1;
+}
+
+void set_iterator_begin(SET_ITERATOR iterator, SET set)
+{
+    iterator->set = set;
+    iterator->idx = 0;
 }
 
 SET_ITERATOR set_iterator_init(SET set)
@@ -285,14 +370,7 @@ SET_ITERATOR set_iterator_init(SET set)
     if (!set) return NULL;
 
     SET_ITERATOR iter = malloc(sizeof(struct set_iterator));
-    iter->set = set; 
-    size_t pos = 0;
-    while (pos < set->capacity)
-    {
-        if (HAS_VALUE(set->buffer, pos)) break;
-        pos++;
-    }
-    iter->idx = pos;
+    set_iterator_begin(iter, set);
     return iter;
 }
 
@@ -303,22 +381,10 @@ void set_iterator_fini(SET_ITERATOR iterator)
 
 int set_iterator_has_next(SET_ITERATOR iterator)
 {
-    return iterator->idx != iterator->set->capacity;
+    return iterator->idx < iterator->set->size;
 }
 
 void *set_iterator_next(SET_ITERATOR iterator)
 {
-    SET set = iterator->set;
-    void *data = set->buffer[iterator->idx];
-
-    // find the index of the next elem or the end of the set
-    size_t pos = iterator->idx + 1;
-    while (pos < set->capacity)
-    {
-        if (HAS_VALUE(set->buffer, pos)) break;
-        ++pos;
-    }
-    iterator->idx = pos; 
-
-    return data;
-}
\ No newline at end of file
+    return iterator->set->values[iterator->idx++];
+}
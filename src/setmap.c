@@ -4,6 +4,8 @@
 
 #include "debug.h"
 
+#include "utility/hash.h"
+
 #define DEFAULT_MAP_CAPACITY 16
 
 #define MAP_LOADFACTOR 0.5
@@ -44,30 +46,12 @@ struct set_map
     size_t size;
 };
 
-struct set_map_iterator
-{
-    SET_MAP map;
-    size_t idx;
-};
-
-typedef union
-{ 
-    void *ptr;
-    uint64_t val;
-} CVT;
-#define INT(ptr) ((CVT){ptr}.val)
-
 hash_t set_hash(SET set)
 {
     hash_t hashes = 0;
-    void *ptr;
-    SET_ITERATOR iter = set_iterator_init(set);
-    while (set_iterator_has_next(iter))
-    {
-        ptr = set_iterator_next(iter);
-        hashes += INT(ptr);
-    }
-    set_iterator_fini(iter);
+    void * const *values = set_view(set);
+    for (size_t i = 0; i < set_size(set); ++i)
+        hashes += hash_ptr(values[i]);
     return hashes;
 }
 
@@ -216,17 +200,22 @@ void * setmap_get(SET_MAP map, SET key)
 }
 
 
-SET_MAP_ITERATOR setmap_iterator_init(SET_MAP map)
+void setmap_iterator_begin(SET_MAP_ITERATOR iterator, SET_MAP map)
 {
-    SET_MAP_ITERATOR iter = malloc(sizeof(struct set_map_iterator));
-    iter->map = map;
+    iterator->map = map;
     size_t pos = 0;
     while (pos < map->capacity)
     {
         if (HAS_PAIR(map->buffer, pos)) break;
         pos++;
     }
-    iter->idx = pos;
+    iterator->idx = pos;
+}
+
+SET_MAP_ITERATOR setmap_iterator_init(SET_MAP map)
+{
+    SET_MAP_ITERATOR iter = malloc(sizeof(struct set_map_iterator));
+    setmap_iterator_begin(iter, map);
     return iter;
 }
 
@@ -1,278 +1,356 @@
 #include "automata/algorithm.h"
 
 #include <stdint.h>
+#include <string.h>
+#include <time.h>
 
 #include "debug.h"
 
-#include "utility/set.h"
-#include "utility/stack.h"
-#include "utility/setmap.h"
+#include "utility/arena.h"
+#include "utility/hash.h"
+#include "utility/vector.h"
+#include "utility/hashmap.h"
 
-typedef union
-{
-    uint64_t val;
-    void *ptr;
-} CVT;
+// approximate sizes used to account for the memory of a construction
+#define DSTATE_FOOTPRINT 256
+#define SET_MEMBER_FOOTPRINT sizeof(uint32_t)
+#define TRANSITION_FOOTPRINT 32
 
-#define PTR(value) ((CVT){ value }.ptr)
-#define SYM(addr) ((SYMBOL) (CVT){.ptr=addr}.val)
+// the clock is only read once every so many DFA states
+#define CLOCK_INTERVAL 64
 
-typedef SET_MAP DSTATE_MAP;
+/**
+ * a set of NFA states is represented by the sorted ids of its states, so equal sets have
+ * equal representations and are compared with a single memcmp.
+ */
+struct id_set
+{
+    const uint32_t *ids;
+    uint32_t count;
+    uint32_t hash;
+};
 
-static DSTATE_MAP dstates_init()
+static inline uint32_t id_set_hash(struct id_set set)
 {
-    return setmap_init();
+    return set.hash;
 }
 
-// free all key sets, does not free the values which wll be DSTATES used to build
-// the DFA
-static void dstates_fini(DSTATE_MAP map)
+static inline int id_set_eq(struct id_set a, struct id_set b)
 {
-    SET key = NULL;
-    SET_MAP_ITERATOR iter = setmap_iterator_init(map);
-    while (setmap_iterator_has_next(iter))
-    {
-        setmap_iterator_next(iter, &key, NULL);
-        set_fini(key);
-    }
-    setmap_iterator_fini(iter);
-    setmap_fini(map);
+    return a.hash == b.hash && a.count == b.count && !memcmp(a.ids, b.ids, a.count * sizeof(uint32_t));
 }
 
-static int dstates_contains(DSTATE_MAP map, SET nstates)
+/**
+ * the symbols on which a set of states has transitions are split into elementary ranges:
+ * every transition, on a single symbol or on a range, starts at one boundary and ends
+ * before another, so all symbols between two neighbouring boundaries reach the same states.
+ * a boundary is recorded as an event which opens or closes a transition.
+ */
+struct boundary
 {
-    return setmap_contains(map, nstates);
-}
+    int64_t at;
+    int delta;
+};
 
-static void dstates_add(DSTATE_MAP map, SET nstates)
+// a DFA state whose transitions have not been computed yet
+struct unmarked_state
+{
+    struct id_set nstates;
+    DSTATE dstate;
+};
+
+DECLARE_VECTOR(ID_VECTOR, id_vector, uint32_t)
+DECLARE_VECTOR(DSTATE_VECTOR, dstate_vector, DSTATE)
+DECLARE_VECTOR(UNMARKED_STACK, unmarked_stack, struct unmarked_state)
+DECLARE_VECTOR(BOUNDARY_VECTOR, boundary_vector, struct boundary)
+DECLARE_VECTOR(RANGE_VECTOR, range_vector, struct symbol_range)
+DECLARE_HASH_MAP(DSTATE_TABLE, dstate_table, struct id_set, DSTATE, id_set_hash, id_set_eq)
+
+struct construction
+{
+    // the states of the NFA indexed by their ids
+    const NSTATE *states;
+    uint8_t *accepting;
+    // marks the states in the closure being computed
+    uint8_t *on;
+    ID_VECTOR closure;
+    ID_VECTOR stack;
+    BOUNDARY_VECTOR boundaries;
+    // the elementary ranges of the set being expanded
+    RANGE_VECTOR ranges;
+    // maps every set of NFA states found so far to its DFA state
+    DSTATE_TABLE dstates;
+    UNMARKED_STACK unmarked;
+    DSTATE_VECTOR dfa_accepting_states;
+    // the DSTATES are allocated from the arena, the arena is handed over to the DFA
+    ARENA arena;
+    // holds the ids of the sets of NFA states, released with the construction
+    ARENA id_arena;
+};
+
+static void construction_init(struct construction *c, NFA nfa)
 {
-    DSTATE dstate = dstate_new();
-    setmap_set(map, nstates, dstate);
+    size_t num_states = nfa_count_states(nfa);
+    c->states = nfa_view_states(nfa);
+    c->accepting = calloc(num_states, sizeof(uint8_t));
+    c->on = calloc(num_states, sizeof(uint8_t));
+
+    const NSTATE *accepting_states = nfa_view_accepting_states(nfa);
+    for (size_t i = 0; i < nfa_count_accepting_states(nfa); ++i)
+        c->accepting[nstate_id(accepting_states[i])] = 1;
+
+    id_vector_init(&c->closure);
+    id_vector_init(&c->stack);
+    boundary_vector_init(&c->boundaries);
+    range_vector_init(&c->ranges);
+    dstate_table_init(&c->dstates);
+    unmarked_stack_init(&c->unmarked);
+    dstate_vector_init(&c->dfa_accepting_states);
+    c->arena = arena_init();
+    c->id_arena = arena_init();
 }
 
-static DSTATE dstates_get(DSTATE_MAP map, SET nstates)
+// releases the scratch space, the arena of the DSTATES is not released
+static void construction_fini(struct construction *c)
 {
-    return setmap_get(map, nstates);
+    free(c->accepting);
+    free(c->on);
+    id_vector_fini(&c->closure);
+    id_vector_fini(&c->stack);
+    boundary_vector_fini(&c->boundaries);
+    range_vector_fini(&c->ranges);
+    dstate_table_fini(&c->dstates);
+    unmarked_stack_fini(&c->unmarked);
+    dstate_vector_fini(&c->dfa_accepting_states);
+    arena_fini(c->id_arena);
 }
 
-
-
-static SET make_set(NSTATE *states, size_t sz)
+static void closure_add(struct construction *c, NSTATE state)
 {
-    SET set = set_init();
-    for (size_t i = 0; i < sz; ++i)
-        set_add(set, states[i]);
-    return set;
+    uint32_t id = nstate_id(state);
+    if (c->on[id]) return;
+    c->on[id] = 1;
+    id_vector_push(&c->closure, id);
+    id_vector_push(&c->stack, id);
 }
 
-static SET set_clone(SET set)
+// extends the closure being computed to its epsilon closure
+static void epsilon_closure(struct construction *c)
 {
-    void *data;
-    SET copy = set_init();
-    SET_ITERATOR iter = set_iterator_init(set);
-    while (set_iterator_has_next(iter))
+    size_t count;
+    while (c->stack.size)
     {
-        data = set_iterator_next(iter);
-        set_add(copy, data);
+        uint32_t id = id_vector_pop(&c->stack);
+        const NSTATE *targets = nstate_view_transition_states(c->states[id], EPSILON, &count);
+        for (size_t i = 0; i < count; ++i)
+            closure_add(c, targets[i]);
     }
-    set_iterator_fini(iter);    
-
-    return copy;
 }
 
-static SET epsilon_closure_set(SET states)
+static int compare_ids(const void *a, const void *b)
 {
-    SET epsilon_closure = set_clone(states);
-    STACK stack = stack_init();
+    uint32_t x = *(const uint32_t*) a, y = *(const uint32_t*) b;
+    return (x > y) - (x < y);
+}
 
-    NSTATE start;
-    SET_ITERATOR iter = set_iterator_init(states);
+// brings the closure into its canonical form and clears the marks for the next closure
+static struct id_set closure_finish(struct construction *c)
+{
+    qsort(c->closure.data, c->closure.size, sizeof(uint32_t), compare_ids);
 
-    // push all elements in the set of states onto the stack
-    while (set_iterator_has_next(iter))
+    uint64_t hash = c->closure.size;
+    for (size_t i = 0; i < c->closure.size; ++i)
     {
-        start = set_iterator_next(iter);
-        stack_push(stack, start);
+        hash = hash_combine(hash, c->closure.data[i]);
+        c->on[c->closure.data[i]] = 0;
     }
-    set_iterator_fini(iter);
+    return (struct id_set){ c->closure.data, c->closure.size, (uint32_t) hash };
+}
 
-    void *state = NULL;
-    while (stack_size(stack) != 0)
+// creates the DFA state of a closure which was not found and accounts for its footprint
+static DSTATE dstates_add(struct construction *c, struct id_set closure, size_t *memory)
+{
+    uint32_t *ids = arena_alloc(c->id_arena, closure.count * sizeof(uint32_t) + 1);
+    memcpy(ids, closure.ids, closure.count * sizeof(uint32_t));
+    struct id_set key = { ids, closure.count, closure.hash };
+
+    DSTATE dstate = dstate_arena_new(c->arena);
+    dstate_table_set(&c->dstates, key, dstate);
+    unmarked_stack_push(&c->unmarked, (struct unmarked_state){ key, dstate });
+
+    // if the set has an accepting state in it, it is an accepting state in the DFA
+    for (size_t i = 0; i < key.count; ++i)
     {
-        stack_pop(stack, &state);
-        NSTATE *transition_states = nstate_get_transition_states(state, EPSILON);
-        size_t transition_states_sz = nstate_count_transition_states(state, EPSILON);
-        
-        for (size_t i = 0; i < transition_states_sz; ++i)
+        if (c->accepting[key.ids[i]])
         {
-            NSTATE to = transition_states[i];
-            if (!set_contains(epsilon_closure, to))
-            {
-                set_add(epsilon_closure, to);
-                stack_push(stack, to);
-            }
+            dstate_vector_push(&c->dfa_accepting_states, dstate);
+            break;
         }
-        free(transition_states);
     }
-    stack_fini(stack);
-    
-    return epsilon_closure;
+
+    *memory += DSTATE_FOOTPRINT + key.count * SET_MEMBER_FOOTPRINT;
+    return dstate;
 }
 
-static SET epsilon_closure_state(NSTATE state)
+static void add_boundaries(struct construction *c, SYMBOL lo, SYMBOL hi)
 {
-    SET self = set_init();
-    set_add(self, state);
-    SET epsilon_closure = epsilon_closure_set(self);
-    set_fini(self);
+    boundary_vector_push(&c->boundaries, (struct boundary){ lo, 1 });
+    boundary_vector_push(&c->boundaries, (struct boundary){ (int64_t) hi + 1, -1 });
+}
 
-    return epsilon_closure;
+static int compare_boundaries(const void *a, const void *b)
+{
+    const struct boundary *x = a, *y = b;
+    return (x->at > y->at) - (x->at < y->at);
 }
 
-static SET move(SET from_states, SYMBOL sym)
+// splits the symbols of the transitions out of a set of states into elementary ranges
+static void transition_ranges(struct construction *c, struct id_set nstates)
 {
-    SET target = set_init();
+    boundary_vector_clear(&c->boundaries);
+    range_vector_clear(&c->ranges);
 
-    NSTATE from;
-    SET_ITERATOR iter = set_iterator_init(from_states);
-    while (set_iterator_has_next(iter))
+    SYMBOL sym;
+    size_t count;
+    for (size_t i = 0; i < nstates.count; ++i)
     {
-        from = set_iterator_next(iter);
-
-        NSTATE *to_states = nstate_get_transition_states(from, sym);
-        size_t to_states_sz = nstate_count_transition_states(from, sym);
-        if (to_states)
+        NSTATE state = c->states[nstates.ids[i]];
+        struct nstate_transition_iterator iter;
+        nstate_transition_iterator_begin(&iter, state);
+        while (nstate_transition_iterator_next(&iter, &sym, NULL, NULL))
         {
-            for (size_t i = 0; i < to_states_sz; ++i)
-            {
-                NSTATE to = to_states[i];
-                set_add(target, to);
-            }
-            free(to_states);
+            if (sym != EPSILON)
+                add_boundaries(c, sym, sym);
         }
+
+        const struct nstate_range_transition *ranges = nstate_view_range_transitions(state, &count);
+        for (size_t j = 0; j < count; ++j)
+            add_boundaries(c, ranges[j].lo, ranges[j].hi);
     }
-    set_iterator_fini(iter);
 
-    return target;
+    qsort(c->boundaries.data, c->boundaries.size, sizeof(struct boundary), compare_boundaries);
+
+    // the symbols between two boundaries are covered if any transition is open
+    int open = 0;
+    for (size_t i = 0; i < c->boundaries.size; ++i)
+    {
+        open += c->boundaries.data[i].delta;
+        int64_t at = c->boundaries.data[i].at;
+        if (i + 1 == c->boundaries.size || c->boundaries.data[i + 1].at == at || !open) continue;
+        range_vector_push(&c->ranges, (struct symbol_range){ (SYMBOL) at, (SYMBOL) (c->boundaries.data[i + 1].at - 1) });
+    }
 }
 
-static SET nonepsilon_transition_symbols(SET states)
+// starts the closure of the states reached from a set of states on an elementary range
+static void move(struct construction *c, struct id_set from_states, struct symbol_range range)
 {
-    SET transition_symbols = set_init();
+    id_vector_clear(&c->closure);
 
-    SET_ITERATOR iter = set_iterator_init(states);
-    while (set_iterator_has_next(iter))
+    size_t count;
+    for (size_t i = 0; i < from_states.count; ++i)
     {
-        NSTATE state = set_iterator_next(iter);
-        SYMBOL *symbols = nstate_get_transition_symbols(state);
-        size_t symbol_sz = nstate_count_transition_symbols(state);
+        NSTATE state = c->states[from_states.ids[i]];
 
-        if (symbols)
+        // single symbols are boundaries on their own, so they only occur in ranges of one symbol
+        if (range.lo == range.hi)
         {
-            for (size_t i = 0; i < symbol_sz; ++i)
-            {
-                if (symbols[i] != EPSILON)
-                    set_add(transition_symbols, PTR(symbols[i]));
-            }
-            free(symbols);
+            const NSTATE *targets = nstate_view_transition_states(state, range.lo, &count);
+            for (size_t j = 0; j < count; ++j)
+                closure_add(c, targets[j]);
+        }
+
+        // an elementary range is either within a range transition or disjoint from it
+        const struct nstate_range_transition *ranges = nstate_view_range_transitions(state, &count);
+        for (size_t j = 0; j < count; ++j)
+        {
+            if (ranges[j].lo <= range.lo && range.hi <= ranges[j].hi)
+                closure_add(c, ranges[j].to);
         }
     }
-    set_iterator_fini(iter);
+}
 
-    return transition_symbols;
+static size_t elapsed_milliseconds(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000 + (now.tv_nsec - start->tv_nsec) / 1000000;
 }
 
-// returns if there is an intersection
-static int has_set_intersection(SET a, SET b)
+// checks the limits after a DFA state was added
+static SUBSET_STATUS check_limits(const struct subset_construction_options *options, size_t num_states,
+    size_t memory, const struct timespec *start)
 {
-    void *data;
-    SET_ITERATOR iter = set_iterator_init(a);
-    while (set_iterator_has_next(iter))
-    {
-        data = set_iterator_next(iter);
-        if (set_contains(b, data))
-        {
-            set_iterator_fini(iter);
-            return 1;
-        }
-    }
-    set_iterator_fini(iter);
-    return 0;
+    if (!options) return SUBSET_SUCCESS;
+    if (options->max_states && num_states > options->max_states) return SUBSET_STATE_LIMIT;
+    if (options->max_memory && memory > options->max_memory) return SUBSET_MEMORY_LIMIT;
+    if (options->max_milliseconds && num_states % CLOCK_INTERVAL == 0 &&
+        elapsed_milliseconds(start) > options->max_milliseconds) return SUBSET_TIME_LIMIT;
+    return SUBSET_SUCCESS;
 }
 
 DFA subset_construction(NFA nfa)
 {
-    DSTATE_MAP dstates = dstates_init();
-    SET dfa_accepting_states = set_init();
-
-    NSTATE nfa_starting_state = nfa_get_starting_state(nfa);
-    void *nfa_accepting_states_list = nfa_get_accepting_states(nfa);
-    SET nfa_accepting_states = make_set(nfa_accepting_states_list, nfa_count_accepting_states(nfa));
-    free(nfa_accepting_states_list);
-
-    // transfer ownership of the allocated memory to dstates
-    SET initial_states = epsilon_closure_state(nfa_starting_state);
-    dstates_add(dstates, initial_states);
-    
-    // stack of unmarked states that need to be processed
-    // every set pushed onto the stack should be in dstates
-    STACK unmarked_sets = stack_init();
-    stack_push(unmarked_sets, initial_states);
-    
-    SET T, U;
-    void *data = NULL;
-    SET_ITERATOR iter; 
-    while (stack_size(unmarked_sets) != 0)
+    return subset_construction_limited(nfa, NULL, NULL);
+}
+
+DFA subset_construction_limited(NFA nfa, const struct subset_construction_options *options, SUBSET_STATUS *status)
+{
+    SUBSET_STATUS result = SUBSET_SUCCESS;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    struct construction c;
+    construction_init(&c, nfa);
+
+    size_t memory = 0;
+    id_vector_clear(&c.closure);
+    closure_add(&c, nfa_get_starting_state(nfa));
+    epsilon_closure(&c);
+    DSTATE dfa_starting_state = dstates_add(&c, closure_finish(&c), &memory);
+    size_t num_states = 1;
+
+    while (result == SUBSET_SUCCESS && c.unmarked.size != 0)
     {
         // popping off the stack marks the set
-        stack_pop(unmarked_sets, &data);
-        T = data;
+        struct unmarked_state T = unmarked_stack_pop(&c.unmarked);
 
-        SET symbols = nonepsilon_transition_symbols(T);
-        
-        iter = set_iterator_init(symbols);
-        while (set_iterator_has_next(iter))
-        {
-            // extract the symbol
-            SYMBOL a = SYM(set_iterator_next(iter));
-
-            SET move_states = move(T, a);
-            U = epsilon_closure_set(move_states);
+        transition_ranges(&c, T.nstates);
 
-            int dstates_has = dstates_contains(dstates, U);
-            if (!dstates_has)
+        for (size_t i = 0; result == SUBSET_SUCCESS && i < c.ranges.size; ++i)
+        {
+            struct symbol_range a = c.ranges.data[i];
+            move(&c, T.nstates, a);
+            epsilon_closure(&c);
+            struct id_set U = closure_finish(&c);
+
+            DSTATE *found = dstate_table_get(&c.dstates, U);
+            DSTATE to = found ? *found : NULL;
+            if (!to)
             {
-                // transfer the ownership to dstates, we do not need to free
-                dstates_add(dstates, U);
-                // mark the set of states
-                stack_push(unmarked_sets, U);
-
-                // if U has an accepting state in it, it is an accepting state in the DFA
-                if (has_set_intersection(U, nfa_accepting_states))
-                    set_add(dfa_accepting_states, dstates_get(dstates, U));
-            } 
+                to = dstates_add(&c, U, &memory);
+                num_states++;
+                result = check_limits(options, num_states, memory, &start);
+            }
 
             // add transition
-            DSTATE from = dstates_get(dstates, T);
-            DSTATE to = dstates_get(dstates, U);
-            dstate_add_transition(from, a, to);
-
-            if (dstates_has) set_fini(U); // we create a set that can not be pushed onto DSTATES, we must free manually
-            set_fini(move_states);
+            dstate_add_range_transition(T.dstate, a.lo, a.hi, to);
+            memory += TRANSITION_FOOTPRINT;
         }
-        set_iterator_fini(iter);
-        set_fini(symbols);
     }
 
-    set_fini(nfa_accepting_states); // free the accepting states
-    stack_fini(unmarked_sets); // free stack of unmarked sets
+    if (status) *status = result;
 
-    void **dfa_accepting_states_list = set_values(dfa_accepting_states);
-    DFA dfa = dfa_new( dstates_get(dstates, initial_states), (DSTATE*) dfa_accepting_states_list, set_size(dfa_accepting_states) );
-    free(dfa_accepting_states_list);
+    if (result != SUBSET_SUCCESS)
+    {
+        info("Abandoned subset construction after %lu states and %lu bytes.", num_states, memory);
+        construction_fini(&c);
+        arena_fini(c.arena);
+        return NULL;
+    }
 
-    set_fini(dfa_accepting_states);
-    dstates_fini(dstates);
+    DFA dfa = dfa_new_arena(dfa_starting_state, c.dfa_accepting_states.data, c.dfa_accepting_states.size, c.arena);
+    if (!dfa) arena_fini(c.arena);
+    construction_fini(&c);
 
     return dfa;
-}
\ No newline at end of file
+}
@@ -0,0 +1,237 @@
+#include "regex/utf8.h"
+
+#include "debug.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "utility/vector.h"
+
+#define SURROGATE_MIN 0xD800
+#define SURROGATE_MAX 0xDFFF
+
+// the largest codepoint encoded in one, two and three bytes
+static const SYMBOL length_limits[] = { 0x7F, 0x7FF, 0xFFFF };
+
+// a sequence of byte ranges matching the encodings of a range of codepoints
+struct utf8_sequence
+{
+    struct symbol_range bytes[UTF8_MAX_LENGTH];
+    size_t length;
+};
+
+DECLARE_VECTOR(SEQUENCE_VECTOR, sequence_vector, struct utf8_sequence)
+
+size_t utf8_encode(SYMBOL codepoint, unsigned char *buffer)
+{
+    if (codepoint < 0 || codepoint > UTF8_MAX || (codepoint >= SURROGATE_MIN && codepoint <= SURROGATE_MAX)) return 0;
+
+    if (codepoint <= 0x7F)
+    {
+        buffer[0] = codepoint;
+        return 1;
+    }
+    if (codepoint <= 0x7FF)
+    {
+        buffer[0] = 0xC0 | (codepoint >> 6);
+        buffer[1] = 0x80 | (codepoint & 0x3F);
+        return 2;
+    }
+    if (codepoint <= 0xFFFF)
+    {
+        buffer[0] = 0xE0 | (codepoint >> 12);
+        buffer[1] = 0x80 | ((codepoint >> 6) & 0x3F);
+        buffer[2] = 0x80 | (codepoint & 0x3F);
+        return 3;
+    }
+    buffer[0] = 0xF0 | (codepoint >> 18);
+    buffer[1] = 0x80 | ((codepoint >> 12) & 0x3F);
+    buffer[2] = 0x80 | ((codepoint >> 6) & 0x3F);
+    buffer[3] = 0x80 | (codepoint & 0x3F);
+    return 4;
+}
+
+int utf8_decode(const char **cursor, SYMBOL *codepoint)
+{
+    const unsigned char *bytes = (const unsigned char*) *cursor;
+    size_t length;
+    SYMBOL value;
+
+    if (bytes[0] < 0x80)
+    {
+        length = 1;
+        value = bytes[0];
+    }
+    else if ((bytes[0] & 0xE0) == 0xC0)
+    {
+        length = 2;
+        value = bytes[0] & 0x1F;
+    }
+    else if ((bytes[0] & 0xF0) == 0xE0)
+    {
+        length = 3;
+        value = bytes[0] & 0x0F;
+    }
+    else if ((bytes[0] & 0xF8) == 0xF0)
+    {
+        length = 4;
+        value = bytes[0] & 0x07;
+    }
+    else return -1;
+
+    for (size_t i = 1; i < length; ++i)
+    {
+        // a terminator is no continuation byte, so truncated sequences stop here
+        if ((bytes[i] & 0xC0) != 0x80) return -1;
+        value = (value << 6) | (bytes[i] & 0x3F);
+    }
+
+    // the shortest encoding is the only valid one
+    unsigned char buffer[UTF8_MAX_LENGTH];
+    if (utf8_encode(value, buffer) != length) return -1;
+
+    *codepoint = value;
+    *cursor += length;
+    return 0;
+}
+
+/**
+ * splits a range of codepoints whose encodings have the same length into ranges whose
+ * encodings only differ in a suffix of full continuation bytes, and appends the byte
+ * ranges of each to the sequences.
+ */
+static void split_range(SEQUENCE_VECTOR *sequences, SYMBOL lo, SYMBOL hi)
+{
+    // the surrogates have no encoding
+    if (lo < SURROGATE_MIN && hi > SURROGATE_MAX)
+    {
+        split_range(sequences, lo, SURROGATE_MIN - 1);
+        split_range(sequences, SURROGATE_MAX + 1, hi);
+        return;
+    }
+    if (lo >= SURROGATE_MIN && lo <= SURROGATE_MAX) lo = SURROGATE_MAX + 1;
+    if (hi >= SURROGATE_MIN && hi <= SURROGATE_MAX) hi = SURROGATE_MIN - 1;
+    if (lo > hi) return;
+
+    for (size_t i = 0; i < sizeof(length_limits) / sizeof(length_limits[0]); ++i)
+    {
+        if (lo <= length_limits[i] && length_limits[i] < hi)
+        {
+            split_range(sequences, lo, length_limits[i]);
+            split_range(sequences, length_limits[i] + 1, hi);
+            return;
+        }
+    }
+
+    if (hi > 0x7F)
+    {
+        // the last i bytes of lo and hi must each cover all continuation bytes
+        for (int i = 1; i < UTF8_MAX_LENGTH; ++i)
+        {
+            SYMBOL mask = (1 << (6 * i)) - 1;
+            if ((lo & ~mask) == (hi & ~mask)) continue;
+            if (lo & mask)
+            {
+                split_range(sequences, lo, lo | mask);
+                split_range(sequences, (lo | mask) + 1, hi);
+                return;
+            }
+            if ((hi & mask) != mask)
+            {
+                split_range(sequences, lo, (hi & ~mask) - 1);
+                split_range(sequences, hi & ~mask, hi);
+                return;
+            }
+        }
+    }
+
+    unsigned char first[UTF8_MAX_LENGTH], last[UTF8_MAX_LENGTH];
+    struct utf8_sequence sequence;
+    sequence.length = utf8_encode(lo, first);
+    utf8_encode(hi, last);
+    for (size_t i = 0; i < sequence.length; ++i)
+        sequence.bytes[i] = (struct symbol_range){ first[i], last[i] };
+    sequence_vector_push(sequences, sequence);
+}
+
+static int range_eq(struct symbol_range a, struct symbol_range b)
+{
+    return a.lo == b.lo && a.hi == b.hi;
+}
+
+/**
+ * builds the union of the prefixes of sequences, the prefix of sequence i being its first
+ * lengths[i] byte ranges. sequences are grouped by the last byte range of their prefix,
+ * so the range is emitted once after the union of the shorter prefixes of the group.
+ * returns null if every prefix is empty.
+ */
+static NFA_COMPONENT share_suffixes(const struct utf8_sequence **sequences, const size_t *lengths, size_t count)
+{
+    const struct utf8_sequence **group = malloc(count * sizeof(struct utf8_sequence*) + 1);
+    size_t *group_lengths = malloc(count * sizeof(size_t) + 1);
+    uint8_t *grouped = calloc(count + 1, sizeof(uint8_t));
+
+    NFA_COMPONENT component = NULL;
+    int empty = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (grouped[i]) continue;
+        if (!lengths[i])
+        {
+            empty = 1;
+            continue;
+        }
+
+        struct symbol_range suffix = sequences[i]->bytes[lengths[i] - 1];
+        size_t group_size = 0;
+        for (size_t j = i; j < count; ++j)
+        {
+            if (grouped[j] || !lengths[j] || !range_eq(sequences[j]->bytes[lengths[j] - 1], suffix)) continue;
+            grouped[j] = 1;
+            group[group_size] = sequences[j];
+            group_lengths[group_size++] = lengths[j] - 1;
+        }
+
+        NFA_COMPONENT prefix = share_suffixes(group, group_lengths, group_size);
+        component = nfa_union(component, nfa_concat(prefix, nfa_ranges(&suffix, 1)));
+    }
+
+    free(grouped);
+    free(group_lengths);
+    free(group);
+
+    // an empty prefix next to longer ones makes the prefix optional
+    if (empty && component) component = nfa_union(component, nfa_epsilon());
+    return component;
+}
+
+NFA_COMPONENT utf8_ranges(const struct symbol_range *ranges, size_t count)
+{
+    SEQUENCE_VECTOR sequences;
+    sequence_vector_init(&sequences);
+    for (size_t i = 0; i < count; ++i)
+    {
+        SYMBOL lo = ranges[i].lo < 0 ? 0 : ranges[i].lo;
+        SYMBOL hi = ranges[i].hi > UTF8_MAX ? UTF8_MAX : ranges[i].hi;
+        if (lo <= hi) split_range(&sequences, lo, hi);
+    }
+
+    const struct utf8_sequence **pointers = malloc(sequences.size * sizeof(struct utf8_sequence*) + 1);
+    size_t *lengths = malloc(sequences.size * sizeof(size_t) + 1);
+    for (size_t i = 0; i < sequences.size; ++i)
+    {
+        pointers[i] = &sequences.data[i];
+        lengths[i] = sequences.data[i].length;
+    }
+
+    NFA_COMPONENT component = share_suffixes(pointers, lengths, sequences.size);
+    info("Compiled %lu codepoint ranges into %lu UTF-8 sequences.", count, sequences.size);
+
+    free(lengths);
+    free(pointers);
+    sequence_vector_fini(&sequences);
+
+    // no codepoint of the ranges has an encoding, nothing matches
+    if (!component) component = nfa_ranges(NULL, 0);
+    return component;
+}
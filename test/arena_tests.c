@@ -0,0 +1,72 @@
+#include <criterion/criterion.h>
+
+#include <stdint.h>
+#include <string.h>
+
+#include "utility/arena.h"
+#include "utility/set.h"
+#include "utility/map.h"
+
+Test(arena_tests, arena_alloc_aligned, .timeout = 5)
+{
+    ARENA arena = arena_init();
+    for (size_t size = 1; size < 200; ++size)
+    {
+        char *ptr = arena_alloc(arena, size);
+        cr_assert(((uintptr_t) ptr) % sizeof(void*) == 0, "Expected aligned memory. Got %p.", ptr);
+        memset(ptr, 0xAB, size);
+    }
+
+    // larger than a block
+    char *large = arena_alloc(arena, 1 << 20);
+    memset(large, 0xCD, 1 << 20);
+    cr_assert(arena_footprint(arena) >= 1 << 20, "Expected the footprint to include the large allocation.");
+
+    int *zeroed = arena_calloc(arena, 64, sizeof(int));
+    for (int i = 0; i < 64; ++i)
+        cr_assert(zeroed[i] == 0, "Expected zeroed memory at %d. Got %d.", i, zeroed[i]);
+    arena_fini(arena);
+}
+
+Test(arena_tests, arena_merge_forwarding, .timeout = 5)
+{
+    ARENA a = arena_init(), b = arena_init(), c = arena_init();
+    arena_alloc(a, 100);
+    arena_alloc(b, 100);
+    arena_alloc(c, 100);
+
+    ARENA ab = arena_merge(a, b);
+    cr_assert(ab == a, "Expected the arena merged into to hold the memory.");
+    cr_assert(arena_merge(b, a) == a, "Expected merging an arena with itself to do nothing.");
+
+    // merged arenas keep allocating from the arena they were merged into
+    ARENA abc = arena_merge(c, b);
+    size_t footprint = arena_footprint(abc);
+    cr_assert(arena_footprint(a) == footprint && arena_footprint(c) == footprint,
+        "Expected all merged arenas to report the same footprint.");
+    char *ptr = arena_alloc(b, 64);
+    memset(ptr, 0, 64);
+
+    arena_fini(c);
+}
+
+Test(arena_tests, arena_containers, .timeout = 5)
+{
+    ARENA arena = arena_init();
+    SET set = set_init_arena(arena);
+    MAP map = map_init_arena(arena);
+
+    // grow both containers beyond their initial capacity
+    for (uintptr_t i = 1; i <= 1000; ++i)
+    {
+        set_add(set, (void*) i);
+        map_add(map, i, (void*) i);
+    }
+    cr_assert(set_size(set) == 1000, "Expected 1000 elements. Got %lu.", set_size(set));
+    cr_assert(map_get(map, 500) == (void*) 500, "Expected the pair of 500 to be found.");
+
+    // releasing the containers is deferred to the arena
+    set_fini(set);
+    map_fini(map);
+    arena_fini(arena);
+}
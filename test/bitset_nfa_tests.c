@@ -0,0 +1,123 @@
+#include <criterion/criterion.h>
+
+#include <string.h>
+
+#include "automata/bitset_nfa.h"
+#include "regex/regex.h"
+
+// fills a buffer with a pseudo-random string over an alphabet, the same for every seed
+static void random_string(char *buffer, size_t length, const char *alphabet, uint64_t *seed)
+{
+    size_t alphabet_sz = strlen(alphabet);
+    for (size_t i = 0; i < length; ++i)
+    {
+        *seed = *seed * 6364136223846793005ull + 1442695040888963407ull;
+        buffer[i] = alphabet[(*seed >> 33) % alphabet_sz];
+    }
+    buffer[length] = '\0';
+}
+
+Test(bitset_nfa_tests, bitset_nfa_agrees_with_nfa, .timeout = 10)
+{
+    // one word, several words and a word boundary inside the state vector
+    const char *patterns[] = { "(a|b)*abb", "(a|b)*a(a|b){12}", "(a|b)*a(a|b){40}", "(ab|c+)*(a|b){3,70}c?" };
+    uint64_t seed = 1;
+    for (size_t p = 0; p < sizeof(patterns) / sizeof(patterns[0]); ++p)
+    {
+        NFA nfa = nfa_construct(regex_parse(patterns[p], REGEX_DEFAULT));
+        BITSET_NFA bitset = nfa_bitset(nfa);
+        cr_assert(bitset != NULL, "Expected \"%s\" to convert into a bitset NFA.", patterns[p]);
+        cr_assert(bitset_nfa_count_bits(bitset) <= nfa_count_states(nfa), "Expected at most %lu bits. Got %lu.",
+            nfa_count_states(nfa), bitset_nfa_count_bits(bitset));
+        cr_assert(bitset_nfa_words(bitset) == (bitset_nfa_count_bits(bitset) + 63) / 64, "Expected %lu words. Got %lu.",
+            (bitset_nfa_count_bits(bitset) + 63) / 64, bitset_nfa_words(bitset));
+
+        for (size_t i = 0; i < 300; ++i)
+        {
+            char input[128];
+            random_string(input, i % 100, "abc", &seed);
+            int nfa_result = nfa_accept_cstr(nfa, input);
+            int bitset_result = bitset_nfa_accept_cstr(bitset, input);
+            cr_assert(!nfa_result == !bitset_result, "Expected NFA and bitset NFA to agree on \"%s\" for \"%s\". "
+                "NFA = %d, BITSET = %d", input, patterns[p], nfa_result, bitset_result);
+        }
+
+        bitset_nfa_free(bitset);
+        nfa_free(nfa);
+    }
+}
+
+Test(bitset_nfa_tests, bitset_nfa_step, .timeout = 5)
+{
+    NFA nfa = nfa_construct(regex_parse("ab*c", REGEX_DEFAULT));
+    BITSET_NFA bitset = nfa_bitset(nfa);
+
+    // a, b and c, plus the class of symbols without transitions
+    size_t classes = bitset_nfa_count_classes(bitset);
+    cr_assert(classes == 4, "Expected 4 symbol classes. Got %lu.", classes);
+
+    uint64_t active[BITSET_NFA_MAX_WORDS], next[BITSET_NFA_MAX_WORDS];
+    bitset_nfa_start(bitset, active);
+    cr_assert(!bitset_nfa_is_accepting(bitset, active), "Expected the start to be rejecting.");
+    cr_assert(bitset_nfa_step(bitset, active, next, 'a'), "Expected states to be reached on 'a'.");
+    cr_assert(bitset_nfa_step(bitset, next, active, 'b'), "Expected states to be reached on 'b'.");
+    cr_assert(bitset_nfa_step(bitset, active, next, 'c'), "Expected states to be reached on 'c'.");
+    cr_assert(bitset_nfa_is_accepting(bitset, next), "Expected \"abc\" to be accepted.");
+    cr_assert(!bitset_nfa_step(bitset, next, active, 'c'), "Expected the simulation to die on \"abcc\".");
+    cr_assert(!bitset_nfa_step(bitset, active, next, 'x'), "Expected a symbol without transitions to reach nothing.");
+
+    bitset_nfa_free(bitset);
+    nfa_free(nfa);
+}
+
+Test(bitset_nfa_tests, bitset_nfa_wide_ranges, .timeout = 5)
+{
+    struct symbol_range any = { 0x01, 0xFFFF };
+    NFA nfa = nfa_construct(nfa_concat(nfa_repeat_min(nfa_ranges(&any, 1), 1), nfa_symbol(0x20000)));
+    BITSET_NFA bitset = nfa_bitset(nfa);
+
+    SYMBOL accepted[] = { 'a', 0xFF, 0x100, 0xFFFF, 0x20000, 0 };
+    SYMBOL rejected[] = { 'a', 0x10000, 0x20000, 0 };
+    cr_assert(bitset_nfa_accept(bitset, accepted), "Expected the bitset NFA to accept the wide string.");
+    cr_assert(!bitset_nfa_accept(bitset, rejected), "Expected the bitset NFA to reject the symbol outside the range.");
+
+    bitset_nfa_free(bitset);
+    nfa_free(nfa);
+}
+
+Test(bitset_nfa_tests, bitset_nfa_limits, .timeout = 5)
+{
+    NFA nfa = nfa_construct(nfa_repeat_exact(nfa_symbol('a'), BITSET_NFA_MAX_STATES));
+    cr_assert(nfa_bitset(nfa) == NULL, "Expected an NFA of %lu states to be too large.", nfa_count_states(nfa));
+    nfa_free(nfa);
+}
+
+Test(bitset_nfa_tests, bitset_nfa_length_delimited, .timeout = 5)
+{
+    NFA nfa = nfa_construct(regex_parse("(a|b)*a(a|b){70}", REGEX_DEFAULT));
+    BITSET_NFA bitset = nfa_bitset(nfa);
+
+    uint8_t bytes[80];
+    uint16_t wide[80];
+    SYMBOL symbols[80];
+    for (size_t i = 0; i < 80; ++i)
+    {
+        bytes[i] = i == 8 ? 'a' : 'b';
+        wide[i] = symbols[i] = bytes[i];
+    }
+    cr_assert(bitset_nfa_accept_u8(bitset, bytes, 79), "Expected the bitset NFA to accept the bytes.");
+    cr_assert(bitset_nfa_accept_u16(bitset, wide, 79), "Expected the bitset NFA to accept the 16-bit string.");
+    cr_assert(bitset_nfa_accept_symbols(bitset, symbols, 79), "Expected the bitset NFA to accept the symbols.");
+    cr_assert(!bitset_nfa_accept_u8(bitset, bytes, 80), "Expected the bitset NFA to reject a longer string.");
+
+    // a 0 inside the string is a symbol without transitions, not the end of the string
+    bytes[40] = 0;
+    wide[40] = 0;
+    cr_assert(!bitset_nfa_accept_u8(bitset, bytes, 79), "Expected the bitset NFA to reject the 0 byte.");
+    cr_assert(!bitset_nfa_accept_u16(bitset, wide, 79), "Expected the bitset NFA to reject the 0 symbol.");
+    wide[40] = 0x162;
+    cr_assert(!bitset_nfa_accept_u16(bitset, wide, 79), "Expected the bitset NFA to reject the wide symbol.");
+
+    bitset_nfa_free(bitset);
+    nfa_free(nfa);
+}
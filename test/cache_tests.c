@@ -0,0 +1,278 @@
+#include <criterion/criterion.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+
+#include "regex/cache.h"
+
+Test(cache_tests, cache_hit_miss, .timeout = 5)
+{
+    struct regex_cache_stats stats;
+    REGEX_CACHE cache = regex_cache_init(1 << 20);
+
+    REGEX a = regex_cache_get(cache, "(a|b)*abb", REGEX_DEFAULT);
+    REGEX b = regex_cache_get(cache, "((a)|(b))*a(b)b", REGEX_DEFAULT);
+    REGEX c = regex_cache_get(cache, "(a|b)*abb", REGEX_NFA);
+
+    cr_assert(a == b, "Expected equivalent spellings to share a compiled regex.");
+    cr_assert(a != c, "Expected different flags to yield different compiled regexes.");
+
+    regex_cache_stats(cache, &stats);
+    cr_assert(stats.hits == 1, "Expected 1 hit. Got %lu.", stats.hits);
+    cr_assert(stats.misses == 2, "Expected 2 misses. Got %lu.", stats.misses);
+    cr_assert(stats.entries == 2, "Expected 2 entries. Got %lu.", stats.entries);
+    cr_assert(stats.footprint == regex_footprint(a) + regex_footprint(c), "Expected the footprint to be the sum of the entries.");
+
+    REGEX invalid = regex_cache_get(cache, "(a", REGEX_DEFAULT);
+    cr_assert(invalid == NULL, "Expected an invalid pattern to yield null.");
+
+    regex_release(a);
+    regex_release(b);
+    regex_release(c);
+    regex_cache_fini(cache);
+}
+
+Test(cache_tests, cache_case_insensitive_classes, .timeout = 5)
+{
+    REGEX_CACHE cache = regex_cache_init(1 << 20);
+    const char *patterns[] = { ".", "[^a]", "[^A-Z]" };
+    const char *inputs[] = { "a", "A", "b", "B", "0", "\n" };
+    for (size_t p = 0; p < sizeof(patterns) / sizeof(patterns[0]); ++p)
+    {
+        REGEX direct = regex_compile(patterns[p], REGEX_ICASE);
+        REGEX cached = regex_cache_get(cache, patterns[p], REGEX_ICASE);
+        for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); ++i)
+        {
+            int expected = regex_match(direct, inputs[i]);
+            int result = regex_match(cached, inputs[i]);
+            cr_assert(!result == !expected, "Expected the cached \"%s\" to give %d on \"%s\". Got %d.",
+                patterns[p], expected, inputs[i], result);
+        }
+        regex_release(direct);
+        regex_release(cached);
+    }
+    regex_cache_fini(cache);
+}
+
+Test(cache_tests, cache_eviction, .timeout = 5)
+{
+    struct regex_cache_stats stats;
+
+    REGEX probe = regex_compile("a+", REGEX_DEFAULT);
+    size_t footprint = regex_footprint(probe);
+    regex_release(probe);
+
+    // room for two single-symbol patterns
+    REGEX_CACHE cache = regex_cache_init(2 * footprint);
+
+    regex_release(regex_cache_get(cache, "a+", REGEX_DEFAULT));
+    regex_release(regex_cache_get(cache, "b+", REGEX_DEFAULT));
+    regex_release(regex_cache_get(cache, "a+", REGEX_DEFAULT)); // a is now the most recently used
+    REGEX c = regex_cache_get(cache, "c+", REGEX_DEFAULT);      // evicts b
+
+    regex_cache_stats(cache, &stats);
+    cr_assert(stats.evictions == 1, "Expected 1 eviction. Got %lu.", stats.evictions);
+    cr_assert(stats.entries == 2, "Expected 2 entries. Got %lu.", stats.entries);
+    cr_assert(stats.footprint <= 2 * footprint, "Expected the footprint to stay within the capacity.");
+
+    regex_release(regex_cache_get(cache, "a+", REGEX_DEFAULT));
+    regex_cache_stats(cache, &stats);
+    cr_assert(stats.hits == 2, "Expected a+ to remain cached. Got %lu hits.", stats.hits);
+
+    regex_release(regex_cache_get(cache, "b+", REGEX_DEFAULT));
+    regex_cache_stats(cache, &stats);
+    cr_assert(stats.misses == 4, "Expected b+ to have been evicted. Got %lu misses.", stats.misses);
+
+    // evicted regexes stay usable while they are referenced
+    regex_cache_clear(cache);
+    cr_assert(regex_match(c, "ccc"), "Expected the evicted regex to remain usable.");
+    regex_release(c);
+
+    regex_cache_fini(cache);
+}
+
+#define CACHE_THREADS 8
+#define CACHE_ITERATIONS 200
+
+static void *cache_worker(void *arg)
+{
+    static const char *patterns[] = { "(a|b)*abb", "[0-9]+", "x{2,4}", "(ab|cd){2,}dcb" };
+    REGEX_CACHE cache = arg;
+    for (size_t i = 0; i < CACHE_ITERATIONS; ++i)
+    {
+        REGEX regex = regex_cache_get(cache, patterns[i % 4], REGEX_DEFAULT);
+        if (!regex || !regex_match(regex, i % 4 == 1 ? "123" : "") != (i % 4 != 1)) return (void*) 1;
+        regex_release(regex);
+    }
+    return NULL;
+}
+
+Test(cache_tests, cache_footprint_promotion, .timeout = 10)
+{
+    struct regex_cache_stats stats;
+    const char *pattern = "(a|b)*a(a|b){12}";
+    REGEX_CACHE cache = regex_cache_init(1 << 24);
+
+    REGEX regex = regex_cache_get(cache, pattern, REGEX_DEFAULT);
+    cr_assert(regex_wait_promotion(regex), "Expected the regex to be promoted to a DFA.");
+    size_t footprint = regex_footprint(regex);
+
+    // the entry was sized before the promotion, the next hit accounts for the DFA
+    regex_release(regex_cache_get(cache, pattern, REGEX_DEFAULT));
+    regex_cache_stats(cache, &stats);
+    cr_assert(stats.footprint == footprint, "Expected a footprint of %lu. Got %lu.", footprint, stats.footprint);
+
+    // a promoted regex which outgrew the cache is evicted on its next hit
+    regex_cache_fini(cache);
+    cache = regex_cache_init(footprint - 1);
+    REGEX other = regex_cache_get(cache, pattern, REGEX_DEFAULT);
+    regex_wait_promotion(other);
+    regex_release(regex_cache_get(cache, pattern, REGEX_DEFAULT));
+    regex_cache_stats(cache, &stats);
+    cr_assert(stats.entries == 0, "Expected the promoted regex to be evicted. Got %lu entries.", stats.entries);
+    cr_assert(stats.footprint == 0, "Expected an empty cache to have no footprint. Got %lu.", stats.footprint);
+
+    regex_release(regex);
+    regex_release(other);
+    regex_cache_fini(cache);
+}
+
+Test(cache_tests, cache_threads, .timeout = 10)
+{
+    struct regex_cache_stats stats;
+    REGEX_CACHE cache = regex_cache_init(1 << 20);
+
+    pthread_t threads[CACHE_THREADS];
+    for (size_t i = 0; i < CACHE_THREADS; ++i)
+        pthread_create(&threads[i], NULL, cache_worker, cache);
+
+    for (size_t i = 0; i < CACHE_THREADS; ++i)
+    {
+        void *ret;
+        pthread_join(threads[i], &ret);
+        cr_assert(ret == NULL, "Expected worker %lu to succeed.", i);
+    }
+
+    regex_cache_stats(cache, &stats);
+    cr_assert(stats.entries == 4, "Expected 4 entries. Got %lu.", stats.entries);
+    cr_assert(stats.hits + stats.misses == CACHE_THREADS * CACHE_ITERATIONS, "Expected every lookup to be counted.");
+
+    regex_cache_fini(cache);
+}
+
+// removes the saved automata and the directory
+static void remove_directory(const char *directory)
+{
+    char path[512];
+    DIR *dir = opendir(directory);
+    for (struct dirent *file; (file = readdir(dir)); )
+    {
+        if (file->d_name[0] == '.') continue;
+        snprintf(path, sizeof(path), "%s/%s", directory, file->d_name);
+        unlink(path);
+    }
+    closedir(dir);
+    rmdir(directory);
+}
+
+Test(cache_tests, cache_disk_reuse, .timeout = 5)
+{
+    struct regex_cache_stats stats;
+    char directory[] = "/tmp/regex_cache_XXXXXX";
+    cr_assert(mkdtemp(directory), "Expected a temporary directory.");
+
+    REGEX_CACHE first = regex_cache_init(1 << 20);
+    cr_assert(!regex_cache_set_directory(first, directory), "Expected the directory to be accepted.");
+    regex_release(regex_cache_get(first, "(a|b)*abb", REGEX_DEFAULT));
+    regex_release(regex_cache_get(first, "(a|b)*abb", REGEX_NFA));
+    regex_cache_stats(first, &stats);
+    cr_assert(stats.disk_hits == 0, "Expected 0 disk hits. Got %lu.", stats.disk_hits);
+    cr_assert(stats.disk_writes == 1, "Expected only the DFA to be saved. Got %lu writes.", stats.disk_writes);
+    regex_cache_fini(first);
+
+    // a fresh cache maps the automaton saved by the first one
+    REGEX_CACHE second = regex_cache_init(1 << 20);
+    cr_assert(!regex_cache_set_directory(second, directory), "Expected the directory to be accepted.");
+    REGEX regex = regex_cache_get(second, "((a)|(b))*a(b)b", REGEX_DEFAULT);
+    regex_cache_stats(second, &stats);
+    cr_assert(stats.disk_hits == 1, "Expected 1 disk hit. Got %lu.", stats.disk_hits);
+    cr_assert(stats.disk_writes == 0, "Expected 0 disk writes. Got %lu.", stats.disk_writes);
+    cr_assert(regex_match(regex, "babb"), "Expected the loaded regex to accept \"babb\".");
+    cr_assert(!regex_match(regex, "bab"), "Expected the loaded regex to reject \"bab\".");
+    regex_release(regex);
+    regex_cache_fini(second);
+
+    remove_directory(directory);
+}
+
+Test(cache_tests, cache_disk_tiered, .timeout = 10)
+{
+    struct regex_cache_stats stats;
+    char directory[] = "/tmp/regex_cache_XXXXXX";
+    cr_assert(mkdtemp(directory), "Expected a temporary directory.");
+
+    // the DFA of this pattern is large enough to be built in the background
+    const char *pattern = "(a|b)*a(a|b){12}";
+    REGEX_CACHE first = regex_cache_init(1 << 24);
+    regex_cache_set_directory(first, directory);
+    REGEX regex = regex_cache_get(first, pattern, REGEX_DEFAULT);
+    regex_cache_stats(first, &stats);
+    cr_assert(regex_engine(regex) == REGEX_ENGINE_TIERED, "Expected the regex to be tiered.");
+    cr_assert(regex_dfa(regex) != NULL, "Expected the regex to be promoted to a DFA.");
+    cr_assert(stats.disk_writes == 1, "Expected the promoted DFA to be saved. Got %lu writes.", stats.disk_writes);
+    regex_release(regex);
+    regex_cache_fini(first);
+
+    REGEX_CACHE second = regex_cache_init(1 << 24);
+    regex_cache_set_directory(second, directory);
+    regex = regex_cache_get(second, pattern, REGEX_DEFAULT);
+    regex_cache_stats(second, &stats);
+    cr_assert(stats.disk_hits == 1, "Expected 1 disk hit. Got %lu.", stats.disk_hits);
+    cr_assert(regex_match(regex, "baaaaaaaaaaaaa"), "Expected the loaded regex to accept \"baaaaaaaaaaaaa\".");
+    cr_assert(!regex_match(regex, "baaaaaaaaaaaa"), "Expected the loaded regex to reject \"baaaaaaaaaaaa\".");
+    regex_release(regex);
+    regex_cache_fini(second);
+
+    remove_directory(directory);
+}
+
+Test(cache_tests, cache_disk_corrupt, .timeout = 5)
+{
+    struct regex_cache_stats stats;
+    char directory[] = "/tmp/regex_cache_XXXXXX";
+    cr_assert(mkdtemp(directory), "Expected a temporary directory.");
+
+    REGEX_CACHE first = regex_cache_init(1 << 20);
+    regex_cache_set_directory(first, directory);
+    regex_release(regex_cache_get(first, "a+b", REGEX_DEFAULT));
+    regex_cache_fini(first);
+
+    // overwrite the saved automaton with garbage
+    char path[512];
+    DIR *dir = opendir(directory);
+    for (struct dirent *file; (file = readdir(dir)); )
+    {
+        if (file->d_name[0] == '.') continue;
+        snprintf(path, sizeof(path), "%s/%s", directory, file->d_name);
+        FILE *out = fopen(path, "w");
+        fputs("garbage", out);
+        fclose(out);
+    }
+    closedir(dir);
+
+    REGEX_CACHE second = regex_cache_init(1 << 20);
+    regex_cache_set_directory(second, directory);
+    REGEX regex = regex_cache_get(second, "a+b", REGEX_DEFAULT);
+    regex_cache_stats(second, &stats);
+    cr_assert(regex != NULL, "Expected the pattern to be compiled again.");
+    cr_assert(stats.disk_hits == 0, "Expected 0 disk hits. Got %lu.", stats.disk_hits);
+    cr_assert(stats.disk_writes == 1, "Expected the corrupt file to be replaced. Got %lu writes.", stats.disk_writes);
+    cr_assert(regex_match(regex, "aab"), "Expected the regex to accept \"aab\".");
+    regex_release(regex);
+    regex_cache_fini(second);
+
+    remove_directory(directory);
+}
@@ -1,5 +1,7 @@
 #include <criterion/criterion.h>
 
+#include <stddef.h>
+
 #include "automata/dfa.h"
 
 /**
@@ -470,4 +472,43 @@ Test(dfa_sim_tests, dfa_sim_simple_1e)
     cr_assert(status == 0, "Expected status to be zero. Got %d", status);
 
     dfa_free(dfa);
-}
\ No newline at end of file
+}
+
+/**
+ * The following DFA matches (ab)* (Starting A)
+ *
+ * [[A]] --'a'--> [B] --'b'--> [[A]]
+ */
+Test(dfa_sim_tests, dfa_sim_scratch, .timeout = 5)
+{
+    DSTATE A = dstate_new();
+    DSTATE B = dstate_new();
+
+    dstate_add_transition(A, 'a', B);
+    dstate_add_transition(B, 'b', A);
+
+    DSTATE accepting_states[] = { A };
+    DFA dfa = dfa_new(A, accepting_states, 1);
+
+    size_t size = dfa_sim_scratch_size(dfa);
+    _Alignas(max_align_t) unsigned char scratch[64];
+    cr_assert(size <= sizeof(scratch), "Expected a small scratch space. Got %lu bytes.", size);
+    cr_assert(dfa_sim_init_scratch(dfa, scratch, size - 1) == NULL, "Expected too little scratch space to be rejected.");
+
+    DFA_SIM sim = dfa_sim_init_scratch(dfa, scratch, size);
+    cr_assert(sim != NULL, "Expected the simulator to fit into %lu bytes.", size);
+
+    const char *inputs[] = { "ab", "aba", "bb", "" };
+    SIM_STATUS expected[] = { SIM_SUCCESS, SIM_FAILURE, SIM_FAILURE, SIM_SUCCESS };
+    for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); ++i)
+    {
+        dfa_sim_reset(sim);
+        for (const char *c = inputs[i]; *c; ++c)
+            dfa_sim_step(sim, *c);
+        SIM_STATUS status = dfa_sim_status(sim);
+        cr_assert(status == expected[i], "Expected status %d on \"%s\". Got %d.", expected[i], inputs[i], status);
+    }
+    dfa_sim_fini(sim);
+
+    dfa_free(dfa);
+}
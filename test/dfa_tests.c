@@ -1,6 +1,7 @@
 #include <criterion/criterion.h>
 
 #include "automata/dfa.h"
+#include "automata/frozen_dfa.h"
 
 /**
  * Using the following automaton 
@@ -244,4 +245,40 @@ Test(dfa_tests, dfa_get_states_simple, .timeout = 5)
     cr_assert(ret != 0, "Expected that the dstate arrays are equal.");
 
     dfa_free(dfa);
-}
\ No newline at end of file
+}
+
+Test(dfa_tests, dfa_million_state_chain, .timeout = 30)
+{
+    // a chain this long would overflow the stack of any recursive traversal
+    size_t length = 1 << 20;
+    DSTATE *chain = malloc((length + 1) * sizeof(DSTATE));
+    for (size_t i = 0; i <= length; ++i)
+    {
+        chain[i] = dstate_new();
+        if (i) dstate_add_transition(chain[i - 1], 'a' + i % 2, chain[i]);
+    }
+
+    DFA dfa = dfa_new(chain[0], &chain[length], 1);
+    cr_assert(dfa != NULL, "Expected the chain to be a valid DFA.");
+    cr_assert(dfa_count_states(dfa) == length + 1, "Expected %lu states. Got %lu.", length + 1, dfa_count_states(dfa));
+    for (size_t i = 0; i < 16; ++i)
+        cr_assert(dstate_id(chain[i]) == (int) i, "Expected state %lu of the chain to have id %lu. Got %d.", i, i, dstate_id(chain[i]));
+
+    char *input = malloc(length + 1);
+    for (size_t i = 0; i < length; ++i)
+        input[i] = 'a' + (i + 1) % 2;
+    input[length] = '\0';
+    cr_assert(dfa_accept_cstr(dfa, input), "Expected the chain to be accepted.");
+
+    FROZEN_DFA frozen = dfa_freeze(dfa);
+    cr_assert(frozen_dfa_count_states(frozen) == length + 2, "Expected %lu frozen states. Got %lu.", length + 2,
+        frozen_dfa_count_states(frozen));
+    cr_assert(frozen_dfa_accept_cstr(frozen, input), "Expected the frozen chain to accept the chain.");
+    input[length - 1] = 'c';
+    cr_assert(!frozen_dfa_accept_cstr(frozen, input), "Expected a broken chain to be rejected.");
+    frozen_dfa_free(frozen);
+
+    free(input);
+    free(chain);
+    dfa_free(dfa);
+}
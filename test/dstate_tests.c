@@ -1,5 +1,7 @@
 #include <criterion/criterion.h>
 
+#include <string.h>
+
 #include "automata/dfa.h"
 
 Test(dstate_tests, dstate_lifetime, .timeout = 5)
@@ -10,6 +12,21 @@ Test(dstate_tests, dstate_lifetime, .timeout = 5)
     cr_assert(ret == 0, "Expected dstate_free to return 0. Got %d", ret);
 }
 
+Test(dstate_tests, dstate_debug_tag, .timeout = 5)
+{
+    DSTATE tagged = dstate_debug_new("tagged");
+    DSTATE untagged = dstate_new();
+    cr_assert(dstate_tag(tagged) != NULL && !strcmp(dstate_tag(tagged), "tagged"), "Expected the tag to be \"tagged\".");
+    cr_assert(dstate_tag(untagged) == NULL, "Expected an untagged state to have no tag.");
+
+    dstate_free(tagged);
+    // a state reusing the memory of a freed tagged state must not inherit its tag
+    DSTATE reused = dstate_new();
+    cr_assert(dstate_tag(reused) == NULL, "Expected a new state to have no tag.");
+    dstate_free(reused);
+    dstate_free(untagged);
+}
+
 /**
  * Building the following automaton 
  *                   a
@@ -399,3 +416,36 @@ Test(dstate_tests, dstate_transition_states_simple_1, .timeout = 5)
     dstate_free(D);
 }
 
+
+Test(dstate_tests, dstate_range_transitions, .timeout = 5)
+{
+    DSTATE A = dstate_new();
+    DSTATE B = dstate_new();
+    DSTATE C = dstate_new();
+
+    cr_assert(!dstate_add_range_transition(A, 'n', 'z', B), "Expected the range transition to be added.");
+    cr_assert(!dstate_add_range_transition(A, 'a', 'l', B), "Expected the range transition to be added.");
+    cr_assert(!dstate_add_transition(A, 'm', C), "Expected the transition between the ranges to be added.");
+    cr_assert(dstate_add_range_transition(A, 'k', 'o', C), "Expected an overlapping range to be rejected.");
+    cr_assert(dstate_add_range_transition(A, 'A', 'z', C), "Expected a range covering a symbol to be rejected.");
+    cr_assert(dstate_add_transition(A, 'q', C), "Expected a symbol within a range to be rejected.");
+    cr_assert(!dstate_add_range_transition(A, 0x100, 0x10FFFF, C), "Expected the wide range to be added.");
+
+    SYMBOL inputs[] = { 'a', 'l', 'm', 'n', 'z', '{', 0x4b00, 0x110000 };
+    DSTATE expected[] = { B, B, C, B, B, NULL, C, NULL };
+    for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); ++i)
+    {
+        DSTATE to = dstate_get_transition_state(A, inputs[i]);
+        cr_assert(to == expected[i], "Expected transition on %d to reach %p. Got %p.", inputs[i], expected[i], to);
+    }
+
+    // the ranges are kept sorted
+    size_t sz;
+    const struct dstate_range_transition *ranges = dstate_view_range_transitions(A, &sz);
+    cr_assert(sz == 3, "Expected 3 range transitions. Got %lu.", sz);
+    cr_assert(ranges[0].lo == 'a' && ranges[1].lo == 'n' && ranges[2].lo == 0x100, "Expected the ranges sorted.");
+
+    dstate_free(A);
+    dstate_free(B);
+    dstate_free(C);
+}
@@ -0,0 +1,291 @@
+#include <criterion/criterion.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "regex/flow_table.h"
+
+#define NUM_FLOWS 8
+
+// the matches of every flow, flows are numbered 0 to NUM_FLOWS - 1
+struct flow_matches
+{
+    size_t offsets[NUM_FLOWS][64];
+    size_t counts[NUM_FLOWS];
+    pthread_mutex_t lock;
+};
+
+static int collect_flow_match(uint64_t flow_id, size_t offset, void *context)
+{
+    struct flow_matches *matches = context;
+    pthread_mutex_lock(&matches->lock);
+    matches->offsets[flow_id][matches->counts[flow_id]++] = offset;
+    pthread_mutex_unlock(&matches->lock);
+    return 0;
+}
+
+static int collect_stream_match(size_t offset, void *context)
+{
+    size_t *offsets = context;
+    offsets[++offsets[0]] = offset;
+    return 0;
+}
+
+static const char *flow_inputs[NUM_FLOWS] = {
+    "xabcabc", "abc", "zzzzabcq", "", "ababcabcabc", "abcxyzabc", "c", "qqqabcabc"
+};
+
+// checks the matches of every flow against a stream over its whole input
+static void check_flow_matches(REGEX regex, struct flow_matches *matches)
+{
+    for (size_t f = 0; f < NUM_FLOWS; ++f)
+    {
+        size_t expected[64] = { 0 };
+        REGEX_STREAM stream = regex_stream_open(regex, collect_stream_match, expected);
+        regex_stream_feed(stream, flow_inputs[f], strlen(flow_inputs[f]));
+        regex_stream_close(stream);
+
+        cr_assert(matches->counts[f] == expected[0], "Expected %lu matches in flow %lu. Got %lu.",
+            expected[0], f, matches->counts[f]);
+        for (size_t i = 0; i < expected[0]; ++i)
+            cr_assert(matches->offsets[f][i] == expected[i + 1], "Expected match %lu of flow %lu at offset %lu. Got %lu.",
+                i, f, expected[i + 1], matches->offsets[f][i]);
+    }
+}
+
+Test(flow_table_tests, flow_table_interleaved_flows, .timeout = 5)
+{
+    REGEX regex = regex_compile("[a-z]*abc", REGEX_DFA);
+    struct flow_matches matches = { .counts = { 0 }, .lock = PTHREAD_MUTEX_INITIALIZER };
+    FLOW_TABLE table = flow_table_init(regex, 3, collect_flow_match, &matches);
+    cr_assert(table != NULL, "Expected a flow table over a DFA.");
+    cr_assert(flow_table_count_shards(table) == 3, "Expected 3 shards. Got %lu.", flow_table_count_shards(table));
+
+    // the flows are fed two bytes at a time, round robin, alternating single scans and batches
+    struct flow_chunk batch[NUM_FLOWS];
+    for (size_t offset = 0, round = 0; offset < 12; offset += 2, ++round)
+    {
+        size_t batch_size = 0;
+        for (size_t f = 0; f < NUM_FLOWS; ++f)
+        {
+            size_t length = strlen(flow_inputs[f]);
+            if (offset >= length) continue;
+            size_t chunk = length - offset < 2 ? length - offset : 2;
+            if (round % 2) flow_table_scan(table, f, flow_inputs[f] + offset, chunk, round);
+            else batch[batch_size++] = (struct flow_chunk){ f, round, flow_inputs[f] + offset, chunk };
+        }
+        flow_table_scan_batch(table, batch, batch_size);
+    }
+    check_flow_matches(regex, &matches);
+
+    // the empty flow 3 was never scanned
+    struct flow_table_stats stats;
+    flow_table_stats(table, &stats);
+    cr_assert(stats.flows == NUM_FLOWS - 1, "Expected %d flows. Got %lu.", NUM_FLOWS - 1, stats.flows);
+    cr_assert(stats.bytes == 48, "Expected 48 bytes. Got %lu.", stats.bytes);
+
+    cr_assert(flow_table_close(table, 1) == 1, "Expected flow 1 to match entirely.");
+    cr_assert(flow_table_close(table, 2) == 0, "Expected flow 2 not to match entirely.");
+    cr_assert(flow_table_close(table, 1) < 0, "Expected a closed flow to be gone.");
+    cr_assert(flow_table_close(table, 3) < 0, "Expected an unknown flow to be reported.");
+
+    flow_table_fini(table);
+    regex_release(regex);
+}
+
+Test(flow_table_tests, flow_table_batch_order, .timeout = 5)
+{
+    REGEX regex = regex_compile("[a-z]*abc", REGEX_DFA);
+    struct flow_matches matches = { .counts = { 0 }, .lock = PTHREAD_MUTEX_INITIALIZER };
+    FLOW_TABLE table = flow_table_init(regex, 2, collect_flow_match, &matches);
+
+    // every byte of every flow in a single batch, the flows interleaved
+    struct flow_chunk batch[128];
+    size_t batch_size = 0;
+    for (size_t offset = 0; offset < 12; ++offset)
+        for (size_t f = 0; f < NUM_FLOWS; ++f)
+            if (offset < strlen(flow_inputs[f]))
+                batch[batch_size++] = (struct flow_chunk){ f, offset, flow_inputs[f] + offset, 1 };
+
+    size_t reported = flow_table_scan_batch(table, batch, batch_size);
+    check_flow_matches(regex, &matches);
+
+    size_t total = 0;
+    for (size_t f = 0; f < NUM_FLOWS; ++f)
+        total += matches.counts[f];
+    cr_assert(reported == total, "Expected the batch to report %lu matches. Got %lu.", total, reported);
+
+    flow_table_fini(table);
+    regex_release(regex);
+}
+
+Test(flow_table_tests, flow_table_evict_idle, .timeout = 5)
+{
+    REGEX regex = regex_compile("a+", REGEX_DFA);
+    FLOW_TABLE table = flow_table_init(regex, 1, NULL, NULL);
+
+    // enough flows to grow the shard
+    for (uint64_t f = 0; f < 1000; ++f)
+        flow_table_scan(table, f, "a", 1, f);
+
+    size_t evicted = flow_table_evict_idle(table, 600);
+    cr_assert(evicted == 600, "Expected 600 idle flows to be evicted. Got %lu.", evicted);
+    for (uint64_t f = 0; f < 1000; f += 7)
+    {
+        int result = flow_table_close(table, f);
+        cr_assert(f < 600 ? result < 0 : result == 1, "Expected flow %lu to be %s. Got %d.", f,
+            f < 600 ? "evicted" : "kept", result);
+    }
+
+    struct flow_table_stats stats;
+    flow_table_stats(table, &stats);
+    cr_assert(stats.evictions == 600, "Expected 600 evictions. Got %lu.", stats.evictions);
+    flow_table_fini(table);
+
+    regex_release(regex);
+    regex = regex_compile("a+", REGEX_NFA);
+    cr_assert(flow_table_init(regex, 1, NULL, NULL) == NULL, "Expected a flow table to need a DFA.");
+    regex_release(regex);
+}
+
+Test(flow_table_tests, flow_table_tiered, .timeout = 10)
+{
+    struct flow_matches matches = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+    // the DFA of this pattern is built in the background, the table waits for it
+    REGEX regex = regex_compile("(a|b)*a(a|b){12}", REGEX_DEFAULT);
+    cr_assert(regex_engine(regex) == REGEX_ENGINE_TIERED, "Expected the regex to be tiered.");
+    FLOW_TABLE table = flow_table_init(regex, 2, collect_flow_match, &matches);
+    cr_assert(table != NULL, "Expected a flow table for a tiered regex.");
+    cr_assert(regex_dfa(regex) != NULL, "Expected the DFA to be promoted.");
+
+    const char *input = "baaaaaaaaaaaaa";
+    flow_table_scan(table, 1, input, strlen(input), 0);
+    flow_table_fini(table);
+    cr_assert(matches.counts[1] == 1 && matches.offsets[1][0] == strlen(input),
+        "Expected one match at offset %lu. Got %lu matches.", strlen(input), matches.counts[1]);
+
+    regex_release(regex);
+}
+
+struct shard_worker
+{
+    FLOW_TABLE table;
+    size_t shard;
+};
+
+// scans the flows of one shard only
+static void *scan_shard(void *arg)
+{
+    struct shard_worker *worker = arg;
+    for (size_t round = 0; round < 100; ++round)
+        for (uint64_t f = 0; f < 256; ++f)
+            if (flow_table_shard(worker->table, f) == worker->shard)
+                flow_table_scan(worker->table, f, "ab", 2, round);
+    return NULL;
+}
+
+Test(flow_table_tests, flow_table_sharded_threads, .timeout = 10)
+{
+    REGEX regex = regex_compile("(ab)*", REGEX_DFA);
+    FLOW_TABLE table = flow_table_init(regex, 4, NULL, NULL);
+
+    pthread_t threads[4];
+    struct shard_worker workers[4];
+    for (size_t i = 0; i < 4; ++i)
+    {
+        workers[i] = (struct shard_worker){ table, i };
+        pthread_create(&threads[i], NULL, scan_shard, &workers[i]);
+    }
+    for (size_t i = 0; i < 4; ++i)
+        pthread_join(threads[i], NULL);
+
+    struct flow_table_stats stats;
+    flow_table_stats(table, &stats);
+    cr_assert(stats.flows == 256, "Expected 256 flows. Got %lu.", stats.flows);
+    // the empty prefix and every round of every flow match
+    cr_assert(stats.matches == 256 * 101, "Expected %d matches. Got %lu.", 256 * 101, stats.matches);
+    flow_table_fini(table);
+    regex_release(regex);
+}
+
+// appends a TCP or UDP packet over ethernet and IPv4 to a pcap file
+static void write_packet(FILE *file, uint32_t seconds, uint8_t protocol, uint16_t source_port, const char *payload)
+{
+    size_t transport_length = protocol == 6 ? 20 : 8;
+    size_t payload_length = strlen(payload);
+    size_t ip_length = 20 + transport_length + payload_length;
+    unsigned char packet[256] = { 0 };
+
+    // ethernet
+    packet[12] = 0x08;
+    // IPv4 from 10.0.0.1 to 10.0.0.2
+    unsigned char *ip = packet + 14;
+    ip[0] = 0x45;
+    ip[2] = ip_length >> 8;
+    ip[3] = ip_length & 0xFF;
+    ip[8] = 64;
+    ip[9] = protocol;
+    ip[12] = 10, ip[15] = 1;
+    ip[16] = 10, ip[19] = 2;
+    // ports
+    unsigned char *transport = ip + 20;
+    transport[0] = source_port >> 8;
+    transport[1] = source_port & 0xFF;
+    transport[3] = 80;
+    if (protocol == 6) transport[12] = 5 << 4;
+    memcpy(transport + transport_length, payload, payload_length);
+
+    uint32_t record[4] = { seconds, 0, 14 + ip_length, 14 + ip_length };
+    fwrite(record, sizeof(record), 1, file);
+    fwrite(packet, 14 + ip_length, 1, file);
+}
+
+static int count_match(uint64_t flow_id, size_t offset, void *context)
+{
+    (*(size_t*) context)++;
+    return 0;
+}
+
+Test(flow_table_tests, flow_table_replay_pcap, .timeout = 5)
+{
+    char filename[] = "/tmp/flow_table_testXXXXXX";
+    int fd = mkstemp(filename);
+    FILE *file = fdopen(fd, "wb");
+    uint32_t header[6] = { 0xa1b2c3d4, 2 | 4 << 16, 0, 0, 65535, 1 };
+    fwrite(header, sizeof(header), 1, file);
+
+    // "GET /" is split over two segments of the first flow
+    write_packet(file, 1, 6, 1000, "xx GE");
+    write_packet(file, 1, 6, 2000, "GET /index");
+    write_packet(file, 2, 6, 1000, "T /a");
+    write_packet(file, 2, 17, 1000, "GET /");
+    // the flow of port 2000 is idle for 10 seconds and evicted before its next packet
+    write_packet(file, 12, 6, 2000, "GET /again");
+    fclose(file);
+
+    size_t matches = 0;
+    REGEX regex = regex_compile(".*GET /.*", REGEX_DFA);
+    FLOW_TABLE table = flow_table_init(regex, 0, count_match, &matches);
+
+    struct flow_replay_stats stats;
+    cr_assert(!flow_table_replay_pcap(table, filename, 5000000, &stats), "Expected the capture to be replayed.");
+    cr_assert(stats.packets == 5, "Expected 5 packets. Got %lu.", stats.packets);
+    cr_assert(stats.scanned == 5, "Expected 5 scanned packets. Got %lu.", stats.scanned);
+
+    // every prefix from the end of "GET /" on is a match: 2 + 6 + 1 + 6 in the tcp flow of port
+    // 1000, the first tcp flow of port 2000, the udp flow and the second tcp flow of port 2000
+    cr_assert(matches == 15, "Expected 15 matches. Got %lu.", matches);
+
+    struct flow_table_stats table_stats;
+    flow_table_stats(table, &table_stats);
+    cr_assert(table_stats.evictions == 3, "Expected the 3 idle flows to be evicted. Got %lu.", table_stats.evictions);
+    cr_assert(table_stats.flows == 1, "Expected 1 flow to remain. Got %lu.", table_stats.flows);
+
+    cr_assert(flow_table_replay_pcap(table, "/nonexistent", 0, NULL), "Expected a missing file to be rejected.");
+    flow_table_fini(table);
+    regex_release(regex);
+    unlink(filename);
+}
@@ -0,0 +1,258 @@
+#include <criterion/criterion.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "automata/algorithm.h"
+#include "automata/frozen_dfa.h"
+
+// (a|b)*abb
+static DFA build_dfa_0()
+{
+    NFA nfa = nfa_construct(
+        nfa_concat(
+            nfa_repeat(
+                nfa_union(
+                    nfa_symbol('a'),
+                    nfa_symbol('b')
+                )
+            ),
+            nfa_concat(
+                nfa_symbol('a'),
+                nfa_concat(
+                    nfa_symbol('b'),
+                    nfa_symbol('b')
+                )
+            )
+        )
+    );
+    DFA dfa = subset_construction(nfa);
+    nfa_free(nfa);
+    return dfa;
+}
+
+static char *inputs[] = { "", "abb", "aabb", "babb", "abbaabb", "aabaa", "c", "abbc", "ab" };
+#define NUM_INPUTS (sizeof(inputs) / sizeof(inputs[0]))
+
+Test(frozen_dfa_tests, frozen_dfa_freeze, .timeout = 5)
+{
+    DFA dfa = build_dfa_0();
+    FROZEN_DFA frozen = dfa_freeze(dfa);
+    cr_assert(frozen != NULL, "Expected dfa_freeze to return a frozen DFA.");
+
+    size_t states = frozen_dfa_count_states(frozen);
+    cr_assert(states == dfa_count_states(dfa) + 1, "Expected %lu states (with the dead state). Got %lu.",
+        dfa_count_states(dfa) + 1, states);
+
+    // a and b are the only symbols, plus the class of symbols without transitions
+    size_t classes = frozen_dfa_count_classes(frozen);
+    cr_assert(classes == 3, "Expected 3 symbol classes. Got %lu.", classes);
+
+    for (size_t i = 0; i < NUM_INPUTS; ++i)
+    {
+        int dfa_result = dfa_accept_cstr(dfa, inputs[i]);
+        int frozen_result = frozen_dfa_accept_cstr(frozen, inputs[i]);
+        cr_assert(!dfa_result == !frozen_result, "Expected DFA and frozen DFA to agree on \"%s\". DFA = %d, FROZEN = %d",
+            inputs[i], dfa_result, frozen_result);
+    }
+
+    frozen_dfa_free(frozen);
+    dfa_free(dfa);
+}
+
+Test(frozen_dfa_tests, frozen_dfa_wide_symbols, .timeout = 5)
+{
+    SYMBOL hello[] = { 0x48, 0x4b00, 0x4b01, 0x10000, 0 };
+    SYMBOL partial[] = { 0x48, 0x4b00, 0 };
+    SYMBOL wrong[] = { 0x48, 0x4b00, 0x4b02, 0x10000, 0 };
+
+    NFA nfa = nfa_construct(NFA_CONCAT_MANY(0x48, 0x4b00, 0x4b01, 0x10000));
+    DFA dfa = subset_construction(nfa);
+    FROZEN_DFA frozen = dfa_freeze(dfa);
+
+    cr_assert(frozen_dfa_accept(frozen, hello), "Expected the frozen DFA to accept the wide string.");
+    cr_assert(!frozen_dfa_accept(frozen, partial), "Expected the frozen DFA to reject the prefix.");
+    cr_assert(!frozen_dfa_accept(frozen, wrong), "Expected the frozen DFA to reject the wrong string.");
+
+    uint32_t state = frozen_dfa_start(frozen);
+    state = frozen_dfa_step(frozen, state, 0x4b01);
+    cr_assert(state == FROZEN_DEAD_STATE, "Expected a missing transition to lead to the dead state. Got %u.", state);
+    state = frozen_dfa_step(frozen, state, 0x48);
+    cr_assert(state == FROZEN_DEAD_STATE, "Expected the dead state to be absorbing. Got %u.", state);
+
+    frozen_dfa_free(frozen);
+    dfa_free(dfa);
+    nfa_free(nfa);
+}
+
+Test(frozen_dfa_tests, frozen_dfa_wide_ranges, .timeout = 5)
+{
+    // [\x01-\x{FFFF}]+ is a single transition whatever the size of the range
+    struct symbol_range any = { 0x01, 0xFFFF };
+    NFA nfa = nfa_construct(nfa_repeat_min(nfa_ranges(&any, 1), 1));
+    DFA dfa = subset_construction(nfa);
+    FROZEN_DFA frozen = dfa_freeze(dfa);
+
+    size_t classes = frozen_dfa_count_classes(frozen);
+    cr_assert(classes == 2, "Expected 2 symbol classes. Got %lu.", classes);
+    cr_assert(frozen_dfa_footprint(frozen) < 4096, "Expected a small image. Got %lu bytes.", frozen_dfa_footprint(frozen));
+
+    SYMBOL accepted[] = { 'a', 0xFF, 0x100, 0xFFFF, 0 };
+    SYMBOL rejected[] = { 'a', 0x10000, 0 };
+    cr_assert(frozen_dfa_accept(frozen, accepted), "Expected the frozen DFA to accept the wide string.");
+    cr_assert(!frozen_dfa_accept(frozen, rejected), "Expected the frozen DFA to reject the symbol outside the range.");
+
+    frozen_dfa_free(frozen);
+    dfa_free(dfa);
+    nfa_free(nfa);
+}
+
+Test(frozen_dfa_tests, frozen_dfa_length_delimited, .timeout = 5)
+{
+    // a[\x{100}-\x{FFFF}]*b
+    struct symbol_range wide = { 0x100, 0xFFFF };
+    NFA nfa = nfa_construct(NFA_CONCAT_MANY('a', nfa_repeat(nfa_ranges(&wide, 1)), 'b'));
+    DFA dfa = subset_construction(nfa);
+    FROZEN_DFA frozen = dfa_freeze(dfa);
+
+    uint16_t accepted16[] = { 'a', 0x100, 0xFFFF, 'b' };
+    uint16_t rejected16[] = { 'a', 0xFF, 'b' };
+    SYMBOL accepted[] = { 'a', 0x4b00, 'b' };
+    SYMBOL rejected[] = { 'a', 0x10000, 'b' };
+    cr_assert(frozen_dfa_accept_u16(frozen, accepted16, 4), "Expected the frozen DFA to accept the 16-bit string.");
+    cr_assert(!frozen_dfa_accept_u16(frozen, rejected16, 3), "Expected the frozen DFA to reject the 16-bit string.");
+    cr_assert(dfa_accept_u16(dfa, accepted16, 4), "Expected the DFA to accept the 16-bit string.");
+    cr_assert(nfa_accept_u16(nfa, accepted16, 4), "Expected the NFA to accept the 16-bit string.");
+    cr_assert(frozen_dfa_accept_symbols(frozen, accepted, 3), "Expected the frozen DFA to accept the symbols.");
+    cr_assert(!frozen_dfa_accept_symbols(frozen, rejected, 3), "Expected the frozen DFA to reject the symbols.");
+    cr_assert(!dfa_accept_symbols(dfa, rejected, 3), "Expected the DFA to reject the symbols.");
+    cr_assert(!nfa_accept_symbols(nfa, rejected, 3), "Expected the NFA to reject the symbols.");
+
+    // the string ends at its length, not at the first 0
+    const uint8_t bytes[] = { 'a', 'b', 0, 'b' };
+    int expected[] = { 0, 0, 1, 0, 0 };
+    for (size_t length = 0; length <= 4; ++length)
+    {
+        int results[] = { frozen_dfa_accept_u8(frozen, bytes, length), dfa_accept_u8(dfa, bytes, length),
+            nfa_accept_u8(nfa, bytes, length) };
+        for (size_t i = 0; i < 3; ++i)
+            cr_assert(!results[i] == !expected[length], "Expected %d for length %lu from automaton %lu. Got %d.",
+                expected[length], length, i, results[i]);
+    }
+
+    frozen_dfa_free(frozen);
+    dfa_free(dfa);
+    nfa_free(nfa);
+}
+
+Test(frozen_dfa_tests, frozen_dfa_sink_states, .timeout = 5)
+{
+    // ab[\x01-\xFF]* accepts every c-style continuation of "ab", but not every symbol
+    struct symbol_range bytes = { 0x01, 0xFF };
+    NFA nfa = nfa_construct(NFA_CONCAT_MANY('a', 'b', nfa_repeat(nfa_ranges(&bytes, 1))));
+    DFA dfa = subset_construction(nfa);
+    FROZEN_DFA frozen = dfa_freeze(dfa);
+
+    cr_assert(frozen_dfa_is_dead(frozen, FROZEN_DEAD_STATE), "Expected the dead state to be marked dead.");
+    uint32_t start = frozen_dfa_start(frozen);
+    cr_assert(!frozen_dfa_is_dead(frozen, start), "Expected the start not to be dead.");
+    uint32_t state = frozen_dfa_step(frozen, frozen_dfa_step(frozen, start, 'a'), 'b');
+    cr_assert(frozen_dfa_is_accepting(frozen, state), "Expected \"ab\" to be accepted.");
+    cr_assert(!frozen_dfa_is_universal(frozen, state), "Expected the state after \"ab\" to reject wide symbols.");
+
+    // the executors stop at the sink states, their results are unchanged
+    char text[4096];
+    memset(text, 'z', sizeof(text) - 1);
+    text[sizeof(text) - 1] = '\0';
+    text[0] = 'a', text[1] = 'b';
+    cr_assert(frozen_dfa_accept_cstr(frozen, text), "Expected the long string to be accepted.");
+    text[1] = 'z';
+    cr_assert(!frozen_dfa_accept_cstr(frozen, text), "Expected the long string to be rejected.");
+    const uint8_t binary[] = { 'a', 'b', 'c', 0, 'c' };
+    cr_assert(!frozen_dfa_accept_u8(frozen, binary, 5), "Expected the 0 byte to be rejected.");
+    SYMBOL wide[] = { 'a', 'b', 'c', 0x100, 'c', 0 };
+    cr_assert(!frozen_dfa_accept(frozen, wide), "Expected the wide symbol to be rejected.");
+
+    frozen_dfa_free(frozen);
+    dfa_free(dfa);
+    nfa_free(nfa);
+
+    // a state which every symbol keeps in itself is universal
+    struct symbol_range any[] = { { INT32_MIN, EPSILON - 1 }, { EPSILON + 1, INT32_MAX } };
+    nfa = nfa_construct(NFA_CONCAT('a', nfa_repeat(nfa_ranges(any, 2))));
+    dfa = subset_construction(nfa);
+    frozen = dfa_freeze(dfa);
+
+    state = frozen_dfa_step(frozen, frozen_dfa_start(frozen), 'a');
+    cr_assert(frozen_dfa_is_universal(frozen, state), "Expected the state after 'a' to be universal.");
+    const uint16_t symbols[] = { 'a', 0, 0xFFFF };
+    cr_assert(frozen_dfa_accept_u16(frozen, symbols, 3), "Expected every continuation of 'a' to be accepted.");
+    cr_assert(!frozen_dfa_accept_u16(frozen, symbols + 1, 2), "Expected strings without 'a' to be rejected.");
+
+    frozen_dfa_free(frozen);
+    dfa_free(dfa);
+    nfa_free(nfa);
+}
+
+Test(frozen_dfa_tests, frozen_dfa_save_load, .timeout = 5)
+{
+    char filename[] = "/tmp/frozen_dfa_testXXXXXX";
+    int fd = mkstemp(filename);
+    cr_assert(fd >= 0, "Failed to create a temporary file.");
+    close(fd);
+
+    DFA dfa = build_dfa_0();
+    int ret = dfa_save(dfa, filename);
+    cr_assert(ret == 0, "Expected dfa_save to return zero. Got %d.", ret);
+
+    FROZEN_DFA loaded = dfa_load_mmap(filename);
+    cr_assert(loaded != NULL, "Expected dfa_load_mmap to map the saved image.");
+
+    for (size_t i = 0; i < NUM_INPUTS; ++i)
+    {
+        int dfa_result = dfa_accept_cstr(dfa, inputs[i]);
+        int loaded_result = frozen_dfa_accept_cstr(loaded, inputs[i]);
+        cr_assert(!dfa_result == !loaded_result, "Expected DFA and loaded DFA to agree on \"%s\". DFA = %d, LOADED = %d",
+            inputs[i], dfa_result, loaded_result);
+    }
+
+    frozen_dfa_free(loaded);
+    dfa_free(dfa);
+    unlink(filename);
+}
+
+Test(frozen_dfa_tests, frozen_dfa_load_corrupt, .timeout = 5)
+{
+    char filename[] = "/tmp/frozen_dfa_testXXXXXX";
+    int fd = mkstemp(filename);
+    cr_assert(fd >= 0, "Failed to create a temporary file.");
+    close(fd);
+
+    DFA dfa = build_dfa_0();
+    dfa_save(dfa, filename);
+    dfa_free(dfa);
+
+    // flip a byte in the transition table
+    fd = open(filename, O_RDWR);
+    off_t size = lseek(fd, 0, SEEK_END);
+    unsigned char byte;
+    pread(fd, &byte, 1, size - 16);
+    byte ^= 0x1;
+    pwrite(fd, &byte, 1, size - 16);
+
+    FROZEN_DFA loaded = dfa_load_mmap(filename);
+    cr_assert(loaded == NULL, "Expected dfa_load_mmap to reject a corrupted image.");
+
+    // truncated images are rejected as well
+    ftruncate(fd, size / 2);
+    close(fd);
+    loaded = dfa_load_mmap(filename);
+    cr_assert(loaded == NULL, "Expected dfa_load_mmap to reject a truncated image.");
+
+    loaded = dfa_load_mmap("/tmp/this/file/does/not/exist");
+    cr_assert(loaded == NULL, "Expected dfa_load_mmap to fail on a missing file.");
+
+    unlink(filename);
+}
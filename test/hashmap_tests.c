@@ -0,0 +1,42 @@
+#include <stdint.h>
+
+#include <criterion/criterion.h>
+
+#include "utility/hashmap.h"
+
+DECLARE_HASH_MAP(ID_MAP, id_map, uint32_t, uint64_t, hash_u32, SCALAR_EQ)
+
+#define HASH_MAP_TEST_SIZE (1 << 12)
+Test(hashmap_tests, hashmap_set_get_remove, .timeout = 5)
+{
+    ID_MAP map;
+    id_map_init(&map);
+    cr_assert(id_map_get(&map, 0) == NULL, "Expected an empty map to contain nothing.");
+
+    for (uint32_t i = 0; i < HASH_MAP_TEST_SIZE; ++i) id_map_set(&map, i, i);
+    // overwriting keeps the size
+    for (uint32_t i = 0; i < HASH_MAP_TEST_SIZE; ++i) id_map_set(&map, i, (uint64_t) i * i);
+    cr_assert(map.size == HASH_MAP_TEST_SIZE, "Expected size %d. Got %lu.", HASH_MAP_TEST_SIZE, map.size);
+
+    for (uint32_t i = 0; i < HASH_MAP_TEST_SIZE; i += 3)
+        cr_assert(id_map_remove(&map, i) == 0, "Expected %u to be removed.", i);
+    cr_assert(id_map_remove(&map, 0) != 0, "Expected a missing key to not be removed.");
+
+    for (uint32_t i = 0; i < HASH_MAP_TEST_SIZE; ++i)
+    {
+        uint64_t *value = id_map_get(&map, i);
+        if (i % 3 == 0) cr_assert(value == NULL, "Expected %u to be removed.", i);
+        else cr_assert(value && *value == (uint64_t) i * i, "Expected the value of %u to be %lu.", i, (uint64_t) i * i);
+    }
+
+    size_t cursor = 0, count = 0;
+    uint32_t key;
+    uint64_t value;
+    while (id_map_next(&map, &cursor, &key, &value))
+    {
+        cr_assert(value == (uint64_t) key * key, "Expected the value of %u to be its square.", key);
+        count++;
+    }
+    cr_assert(count == map.size, "Expected %lu pairs. Got %lu.", map.size, count);
+    id_map_fini(&map);
+}
@@ -0,0 +1,39 @@
+#include <stdint.h>
+
+#include <criterion/criterion.h>
+
+#include "utility/hashset.h"
+
+DECLARE_HASH_SET(ID_SET, id_set, uint32_t, hash_u32, SCALAR_EQ)
+
+#define HASH_SET_TEST_SIZE (1 << 12)
+Test(hashset_tests, hashset_add_remove, .timeout = 5)
+{
+    ID_SET set;
+    id_set_init(&set);
+    cr_assert(!id_set_contains(&set, 0), "Expected an empty set to contain nothing.");
+
+    for (uint32_t i = 0; i < HASH_SET_TEST_SIZE; ++i)
+        cr_assert(id_set_add(&set, i) == 0, "Expected %u to be added.", i);
+    cr_assert(id_set_add(&set, 0) != 0, "Expected a duplicate to be rejected.");
+    cr_assert(set.size == HASH_SET_TEST_SIZE, "Expected size %d. Got %lu.", HASH_SET_TEST_SIZE, set.size);
+
+    // removing every other key must keep the remaining keys reachable
+    for (uint32_t i = 0; i < HASH_SET_TEST_SIZE; i += 2)
+        cr_assert(id_set_remove(&set, i) == 0, "Expected %u to be removed.", i);
+    for (uint32_t i = 0; i < HASH_SET_TEST_SIZE; ++i)
+        cr_assert(!id_set_contains(&set, i) == (i % 2 == 0), "Expected contains(%u) to be %d.", i, i % 2);
+
+    size_t cursor = 0, count = 0;
+    uint32_t key;
+    while (id_set_next(&set, &cursor, &key))
+    {
+        cr_assert(key % 2 == 1, "Expected only odd keys. Got %u.", key);
+        count++;
+    }
+    cr_assert(count == HASH_SET_TEST_SIZE / 2, "Expected %d keys. Got %lu.", HASH_SET_TEST_SIZE / 2, count);
+
+    id_set_clear(&set);
+    cr_assert(set.size == 0 && !id_set_contains(&set, 1), "Expected a cleared set to be empty.");
+    id_set_fini(&set);
+}
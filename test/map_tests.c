@@ -326,4 +326,50 @@ Test(map_tests, map_values_simple, .timeout = 5)
 
     free(buf);
     map_fini(map);
-}
\ No newline at end of file
+}
+
+Test(map_tests, map_inline_spill, .timeout = 5)
+{
+    MAP map = map_init();
+
+    // crosses the boundary between the inline pairs and the hash table both ways
+    for (int round = 0; round < 3; ++round)
+    {
+        for (int i = -2; i < 10; ++i)
+            map_add(map, i * 1000, PTR(i + 3));
+        for (int i = -2; i < 10; ++i)
+            cr_assert(map_get(map, i * 1000) == PTR(i + 3), "Expected key %d to be in the map.", i * 1000);
+
+        size_t count = 0;
+        MAP_ITERATOR iter = map_iterator_init(map);
+        while (map_iterator_has_next(iter))
+        {
+            map_iterator_next(iter, NULL, NULL);
+            count++;
+        }
+        map_iterator_fini(iter);
+        cr_assert(count == 12, "Expected 12 pairs. Got %lu.", count);
+
+        for (int i = -2; i < 10; ++i)
+            cr_assert(map_remove(map, i * 1000) == 0, "Expected key %d to be removed.", i * 1000);
+        cr_assert(map_size(map) == 0, "Expected an empty map. Got %lu.", map_size(map));
+    }
+    map_fini(map);
+}
+
+#define MAP_TOMBSTONE_CHURN_COUNT 100000
+Test(map_tests, map_tombstone_churn, .timeout = 5)
+{
+    MAP map = map_init();
+    for (int i = 0; i < 8; ++i) map_add(map, -i - 1, PTR(1));
+
+    // removed keys must not pile up and slow down or break the lookups
+    for (int i = 0; i < MAP_TOMBSTONE_CHURN_COUNT; ++i)
+    {
+        map_add(map, i, PTR(i + 1));
+        cr_assert(map_remove(map, i) == 0, "Expected key %d to be removed.", i);
+    }
+    cr_assert(map_size(map) == 8, "Expected 8 pairs. Got %lu.", map_size(map));
+    cr_assert(!map_contains_key(map, MAP_TOMBSTONE_CHURN_COUNT), "Expected a missing key to be reported missing.");
+    map_fini(map);
+}
@@ -1,5 +1,8 @@
 #include <criterion/criterion.h>
 
+#include <stdio.h>
+#include <stdlib.h>
+
 #include "automata/nfa.h"
 
 /**
@@ -243,4 +246,93 @@ Test(nfa_component_tests, component_simple_3, .timeout = 5)
     cr_assert(ret != 0, "Expected nfa_accept for \"%s\" to return nonzero. Got %d", input, ret);
 
     nfa_free(nfa);
-}
\ No newline at end of file
+}
+
+Test(nfa_component_tests, component_sharing, .timeout = 5)
+{
+    NFA_COMPONENT a = nfa_symbol('a');
+    NFA_COMPONENT b = nfa_symbol('a');
+    cr_assert(a == b, "Expected identical symbols to share a component. Got %p and %p", a, b);
+
+    SYMBOL forward[] = { 'x', 'y', 'z' }, backward[] = { 'z', 'y', 'x', 'x' };
+    NFA_COMPONENT c = nfa_symbols(forward, 3);
+    NFA_COMPONENT d = nfa_symbols(backward, 4);
+    cr_assert(c == d, "Expected equal symbol sets to share a component. Got %p and %p", c, d);
+
+    NFA_COMPONENT e = nfa_concat(a, c);
+    NFA_COMPONENT f = nfa_concat(b, d);
+    cr_assert(e == f, "Expected identical concatenations to share a component. Got %p and %p", e, f);
+
+    NFA nfa = nfa_construct(nfa_union(e, f));
+
+    char *input = "ay";
+    int ret = nfa_accept_cstr(nfa, input);
+    cr_assert(ret != 0, "Expected nfa_accept for \"%s\" to return nonzero. Got %d", input, ret);
+
+    nfa_free(nfa);
+}
+
+/**
+ * Using the following regex:
+ *  (a|b){1000}
+ */
+Test(nfa_component_tests, component_large_repeat, .timeout = 5)
+{
+    NFA nfa = nfa_construct(nfa_repeat_exact(nfa_union(nfa_symbol('a'), nfa_symbol('b')), 1000));
+
+    char input[1001];
+    for (size_t i = 0; i < 1000; ++i) input[i] = i % 3 ? 'a' : 'b';
+    input[1000] = '\0';
+
+    int ret = nfa_accept_cstr(nfa, input);
+    cr_assert(ret != 0, "Expected nfa_accept for 1000 symbols to return nonzero. Got %d", ret);
+
+    input[999] = '\0';
+    ret = nfa_accept_cstr(nfa, input);
+    cr_assert(ret == 0, "Expected nfa_accept for 999 symbols to return zero. Got %d", ret);
+
+    nfa_free(nfa);
+}
+
+/**
+ * Using the following regex, built by repeated binary unions and concatenations:
+ *  k0|k1|k2|...|k99999
+ */
+Test(nfa_component_tests, component_deep_keyword_union, .timeout = 60)
+{
+    NFA_COMPONENT keywords = NULL;
+    for (size_t i = 0; i < 100000; ++i)
+    {
+        char keyword[16];
+        snprintf(keyword, sizeof(keyword), "k%lu", i);
+        NFA_COMPONENT word = nfa_symbol(keyword[0]);
+        for (size_t j = 1; keyword[j]; ++j)
+            word = nfa_concat(word, nfa_symbol(keyword[j]));
+        keywords = keywords ? nfa_union(keywords, word) : word;
+    }
+    NFA nfa = nfa_construct(keywords);
+
+    const char *inputs[] = { "k0", "k99999", "k31415", "k100000", "k", "x1" };
+    int expected[] = { 1, 1, 1, 0, 0, 0 };
+    for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); ++i)
+    {
+        int ret = nfa_accept_cstr(nfa, (char*) inputs[i]);
+        cr_assert(!ret == !expected[i], "Expected nfa_accept for \"%s\" to return %d. Got %d", inputs[i], expected[i], ret);
+    }
+    nfa_free(nfa);
+
+    // a left-deep chain of 100000 concatenations
+    NFA_COMPONENT chain = nfa_symbol('a');
+    for (size_t i = 1; i < 100000; ++i)
+        chain = nfa_concat(chain, nfa_symbol(i % 2 ? 'b' : 'a'));
+    nfa = nfa_construct(chain);
+
+    char *input = malloc(100001);
+    for (size_t i = 0; i < 100000; ++i) input[i] = i % 2 ? 'b' : 'a';
+    input[100000] = '\0';
+    int ret = nfa_accept_cstr(nfa, input);
+    cr_assert(ret != 0, "Expected nfa_accept for the whole chain to return nonzero. Got %d", ret);
+
+    free(input);
+    nfa_free(nfa);
+}
@@ -1,5 +1,7 @@
 #include <criterion/criterion.h>
 
+#include <stddef.h>
+
 #include "automata/nfa.h"
 
 /**
@@ -803,4 +805,90 @@ Test(nfa_sim_tests, nfa_sim_simple_2e, .timeout = 5)
     cr_assert(status == 0, "Expected status to be zero. Got %d", status);
 
     nfa_free(nfa);
-}
\ No newline at end of file
+}
+
+/**
+ * The following NFA matches (ab)* (Starting A)
+ *
+ * [[A]] --'a'--> [B] --'b'--> [C] --eps--> [[A]]
+ */
+Test(nfa_sim_tests, nfa_sim_scratch, .timeout = 5)
+{
+    NSTATE A = nstate_new();
+    NSTATE B = nstate_new();
+    NSTATE C = nstate_new();
+
+    nstate_add_transition(A, 'a', B);
+    nstate_add_transition(B, 'b', C);
+    nstate_add_transition(C, EPSILON, A);
+
+    NSTATE accepting_states[] = { A };
+    NFA nfa = nfa_new(A, accepting_states, 1);
+
+    size_t size = nfa_sim_scratch_size(nfa);
+    _Alignas(max_align_t) unsigned char scratch[1024];
+    cr_assert(size <= sizeof(scratch), "Expected a small scratch space. Got %lu bytes.", size);
+    cr_assert(nfa_sim_init_scratch(nfa, scratch, size - 1) == NULL, "Expected too little scratch space to be rejected.");
+    cr_assert(nfa_sim_init_scratch(nfa, scratch + 1, size) == NULL, "Expected misaligned scratch space to be rejected.");
+
+    NFA_SIM sim = nfa_sim_init_scratch(nfa, scratch, size);
+    cr_assert(sim != NULL, "Expected the simulator to fit into %lu bytes.", size);
+    cr_assert(nfa_sim_status(sim) == SIM_SUCCESS, "Expected the empty input to be accepted.");
+
+    // the same simulator is reused for every input
+    const char *inputs[] = { "ab", "aba", "abab", "b", "" };
+    SIM_STATUS expected[] = { SIM_SUCCESS, SIM_FAILURE, SIM_SUCCESS, SIM_FAILURE, SIM_SUCCESS };
+    for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); ++i)
+    {
+        nfa_sim_reset(sim);
+        for (const char *c = inputs[i]; *c; ++c)
+            nfa_sim_step(sim, *c);
+        SIM_STATUS status = nfa_sim_status(sim);
+        cr_assert(status == expected[i], "Expected status %d on \"%s\". Got %d.", expected[i], inputs[i], status);
+    }
+
+    SIM_STATUS status = nfa_sim_fini(sim);
+    cr_assert(status == SIM_SUCCESS, "Expected the final status to be %d. Got %d", SIM_SUCCESS, status);
+
+    nfa_free(nfa);
+}
+
+/**
+ * The following NFA has several targets per symbol, a range and an epsilon cycle
+ * (Starting A)
+ *
+ * [A] --'a'--> [B] --'x'--> [[F]]
+ *  |---'a'--> [C] <--eps--> [E] --'y'--> [[F]]
+ *  |---'c'-'z'--> [D] --'x'--> [[F]]
+ */
+Test(nfa_sim_tests, nfa_sim_transition_lists, .timeout = 5)
+{
+    NSTATE A = nstate_new();
+    NSTATE B = nstate_new();
+    NSTATE C = nstate_new();
+    NSTATE D = nstate_new();
+    NSTATE E = nstate_new();
+    NSTATE F = nstate_new();
+
+    nstate_add_transition(A, 'a', B);
+    nstate_add_transition(A, 'a', C);
+    nstate_add_range_transition(A, 'c', 'z', D);
+    nstate_add_transition(B, 'x', F);
+    nstate_add_transition(C, EPSILON, E);
+    nstate_add_transition(E, EPSILON, C);
+    nstate_add_transition(E, 'y', F);
+    nstate_add_transition(D, 'x', F);
+
+    NSTATE accepting_states[] = { F };
+    NFA nfa = nfa_new(A, accepting_states, 1);
+
+    const char *inputs[] = { "ax", "ay", "cx", "zx", "by", "az", "a", "axx" };
+    int expected[] = { 1, 1, 1, 1, 0, 0, 0, 0 };
+    for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); ++i)
+    {
+        int result = nfa_accept_cstr(nfa, (char*) inputs[i]);
+        cr_assert(result == expected[i], "Expected %d on \"%s\". Got %d.", expected[i], inputs[i], result);
+    }
+
+    nfa_free(nfa);
+}
@@ -1,5 +1,7 @@
 #include <criterion/criterion.h>
 
+#include <string.h>
+
 #include "automata/nfa.h"
 
 /**
@@ -182,7 +184,7 @@ Test(nfa_tests, nfa_get_starting_state_simple, .timeout = 5)
     nfa_free(nfa);
 }
 
-static int nstate_arr_eq(NSTATE *arr1, size_t arr1_sz, NSTATE *arr2, size_t arr2_sz)
+static int nstate_arr_eq(const NSTATE *arr1, size_t arr1_sz, const NSTATE *arr2, size_t arr2_sz)
 {
     if (arr1_sz != arr2_sz) return 0;
     for (size_t i = 0; i < arr1_sz; ++i)
@@ -281,4 +283,78 @@ Test(nfa_tests, nfa_all_states_simple, .timeout = 5)
 
     free(all);
     nfa_free(nfa);
-}
\ No newline at end of file
+}
+
+Test(nfa_tests, nfa_view_states_simple, .timeout = 5)
+{
+    NSTATE A = nstate_new();
+    NSTATE B = nstate_new();
+    NSTATE C = nstate_new();
+
+    nstate_add_transition(A, 'a', B);
+    nstate_add_transition(A, EPSILON, C);
+    nstate_add_transition(B, 'b', C);
+
+    NSTATE accepting_states[] = { B, C };
+    NFA nfa = nfa_new(A, accepting_states, 2);
+
+    NSTATE all_states[] = { A, B, C };
+    cr_assert(nstate_arr_eq(all_states, 3, nfa_view_states(nfa), nfa_count_states(nfa)),
+        "Expected the view of all states to match.");
+    cr_assert(nstate_arr_eq(accepting_states, 2, nfa_view_accepting_states(nfa), nfa_count_accepting_states(nfa)),
+        "Expected the view of the accepting states to match.");
+
+    nfa_free(nfa);
+}
+
+Test(nfa_tests, nfa_million_state_chain, .timeout = 30)
+{
+    // a chain this long would overflow the stack of any recursive traversal
+    size_t length = 1 << 20;
+    NFA nfa = nfa_construct(nfa_repeat_exact(nfa_symbol('a'), length));
+    cr_assert(nfa != NULL, "Expected the chain to be constructed.");
+    cr_assert(nfa_count_states(nfa) == length + 1, "Expected %lu states. Got %lu.", length + 1, nfa_count_states(nfa));
+
+    // the states are numbered in breadth-first order, i.e. along the chain
+    NSTATE state = nfa_get_starting_state(nfa);
+    for (size_t i = 0; i < 16; ++i)
+    {
+        cr_assert(nstate_id(state) == (int) i, "Expected state %lu of the chain to have id %lu. Got %d.", i, i, nstate_id(state));
+        size_t count;
+        state = nstate_view_transition_states(state, 'a', &count)[0];
+    }
+
+    char *input = malloc(length + 2);
+    memset(input, 'a', length);
+    input[length] = '\0';
+    cr_assert(nfa_accept_cstr(nfa, input), "Expected %lu symbols to be accepted.", length);
+    input[length] = 'a';
+    input[length + 1] = '\0';
+    cr_assert(!nfa_accept_cstr(nfa, input), "Expected %lu symbols to be rejected.", length + 1);
+    free(input);
+
+    nfa_free(nfa);
+}
+
+Test(nfa_tests, nfa_wide_union, .timeout = 30)
+{
+    // a union of many keywords is a single component, however many alternatives there are
+    size_t count = 100000;
+    NFA_COMPONENT *keywords = malloc(count * sizeof(NFA_COMPONENT));
+    for (size_t i = 0; i < count; ++i)
+    {
+        NFA_COMPONENT letters[4];
+        for (size_t j = 0, k = i; j < 4; ++j, k /= 26)
+            letters[j] = nfa_symbol('a' + k % 26);
+        keywords[i] = nfa_concat_array(letters, 4);
+    }
+    NFA nfa = nfa_construct(nfa_union_array(keywords, count));
+    free(keywords);
+    cr_assert(nfa != NULL, "Expected the union to be constructed.");
+
+    cr_assert(nfa_accept_cstr(nfa, "dyrf"), "Expected keyword 99999 to be accepted.");
+    cr_assert(nfa_accept_cstr(nfa, "aaaa"), "Expected keyword 0 to be accepted.");
+    cr_assert(!nfa_accept_cstr(nfa, "zzzz"), "Expected a word outside of the union to be rejected.");
+
+    nfa_free(nfa);
+}
@@ -1,5 +1,7 @@
 #include <criterion/criterion.h>
 
+#include <string.h>
+
 #include "automata/nfa.h"
 
 Test(nstate_tests, nstate_lifetime, .timeout = 5)
@@ -10,6 +12,21 @@ Test(nstate_tests, nstate_lifetime, .timeout = 5)
     cr_assert(ret == 0, "Expected nstate_free to return 0. Got %d.", ret);   
 }
 
+Test(nstate_tests, nstate_debug_tag, .timeout = 5)
+{
+    NSTATE tagged = nstate_debug_new("tagged");
+    NSTATE untagged = nstate_new();
+    cr_assert(nstate_tag(tagged) != NULL && !strcmp(nstate_tag(tagged), "tagged"), "Expected the tag to be \"tagged\".");
+    cr_assert(nstate_tag(untagged) == NULL, "Expected an untagged state to have no tag.");
+
+    nstate_free(tagged);
+    // a state reusing the memory of a freed tagged state must not inherit its tag
+    NSTATE reused = nstate_new();
+    cr_assert(nstate_tag(reused) == NULL, "Expected a new state to have no tag.");
+    nstate_free(reused);
+    nstate_free(untagged);
+}
+
 /**
  * Building the following automaton 
  *                   a
@@ -563,7 +580,7 @@ Test(nstate_tests, nstate_transition_symbols_simple_1, .timeout = 5)
     nstate_free(E);
 }
 
-static int nstate_arr_eq(NSTATE *arr1, size_t arr1_sz, NSTATE *arr2, size_t arr2_sz)
+static int nstate_arr_eq(const NSTATE *arr1, size_t arr1_sz, const NSTATE *arr2, size_t arr2_sz)
 {
     if (arr1_sz != arr2_sz) return 0;
     for (size_t i = 0; i < arr1_sz; ++i)
@@ -688,4 +705,79 @@ Test(nstate_tests, nstate_transition_states_simple_1, .timeout = 5)
     nstate_free(C);
     nstate_free(D);
     nstate_free(E);
-}
\ No newline at end of file
+}
+
+Test(nstate_tests, nstate_view_transitions, .timeout = 5)
+{
+    NSTATE A = nstate_new();
+    NSTATE B = nstate_new();
+    NSTATE C = nstate_new();
+
+    nstate_add_transition(A, EPSILON, B);
+    nstate_add_transition(A, EPSILON, C);
+    nstate_add_transition(A, 'a', C);
+
+    size_t sz;
+    const NSTATE *states = nstate_view_transition_states(A, EPSILON, &sz);
+    NSTATE expected[] = { B, C };
+    cr_assert(nstate_arr_eq(expected, 2, states, sz), "Transition states do not match!");
+
+    states = nstate_view_transition_states(A, 'b', &sz);
+    cr_assert(states == NULL && sz == 0, "Expected no transition states on 'b'. Got %lu.", sz);
+
+    // every symbol is visited once together with its states
+    int seen_epsilon = 0, seen_a = 0;
+    SYMBOL sym;
+    struct nstate_transition_iterator iter;
+    nstate_transition_iterator_begin(&iter, A);
+    while (nstate_transition_iterator_next(&iter, &sym, &states, &sz))
+    {
+        if (sym == EPSILON)
+        {
+            seen_epsilon++;
+            cr_assert(nstate_arr_eq(expected, 2, states, sz), "Transition states do not match!");
+        }
+        else if (sym == 'a')
+        {
+            seen_a++;
+            cr_assert(sz == 1 && states[0] == C, "Expected a single transition to C on 'a'.");
+        }
+        else cr_assert(0, "Unexpected transition symbol %d.", sym);
+    }
+    cr_assert(seen_epsilon == 1 && seen_a == 1, "Expected every symbol once. Got %d and %d.", seen_epsilon, seen_a);
+
+    nstate_free(A);
+    nstate_free(B);
+    nstate_free(C);
+}
+
+Test(nstate_tests, nstate_range_transitions, .timeout = 5)
+{
+    NSTATE A = nstate_new();
+    NSTATE B = nstate_new();
+    NSTATE C = nstate_new();
+
+    cr_assert(!nstate_add_range_transition(A, 'a', 'z', B), "Expected the range transition to be added.");
+    cr_assert(!nstate_add_range_transition(A, 'm', 0xFFFF, C), "Expected an overlapping range transition to be added.");
+    cr_assert(nstate_add_range_transition(A, 'a', 'z', B), "Expected a duplicate range transition to be rejected.");
+    cr_assert(nstate_add_range_transition(A, 'z', 'a', B), "Expected an empty range to be rejected.");
+    cr_assert(nstate_add_range_transition(A, EPSILON, 'a', B), "Expected a range containing epsilon to be rejected.");
+
+    // a range of one symbol is an ordinary transition
+    cr_assert(!nstate_add_range_transition(A, '0', '0', C), "Expected the single symbol range to be added.");
+    cr_assert(nstate_has_transition(A, '0', C), "Expected a transition on '0'.");
+
+    size_t sz;
+    const struct nstate_range_transition *ranges = nstate_view_range_transitions(A, &sz);
+    cr_assert(sz == 2, "Expected 2 range transitions. Got %lu.", sz);
+    cr_assert(ranges[0].lo == 'a' && ranges[0].hi == 'z' && ranges[0].to == B, "Expected [a-z] to B first.");
+    cr_assert(ranges[1].lo == 'm' && ranges[1].hi == 0xFFFF && ranges[1].to == C, "Expected [m-0xFFFF] to C second.");
+
+    nstate_clear_all_transitions(A);
+    ranges = nstate_view_range_transitions(A, &sz);
+    cr_assert(ranges == NULL && sz == 0, "Expected no range transitions after clearing. Got %lu.", sz);
+
+    nstate_free(A);
+    nstate_free(B);
+    nstate_free(C);
+}
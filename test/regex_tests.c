@@ -0,0 +1,624 @@
+#include <criterion/criterion.h>
+
+#include <stddef.h>
+#include <string.h>
+
+#include "regex/regex.h"
+
+struct normalize_case
+{
+    const char *pattern;
+    const char *normalized;
+};
+
+Test(regex_tests, regex_normalize_simple, .timeout = 5)
+{
+    struct normalize_case cases[] = {
+        { "abc", "abc" },
+        { "(a)(b)((c))", "abc" },
+        { "a{1}b{0,}c{1,}d{0,1}", "ab*c+d?" },
+        { "a{2,2}", "a{2}" },
+        { "(a|b)|c", "a|b|c" },
+        { "[cba]", "[a-c]" },
+        { "[a-cb-d]", "[a-d]" },
+        { "[ab]", "[ab]" },
+        { "[.]", "\\." },
+        { "\\x41", "A" },
+        { "[^\\n]", "." },
+        { "(ab)*", "(ab)*" },
+        { "(a*)*", "(a*)*" },
+        { "a()b", "ab" },
+        { "\\d+", "[0-9]+" },
+    };
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i)
+    {
+        char *normalized = regex_normalize(cases[i].pattern, REGEX_DEFAULT);
+        cr_assert(normalized != NULL, "Expected \"%s\" to be valid.", cases[i].pattern);
+        cr_assert(!strcmp(normalized, cases[i].normalized), "Expected \"%s\" to normalize to \"%s\". Got \"%s\".",
+            cases[i].pattern, cases[i].normalized, normalized);
+        free(normalized);
+    }
+}
+
+Test(regex_tests, regex_normalize_invalid, .timeout = 5)
+{
+    const char *patterns[] = { "(a", "a)", "*a", "a{2,1}", "[a", "[]", "\\", "\\q", "a{1001}", "[z-a]" };
+
+    for (size_t i = 0; i < sizeof(patterns) / sizeof(patterns[0]); ++i)
+    {
+        char *normalized = regex_normalize(patterns[i], REGEX_DEFAULT);
+        cr_assert(normalized == NULL, "Expected \"%s\" to be invalid. Got \"%s\".", patterns[i], normalized);
+
+        REGEX regex = regex_compile(patterns[i], REGEX_DEFAULT);
+        cr_assert(regex == NULL, "Expected compiling \"%s\" to fail.", patterns[i]);
+    }
+}
+
+// the normalized pattern must match the same strings as the original pattern
+Test(regex_tests, regex_normalize_roundtrip, .timeout = 5)
+{
+    const char *patterns[] = { "[^a-y]x", "(a|b)*abb", "\\w+@\\w+\\.(com|org)", "[\\x01-\\xFF]*", "a{2,3}|()" };
+    const char *inputs[] = { "", "zx", "ax", "abb", "aabb", "me@host.org", "me@host.net", "aa", "aaa", "aaaa", "\xFF" };
+
+    for (size_t i = 0; i < sizeof(patterns) / sizeof(patterns[0]); ++i)
+    {
+        char *normalized = regex_normalize(patterns[i], REGEX_DEFAULT);
+        REGEX original = regex_compile(patterns[i], REGEX_DEFAULT);
+        REGEX renormalized = regex_compile(normalized, REGEX_DEFAULT);
+        cr_assert(renormalized != NULL, "Expected \"%s\" to be valid.", normalized);
+
+        for (size_t j = 0; j < sizeof(inputs) / sizeof(inputs[0]); ++j)
+        {
+            int a = regex_match(original, inputs[j]);
+            int b = regex_match(renormalized, inputs[j]);
+            cr_assert(!a == !b, "Expected \"%s\" and \"%s\" to agree on \"%s\".", patterns[i], normalized, inputs[j]);
+        }
+
+        regex_release(original);
+        regex_release(renormalized);
+        free(normalized);
+    }
+}
+
+struct match_case
+{
+    const char *pattern;
+    const char *input;
+    int expected;
+};
+
+static struct match_case match_cases[] = {
+    { "(a|b)*abb", "babb", 1 },
+    { "(a|b)*abb", "abba", 0 },
+    { "(ab|cd){2,}dcb", "abcddcb", 1 },
+    { "(ab|cd){2,}dcb", "abdcb", 0 },
+    { "a{2,3}", "a", 0 },
+    { "a{2,3}", "aaa", 1 },
+    { "a{2,3}", "aaaa", 0 },
+    { "colou?r", "color", 1 },
+    { "colou?r", "colour", 1 },
+    { "[a-z]+[0-9]", "abc1", 1 },
+    { "[^0-9]+", "abc1", 0 },
+    { "a.c", "a\nc", 0 },
+    { "a.c", "a-c", 1 },
+    { "\\d{3}-\\d{4}", "555-1234", 1 },
+    { "x|", "", 1 },
+    { "a{0}b", "b", 1 },
+};
+
+Test(regex_tests, regex_match_dfa, .timeout = 5)
+{
+    for (size_t i = 0; i < sizeof(match_cases) / sizeof(match_cases[0]); ++i)
+    {
+        REGEX regex = regex_compile(match_cases[i].pattern, REGEX_DFA);
+        cr_assert(regex != NULL, "Expected \"%s\" to compile.", match_cases[i].pattern);
+
+        int result = regex_match(regex, match_cases[i].input);
+        cr_assert(!result == !match_cases[i].expected, "Expected \"%s\" on \"%s\" to yield %d. Got %d.",
+            match_cases[i].pattern, match_cases[i].input, match_cases[i].expected, result);
+        regex_release(regex);
+    }
+}
+
+Test(regex_tests, regex_match_nfa, .timeout = 5)
+{
+    for (size_t i = 0; i < sizeof(match_cases) / sizeof(match_cases[0]); ++i)
+    {
+        REGEX regex = regex_compile(match_cases[i].pattern, REGEX_NFA);
+        cr_assert(regex != NULL, "Expected \"%s\" to compile.", match_cases[i].pattern);
+
+        int result = regex_match(regex, match_cases[i].input);
+        cr_assert(!result == !match_cases[i].expected, "Expected \"%s\" on \"%s\" to yield %d. Got %d.",
+            match_cases[i].pattern, match_cases[i].input, match_cases[i].expected, result);
+        regex_release(regex);
+    }
+}
+
+Test(regex_tests, regex_match_scratch, .timeout = 5)
+{
+    REGEX nfa = regex_compile("(a|b)*abb", REGEX_NFA);
+    REGEX dfa = regex_compile("(a|b)*abb", REGEX_DFA);
+    cr_assert(regex_scratch_size(dfa) == 0, "Expected a DFA to match without scratch space.");
+
+    size_t size = regex_scratch_size(nfa);
+    void *scratch = aligned_alloc(_Alignof(max_align_t), 1024);
+    cr_assert(size > 0 && size <= 1024, "Expected a small scratch space. Got %lu bytes.", size);
+    cr_assert(regex_match_scratch(nfa, "abb", scratch, size - 1) < 0, "Expected too little scratch space to be rejected.");
+
+    // the scratch space is reused for every match
+    const char *inputs[] = { "abb", "babb", "ab", "aabbabb", "" };
+    for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); ++i)
+    {
+        int expected = regex_match(dfa, inputs[i]);
+        int result = regex_match_scratch(nfa, inputs[i], scratch, size);
+        cr_assert(result == expected, "Expected %d on \"%s\". Got %d.", expected, inputs[i], result);
+        cr_assert(regex_match_scratch(dfa, inputs[i], NULL, 0) == expected, "Expected the DFA to ignore the scratch space.");
+    }
+
+    free(scratch);
+    regex_release(nfa);
+    regex_release(dfa);
+}
+
+Test(regex_tests, regex_reference_counting, .timeout = 5)
+{
+    REGEX regex = regex_compile("ab*", REGEX_DEFAULT);
+    REGEX other = regex_retain(regex);
+    cr_assert(other == regex, "Expected regex_retain to return the same regex.");
+
+    regex_release(regex);
+    cr_assert(regex_match(other, "abbb"), "Expected the retained regex to remain usable.");
+    regex_release(other);
+}
+
+Test(regex_tests, regex_match_tiered, .timeout = 5)
+{
+    for (size_t i = 0; i < sizeof(match_cases) / sizeof(match_cases[0]); ++i)
+    {
+        REGEX regex = regex_compile(match_cases[i].pattern, REGEX_TIERED);
+        cr_assert(regex != NULL, "Expected \"%s\" to compile.", match_cases[i].pattern);
+
+        // matches before, while and after the promotion agree
+        int before = regex_match(regex, match_cases[i].input);
+        cr_assert(regex_wait_promotion(regex), "Expected \"%s\" to be promoted to a DFA.", match_cases[i].pattern);
+        int after = regex_match(regex, match_cases[i].input);
+        cr_assert(!before == !match_cases[i].expected && !after == !match_cases[i].expected,
+            "Expected \"%s\" on \"%s\" to yield %d. Got %d before and %d after the promotion.",
+            match_cases[i].pattern, match_cases[i].input, match_cases[i].expected, before, after);
+        regex_release(regex);
+    }
+
+    REGEX regex = regex_compile("a*b", REGEX_TIERED | REGEX_NFA);
+    cr_assert(!regex_wait_promotion(regex), "Expected REGEX_NFA to disable the promotion.");
+    regex_release(regex);
+}
+
+Test(regex_tests, regex_tiered_release_early, .timeout = 5)
+{
+    // the regex must outlive its last reference until the background thread is done
+    for (int i = 0; i < 32; ++i)
+    {
+        REGEX regex = regex_compile("(a|b)*a(a|b){6}", REGEX_TIERED);
+        regex_match(regex, "abababab");
+        regex_release(regex);
+    }
+}
+
+Test(regex_tests, regex_nesting_limit, .timeout = 10)
+{
+    size_t levels = 100000;
+    char *pattern = malloc(2 * levels + 2);
+
+    // too deeply nested groups are rejected like any other invalid pattern
+    memset(pattern, '(', levels);
+    pattern[levels] = 'a';
+    memset(pattern + levels + 1, ')', levels);
+    pattern[2 * levels + 1] = '\0';
+    cr_assert(regex_compile(pattern, REGEX_DEFAULT) == NULL, "Expected %lu nested groups to be rejected.", levels);
+
+    // groups within the limit are fine
+    size_t shallow = 500;
+    memmove(pattern + shallow, pattern + levels, shallow + 1);
+    pattern[2 * shallow + 1] = '\0';
+    REGEX regex = regex_compile(pattern, REGEX_DEFAULT);
+    cr_assert(regex != NULL, "Expected %lu nested groups to compile.", shallow);
+    cr_assert(regex_match(regex, "a"), "Expected %lu nested groups to match \"a\".", shallow);
+    regex_release(regex);
+
+    // stacked quantifiers fold into a single repetition however many there are
+    const char quantifiers[] = { '*', '?' };
+    for (size_t q = 0; q < sizeof(quantifiers); ++q)
+    {
+        pattern[0] = 'a';
+        memset(pattern + 1, quantifiers[q], levels);
+        pattern[levels + 1] = '\0';
+        regex = regex_compile(pattern, REGEX_DEFAULT);
+        cr_assert(regex != NULL, "Expected \"a\" followed by %lu '%c' to compile.", levels, quantifiers[q]);
+        cr_assert(regex_match(regex, "") && regex_match(regex, "a"), "Expected the stacked quantifiers to match.");
+        cr_assert(!regex_match(regex, "aa") == (quantifiers[q] == '?'), "Expected \"aa\" to match a** only.");
+        regex_release(regex);
+    }
+
+    // a counted quantifier followed by `?` leaves gaps, so only every other quantifier folds
+    pattern[0] = 'a';
+    for (size_t i = 0; i < 2000; ++i)
+        memcpy(pattern + 1 + 6 * i, "{3,4}?", 6);
+    pattern[1 + 6 * 2000] = '\0';
+    regex = regex_compile(pattern, REGEX_NFA);
+    cr_assert(regex != NULL, "Expected 2000 counted quantifiers to compile.");
+    cr_assert(regex_match(regex, "") && !regex_match(regex, "aa"), "Expected the counted quantifiers to match.");
+    regex_release(regex);
+
+    free(pattern);
+}
+
+Test(regex_tests, regex_analyze_blowup, .timeout = 5)
+{
+    struct regex_analysis analysis;
+
+    cr_assert(!regex_analyze("hello", REGEX_DEFAULT, &analysis), "Expected \"hello\" to be analyzed.");
+    cr_assert(analysis.is_literal && analysis.literal_length == 5, "Expected a literal of 5 bytes.");
+    cr_assert(analysis.ambiguous_positions == 0, "Expected no ambiguous positions. Got %lu.", analysis.ambiguous_positions);
+
+    cr_assert(!regex_analyze("a*b", REGEX_DEFAULT, &analysis), "Expected \"a*b\" to be analyzed.");
+    cr_assert(!analysis.is_literal, "Expected \"a*b\" not to be a literal.");
+    cr_assert(analysis.ambiguous_positions == 0, "Expected no ambiguous positions. Got %lu.", analysis.ambiguous_positions);
+
+    cr_assert(!regex_analyze("(a|b)*a(a|b){10}", REGEX_DEFAULT, &analysis), "Expected the pattern to be analyzed.");
+    cr_assert(analysis.ambiguous_positions == 11, "Expected 11 ambiguous positions. Got %lu.", analysis.ambiguous_positions);
+    cr_assert(analysis.dfa_states >= 1 << 11, "Expected at least 2048 DFA states. Got %lu.", analysis.dfa_states);
+
+    cr_assert(regex_analyze("a(", REGEX_DEFAULT, &analysis), "Expected an invalid pattern to be rejected.");
+}
+
+Test(regex_tests, regex_simplify_savings, .timeout = 5)
+{
+    struct simplify_case
+    {
+        const char *pattern;
+        size_t nodes_saved, states_saved;
+    } cases[] = {
+        { "(a*)*", 1, 2 },
+        { "a|a", 2, 4 },
+        { "a|b|c", 3, 6 },
+        { "aa*", 2, 0 },
+        { "(ab)*", 0, 0 },
+        { "(a{2})*", 0, 0 },
+    };
+
+    struct regex_simplification report;
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i)
+    {
+        cr_assert(!regex_simplify(cases[i].pattern, REGEX_DEFAULT, &report), "Expected \"%s\" to be simplified.",
+            cases[i].pattern);
+        cr_assert(report.nodes_saved == cases[i].nodes_saved && report.states_saved == cases[i].states_saved,
+            "Expected \"%s\" to save %lu nodes and %lu states. Got %lu and %lu.", cases[i].pattern,
+            cases[i].nodes_saved, cases[i].states_saved, report.nodes_saved, report.states_saved);
+    }
+    cr_assert(regex_simplify("a(", REGEX_DEFAULT, &report), "Expected an invalid pattern to be rejected.");
+
+    const char *patterns[] = { "((a*)*b|(a*)*b|c)", "(a{2})*(x|)(a?)*", "a|[a-c]|b" };
+    const char *matching[] = { "aaab", "aaaax", "c" };
+    const char *failing[] = { "aaa", "aaaxx", "d" };
+    for (size_t i = 0; i < sizeof(patterns) / sizeof(patterns[0]); ++i)
+    {
+        REGEX regex = regex_compile(patterns[i], REGEX_NFA);
+        cr_assert(regex_match(regex, matching[i]), "Expected \"%s\" to match \"%s\".", patterns[i], matching[i]);
+        cr_assert(!regex_match(regex, failing[i]), "Expected \"%s\" not to match \"%s\".", patterns[i], failing[i]);
+        regex_release(regex);
+    }
+}
+
+Test(regex_tests, regex_case_insensitive, .timeout = 5)
+{
+    struct icase_case
+    {
+        const char *pattern;
+        const char *input;
+        int expected;
+    } cases[] = {
+        { "hello", "HeLLo", 1 },
+        { "[a-c]+x", "aBcX", 1 },
+        { "[^a]", "A", 0 },
+        { "[^a]", "b", 1 },
+        { "[^A-Z]", "q", 0 },
+        { "\\W", "Q", 0 },
+        { "a.c", "ABC", 1 },
+        { "abc", "abd", 0 },
+    };
+
+    int engines[] = { REGEX_NFA, REGEX_DFA };
+    for (size_t e = 0; e < sizeof(engines) / sizeof(engines[0]); ++e)
+    {
+        for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i)
+        {
+            REGEX regex = regex_compile(cases[i].pattern, REGEX_ICASE | engines[e]);
+            cr_assert(regex != NULL, "Expected \"%s\" to compile.", cases[i].pattern);
+            int result = regex_match(regex, cases[i].input);
+            cr_assert(!result == !cases[i].expected, "Expected \"%s\" on \"%s\" to yield %d. Got %d.",
+                cases[i].pattern, cases[i].input, cases[i].expected, result);
+            regex_release(regex);
+        }
+    }
+
+    // the input is folded, so the automaton is not any larger than the case-sensitive one
+    NFA sensitive = nfa_construct(regex_parse("[a-z]+@(Foo|bar)\\.com", REGEX_DEFAULT));
+    NFA insensitive = nfa_construct(regex_parse("[a-z]+@(Foo|bar)\\.com", REGEX_ICASE));
+    cr_assert(nfa_count_states(insensitive) == nfa_count_states(sensitive), "Expected %lu states. Got %lu.",
+        nfa_count_states(sensitive), nfa_count_states(insensitive));
+    nfa_free(sensitive);
+    nfa_free(insensitive);
+
+    REGEX unicode = regex_compile("[α-ω]+ é", REGEX_ICASE | REGEX_UTF8 | REGEX_DFA);
+    cr_assert(regex_match(unicode, "ΛΟγος É"), "Expected greek and latin-1 letters to match in either case.");
+    cr_assert(!regex_match(unicode, "ΛΟγος E"), "Expected \"E\" not to match \"é\".");
+    regex_release(unicode);
+}
+
+Test(regex_tests, regex_plan_engine, .timeout = 5)
+{
+    struct plan_case
+    {
+        const char *pattern;
+        int flags;
+        enum regex_engine engine;
+    } cases[] = {
+        { "hello", REGEX_DEFAULT, REGEX_ENGINE_DFA },
+        { "[a-z]+@[a-z]+\\.com", REGEX_DEFAULT, REGEX_ENGINE_DFA },
+        { "(a|b)*a(a|b){12}", REGEX_DEFAULT, REGEX_ENGINE_TIERED },
+        { "(a|b)*a(a|b){40}", REGEX_DEFAULT, REGEX_ENGINE_NFA },
+        { "hello", REGEX_NFA, REGEX_ENGINE_NFA },
+        { "(a|b)*a(a|b){40}", REGEX_TIERED | REGEX_NFA, REGEX_ENGINE_NFA },
+    };
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i)
+    {
+        REGEX regex = regex_compile(cases[i].pattern, cases[i].flags);
+        cr_assert(regex_engine(regex) == cases[i].engine, "Expected \"%s\" to use engine %d. Got %d.",
+            cases[i].pattern, cases[i].engine, regex_engine(regex));
+        regex_wait_promotion(regex);
+        regex_release(regex);
+    }
+
+    REGEX regex = regex_compile("(a|b)*a(a|b){40}", REGEX_DEFAULT);
+    cr_assert(regex_match(regex, "b" "a" "ababababab" "ababababab" "ababababab" "ababababab"),
+        "Expected the NFA plan to match.");
+    regex_release(regex);
+}
+
+Test(regex_tests, regex_explain_plan, .timeout = 5)
+{
+    REGEX regex = regex_compile("(a|b)*a(a|b){40}", REGEX_DEFAULT);
+    char *explanation = regex_explain(regex);
+    cr_assert(strstr(explanation, "engine: nfa"), "Expected the explanation to name the engine. Got \"%s\".", explanation);
+    cr_assert(strstr(explanation, "exceeds the limit"), "Expected the explanation to give the reason. Got \"%s\".", explanation);
+    cr_assert(strstr(explanation, "memory: "), "Expected the explanation to report the memory. Got \"%s\".", explanation);
+    free(explanation);
+    regex_release(regex);
+
+    regex = regex_compile("hello", REGEX_DEFAULT);
+    explanation = regex_explain(regex);
+    cr_assert(strstr(explanation, "engine: dfa"), "Expected the explanation to name the engine. Got \"%s\".", explanation);
+    cr_assert(strstr(explanation, "literal of 5 bytes"), "Expected the explanation to give the reason. Got \"%s\".", explanation);
+    free(explanation);
+    regex_release(regex);
+}
+
+Test(regex_tests, regex_bitset_nfa, .timeout = 5)
+{
+    // an 'a' followed by 70 symbols
+    char input[128] = "bbba";
+    memset(input + 4, 'b', 70);
+
+    REGEX regex = regex_compile("(a|b)*a(a|b){70}", REGEX_DEFAULT);
+    char *explanation = regex_explain(regex);
+    cr_assert(strstr(explanation, "simulated as a bitset"), "Expected the NFA to be simulated as a bitset. Got \"%s\".",
+        explanation);
+    free(explanation);
+    cr_assert(regex_scratch_size(regex) == 0, "Expected a bitset NFA to need no scratch space. Got %lu bytes.",
+        regex_scratch_size(regex));
+    cr_assert(regex_match(regex, input), "Expected the bitset NFA to match.");
+    input[73] = '\0';
+    cr_assert(!regex_match(regex, input), "Expected \"%s\" to be rejected.", input);
+    input[73] = 'b';
+    regex_release(regex);
+
+    // the folding of case-insensitive regexes is part of the byte classes
+    memset(input + 4, 'B', 10);
+    regex = regex_compile("(A|B)*A(A|B){70}", REGEX_ICASE | REGEX_NFA);
+    cr_assert(regex_match(regex, input), "Expected the case-insensitive bitset NFA to match.");
+    regex_release(regex);
+}
+
+Test(regex_tests, regex_match_bytes, .timeout = 5)
+{
+    // every engine, including the bitset NFA and a case-insensitive DFA
+    const char *patterns[] = { "ab*c", "ab*c", "(a|b)*a(a|b){70}|ab*c", "AB*C" };
+    int flags[] = { REGEX_NFA, REGEX_DFA, REGEX_NFA, REGEX_ICASE | REGEX_DFA };
+    for (size_t p = 0; p < sizeof(patterns) / sizeof(patterns[0]); ++p)
+    {
+        REGEX regex = regex_compile(patterns[p], flags[p]);
+        cr_assert(regex_match_bytes(regex, "abbc", 4), "Expected \"%s\" to match \"abbc\".", patterns[p]);
+        cr_assert(regex_match_bytes(regex, "abbcx", 4), "Expected \"%s\" to match the first 4 bytes.", patterns[p]);
+        cr_assert(!regex_match_bytes(regex, "abbc", 3), "Expected \"%s\" to reject \"abb\".", patterns[p]);
+        // the 0 byte is part of the data
+        cr_assert(!regex_match_bytes(regex, "ac\0", 3), "Expected \"%s\" to reject a trailing 0 byte.", patterns[p]);
+        cr_assert(!regex_match_bytes(regex, "a\0bc", 4), "Expected \"%s\" to reject an inner 0 byte.", patterns[p]);
+        cr_assert(regex_match_bytes(regex, "ac\0", 2) == regex_match(regex, "ac"),
+            "Expected \"%s\" to agree with regex_match.", patterns[p]);
+        regex_release(regex);
+    }
+}
+
+// collects the offsets reported by a stream
+struct stream_matches
+{
+    size_t offsets[256];
+    size_t count;
+    // the number of matches after which the stream is stopped, zero to never stop
+    size_t stop_after;
+};
+
+static int collect_match(size_t offset, void *context)
+{
+    struct stream_matches *matches = context;
+    matches->offsets[matches->count++] = offset;
+    return matches->stop_after && matches->count == matches->stop_after;
+}
+
+Test(regex_tests, regex_stream_chunks, .timeout = 10)
+{
+    struct stream_case
+    {
+        const char *pattern;
+        int flags;
+        const char *input;
+    } cases[] = {
+        { "(ab|c)*", REGEX_DFA, "ababcabcx" },
+        { "(ab|c)*", REGEX_NFA, "ababcabcx" },
+        { "(a|b)*a(a|b){70}", REGEX_NFA, "a" "ababababab" "ababababab" "ababababab" "ababababab" "ababababab"
+            "ababababab" "ababababab" "ab" },
+        { "[a-z]+1", REGEX_ICASE | REGEX_NFA, "HeLLo1x" },
+        { "[a-z]+1", REGEX_ICASE | REGEX_DFA, "HeLLo1x" },
+    };
+
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); ++c)
+    {
+        REGEX regex = regex_compile(cases[c].pattern, cases[c].flags);
+        size_t length = strlen(cases[c].input);
+
+        // a prefix is matched iff the regex matches it as a whole
+        struct stream_matches expected = { .count = 0 };
+        char prefix[256];
+        for (size_t i = 0; i <= length; ++i)
+        {
+            memcpy(prefix, cases[c].input, i);
+            prefix[i] = '\0';
+            if (regex_match(regex, prefix)) expected.offsets[expected.count++] = i;
+        }
+
+        for (size_t chunk = 1; chunk <= length; chunk += 3)
+        {
+            struct stream_matches matches = { .count = 0 };
+            REGEX_STREAM stream = regex_stream_open(regex, collect_match, &matches);
+            for (size_t i = 0; i < length; i += chunk)
+                regex_stream_feed(stream, cases[c].input + i, i + chunk <= length ? chunk : length - i);
+            int matched = regex_stream_close(stream);
+
+            cr_assert(matched == regex_match(regex, cases[c].input), "Expected the stream of \"%s\" in chunks of %lu "
+                "to report %d. Got %d.", cases[c].pattern, chunk, regex_match(regex, cases[c].input), matched);
+            cr_assert(matches.count == expected.count, "Expected %lu matches of \"%s\" in chunks of %lu. Got %lu.",
+                expected.count, cases[c].pattern, chunk, matches.count);
+            for (size_t i = 0; i < matches.count; ++i)
+                cr_assert(matches.offsets[i] == expected.offsets[i], "Expected match %lu at offset %lu. Got %lu.",
+                    i, expected.offsets[i], matches.offsets[i]);
+        }
+        regex_release(regex);
+    }
+}
+
+Test(regex_tests, regex_stream_binary_and_stop, .timeout = 5)
+{
+    REGEX regex = regex_compile("a[^a]*", REGEX_DFA);
+
+    // the byte 0 is input like any other, no pattern matches it
+    struct stream_matches matches = { .count = 0 };
+    REGEX_STREAM stream = regex_stream_open(regex, collect_match, &matches);
+    regex_stream_feed(stream, "ab", 2);
+    regex_stream_feed(stream, "", 0);
+    regex_stream_feed(stream, "\0b", 2);
+    cr_assert(!regex_stream_close(stream), "Expected the stream not to match \"ab\\0b\".");
+    cr_assert(matches.count == 2, "Expected 2 matches. Got %lu.", matches.count);
+    cr_assert(matches.offsets[1] == 2, "Expected the last match at offset 2. Got %lu.", matches.offsets[1]);
+
+    // a dead stream keeps counting offsets without reporting
+    matches = (struct stream_matches){ .count = 0 };
+    stream = regex_stream_open(regex, collect_match, &matches);
+    regex_stream_feed(stream, "aa", 2);
+    regex_stream_feed(stream, "bbbb", 4);
+    cr_assert(!regex_stream_close(stream), "Expected the dead stream not to match.");
+    cr_assert(matches.count == 1 && matches.offsets[0] == 1, "Expected a single match at offset 1.");
+
+    // the callback stops the stream
+    matches = (struct stream_matches){ .count = 0, .stop_after = 2 };
+    stream = regex_stream_open(regex, collect_match, &matches);
+    cr_assert(regex_stream_feed(stream, "abbb", 4), "Expected the callback to stop the stream.");
+    cr_assert(regex_stream_feed(stream, "b", 1), "Expected a stopped stream to ignore input.");
+    cr_assert(!regex_stream_close(stream), "Expected a stopped stream not to report a match.");
+    cr_assert(matches.count == 2, "Expected 2 matches. Got %lu.", matches.count);
+    regex_release(regex);
+
+    // the empty input is reported on close
+    regex = regex_compile("a*", REGEX_DEFAULT);
+    matches = (struct stream_matches){ .count = 0 };
+    stream = regex_stream_open(regex, collect_match, &matches);
+    cr_assert(regex_stream_close(stream), "Expected the empty stream to match \"a*\".");
+    cr_assert(matches.count == 1 && matches.offsets[0] == 0, "Expected a single match at offset 0.");
+    regex_release(regex);
+}
+
+Test(regex_tests, regex_stream_snapshot, .timeout = 5)
+{
+    const char *input = "xyzabcabcxyzabc";
+    REGEX regex = regex_compile("[a-z]*abc", REGEX_DFA);
+
+    struct stream_matches expected = { .count = 0 };
+    REGEX_STREAM stream = regex_stream_open(regex, collect_match, &expected);
+    regex_stream_feed(stream, input, strlen(input));
+    regex_stream_close(stream);
+
+    // a stream is snapshotted after every chunk and continued on a separately compiled regex
+    REGEX other = regex_compile("[a-z]*abc", REGEX_DFA);
+    struct stream_matches matches = { .count = 0 };
+    unsigned char snapshot[REGEX_STREAM_SNAPSHOT_SIZE];
+    stream = regex_stream_open(regex, collect_match, &matches);
+    for (size_t i = 0; i < strlen(input); i += 4)
+    {
+        regex_stream_feed(stream, input + i, strlen(input + i) < 4 ? strlen(input + i) : 4);
+        cr_assert(!regex_stream_snapshot(stream, snapshot), "Expected a DFA stream to be snapshotted.");
+        regex_stream_discard(stream);
+        stream = regex_stream_restore(i % 8 ? regex : other, snapshot, collect_match, &matches);
+        cr_assert(stream != NULL, "Expected the snapshot after %lu bytes to be restored.", i);
+    }
+    cr_assert(regex_stream_close(stream), "Expected the restored stream to match the entire input.");
+    cr_assert(matches.count == expected.count, "Expected %lu matches. Got %lu.", expected.count, matches.count);
+    for (size_t i = 0; i < matches.count; ++i)
+        cr_assert(matches.offsets[i] == expected.offsets[i], "Expected match %lu at offset %lu. Got %lu.",
+            i, expected.offsets[i], matches.offsets[i]);
+    regex_release(other);
+
+    // snapshots only restore into the DFA they were taken of
+    other = regex_compile("[a-z]*abd", REGEX_DFA);
+    cr_assert(regex_stream_restore(other, snapshot, NULL, NULL) == NULL, "Expected a snapshot of another DFA to be rejected.");
+    regex_release(other);
+
+    other = regex_compile("[a-z]*abc", REGEX_NFA);
+    stream = regex_stream_open(other, NULL, NULL);
+    cr_assert(regex_stream_snapshot(stream, snapshot), "Expected an NFA stream not to be snapshotted.");
+    regex_stream_discard(stream);
+    regex_release(other);
+    regex_release(regex);
+}
+
+Test(regex_tests, regex_plan_fallback, .timeout = 30)
+{
+    // the repetition inside the alternative hides the blowup from the analysis
+    const char *pattern = "((a|b)*a|c)(a|b){16}";
+    struct regex_analysis analysis;
+    regex_analyze(pattern, REGEX_DEFAULT, &analysis);
+    cr_assert(analysis.dfa_states <= 1024, "Expected the analysis to underestimate the DFA. Got %lu states.",
+        analysis.dfa_states);
+
+    REGEX regex = regex_compile(pattern, REGEX_DEFAULT);
+    cr_assert(regex_engine(regex) == REGEX_ENGINE_NFA, "Expected the regex to fall back to the NFA. Got %d.",
+        regex_engine(regex));
+    cr_assert(regex_match(regex, "bbba" "abababababababab"), "Expected the fallback NFA to match.");
+
+    char *explanation = regex_explain(regex);
+    // the state or the time limit is exceeded depending on the speed of the machine
+    cr_assert(strstr(explanation, "construction exceeded the"), "Expected the explanation to report the limit. Got \"%s\".",
+        explanation);
+    free(explanation);
+    regex_release(regex);
+}
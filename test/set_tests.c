@@ -273,3 +273,88 @@ Test(set_tests, set_iterator_simple, .timeout = 5)
     }
     set_fini(set);
 }
+
+#define SET_CHURN_TEST_SIZE (1 << 6)
+#define SET_CHURN_TEST_ROUNDS (1 << 12)
+Test(set_tests, set_remove_churn, .timeout = 5)
+{
+    // removals must not leave anything behind that slows down or breaks later lookups
+    SET set = set_init();
+    for (size_t i = 1; i <= SET_CHURN_TEST_SIZE; ++i) set_add(set, PTR(i));
+
+    for (size_t round = 0; round < SET_CHURN_TEST_ROUNDS; ++round)
+    {
+        size_t removed = round % SET_CHURN_TEST_SIZE + 1 + round / SET_CHURN_TEST_SIZE * SET_CHURN_TEST_SIZE;
+        size_t added = removed + SET_CHURN_TEST_SIZE;
+        cr_assert(set_remove(set, PTR(removed)) == 0, "Expected %lu to be removed.", removed);
+        cr_assert(set_add(set, PTR(added)) == 0, "Expected %lu to be added.", added);
+        cr_assert(!set_contains(set, PTR(removed)), "Expected %lu to not be in the set.", removed);
+        cr_assert(set_size(set) == SET_CHURN_TEST_SIZE, "Expected size %d. Got %lu.", SET_CHURN_TEST_SIZE, set_size(set));
+    }
+
+    for (size_t i = 1; i <= SET_CHURN_TEST_ROUNDS + SET_CHURN_TEST_SIZE; ++i)
+    {
+        int expected = i > SET_CHURN_TEST_ROUNDS;
+        cr_assert(!set_contains(set, PTR(i)) == !expected, "Expected contains(%lu) to be %d.", i, expected);
+    }
+    set_fini(set);
+}
+
+#define SET_BULK_TEST_SIZE (1 << 10)
+Test(set_tests, set_bulk_in_place, .timeout = 5)
+{
+    SET A = set_init(), B = set_init(), C = set_init();
+    // A holds the multiples of 2, B the multiples of 3
+    for (size_t i = 1; i <= SET_BULK_TEST_SIZE; ++i)
+    {
+        if (i % 2 == 0) set_add(A, PTR(i));
+        if (i % 3 == 0) set_add(B, PTR(i));
+    }
+    set_union_with(C, A);
+
+    set_union_with(A, B);
+    set_intersect_with(C, B);
+    for (size_t i = 1; i <= SET_BULK_TEST_SIZE; ++i)
+    {
+        int in_union = i % 2 == 0 || i % 3 == 0, in_intersection = i % 6 == 0;
+        cr_assert(!set_contains(A, PTR(i)) == !in_union, "Expected contains(A, %lu) to be %d.", i, in_union);
+        cr_assert(!set_contains(C, PTR(i)) == !in_intersection, "Expected contains(C, %lu) to be %d.", i, in_intersection);
+    }
+    cr_assert(set_size(A) == SET_BULK_TEST_SIZE * 2 / 3 + 1, "Expected size %d. Got %lu.", SET_BULK_TEST_SIZE * 2 / 3 + 1, set_size(A));
+    cr_assert(set_size(C) == SET_BULK_TEST_SIZE / 6, "Expected size %d. Got %lu.", SET_BULK_TEST_SIZE / 6, set_size(C));
+
+    // intersecting with a disjoint set empties the set
+    SET D = set_init();
+    set_add(D, PTR(SET_BULK_TEST_SIZE + 1));
+    set_intersect_with(C, D);
+    cr_assert(set_size(C) == 0, "Expected an empty set. Got size %lu.", set_size(C));
+
+    set_fini(A);
+    set_fini(B);
+    set_fini(C);
+    set_fini(D);
+}
+
+#define SET_VIEW_TEST_SIZE (1 << 8)
+Test(set_tests, set_view_and_stack_iterator, .timeout = 5)
+{
+    SET set = set_init();
+    for (size_t i = 1; i <= SET_VIEW_TEST_SIZE; ++i) set_add(set, PTR(i));
+    // removals keep the values dense
+    for (size_t i = 1; i <= SET_VIEW_TEST_SIZE; i += 2) set_remove(set, PTR(i));
+
+    char flag[SET_VIEW_TEST_SIZE + 1] = { 0 };
+    void * const *values = set_view(set);
+    for (size_t i = 0; i < set_size(set); ++i) flag[INT(values[i])]++;
+
+    struct set_iterator iter;
+    set_iterator_begin(&iter, set);
+    while (set_iterator_has_next(&iter)) flag[INT(set_iterator_next(&iter))]++;
+
+    for (size_t i = 1; i <= SET_VIEW_TEST_SIZE; ++i)
+    {
+        int expected = i % 2 == 0 ? 2 : 0;
+        cr_assert(flag[i] == expected, "Expected %lu to be seen %d times. Got %d.", i, expected, flag[i]);
+    }
+    set_fini(set);
+}
@@ -216,4 +216,102 @@ Test(subset_construction_tests, subset_construct_2, .timeout = 5)
 
     nfa_free(nfa);
     dfa_free(dfa);
-}
\ No newline at end of file
+}
+
+// (a|b)*
+Test(subset_construction_tests, subset_construct_empty_string, .timeout = 5)
+{
+    NFA nfa = nfa_construct(
+        nfa_repeat(
+            nfa_union(
+                nfa_symbol('a'),
+                nfa_symbol('b')
+            )
+        )
+    );
+
+    DFA dfa = subset_construction(nfa);
+
+    int nfa_result = nfa_accept_cstr(nfa, "");
+    int dfa_result = dfa_accept_cstr(dfa, "");
+    cr_assert(nfa_result && dfa_result, "Expected NFA and DFA simulation for \"\" to accept. NFA = %d, DFA = %d", 
+        nfa_result, dfa_result);
+
+    nfa_free(nfa);
+    dfa_free(dfa);
+}
+
+/**
+ * Using the following regex:
+ *  [a-z]*m[\x{100}-\x{FFFF}]
+ */
+Test(subset_construction_tests, subset_construct_ranges, .timeout = 5)
+{
+    struct symbol_range letters = { 'a', 'z' }, wide = { 0x100, 0xFFFF };
+    NFA nfa = nfa_construct(
+        nfa_concat_va(3,
+            nfa_repeat(nfa_ranges(&letters, 1)),
+            nfa_symbol('m'),
+            nfa_ranges(&wide, 1)
+        )
+    );
+
+    DFA dfa = subset_construction(nfa);
+    cr_assert(dfa != NULL, "Expected the construction to succeed.");
+
+    // [a-z] is split around m, which has a transition of its own
+    DSTATE start = dfa_get_starting_state(dfa);
+    size_t sz;
+    const struct dstate_range_transition *ranges = dstate_view_range_transitions(start, &sz);
+    cr_assert(sz == 2, "Expected 2 range transitions out of the start. Got %lu.", sz);
+    cr_assert(ranges[0].lo == 'a' && ranges[0].hi == 'l', "Expected [a-l]. Got [%d-%d].", ranges[0].lo, ranges[0].hi);
+    cr_assert(ranges[1].lo == 'n' && ranges[1].hi == 'z', "Expected [n-z]. Got [%d-%d].", ranges[1].lo, ranges[1].hi);
+    cr_assert(dstate_count_transition_symbols(start) == 1, "Expected a single symbol transition on 'm'.");
+
+    SYMBOL accepted[] = { 'a', 'b', 'm', 0x4b00, 0 };
+    SYMBOL rejected[] = { 'a', 'b', 'm', 0x10000, 0 };
+    cr_assert(dfa_accept(dfa, accepted) && nfa_accept(nfa, accepted), "Expected the wide string to be accepted.");
+    cr_assert(!dfa_accept(dfa, rejected) && !nfa_accept(nfa, rejected), "Expected the wide string to be rejected.");
+
+    dfa_free(dfa);
+    nfa_free(nfa);
+}
+
+// (a|b)*a(a|b){10} has at least 2^11 DFA states
+static NFA blowup_nfa()
+{
+    return nfa_construct(
+        nfa_concat_va(3,
+            nfa_repeat(nfa_union(nfa_symbol('a'), nfa_symbol('b'))),
+            nfa_symbol('a'),
+            nfa_repeat_exact(nfa_union(nfa_symbol('a'), nfa_symbol('b')), 10)
+        )
+    );
+}
+
+Test(subset_construction_tests, subset_construct_state_limit, .timeout = 10)
+{
+    SUBSET_STATUS status;
+    NFA nfa = blowup_nfa();
+
+    struct subset_construction_options options = { .max_states = 256 };
+    DFA dfa = subset_construction_limited(nfa, &options, &status);
+    cr_assert(dfa == NULL, "Expected the construction to give up.");
+    cr_assert(status == SUBSET_STATE_LIMIT, "Expected SUBSET_STATE_LIMIT. Got %d.", status);
+
+    options = (struct subset_construction_options){ .max_memory = 64 * 1024 };
+    dfa = subset_construction_limited(nfa, &options, &status);
+    cr_assert(dfa == NULL, "Expected the construction to give up.");
+    cr_assert(status == SUBSET_MEMORY_LIMIT, "Expected SUBSET_MEMORY_LIMIT. Got %d.", status);
+
+    options = (struct subset_construction_options){ .max_states = 4096 };
+    dfa = subset_construction_limited(nfa, &options, &status);
+    cr_assert(dfa != NULL, "Expected the construction to stay within the limit.");
+    cr_assert(status == SUBSET_SUCCESS, "Expected SUBSET_SUCCESS. Got %d.", status);
+    cr_assert(dfa_count_states(dfa) >= 1 << 11, "Expected at least 2048 states. Got %lu.", dfa_count_states(dfa));
+    cr_assert(dfa_accept_cstr(dfa, "babbbbbbbbbb") == nfa_accept_cstr(nfa, "babbbbbbbbbb"),
+        "Expected the NFA and the DFA to agree.");
+
+    dfa_free(dfa);
+    nfa_free(nfa);
+}
@@ -0,0 +1,89 @@
+#include <criterion/criterion.h>
+
+#include <string.h>
+
+#include "regex/regex.h"
+#include "regex/utf8.h"
+
+Test(utf8_tests, utf8_encode_decode, .timeout = 5)
+{
+    SYMBOL codepoints[] = { 0x1, 0x7F, 0x80, 0x7FF, 0x800, 0xD7FF, 0xE000, 0xFFFF, 0x10000, 0x10FFFF };
+    size_t lengths[] = { 1, 1, 2, 2, 3, 3, 3, 3, 4, 4 };
+
+    for (size_t i = 0; i < sizeof(codepoints) / sizeof(codepoints[0]); ++i)
+    {
+        char buffer[UTF8_MAX_LENGTH + 1] = { 0 };
+        size_t length = utf8_encode(codepoints[i], (unsigned char*) buffer);
+        cr_assert(length == lengths[i], "Expected U+%X to encode into %lu bytes. Got %lu.", codepoints[i], lengths[i], length);
+
+        const char *cursor = buffer;
+        SYMBOL decoded;
+        cr_assert(!utf8_decode(&cursor, &decoded), "Expected the encoding of U+%X to decode.", codepoints[i]);
+        cr_assert(decoded == codepoints[i], "Expected U+%X. Got U+%X.", codepoints[i], decoded);
+        cr_assert(cursor == buffer + length, "Expected the cursor to move past the encoding of U+%X.", codepoints[i]);
+    }
+
+    unsigned char buffer[UTF8_MAX_LENGTH];
+    cr_assert(!utf8_encode(0xD800, buffer), "Expected surrogates to have no encoding.");
+    cr_assert(!utf8_encode(0x110000, buffer), "Expected codepoints above U+10FFFF to have no encoding.");
+
+    const char *invalid[] = { "\xC0\xAF", "\xE0\x80\xAF", "\xED\xA0\x80", "\xE2\x82", "\x80", "\xF8\x88\x80\x80\x80" };
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); ++i)
+    {
+        const char *cursor = invalid[i];
+        SYMBOL decoded;
+        cr_assert(utf8_decode(&cursor, &decoded), "Expected invalid sequence %lu to be rejected.", i);
+        cr_assert(cursor == invalid[i], "Expected the cursor not to move on invalid sequence %lu.", i);
+    }
+}
+
+Test(utf8_tests, utf8_ranges_every_length, .timeout = 5)
+{
+    // a range spanning every encoding length and the surrogates
+    struct symbol_range range = { 0x70, 0x10010 };
+    NFA nfa = nfa_construct(utf8_ranges(&range, 1));
+    cr_assert(nfa != NULL, "Expected the ranges to construct.");
+
+    SYMBOL probes[] = { 0x6F, 0x70, 0x7F, 0x80, 0x7FF, 0x800, 0xD7FF, 0xE000, 0xFFFF, 0x10000, 0x10010, 0x10011 };
+    int expected[] = { 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0 };
+    for (size_t i = 0; i < sizeof(probes) / sizeof(probes[0]); ++i)
+    {
+        char buffer[UTF8_MAX_LENGTH + 1] = { 0 };
+        utf8_encode(probes[i], (unsigned char*) buffer);
+        int result = nfa_accept_cstr(nfa, buffer);
+        cr_assert(result == expected[i], "Expected U+%X to be %s.", probes[i], expected[i] ? "accepted" : "rejected");
+    }
+
+    // a surrogate encoded as if it were a codepoint is never matched
+    cr_assert(!nfa_accept_cstr(nfa, "\xED\xA0\x80"), "Expected an encoded surrogate to be rejected.");
+    nfa_free(nfa);
+}
+
+Test(utf8_tests, utf8_regex_match, .timeout = 5)
+{
+    int engines[] = { REGEX_NFA, REGEX_DFA };
+    for (size_t e = 0; e < sizeof(engines) / sizeof(engines[0]); ++e)
+    {
+        REGEX greek = regex_compile("[α-ω]+ς?", REGEX_UTF8 | engines[e]);
+        cr_assert(greek != NULL, "Expected \"[α-ω]+ς?\" to compile.");
+        cr_assert(regex_match(greek, "λόγος") == 0, "Expected \"λόγος\" to be rejected (ό is outside α-ω).");
+        cr_assert(regex_match(greek, "λογος") == 1, "Expected \"λογος\" to match.");
+        cr_assert(regex_match(greek, "\xCE") == 0, "Expected a truncated encoding to be rejected.");
+        regex_release(greek);
+
+        REGEX any = regex_compile("a.b", REGEX_UTF8 | engines[e]);
+        cr_assert(any != NULL, "Expected \"a.b\" to compile.");
+        cr_assert(regex_match(any, "a€b") == 1, "Expected the wildcard to match a three byte codepoint.");
+        cr_assert(regex_match(any, "a\U0001F600b") == 1, "Expected the wildcard to match a four byte codepoint.");
+        cr_assert(regex_match(any, "a\xE2\x82\xACxb") == 0, "Expected the wildcard to match exactly one codepoint.");
+        regex_release(any);
+
+        REGEX negated = regex_compile("[^a]\\x{E9}", REGEX_UTF8 | engines[e]);
+        cr_assert(negated != NULL, "Expected \"[^a]\\x{E9}\" to compile.");
+        cr_assert(regex_match(negated, "日é") == 1, "Expected \"日é\" to match.");
+        cr_assert(regex_match(negated, "a\xC3\xA9") == 0, "Expected \"aé\" to be rejected.");
+        regex_release(negated);
+    }
+
+    cr_assert(regex_compile("\xC3", REGEX_UTF8) == NULL, "Expected a pattern with invalid UTF-8 to be rejected.");
+}
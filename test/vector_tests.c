@@ -0,0 +1,47 @@
+#include <stdint.h>
+
+#include <criterion/criterion.h>
+
+#include "utility/vector.h"
+#include "utility/smallvector.h"
+
+DECLARE_VECTOR(U32_VECTOR, u32_vector, uint32_t)
+DECLARE_SMALL_VECTOR(U32_SMALL_VECTOR, u32_small_vector, uint32_t, 4)
+
+#define VECTOR_TEST_SIZE (1 << 10)
+Test(vector_tests, vector_push_pop, .timeout = 5)
+{
+    U32_VECTOR vector;
+    u32_vector_init(&vector);
+    for (uint32_t i = 0; i < VECTOR_TEST_SIZE; ++i) u32_vector_push(&vector, i);
+    cr_assert(vector.size == VECTOR_TEST_SIZE, "Expected size %d. Got %lu.", VECTOR_TEST_SIZE, vector.size);
+
+    for (uint32_t i = 0; i < VECTOR_TEST_SIZE; ++i)
+        cr_assert(vector.data[i] == i, "Expected %u at %u. Got %u.", i, i, vector.data[i]);
+    for (uint32_t i = VECTOR_TEST_SIZE; i-- > 0;)
+    {
+        uint32_t value = u32_vector_pop(&vector);
+        cr_assert(value == i, "Expected to pop %u. Got %u.", i, value);
+    }
+
+    u32_vector_push(&vector, 7);
+    u32_vector_clear(&vector);
+    cr_assert(vector.size == 0, "Expected an empty vector. Got size %lu.", vector.size);
+    u32_vector_fini(&vector);
+}
+
+Test(vector_tests, small_vector_spill, .timeout = 5)
+{
+    U32_SMALL_VECTOR vector;
+    u32_small_vector_init(&vector);
+    for (uint32_t i = 0; i < 4; ++i) u32_small_vector_push(&vector, i);
+    cr_assert(vector.heap == NULL, "Expected the elements to be stored inline.");
+
+    for (uint32_t i = 4; i < VECTOR_TEST_SIZE; ++i) u32_small_vector_push(&vector, i);
+    cr_assert(vector.heap != NULL, "Expected the elements to spill to the heap.");
+
+    uint32_t *data = u32_small_vector_data(&vector);
+    for (uint32_t i = 0; i < VECTOR_TEST_SIZE; ++i)
+        cr_assert(data[i] == i, "Expected %u at %u. Got %u.", i, i, data[i]);
+    u32_small_vector_fini(&vector);
+}